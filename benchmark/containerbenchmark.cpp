@@ -0,0 +1,308 @@
+/*
+ * Host-side benchmark of the containers in include/common against the fixed
+ * arrays and linear scans they replaced in the kernel. Built and run for the
+ * machine running make with 'make benchmark' (no optimisation, like the kernel).
+ *
+ * The containers are header-only and freestanding; the host only has to supply
+ * memory (HostAllocator, through the containers' 'Allocator' parameter) and the
+ * placement new that memorymanagement.h declares.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <common/hashmap.h>
+#include <common/bitmap.h>
+#include <common/minheap.h>
+#include <common/intrusivelist.h>
+
+/*
+ * Only the container names are imported: the host's C headers have their own
+ * size_t and uint32_t, which would clash with the ones in 'myos::common'.
+ */
+using myos::common::HashMap;
+using myos::common::DefaultHash;
+using myos::common::Bitmap;
+using myos::common::MinHeap;
+using myos::common::DefaultLess;
+using myos::common::IntrusiveList;
+using myos::common::IntrusiveListNode;
+
+typedef unsigned long long Key;
+
+
+// Placement new as the kernel defines it (memorymanagement.cpp isn't linked in).
+void* operator new(myos::common::size_t size, void* ptr)
+{
+    return ptr;
+}
+
+// The host heap, in the shape of KernelAllocator.
+struct HostAllocator
+{
+    static void* Allocate(myos::common::size_t size) { return malloc(size); }
+    static void Free(void* pointer) { free(pointer); }
+};
+
+/*
+ * Clock:
+ *  Nanoseconds since some fixed point in the past.
+ */
+static unsigned long long Clock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+ * Random:
+ *  A xorshift generator, so every run (and both sides of a comparison) see the
+ *  same sequence.
+ */
+static unsigned int randomState = 2463534242u;
+static unsigned int Random()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// Keeps results alive, so no loop is thrown away as dead code.
+static volatile unsigned long long sink;
+
+/*
+ * PrintResult:
+ *  Prints the cost of one operation of the container and of the scan it replaced.
+ */
+static void PrintResult(const char* what, unsigned int n, unsigned long long containerNs,
+                        unsigned long long scanNs, unsigned int operations)
+{
+    printf("  N=%-6u %-14s %8.1f ns   linear scan %8.1f ns\n", n, what,
+           (double)containerNs / operations, (double)scanNs / operations);
+}
+
+
+/*
+ * BenchmarkHashMap:
+ *  Socket lookups: keys packed like PortAllocator::SocketKey (remote IP, remote
+ *  port, local port), looked up in a HashMap and in an array of (key, value)
+ *  pairs scanned from the front, as the ARP cache and socket tables were.
+ */
+static void BenchmarkHashMap(unsigned int n)
+{
+    const unsigned int lookups = 200000;
+
+    struct Pair { Key key; int value; };
+    Pair* pairs = (Pair*)malloc(n * sizeof(Pair));
+    HashMap<Key, int, DefaultHash<Key>, HostAllocator> map;
+    for(unsigned int i = 0; i < n; i++)
+    {
+        Key ip = 0x0A000000u | (Random() & 0xFFFFFF);
+        pairs[i].key = (ip << 32) | ((Key)(Random() & 0xFFFF) << 16) | (1024 + i);
+        pairs[i].value = i;
+        map.Insert(pairs[i].key, i);
+    }
+
+    unsigned int* order = (unsigned int*)malloc(lookups * sizeof(unsigned int));
+    for(unsigned int i = 0; i < lookups; i++)
+        order[i] = Random() % n;
+
+    unsigned long long start = Clock();
+    for(unsigned int i = 0; i < lookups; i++)
+        sink += *map.Find(pairs[order[i]].key);
+    unsigned long long containerNs = Clock() - start;
+
+    start = Clock();
+    for(unsigned int i = 0; i < lookups; i++)
+    {
+        Key key = pairs[order[i]].key;
+        for(unsigned int j = 0; j < n; j++)
+            if(pairs[j].key == key)
+            {
+                sink += pairs[j].value;
+                break;
+            }
+    }
+    unsigned long long scanNs = Clock() - start;
+
+    PrintResult("hashmap", n, containerNs, scanNs, lookups);
+    free(order);
+    free(pairs);
+}
+
+
+/*
+ * BenchmarkBitmap:
+ *  Ephemeral port allocation with the first 'n' ports above 1024 in use: the
+ *  next clear bit of a Bitmap against the first empty entry of a table with
+ *  one pointer per port, like the old sockets[65535].
+ */
+static void BenchmarkBitmap(unsigned int n)
+{
+    const unsigned int searches = 2000;
+
+    Bitmap<65536>* ports = new (malloc(sizeof(Bitmap<65536>))) Bitmap<65536>();
+    void** sockets = (void**)calloc(65536, sizeof(void*));
+    for(unsigned int port = 1024; port < 1024 + n; port++)
+    {
+        ports->Set(port);
+        sockets[port] = ports;
+    }
+
+    unsigned long long start = Clock();
+    for(unsigned int i = 0; i < searches; i++)
+        sink += ports->FindFirstClear(1024);
+    unsigned long long containerNs = Clock() - start;
+
+    start = Clock();
+    for(unsigned int i = 0; i < searches; i++)
+    {
+        unsigned int port = 1024;
+        while(port < 65536 && sockets[port] != 0)
+            port++;
+        sink += port;
+    }
+    unsigned long long scanNs = Clock() - start;
+
+    PrintResult("bitmap", n, containerNs, scanNs, searches);
+    free(sockets);
+    free(ports);
+}
+
+
+/*
+ * BenchmarkMinHeap:
+ *  Timer-style use: take the earliest deadline and put a later one back. The
+ *  MinHeap pops and pushes; the array is scanned for its minimum, which is
+ *  then overwritten.
+ */
+static void BenchmarkMinHeap(unsigned int n)
+{
+    const unsigned int operations = 100000;
+
+    MinHeap<unsigned int, DefaultLess<unsigned int>, HostAllocator> heap;
+    unsigned int* deadlines = (unsigned int*)malloc(n * sizeof(unsigned int));
+    for(unsigned int i = 0; i < n; i++)
+    {
+        deadlines[i] = Random() % 100000;
+        heap.Push(deadlines[i]);
+    }
+
+    unsigned int state = randomState;
+    unsigned long long start = Clock();
+    for(unsigned int i = 0; i < operations; i++)
+    {
+        unsigned int earliest;
+        heap.Pop(earliest);
+        heap.Push(earliest + 1 + Random() % 1000);
+        sink += earliest;
+    }
+    unsigned long long containerNs = Clock() - start;
+
+    randomState = state;
+    start = Clock();
+    for(unsigned int i = 0; i < operations; i++)
+    {
+        unsigned int smallest = 0;
+        for(unsigned int j = 1; j < n; j++)
+            if(deadlines[j] < deadlines[smallest])
+                smallest = j;
+        unsigned int earliest = deadlines[smallest];
+        deadlines[smallest] = earliest + 1 + Random() % 1000;
+        sink += earliest;
+    }
+    unsigned long long scanNs = Clock() - start;
+
+    PrintResult("minheap", n, containerNs, scanNs, operations);
+    free(deadlines);
+}
+
+
+/*
+ * BenchmarkIntrusiveList:
+ *  Removing a given object and adding it back at the end, as tasks and drivers
+ *  come and go. The IntrusiveList unlinks through the object's node; the array
+ *  of pointers (like the old tasks[256]) is searched for the object and the
+ *  rest of it is shifted down.
+ */
+struct ListItem
+{
+    IntrusiveListNode node;
+    unsigned int id;
+};
+
+static void BenchmarkIntrusiveList(unsigned int n)
+{
+    const unsigned int operations = 100000;
+
+    ListItem* items = (ListItem*)malloc(n * sizeof(ListItem));
+    ListItem** array = (ListItem**)malloc(n * sizeof(ListItem*));
+    IntrusiveList<ListItem, &ListItem::node> list;
+    for(unsigned int i = 0; i < n; i++)
+    {
+        new (&items[i]) ListItem();
+        items[i].id = i;
+        list.PushBack(&items[i]);
+        array[i] = &items[i];
+    }
+
+    unsigned int* order = (unsigned int*)malloc(operations * sizeof(unsigned int));
+    for(unsigned int i = 0; i < operations; i++)
+        order[i] = Random() % n;
+
+    unsigned long long start = Clock();
+    for(unsigned int i = 0; i < operations; i++)
+    {
+        ListItem* item = &items[order[i]];
+        list.Remove(item);
+        list.PushBack(item);
+        sink += item->id;
+    }
+    unsigned long long containerNs = Clock() - start;
+
+    start = Clock();
+    for(unsigned int i = 0; i < operations; i++)
+    {
+        ListItem* item = &items[order[i]];
+        unsigned int j = 0;
+        while(array[j] != item)
+            j++;
+        for(; j + 1 < n; j++)
+            array[j] = array[j + 1];
+        array[n - 1] = item;
+        sink += item->id;
+    }
+    unsigned long long scanNs = Clock() - start;
+
+    PrintResult("intrusivelist", n, containerNs, scanNs, operations);
+    free(order);
+    free(array);
+    free(items);
+}
+
+
+int main()
+{
+    const unsigned int sizes[] = { 16, 128, 1024 };
+    const unsigned int portsInUse[] = { 16, 1024, 16384 };
+
+    printf("HashMap lookup vs. scanning (key, value) pairs:\n");
+    for(unsigned int i = 0; i < 3; i++)
+        BenchmarkHashMap(sizes[i]);
+
+    printf("Bitmap free port search vs. scanning a pointer per port:\n");
+    for(unsigned int i = 0; i < 3; i++)
+        BenchmarkBitmap(portsInUse[i]);
+
+    printf("MinHeap pop and push vs. scanning for the minimum:\n");
+    for(unsigned int i = 0; i < 3; i++)
+        BenchmarkMinHeap(sizes[i]);
+
+    printf("IntrusiveList remove and append vs. array search and shift:\n");
+    for(unsigned int i = 0; i < 3; i++)
+        BenchmarkIntrusiveList(sizes[i]);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#ifndef __MYOS__COMMON__BITMAP_H                  // Header guard to prevent multiple inclusions
+#define __MYOS__COMMON__BITMAP_H
+
+#include <common/types.h>                         // Provides fixed-size integer types
+
+namespace myos
+{
+    namespace common
+    {
+        /*
+         * Bitmap:
+         *  'Bits' bits (all clear at first) stored in 32-bit words, e.g. one bit per port
+         *  number or per IRQ vector. The searches skip a whole word at a time when it has
+         *  nothing to offer. The storage is part of the object; nothing is allocated.
+         */
+        template<size_t Bits>
+        class Bitmap
+        {
+        protected:
+            enum { WordCount = (Bits + 31) / 32 };
+            uint32_t words[WordCount];
+
+            // Index of the first set bit in 'words' at 'from' or later (inverted if 'invert'), or -1.
+            int32_t Find(size_t from, bool invert) const
+            {
+                if(from >= Bits)
+                    return -1;
+                uint32_t flip = invert ? 0xFFFFFFFF : 0;
+                size_t word = from / 32;
+                uint32_t bits = (words[word] ^ flip) & (0xFFFFFFFF << (from % 32));
+                while(true)
+                {
+                    if(bits != 0)
+                    {
+                        size_t index = word * 32 + __builtin_ctz(bits);
+                        return index < Bits ? (int32_t)index : -1;
+                    }
+                    if(++word >= WordCount)
+                        return -1;
+                    bits = words[word] ^ flip;
+                }
+            }
+
+        public:
+            Bitmap() { ClearAll(); }
+
+            size_t Size() const { return Bits; }
+
+            bool Test(size_t bit) const { return (words[bit / 32] >> (bit % 32)) & 1; }
+            void Set(size_t bit) { words[bit / 32] |= (uint32_t)1 << (bit % 32); }
+            void Clear(size_t bit) { words[bit / 32] &= ~((uint32_t)1 << (bit % 32)); }
+
+            void ClearAll()
+            {
+                for(size_t i = 0; i < WordCount; i++)
+                    words[i] = 0;
+            }
+
+            // Number of set bits.
+            size_t Count() const
+            {
+                size_t count = 0;
+                for(size_t i = 0; i < WordCount; i++)
+                    count += __builtin_popcount(words[i]);
+                return count;
+            }
+
+            // Index of the first set / clear bit at 'from' or later, or -1 if there is none.
+            int32_t FindFirstSet(size_t from = 0) const { return Find(from, false); }
+            int32_t FindFirstClear(size_t from = 0) const { return Find(from, true); }
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__BITMAP_H
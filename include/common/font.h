@@ -0,0 +1,55 @@
+#ifndef __MYOS__COMMON__FONT_H             // Header guard to prevent multiple inclusions of this file
+#define __MYOS__COMMON__FONT_H
+
+#include <common/types.h>                  // Provides fixed-size integer types
+
+namespace myos
+{
+    namespace common
+    {
+        /*
+         * Font:
+         *  A bitmap font with glyphs 8 pixels wide, stored like the PC's VGA fonts (and PSF files):
+         *  one byte per row, the leftmost pixel in the highest bit.
+         *
+         *  The glyphs cover a contiguous range of characters; characters outside that range are
+         *  drawn with the glyph of '?'. 'builtin' is an 8x16 font for printable ASCII, compiled
+         *  into the kernel so text works without a filesystem.
+         */
+        class Font
+        {
+        protected:
+            // 'count' glyphs of 'height' bytes each, starting with character 'first'.
+            const uint8_t* glyphs;
+            uint8_t first;
+            uint16_t count;
+            int32_t height;
+
+        public:
+            /*
+             * Constructor:
+             *  Wraps glyph data that stays valid for the lifetime of the font.
+             */
+            Font(const uint8_t* glyphs, uint8_t first, uint16_t count, int32_t height);
+            ~Font();
+
+            // The 8x16 ASCII font compiled into the kernel.
+            static Font builtin;
+
+            // Width of every glyph (always 8) and height of every glyph in pixels.
+            int32_t GetWidth();
+            int32_t GetHeight();
+
+            // Returns the character's position in the glyph table (unknown characters give '?').
+            uint16_t GetGlyphIndex(char c);
+
+            // Returns the rows of the glyph at 'index' (as returned by GetGlyphIndex).
+            const uint8_t* GetGlyph(uint16_t index);
+
+            // Number of glyphs in the font.
+            uint16_t GetGlyphCount();
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__FONT_H
@@ -0,0 +1,83 @@
+#ifndef __MYOS__COMMON__GLYPHCACHE_H       // Header guard to prevent multiple inclusions of this file
+#define __MYOS__COMMON__GLYPHCACHE_H
+
+#include <common/types.h>                  // Provides fixed-size integer types
+#include <common/graphicscontext.h>        // The contexts text is drawn into
+#include <common/surface.h>                // Atlases holding the expanded glyphs
+#include <common/region.h>                 // Clip lists
+#include <common/font.h>                   // The bitmap font being cached
+
+namespace myos
+{
+    namespace common
+    {
+        /*
+         * GlyphCache:
+         *  Draws text of one font quickly by never looking at font bits while drawing.
+         *
+         *  For every combination of foreground color, background color and pixel format in use,
+         *  the cache keeps an "atlas": a surface with all glyphs of the font side by side, already
+         *  expanded into native pixels of those colors. Drawing a string then only copies pixel
+         *  rows out of the atlas, one row of the whole string at a time.
+         *
+         *  A few atlases are kept; the least recently used one is replaced when a new color pair
+         *  shows up. If the heap is full, text is still drawn, just pixel by pixel.
+         */
+        class GlyphCache
+        {
+        protected:
+            // Number of color combinations kept at the same time.
+            enum { NumAtlases = 8 };
+
+            // One cached color combination.
+            struct Atlas
+            {
+                Surface* surface;       // All glyphs in a row (0 if the slot is unused)
+                uint32_t foreground;    // Native colors the glyphs were expanded with
+                uint32_t background;
+                uint32_t lastUse;       // Value of 'useCounter' when last drawn with
+            };
+
+            Font* font;
+            Atlas atlases[NumAtlases];
+            uint32_t useCounter;
+
+            // Finds or builds the atlas for these colors in the format of 'gc' (0 if out of memory).
+            Surface* GetAtlas(GraphicsContext* gc, uint32_t foreground, uint32_t background);
+
+            // Destroys the surface of one slot.
+            void FreeAtlas(Atlas* atlas);
+
+        public:
+            /*
+             * Constructor:
+             *  Creates an empty cache for 'font' and makes it the active one.
+             */
+            GlyphCache(Font* font);
+
+            // Destructor: frees all atlases.
+            ~GlyphCache();
+
+            // The cache used by text widgets (the most recently created one).
+            static GlyphCache* activeGlyphCache;
+
+            // Returns the font drawn by this cache.
+            Font* GetFont();
+
+            /*
+             * DrawText:
+             *  Draws 'length' characters of 'text' with the top-left corner at (x, y), only inside
+             *  'clip'. Colors are native (see GraphicsContext::MapColor); every glyph cell is
+             *  filled completely, with 'background' behind the glyph.
+             */
+            void DrawText(GraphicsContext* gc, Region* clip, int32_t x, int32_t y,
+                          const char* text, int32_t length,
+                          uint32_t foreground, uint32_t background);
+
+            // Frees all atlases (e.g. after a mode switch changed the pixel format).
+            void Flush();
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__GLYPHCACHE_H
@@ -1,15 +1,148 @@
 #ifndef __MYOS__COMMON__GRAPHICSCONTEXT_H  // Header guard to prevent multiple inclusions of this file
 #define __MYOS__COMMON__GRAPHICSCONTEXT_H  // Defines the unique macro for this header file
 
-#include <drivers/vga.h>  // Includes the definition/declaration of the VideoGraphicsArray class
+#include <common/types.h>                  // Provides fixed-size integer types (int32_t, uint32_t, etc.)
 
 namespace myos
 {
     namespace common
     {
-        // This typedef creates a shorter alias 'GraphicsContext' for 'myos::drivers::VideoGraphicsArray'.
-        // It allows code to refer to VideoGraphicsArray functionality using 'GraphicsContext'.
-        typedef myos::drivers::VideoGraphicsArray GraphicsContext;
+        /*
+         * PixelFormat:
+         *  How a pixel is stored in memory.
+         *   - Indexed8: one byte per pixel, an index into a 256 color palette
+         *   - XRGB8888: four bytes per pixel, 0x00RRGGBB
+         *   - ARGB8888: four bytes per pixel, 0xAARRGGBB (alpha 0xFF = opaque)
+         */
+        enum PixelFormat
+        {
+            Indexed8 = 0,
+            XRGB8888 = 1,
+            ARGB8888 = 2
+        };
+
+
+        /*
+         * GraphicsContext:
+         *  Anything that can be drawn on: the screen of a video driver or an in-memory Surface.
+         *
+         *  A context describes its pixels as a block of memory (address, size, bytes per row and
+         *  pixel format). All drawing primitives are implemented here in software on top of that
+         *  memory, so a driver only has to point the context at its framebuffer when a mode is set.
+         *  The primitives are virtual, so a driver with hardware acceleration can override them.
+         *
+         *  Colors passed as a single uint32_t are "native" colors of the context (a palette index
+         *  for Indexed8, the packed value otherwise); MapColor converts RGB to native. Converting
+         *  once and drawing with the native value avoids a color lookup per pixel.
+         *
+         *  All primitives clip against the context, so coordinates may lie partly off-screen.
+         */
+        class GraphicsContext
+        {
+        protected:
+            // First pixel of the top row, or 0 if no mode/memory is set up yet.
+            uint8_t* pixels;
+
+            // Size in pixels and distance between two rows in bytes.
+            int32_t width;
+            int32_t height;
+            int32_t pitch;
+
+            // Layout of a pixel in memory.
+            PixelFormat format;
+
+            // For Indexed8: 256 entries of 0x00RRGGBB, used when blitting into a 32 bit context
+            // (0 if unknown; indices are then shown as grey levels).
+            uint32_t* palette;
+
+            /*
+             * SetPixelBuffer:
+             *  (Re)describes the memory the context draws into.
+             */
+            void SetPixelBuffer(uint8_t* pixels, int32_t width, int32_t height, int32_t pitch, PixelFormat format);
+
+            /*
+             * ClipBlit:
+             *  Clips a copy of the w x h block at (sx, sy) in 'source' to (dx, dy) in this
+             *  context against both bounds. Returns false if nothing is left to copy.
+             */
+            bool ClipBlit(GraphicsContext* source, int32_t& sx, int32_t& sy,
+                          int32_t& w, int32_t& h, int32_t& dx, int32_t& dy);
+
+            /*
+             * ToRGB / FromRGB:
+             *  Convert between a pixel of a given format and 0x00RRGGBB.
+             */
+            static uint32_t ToRGB(uint32_t pixel, PixelFormat format, uint32_t* palette);
+            uint32_t FromRGB(uint32_t rgb);
+
+        public:
+            GraphicsContext();
+            ~GraphicsContext();
+
+            // Accessors for the pixel memory description.
+            int32_t GetWidth();
+            int32_t GetHeight();
+            int32_t GetPitch();
+            PixelFormat GetFormat();
+            uint8_t* GetPixels();
+            uint32_t* GetPalette();
+
+            /*
+             * MapColor:
+             *  Returns the native color value closest to (r, g, b) for this context.
+             *  Indexed contexts without a palette map everything to index 0.
+             */
+            virtual uint32_t MapColor(uint8_t r, uint8_t g, uint8_t b);
+
+            /*
+             * PutPixel / GetPixel:
+             *  Single pixel access; the RGB overload maps the color first.
+             */
+            virtual void PutPixel(int32_t x, int32_t y, uint8_t r, uint8_t g, uint8_t b);
+            virtual void PutPixel(int32_t x, int32_t y, uint32_t color);
+            virtual uint32_t GetPixel(int32_t x, int32_t y);
+
+            /*
+             * FillSpan:
+             *  Fills 'length' pixels of row y, starting at x, with a native color.
+             *  This is the building block of all solid fills.
+             */
+            virtual void FillSpan(int32_t x, int32_t y, int32_t length, uint32_t color);
+
+            /*
+             * FillRectangle:
+             *  Fills a w x h rectangle at (x, y), either with an RGB color
+             *  or with an already mapped native color.
+             */
+            virtual void FillRectangle(uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                                       uint8_t r, uint8_t g, uint8_t b);
+            virtual void FillRectangle(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+
+            /*
+             * Blit:
+             *  Copies the w x h block at (sx, sy) of 'source' to (dx, dy), converting the pixel
+             *  format if the two contexts differ. Both sides are clipped.
+             */
+            virtual void Blit(GraphicsContext* source, int32_t sx, int32_t sy,
+                              int32_t w, int32_t h, int32_t dx, int32_t dy);
+
+            /*
+             * BlitColorKey:
+             *  Like Blit, but source pixels equal to 'key' (a native color of the source)
+             *  are transparent and leave the destination unchanged.
+             */
+            virtual void BlitColorKey(GraphicsContext* source, int32_t sx, int32_t sy,
+                                      int32_t w, int32_t h, int32_t dx, int32_t dy, uint32_t key);
+
+            /*
+             * BlitAlpha:
+             *  Blends the source over the destination. The opacity of a pixel is 'alpha'
+             *  (0..255) times the pixel's own alpha for ARGB8888 sources.
+             */
+            virtual void BlitAlpha(GraphicsContext* source, int32_t sx, int32_t sy,
+                                   int32_t w, int32_t h, int32_t dx, int32_t dy, uint8_t alpha);
+        };
     }
 }
 
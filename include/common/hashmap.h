@@ -0,0 +1,323 @@
+#ifndef __MYOS__COMMON__HASHMAP_H                 // Header guard to prevent multiple inclusions
+#define __MYOS__COMMON__HASHMAP_H
+
+#include <common/types.h>                         // Provides fixed-size integer types
+#include <memorymanagement.h>                     // KernelAllocator and placement new
+
+namespace myos
+{
+    namespace common
+    {
+        /*
+         * HashInteger:
+         *  Mixes all bits of 'x' into all bits of the result (the finalizer of MurmurHash3),
+         *  so that keys which differ only in a few bits (ports, addresses) spread over the table.
+         *  Multiplications and shifts only: the 32-bit build has no 64-bit division helpers.
+         */
+        static inline uint64_t HashInteger(uint64_t x)
+        {
+            x ^= x >> 33;
+            x *= 0xFF51AFD7ED558CCDULL;
+            x ^= x >> 33;
+            x *= 0xC4CEB9FE1A85EC53ULL;
+            x ^= x >> 33;
+            return x;
+        }
+
+        // The hash function HashMap uses unless told otherwise: integers and pointers.
+        template<typename Key>
+        struct DefaultHash
+        {
+            uint64_t operator()(const Key& key) const { return HashInteger((uint64_t)key); }
+        };
+
+        template<typename T>
+        struct DefaultHash<T*>
+        {
+            uint64_t operator()(T* key) const { return HashInteger((uint64_t)(uintptr_t)key); }
+        };
+
+
+        /*
+         * HashMap:
+         *  An open addressing hash table in the style of the "Swiss table": next to the
+         *  entries, every slot has a control byte that is either Empty, Deleted, or the low
+         *  7 bits of the hash of the key in it. The control bytes are probed eight at a time,
+         *  as one 64-bit word (SIMD within a register): a single compare finds every slot of
+         *  the group whose 7 hash bits match, so the keys themselves are only compared for the
+         *  (almost always one) real candidate, and a group with an Empty byte ends the search.
+         *
+         *  The kernel is built without SSE (it is only switched on at run time), so groups
+         *  are 8 bytes wide rather than the 16 an SSE2 compare would handle.
+         *
+         *  The table grows by doubling when 7/8 of the slots are used (tombstones count, and
+         *  are dropped by the rehash). Memory comes from 'Allocator' (KernelAllocator: the
+         *  kernel heap); when it runs out, Insert returns false and the map is unchanged.
+         *  Reserve lets a caller grow the table up front, e.g. before an interrupt handler
+         *  starts inserting.
+         *
+         *  Pointers returned by Find stay valid until the next Insert or Reserve.
+         */
+        template<typename Key, typename Value, typename Hash = DefaultHash<Key>, typename Allocator = KernelAllocator>
+        class HashMap
+        {
+        public:
+            struct Entry
+            {
+                Key key;
+                Value value;
+            };
+
+        protected:
+            enum : uint8_t
+            {
+                Empty = 0x80,                         // 0b10000000
+                Deleted = 0xFE                        // 0b11111110; full slots are 0b0xxxxxxx
+            };
+            enum { GroupSize = 8 };
+
+            typedef uint64_t __attribute__((may_alias)) GroupWord;
+
+            static constexpr uint64_t LowBits = 0x0101010101010101ULL;
+            static constexpr uint64_t HighBits = 0x8080808080808080ULL;
+
+            uint8_t* control;                         // 'capacity' control bytes (0 until the first insert)
+            Entry* entries;                           // 'capacity' slots, in the same allocation
+            size_t capacity;                          // 0 or a power of two >= GroupSize
+            size_t count;                             // Entries in the map
+            size_t growthLeft;                        // Inserts into Empty slots left before growing
+            Hash hash;
+
+            // The 8 control bytes of the group starting at slot 'group * GroupSize'.
+            uint64_t LoadGroup(size_t group) const
+            {
+                return *(const GroupWord*)(control + group * GroupSize);
+            }
+
+            // High bit set in each byte of 'group' that may equal 'h2' (false positives
+            // after a true match are possible; the key compare sorts them out).
+            static uint64_t MatchHash(uint64_t group, uint8_t h2)
+            {
+                uint64_t x = group ^ (LowBits * h2);
+                return (x - LowBits) & ~x & HighBits;
+            }
+
+            // High bit set in each Empty byte (bit 7 set, bit 1 clear).
+            static uint64_t MatchEmpty(uint64_t group)
+            {
+                return group & (~group << 6) & HighBits;
+            }
+
+            // High bit set in each Empty or Deleted byte (bit 7 set, bit 0 clear).
+            static uint64_t MatchEmptyOrDeleted(uint64_t group)
+            {
+                return group & (~group << 7) & HighBits;
+            }
+
+            // Index of the byte holding the lowest set bit of a non-zero match mask.
+            static size_t LowestMatch(uint64_t mask)
+            {
+                uint32_t low = (uint32_t)mask;
+                if(low != 0)
+                    return __builtin_ctz(low) >> 3;
+                return 4 + (__builtin_ctz((uint32_t)(mask >> 32)) >> 3);
+            }
+
+            static size_t GrowthLimit(size_t capacity)
+            {
+                return capacity - capacity / 8;
+            }
+
+            // Slot index of 'key', or capacity if it isn't in the map.
+            size_t FindSlot(const Key& key, uint64_t h) const
+            {
+                size_t groupMask = capacity / GroupSize - 1;
+                size_t group = (size_t)(h >> 7) & groupMask;
+                uint8_t h2 = h & 0x7F;
+
+                // Triangular probing over groups visits each group once (the count is a power of two).
+                for(size_t step = 1; ; step++)
+                {
+                    uint64_t word = LoadGroup(group);
+                    for(uint64_t match = MatchHash(word, h2); match != 0; match &= match - 1)
+                    {
+                        size_t slot = group * GroupSize + LowestMatch(match);
+                        if(entries[slot].key == key)
+                            return slot;
+                    }
+                    if(MatchEmpty(word) != 0)
+                        return capacity;
+                    group = (group + step) & groupMask;
+                }
+            }
+
+            // The first Empty or Deleted slot on the probe sequence of 'h' (there always is one).
+            size_t FindInsertSlot(uint64_t h) const
+            {
+                size_t groupMask = capacity / GroupSize - 1;
+                size_t group = (size_t)(h >> 7) & groupMask;
+                for(size_t step = 1; ; step++)
+                {
+                    uint64_t match = MatchEmptyOrDeleted(LoadGroup(group));
+                    if(match != 0)
+                        return group * GroupSize + LowestMatch(match);
+                    group = (group + step) & groupMask;
+                }
+            }
+
+            // Moves all entries into a new table of 'newCapacity' slots.
+            bool Rehash(size_t newCapacity)
+            {
+                uint8_t* memory = (uint8_t*)Allocator::Allocate(newCapacity + newCapacity * sizeof(Entry));
+                if(memory == 0)
+                    return false;
+
+                uint8_t* oldControl = control;
+                Entry* oldEntries = entries;
+                size_t oldCapacity = capacity;
+
+                control = memory;
+                entries = (Entry*)(memory + newCapacity);
+                capacity = newCapacity;
+                growthLeft = GrowthLimit(newCapacity) - count;
+                for(size_t i = 0; i < newCapacity; i++)
+                    control[i] = Empty;
+
+                for(size_t i = 0; i < oldCapacity; i++)
+                {
+                    if(oldControl[i] & 0x80)
+                        continue;
+                    uint64_t h = hash(oldEntries[i].key);
+                    size_t slot = FindInsertSlot(h);
+                    control[slot] = h & 0x7F;
+                    new (&entries[slot]) Entry(oldEntries[i]);
+                    oldEntries[i].~Entry();
+                }
+
+                Allocator::Free(oldControl);
+                return true;
+            }
+
+        public:
+            HashMap() : control(0), entries(0), capacity(0), count(0), growthLeft(0) {}
+
+            ~HashMap()
+            {
+                Clear();
+                Allocator::Free(control);
+            }
+
+            HashMap(const HashMap&) = delete;
+            HashMap& operator=(const HashMap&) = delete;
+
+            size_t Size() const { return count; }
+            bool IsEmpty() const { return count == 0; }
+
+            // Makes room for 'expected' entries without further allocation. Returns false if out of memory.
+            bool Reserve(size_t expected)
+            {
+                size_t newCapacity = capacity == 0 ? (size_t)GroupSize : capacity;
+                while(GrowthLimit(newCapacity) < expected)
+                    newCapacity *= 2;
+                if(newCapacity == capacity)
+                    return true;
+                return Rehash(newCapacity);
+            }
+
+            // Returns the value stored for 'key', or 0.
+            Value* Find(const Key& key)
+            {
+                if(count == 0)
+                    return 0;
+                size_t slot = FindSlot(key, hash(key));
+                return slot == capacity ? 0 : &entries[slot].value;
+            }
+
+            bool Contains(const Key& key) { return Find(key) != 0; }
+
+            // Stores 'value' for 'key', replacing an existing value. Returns false if out of memory.
+            bool Insert(const Key& key, const Value& value)
+            {
+                uint64_t h = hash(key);
+                if(count != 0)
+                {
+                    size_t slot = FindSlot(key, h);
+                    if(slot != capacity)
+                    {
+                        entries[slot].value = value;
+                        return true;
+                    }
+                }
+
+                if(growthLeft == 0)
+                {
+                    // Double, unless most of the used slots are tombstones; then rehashing in place frees them.
+                    size_t newCapacity = capacity == 0 ? (size_t)GroupSize : capacity;
+                    if(count + 1 > GrowthLimit(newCapacity) / 2)
+                        newCapacity *= 2;
+                    if(!Rehash(newCapacity))
+                        return false;
+                }
+
+                size_t slot = FindInsertSlot(h);
+                if(control[slot] == Empty)
+                    growthLeft--;
+                control[slot] = h & 0x7F;
+                new (&entries[slot]) Entry{key, value};
+                count++;
+                return true;
+            }
+
+            /*
+             * Remove:
+             *  Removes 'key' and returns true if it was there. The slot becomes Empty again if
+             *  its group still has an Empty slot: such a group never was full, so no probe went
+             *  past it. Otherwise it becomes a tombstone (Deleted) until the next rehash.
+             */
+            bool Remove(const Key& key)
+            {
+                if(count == 0)
+                    return false;
+                size_t slot = FindSlot(key, hash(key));
+                if(slot == capacity)
+                    return false;
+
+                entries[slot].~Entry();
+                if(MatchEmpty(LoadGroup(slot / GroupSize)) != 0)
+                {
+                    control[slot] = Empty;
+                    growthLeft++;
+                }
+                else
+                    control[slot] = Deleted;
+                count--;
+                return true;
+            }
+
+            // Removes all entries (the table keeps its size).
+            void Clear()
+            {
+                for(size_t i = 0; i < capacity; i++)
+                {
+                    if((control[i] & 0x80) == 0)
+                        entries[i].~Entry();
+                    control[i] = Empty;
+                }
+                count = 0;
+                growthLeft = GrowthLimit(capacity);
+            }
+
+            // Calls 'function(key, value)' for every entry, in no particular order. The map must
+            // not be changed meanwhile.
+            template<typename Function>
+            void ForEach(Function function)
+            {
+                for(size_t i = 0; i < capacity; i++)
+                    if((control[i] & 0x80) == 0)
+                        function(entries[i].key, entries[i].value);
+            }
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__HASHMAP_H
@@ -0,0 +1,128 @@
+#ifndef __MYOS__COMMON__INTRUSIVELIST_H           // Header guard to prevent multiple inclusions
+#define __MYOS__COMMON__INTRUSIVELIST_H
+
+#include <common/types.h>                         // Provides fixed-size integer types (size_t, uintptr_t)
+
+namespace myos
+{
+    namespace common
+    {
+        /*
+         * IntrusiveListNode:
+         *  The links an object needs to be in an IntrusiveList. The object embeds the node as
+         *  a member, so putting it on a list never allocates and taking it off is O(1).
+         *  An object can be on as many lists at once as it has nodes.
+         */
+        struct IntrusiveListNode
+        {
+            IntrusiveListNode* next;                  // 0 while the node is on no list
+            IntrusiveListNode* prev;
+
+            IntrusiveListNode() : next(0), prev(0) {}
+
+            // Returns true while the node is on a list.
+            bool IsLinked() const { return next != 0; }
+        };
+
+
+        /*
+         * IntrusiveList:
+         *  A doubly linked list of 'T's threaded through their 'Member' node, e.g.
+         *
+         *      IntrusiveList<Task, &Task::schedulerNode> tasks;
+         *
+         *  The list is circular around a sentinel node inside the list object, so insertion
+         *  and removal have no special cases; the list therefore must not be copied or moved.
+         *  The list doesn't own its items: removing an item only unlinks it.
+         *
+         *  Iterate with   for(T* t = list.Front(); t != 0; t = list.Next(t))
+         */
+        template<typename T, IntrusiveListNode T::*Member>
+        class IntrusiveList
+        {
+        protected:
+            IntrusiveListNode head;                   // Sentinel: head.next is the front, head.prev the back
+            size_t count;                             // Number of items on the list
+
+            static IntrusiveListNode* NodeOf(T* item)
+            {
+                return &(item->*Member);
+            }
+
+            // The item a node is embedded in (the node's offset is fixed by 'Member').
+            static T* ItemOf(IntrusiveListNode* node)
+            {
+                uintptr_t offset = (uintptr_t)&(((T*)0x1000)->*Member) - 0x1000;
+                return (T*)((uint8_t*)node - offset);
+            }
+
+            // Links 'node' in between 'prev' and 'next'.
+            void Link(IntrusiveListNode* node, IntrusiveListNode* prev, IntrusiveListNode* next)
+            {
+                node->prev = prev;
+                node->next = next;
+                prev->next = node;
+                next->prev = node;
+                count++;
+            }
+
+        public:
+            IntrusiveList() : count(0)
+            {
+                head.next = &head;
+                head.prev = &head;
+            }
+
+            IntrusiveList(const IntrusiveList&) = delete;
+            IntrusiveList& operator=(const IntrusiveList&) = delete;
+
+            bool IsEmpty() const { return count == 0; }
+            size_t Size() const { return count; }
+
+            // The first / last item, or 0 if the list is empty.
+            T* Front() { return head.next == &head ? 0 : ItemOf(head.next); }
+            T* Back() { return head.prev == &head ? 0 : ItemOf(head.prev); }
+
+            // The item after / before 'item', or 0 at the end of the list.
+            T* Next(T* item)
+            {
+                IntrusiveListNode* next = NodeOf(item)->next;
+                return next == &head ? 0 : ItemOf(next);
+            }
+
+            T* Prev(T* item)
+            {
+                IntrusiveListNode* prev = NodeOf(item)->prev;
+                return prev == &head ? 0 : ItemOf(prev);
+            }
+
+            // Insert 'item', which must not be on a list through the same node.
+            void PushFront(T* item) { Link(NodeOf(item), &head, head.next); }
+            void PushBack(T* item) { Link(NodeOf(item), head.prev, &head); }
+            void InsertAfter(T* position, T* item) { Link(NodeOf(item), NodeOf(position), NodeOf(position)->next); }
+            void InsertBefore(T* position, T* item) { Link(NodeOf(item), NodeOf(position)->prev, NodeOf(position)); }
+
+            // Unlinks 'item', which must be on this list.
+            void Remove(T* item)
+            {
+                IntrusiveListNode* node = NodeOf(item);
+                node->prev->next = node->next;
+                node->next->prev = node->prev;
+                node->next = 0;
+                node->prev = 0;
+                count--;
+            }
+
+            // Unlinks and returns the first item, or returns 0 if the list is empty.
+            T* PopFront()
+            {
+                T* item = Front();
+                if(item != 0)
+                    Remove(item);
+                return item;
+            }
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__INTRUSIVELIST_H
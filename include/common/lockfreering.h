@@ -0,0 +1,246 @@
+#ifndef __MYOS__COMMON__LOCKFREERING_H            // Header guard to prevent multiple inclusions
+#define __MYOS__COMMON__LOCKFREERING_H
+
+#include <common/types.h>                         // Provides fixed-size integer types
+
+namespace myos
+{
+    namespace common
+    {
+        // Size of a cache line on the x86 CPUs we run on. The rings keep data written by the
+        // producer side and data written by the consumer side on different lines, so that
+        // two CPUs working on the two ends don't keep taking the same line from each other.
+        // Each side's line is aligned, so it isn't shared with fields before the ring either;
+        // a ring on the heap needs memory aligned to CacheLineSize for that.
+        enum { CacheLineSize = 64 };
+
+
+        /*
+         * SingleProducerRing:
+         *  A bounded FIFO of up to 'Capacity' elements (a power of two) for handing data from
+         *  one producer to one consumer without a lock, e.g. from a device's interrupt handler
+         *  to a task. Producer and consumer may run on different CPUs.
+         *
+         *  'head' is written only by the producer and 'tail' only by the consumer; both count
+         *  elements forever and are masked to index the ring. The producer publishes elements
+         *  with a release store of 'head' after writing them, and the consumer frees slots
+         *  with a release store of 'tail' after reading them; the other side reads the counter
+         *  with an acquire load before touching the slots. Each side also keeps its last view
+         *  of the other side's counter on its own cache line, and only reloads it when that
+         *  view says the ring is full (or empty).
+         *
+         *  The Batch calls move as many elements as fit with a single counter update.
+         */
+        template<typename T, uint32_t Capacity>
+        class SingleProducerRing
+        {
+            static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+        protected:
+            // Producer side
+            uint32_t head __attribute__((aligned(CacheLineSize))); // Elements pushed so far
+            uint32_t cachedTail;                      // The producer's last view of 'tail'
+            uint8_t producerPadding[CacheLineSize - 2 * sizeof(uint32_t)];
+
+            // Consumer side
+            uint32_t tail __attribute__((aligned(CacheLineSize))); // Elements popped so far
+            uint32_t cachedHead;                      // The consumer's last view of 'head'
+            uint8_t consumerPadding[CacheLineSize - 2 * sizeof(uint32_t)];
+
+            T elements[Capacity];
+
+        public:
+            SingleProducerRing() : head(0), cachedTail(0), tail(0), cachedHead(0) {}
+
+            /*
+             * PushBatch (producer only):
+             *  Appends up to 'count' elements from 'items' and returns how many fitted.
+             */
+            uint32_t PushBatch(const T* items, uint32_t count)
+            {
+                uint32_t position = __atomic_load_n(&head, __ATOMIC_RELAXED);
+                uint32_t free = Capacity - (position - cachedTail);
+                if(free < count)
+                {
+                    cachedTail = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+                    free = Capacity - (position - cachedTail);
+                }
+                if(count > free)
+                    count = free;
+
+                for(uint32_t i = 0; i < count; i++)
+                    elements[(position + i) & (Capacity - 1)] = items[i];
+                __atomic_store_n(&head, position + count, __ATOMIC_RELEASE);
+                return count;
+            }
+
+            // Appends 'item'; returns false (and drops it) if the ring is full.
+            bool Push(const T& item) { return PushBatch(&item, 1) == 1; }
+
+            /*
+             * PopBatch (consumer only):
+             *  Takes up to 'count' of the oldest elements out into 'items' and returns how many.
+             */
+            uint32_t PopBatch(T* items, uint32_t count)
+            {
+                uint32_t position = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+                uint32_t available = cachedHead - position;
+                if(available < count)
+                {
+                    cachedHead = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+                    available = cachedHead - position;
+                }
+                if(count > available)
+                    count = available;
+
+                for(uint32_t i = 0; i < count; i++)
+                    items[i] = elements[(position + i) & (Capacity - 1)];
+                __atomic_store_n(&tail, position + count, __ATOMIC_RELEASE);
+                return count;
+            }
+
+            // Takes the oldest element out into 'item'; returns false if the ring is empty.
+            bool Pop(T& item) { return PopBatch(&item, 1) == 1; }
+
+            /*
+             * Front / PopFront (consumer only):
+             *  Front returns the oldest element in place (0 if the ring is empty); its slot stays
+             *  taken until PopFront, so the consumer can finish with it before the producer reuses it.
+             */
+            T* Front()
+            {
+                uint32_t position = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+                if(cachedHead == position)
+                {
+                    cachedHead = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+                    if(cachedHead == position)
+                        return 0;
+                }
+                return &elements[position & (Capacity - 1)];
+            }
+
+            void PopFront()
+            {
+                __atomic_store_n(&tail, __atomic_load_n(&tail, __ATOMIC_RELAXED) + 1, __ATOMIC_RELEASE);
+            }
+
+            // Elements in the ring; exact on either side when the other side isn't running.
+            uint32_t Size() const
+            {
+                return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+            }
+            bool IsEmpty() const { return Size() == 0; }
+            bool IsFull() const { return Size() == Capacity; }
+        };
+
+
+        /*
+         * MultiProducerRing:
+         *  A bounded FIFO of up to 'Capacity' elements (a power of two) that any number of
+         *  producers (interrupt handlers on any CPU, tasks) can push to without a lock, and one
+         *  consumer takes out of.
+         *
+         *  A producer claims slots by advancing 'head' with a compare-and-swap, after checking
+         *  against 'tail' that they are free. It then writes the elements and publishes each
+         *  one with a release store of its slot's 'sequence' (position + 1). Producers can
+         *  finish in any order, so the consumer checks each slot's sequence with an acquire
+         *  load and stops at the first one not yet published. It frees slots with a release
+         *  store of 'tail'.
+         *
+         *  No producer ever waits for another one: one that is interrupted between claiming
+         *  and publishing only holds up the consumer, which finds the rest of the elements on
+         *  its next call.
+         */
+        template<typename T, uint32_t Capacity>
+        class MultiProducerRing
+        {
+            static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+        protected:
+            struct Cell
+            {
+                uint32_t sequence;                    // Position + 1 of the element in 'value' once it is published
+                T value;
+            };
+
+            uint32_t head __attribute__((aligned(CacheLineSize))); // Slots claimed by producers so far
+            uint8_t producerPadding[CacheLineSize - sizeof(uint32_t)];
+
+            uint32_t tail __attribute__((aligned(CacheLineSize))); // Elements popped so far
+            uint8_t consumerPadding[CacheLineSize - sizeof(uint32_t)];
+
+            Cell cells[Capacity];
+
+        public:
+            MultiProducerRing() : head(0), tail(0)
+            {
+                for(uint32_t i = 0; i < Capacity; i++)
+                    cells[i].sequence = 0;
+            }
+
+            /*
+             * PushBatch (any producer):
+             *  Appends up to 'count' elements from 'items', in order and without elements from
+             *  other producers in between, and returns how many fitted.
+             */
+            uint32_t PushBatch(const T* items, uint32_t count)
+            {
+                uint32_t position = __atomic_load_n(&head, __ATOMIC_RELAXED);
+                uint32_t claimed;
+                do
+                {
+                    uint32_t free = Capacity - (position - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+                    claimed = count < free ? count : free;
+                    if(claimed == 0)
+                        return 0;
+                }
+                while(!__atomic_compare_exchange_n(&head, &position, position + claimed, true,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+                for(uint32_t i = 0; i < claimed; i++)
+                {
+                    Cell* cell = &cells[(position + i) & (Capacity - 1)];
+                    cell->value = items[i];
+                    __atomic_store_n(&cell->sequence, position + i + 1, __ATOMIC_RELEASE);
+                }
+                return claimed;
+            }
+
+            // Appends 'item'; returns false (and drops it) if the ring is full.
+            bool Push(const T& item) { return PushBatch(&item, 1) == 1; }
+
+            /*
+             * PopBatch (consumer only):
+             *  Takes up to 'count' of the oldest published elements out into 'items' and
+             *  returns how many.
+             */
+            uint32_t PopBatch(T* items, uint32_t count)
+            {
+                uint32_t position = __atomic_load_n(&tail, __ATOMIC_RELAXED);
+                uint32_t taken = 0;
+                for(; taken < count; taken++)
+                {
+                    Cell* cell = &cells[(position + taken) & (Capacity - 1)];
+                    if(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != position + taken + 1)
+                        break;
+                    items[taken] = cell->value;
+                }
+                if(taken != 0)
+                    __atomic_store_n(&tail, position + taken, __ATOMIC_RELEASE);
+                return taken;
+            }
+
+            // Takes the oldest element out into 'item'; returns false if there is none (yet).
+            bool Pop(T& item) { return PopBatch(&item, 1) == 1; }
+
+            // Slots in use, counting elements still being written.
+            uint32_t Size() const
+            {
+                return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+            }
+            bool IsEmpty() const { return Size() == 0; }
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__LOCKFREERING_H
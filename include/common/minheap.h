@@ -0,0 +1,133 @@
+#ifndef __MYOS__COMMON__MINHEAP_H                 // Header guard to prevent multiple inclusions
+#define __MYOS__COMMON__MINHEAP_H
+
+#include <common/types.h>                         // Provides fixed-size integer types
+#include <memorymanagement.h>                     // KernelAllocator and placement new
+
+namespace myos
+{
+    namespace common
+    {
+        // The ordering MinHeap uses unless told otherwise: operator<.
+        template<typename T>
+        struct DefaultLess
+        {
+            bool operator()(const T& a, const T& b) const { return a < b; }
+        };
+
+
+        /*
+         * MinHeap:
+         *  A binary heap in an array: Top is the smallest element by 'Less', Push and Pop are
+         *  O(log n). Suited to "what is due next" questions such as timers ordered by deadline.
+         *
+         *  The array doubles through 'Allocator' when it is full; Push returns false if that
+         *  fails. Reserve allocates up front.
+         */
+        template<typename T, typename Less = DefaultLess<T>, typename Allocator = KernelAllocator>
+        class MinHeap
+        {
+        protected:
+            T* elements;
+            size_t count;
+            size_t capacity;
+            Less less;
+
+            void Swap(size_t a, size_t b)
+            {
+                T temporary = elements[a];
+                elements[a] = elements[b];
+                elements[b] = temporary;
+            }
+
+        public:
+            MinHeap() : elements(0), count(0), capacity(0) {}
+
+            ~MinHeap()
+            {
+                Clear();
+                Allocator::Free(elements);
+            }
+
+            MinHeap(const MinHeap&) = delete;
+            MinHeap& operator=(const MinHeap&) = delete;
+
+            size_t Size() const { return count; }
+            bool IsEmpty() const { return count == 0; }
+
+            // Makes room for 'newCapacity' elements. Returns false if out of memory.
+            bool Reserve(size_t newCapacity)
+            {
+                if(newCapacity <= capacity)
+                    return true;
+                T* memory = (T*)Allocator::Allocate(newCapacity * sizeof(T));
+                if(memory == 0)
+                    return false;
+                for(size_t i = 0; i < count; i++)
+                {
+                    new (&memory[i]) T(elements[i]);
+                    elements[i].~T();
+                }
+                Allocator::Free(elements);
+                elements = memory;
+                capacity = newCapacity;
+                return true;
+            }
+
+            // The smallest element (the heap must not be empty).
+            T& Top() { return elements[0]; }
+
+            // Adds 'element'. Returns false if out of memory.
+            bool Push(const T& element)
+            {
+                if(count == capacity && !Reserve(capacity == 0 ? 8 : capacity * 2))
+                    return false;
+
+                size_t i = count++;
+                new (&elements[i]) T(element);
+                while(i > 0 && less(elements[i], elements[(i - 1) / 2]))
+                {
+                    Swap(i, (i - 1) / 2);
+                    i = (i - 1) / 2;
+                }
+                return true;
+            }
+
+            // Removes the smallest element into 'element'; returns false if the heap is empty.
+            bool Pop(T& element)
+            {
+                if(count == 0)
+                    return false;
+                element = elements[0];
+                elements[0] = elements[--count];
+                elements[count].~T();
+
+                size_t i = 0;
+                while(true)
+                {
+                    size_t smallest = i;
+                    size_t left = 2 * i + 1;
+                    size_t right = left + 1;
+                    if(left < count && less(elements[left], elements[smallest]))
+                        smallest = left;
+                    if(right < count && less(elements[right], elements[smallest]))
+                        smallest = right;
+                    if(smallest == i)
+                        break;
+                    Swap(i, smallest);
+                    i = smallest;
+                }
+                return true;
+            }
+
+            void Clear()
+            {
+                for(size_t i = 0; i < count; i++)
+                    elements[i].~T();
+                count = 0;
+            }
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__MINHEAP_H
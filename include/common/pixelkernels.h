@@ -0,0 +1,56 @@
+#ifndef __MYOS__COMMON__PIXELKERNELS_H     // Header guard to prevent multiple inclusions of this file
+#define __MYOS__COMMON__PIXELKERNELS_H
+
+#include <common/types.h>                  // Provides fixed-size integer types
+
+namespace myos
+{
+    namespace common
+    {
+        /*
+         * PixelKernels:
+         *  The inner loops of the software rasterizer, each working on one row of pixels.
+         *  GraphicsContext clips first and then calls these through 'active', so faster
+         *  versions can be chosen at runtime without touching the drawing code.
+         *
+         *  'scalar' works on any i386. 'sse2' moves 16 bytes per instruction and may only
+         *  be selected once CentralProcessingUnit::EnableSSE has succeeded.
+         */
+        class PixelKernels
+        {
+        public:
+            // Name shown by diagnostics and the benchmark ("scalar" or "sse2").
+            const char* name;
+
+            // Stores 'color' into 'count' consecutive 8 or 32 bit pixels.
+            void (*FillRow8)(uint8_t* dst, uint8_t color, int32_t count);
+            void (*FillRow32)(uint32_t* dst, uint32_t color, int32_t count);
+
+            // Copies 'bytes' bytes from 'src' to 'dst' (front to back, so 'dst' may lie below 'src').
+            void (*CopyRow)(uint8_t* dst, uint8_t* src, int32_t bytes);
+
+            // Copies 'count' pixels, leaving the destination alone where the source equals 'key'.
+            void (*CopyRowColorKey8)(uint8_t* dst, uint8_t* src, int32_t count, uint8_t key);
+            void (*CopyRowColorKey32)(uint32_t* dst, uint32_t* src, int32_t count, uint32_t key);
+
+            // Looks up 'count' palette indices and stores them as 32 bit pixels ORed with 'alphaMask'.
+            void (*ConvertRow8To32)(uint32_t* dst, uint8_t* src, int32_t count,
+                                    uint32_t* palette, uint32_t alphaMask);
+
+            // The available implementations.
+            static PixelKernels scalar;
+            static PixelKernels sse2;
+
+            // The implementation used by all graphics contexts (starts as 'scalar').
+            static PixelKernels* active;
+
+            /*
+             * Select:
+             *  Picks the fastest implementation allowed by the given CPU features.
+             */
+            static void Select(bool sse2Enabled);
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__PIXELKERNELS_H
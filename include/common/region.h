@@ -0,0 +1,108 @@
+#ifndef __MYOS__COMMON__REGION_H                  // Header guard to prevent multiple inclusions
+#define __MYOS__COMMON__REGION_H
+
+#include <common/types.h>                         // Provides fixed-size integer types (int32_t, etc.)
+
+namespace myos
+{
+    namespace common
+    {
+        /*
+         * Rectangle:
+         *  An axis-aligned rectangle given by its top-left corner (x, y) and its size (w, h).
+         *  A rectangle with a width or height <= 0 is considered empty.
+         */
+        class Rectangle
+        {
+        public:
+            int32_t x;
+            int32_t y;
+            int32_t w;
+            int32_t h;
+
+            // Creates an empty rectangle at (0, 0).
+            Rectangle();
+
+            // Creates a rectangle at (x, y) with the given width and height.
+            Rectangle(int32_t x, int32_t y, int32_t w, int32_t h);
+
+            // Returns true if the rectangle covers no pixels at all.
+            bool IsEmpty() const;
+
+            // Returns true if this rectangle and 'other' share at least one pixel.
+            bool Intersects(const Rectangle& other) const;
+
+            // Returns the overlapping part of this rectangle and 'other' (possibly empty).
+            Rectangle Intersection(const Rectangle& other) const;
+        };
+
+
+        /*
+         * Region:
+         *  A set of pixels described as a list of non-overlapping rectangles (a "clip list").
+         *  It is used to tell a widget which parts of it are actually visible, so that
+         *  covered pixels are never painted.
+         *
+         *  The rectangle list has a fixed capacity because the kernel has no growable
+         *  containers. If an operation would need more rectangles than fit, the region is
+         *  left covering *more* pixels than the exact result. Callers therefore paint
+         *  back to front, so an oversized region only costs overdraw, never wrong output.
+         */
+        class Region
+        {
+        public:
+            // Maximum number of rectangles a single region can hold.
+            static const int MaxRectangles = 32;
+
+        protected:
+            Rectangle rectangles[MaxRectangles];
+            int numRectangles;
+
+        public:
+            // Creates an empty region.
+            Region();
+
+            // Creates a region covering exactly the given rectangle.
+            Region(const Rectangle& rectangle);
+
+            // Removes all rectangles from the region.
+            void Clear();
+
+            // Returns true if the region covers no pixels.
+            bool IsEmpty() const;
+
+            // Returns the number of rectangles in the clip list.
+            int NumRectangles() const;
+
+            // Returns the i-th rectangle of the clip list.
+            const Rectangle& GetRectangle(int i) const;
+
+            /*
+             * Intersect:
+             *  Clips every rectangle of the region against 'rectangle',
+             *  dropping the ones that end up empty.
+             */
+            void Intersect(const Rectangle& rectangle);
+
+            /*
+             * Subtract:
+             *  Removes the pixels covered by 'rectangle' from the region. Each rectangle that
+             *  overlaps it is split into up to four pieces (above, below, left, right).
+             *  Returns false if the capacity ran out; the affected rectangles are then kept
+             *  whole, so the region is a superset of the exact difference.
+             */
+            bool Subtract(const Rectangle& rectangle);
+
+            /*
+             * Add:
+             *  Adds the pixels covered by 'rectangle' to the region. Only the parts not yet
+             *  covered are appended, so the rectangles still don't overlap. Returns false if
+             *  the capacity ran out; the region is then replaced by the bounding box of both,
+             *  again a superset of the exact union.
+             */
+            bool Add(const Rectangle& rectangle);
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__REGION_H
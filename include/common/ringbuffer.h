@@ -0,0 +1,60 @@
+#ifndef __MYOS__COMMON__RINGBUFFER_H              // Header guard to prevent multiple inclusions
+#define __MYOS__COMMON__RINGBUFFER_H
+
+#include <common/types.h>                         // Provides fixed-size integer types
+
+namespace myos
+{
+    namespace common
+    {
+        /*
+         * RingBuffer:
+         *  A FIFO of up to 'Capacity' elements (a power of two) stored in the object itself.
+         *  The read and write counters run freely and are masked on access, so a full buffer
+         *  needs no spare slot. It is meant for use from one context at a time; queues shared
+         *  between an interrupt handler and a task need the rings in common/lockfreering.h.
+         */
+        template<typename T, size_t Capacity>
+        class RingBuffer
+        {
+            static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+        protected:
+            T elements[Capacity];
+            uint32_t readCount;                       // Elements taken out so far
+            uint32_t writeCount;                      // Elements put in so far
+
+        public:
+            RingBuffer() : readCount(0), writeCount(0) {}
+
+            size_t Size() const { return writeCount - readCount; }
+            bool IsEmpty() const { return writeCount == readCount; }
+            bool IsFull() const { return writeCount - readCount == Capacity; }
+
+            // Appends 'element'; returns false (and drops it) if the buffer is full.
+            bool Push(const T& element)
+            {
+                if(IsFull())
+                    return false;
+                elements[writeCount++ & (Capacity - 1)] = element;
+                return true;
+            }
+
+            // Takes the oldest element out into 'element'; returns false if the buffer is empty.
+            bool Pop(T& element)
+            {
+                if(IsEmpty())
+                    return false;
+                element = elements[readCount++ & (Capacity - 1)];
+                return true;
+            }
+
+            // The oldest element, which stays in the buffer (the buffer must not be empty).
+            T& Front() { return elements[readCount & (Capacity - 1)]; }
+
+            void Clear() { readCount = writeCount; }
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__RINGBUFFER_H
@@ -0,0 +1,39 @@
+#ifndef __MYOS__COMMON__SURFACE_H          // Header guard to prevent multiple inclusions of this file
+#define __MYOS__COMMON__SURFACE_H
+
+#include <common/types.h>                  // Provides fixed-size integer types
+#include <common/graphicscontext.h>        // Surface is a GraphicsContext backed by heap memory
+
+namespace myos
+{
+    namespace common
+    {
+        /*
+         * Surface:
+         *  An off-screen GraphicsContext of any size and pixel format. Its pixels live on the
+         *  kernel heap, so it can be drawn into like the screen and later blitted elsewhere
+         *  (e.g. to cache a window's contents or to build a frame before showing it).
+         *
+         *  If the heap can't provide the memory, the surface has no pixels and all drawing
+         *  into or out of it is silently skipped; check IsValid() after construction.
+         */
+        class Surface : public GraphicsContext
+        {
+        public:
+            /*
+             * Constructor:
+             *  Allocates width x height pixels of the given format. Rows are padded to
+             *  a multiple of 4 bytes. 'palette' (optional) describes Indexed8 colors.
+             */
+            Surface(int32_t width, int32_t height, PixelFormat format, uint32_t* palette = 0);
+
+            // Destructor: returns the pixel memory to the heap.
+            ~Surface();
+
+            // Returns true if the pixel memory could be allocated.
+            bool IsValid();
+        };
+    }
+}
+
+#endif // __MYOS__COMMON__SURFACE_H
@@ -20,7 +20,14 @@ namespace myos
         // These typedef statements provide convenient names for common usage.
         
         typedef const char*              string;   // Represents a pointer to a constant character array (C-style string)
+#ifdef __x86_64__
+        // In the 64-bit build, sizes and addresses are as wide as a pointer (the LP64 model).
+        typedef unsigned long            size_t;   // Defines a generic size type, typically used for memory sizes
+        typedef unsigned long         uintptr_t;   // An unsigned integer that can hold any pointer
+#else
         typedef uint32_t                 size_t;   // Defines a generic size type, typically used for memory sizes
+        typedef uint32_t              uintptr_t;   // An unsigned integer that can hold any pointer
+#endif
     }
 }
     
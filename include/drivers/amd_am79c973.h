@@ -5,7 +5,8 @@
 #include <drivers/driver.h>                          // Include base driver class definitions
 #include <hardwarecommunication/pci.h>               // Include PCI-related definitions (Peripheral Component Interconnect)
 #include <hardwarecommunication/interrupts.h>        // Include interrupt-related definitions
-#include <hardwarecommunication/port.h>              // Include I/O port abstractions
+#include <hardwarecommunication/mmio.h>              // Typed register access (memory or I/O space)
+#include <common/lockfreering.h>                     // Hands received frames from the interrupt to a task
 
 namespace myos
 {
@@ -74,15 +75,46 @@ namespace myos
                 common::uint32_t avail;                // Available space or metadata for driver/HW usage
             } __attribute__((packed));
             
-            // The following ports are used to communicate with the AM79C973 NIC at the I/O level.
-            // Each port corresponds to a specific I/O address that the device expects to read/write.
-            hardwarecommunication::Port16Bit MACAddress0Port;          // Access to MAC address low word
-            hardwarecommunication::Port16Bit MACAddress2Port;          // Access to MAC address middle word
-            hardwarecommunication::Port16Bit MACAddress4Port;          // Access to MAC address high word
-            hardwarecommunication::Port16Bit registerDataPort;         // Data port for register reads/writes
-            hardwarecommunication::Port16Bit registerAddressPort;      // Address port to specify which register to access
-            hardwarecommunication::Port16Bit resetPort;                // Port used to reset the NIC
-            hardwarecommunication::Port16Bit busControlRegisterDataPort;// Port for bus control register access
+            // The card's register block (word I/O mode). It is the same in I/O space (BAR 0)
+            // and memory space (BAR 1); 'registers' uses memory space when the BAR is enabled.
+            typedef hardwarecommunication::Register<common::uint16_t, 0x00> AddressPROM;     // MAC address, 3 words
+            typedef hardwarecommunication::Register<common::uint16_t, 0x10> RegisterData;    // RDP: the CSR selected in RAP
+            typedef hardwarecommunication::Register<common::uint16_t, 0x12> RegisterAddress; // RAP: CSR/BCR number
+            typedef hardwarecommunication::Register<common::uint16_t, 0x14> ResetRegister;   // Reading it resets the card
+            typedef hardwarecommunication::Register<common::uint16_t, 0x16> BusControlData;  // BDP: the BCR selected in RAP
+
+            // Numbers of the control and status registers (CSRs) and bus control registers (BCRs) used.
+            enum
+            {
+                CSRStatus = 0,                        // CSR0: commands and interrupt status
+                CSRInitBlockLow = 1,                  // CSR1/2: address of the initialization block
+                CSRInitBlockHigh = 2,
+                CSRFeatures = 4,                      // CSR4: test and features control
+                BCRSoftwareStyle = 20                 // BCR20: descriptor and block layout
+            };
+
+            // Bits of CSR0.
+            typedef hardwarecommunication::BitField<common::uint16_t, 0>  StatusInit;          // Read the initialization block
+            typedef hardwarecommunication::BitField<common::uint16_t, 1>  StatusStart;         // Start sending and receiving
+            typedef hardwarecommunication::BitField<common::uint16_t, 2>  StatusStop;          // Stop all activity
+            typedef hardwarecommunication::BitField<common::uint16_t, 3>  StatusTransmitDemand; // Look at the send ring now
+            typedef hardwarecommunication::BitField<common::uint16_t, 6>  StatusInterruptEnable;
+            typedef hardwarecommunication::BitField<common::uint16_t, 7>  StatusInterruptPending; // Any interrupt flag below is set
+            typedef hardwarecommunication::BitField<common::uint16_t, 8>  StatusInitDone;
+            typedef hardwarecommunication::BitField<common::uint16_t, 9>  StatusTransmitInterrupt;
+            typedef hardwarecommunication::BitField<common::uint16_t, 10> StatusReceiveInterrupt;
+            typedef hardwarecommunication::BitField<common::uint16_t, 11> StatusMemoryError;
+            typedef hardwarecommunication::BitField<common::uint16_t, 12> StatusMissedFrame;
+            typedef hardwarecommunication::BitField<common::uint16_t, 13> StatusCollisionError;
+            typedef hardwarecommunication::BitField<common::uint16_t, 15> StatusError;
+
+            // The registers, in memory or I/O space.
+            hardwarecommunication::DeviceRegisters registers;
+
+            // Read and write a CSR or BCR through the address register (RAP) and the matching data register.
+            common::uint16_t ReadControlStatus(common::uint16_t number);
+            void WriteControlStatus(common::uint16_t number, common::uint16_t value);
+            void WriteBusControl(common::uint16_t number, common::uint16_t value);
             
             // The InitializationBlock used to configure the device on startup
             InitializationBlock initBlock;
@@ -102,6 +134,18 @@ namespace myos
             
             // Handler to process raw data received by this network driver
             RawDataHandler* handler;
+
+            // With deferred receiving, the receive descriptors (indices) the interrupt handler took
+            // from the card, in order, until ProcessReceived has handled them. There are 8
+            // descriptors, so the ring only fills up when all of them wait.
+            common::SingleProducerRing<common::uint8_t, 8> receivedDescriptors;
+            bool deferReceive;                                   // Queue frames instead of handling them in the interrupt
+
+            // Hands the frame in a receive descriptor to 'handler' (if it arrived intact).
+            void DeliverFrame(common::uint8_t descriptor);
+
+            // Gives a receive descriptor back to the card for the next frame.
+            void ReturnReceiveDescriptor(common::uint8_t descriptor);
             
         public:
             // Constructor that initializes ports, the interrupt manager, and configures the device based on
@@ -111,6 +155,14 @@ namespace myos
             
             // Destructor for cleanup if needed (currently empty).
             ~amd_am79c973();
+
+            // The PCI devices this driver handles (AMD 1022:2000), for the PCI driver table.
+            static const hardwarecommunication::PeripheralComponentInterconnectMatch pciMatches[];
+
+            // Creates the driver for a matched device on the kernel heap (0 if out of memory).
+            static Driver* Probe(hardwarecommunication::PeripheralComponentInterconnectController* controller,
+                                 hardwarecommunication::PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                 hardwarecommunication::InterruptManager* interrupts);
             
             // Activates the device (e.g., enables DMA, sets up buffers, configures interrupts).
             void Activate();
@@ -120,9 +172,9 @@ namespace myos
             
             // This method is called by the interrupt manager when the device triggers an interrupt.
             // It handles packet sending/receiving or device-specific events.
-            // esp: the current stack pointer (used to return the new stack pointer if modified).
-            // Returns the (possibly) updated stack pointer after handling the interrupt.
-            common::uint32_t HandleInterrupt(common::uint32_t esp);
+            // esp: the current stack pointer (left unchanged).
+            // Returns false if the card has no interrupt pending (another device on a shared line raised it).
+            bool HandleInterrupt(common::uintptr_t& esp);
             
             // Sends a packet of data across the network using the AMD NIC.
             // buffer: pointer to the data to be sent
@@ -130,8 +182,20 @@ namespace myos
             void Send(common::uint8_t* buffer, int count);
 
             // Called internally (and by interrupts) to handle incoming packets. Processes them,
-            // then hands them to the RawDataHandler for further handling if available.
+            // then hands them to the RawDataHandler for further handling if available
+            // (or, with deferred receiving, queues them for ProcessReceived).
             void Receive();
+
+            // Deferred receiving: the interrupt handler only queues received frames, and
+            // ProcessReceived, called by a task or the main loop, hands them to the handler.
+            // Off by default; kernelMain turns it on and calls ProcessReceived in its main loop.
+            // Code that waits for a reply while deferred receiving is on must keep calling
+            // ProcessReceived, or the reply never arrives.
+            void SetDeferredReceive(bool defer);
+
+            // Hands the frames queued by the interrupt handler to the handler and gives their
+            // buffers back to the card. Returns the number of frames. Only one task may call it.
+            common::uint32_t ProcessReceived();
             
             // Assigns a RawDataHandler to this device, allowing external code to handle incoming data.
             void SetHandler(RawDataHandler* handler);
@@ -0,0 +1,162 @@
+#ifndef __MYOS__DRIVERS__BGA_H                               // Header guard to prevent multiple inclusion
+#define __MYOS__DRIVERS__BGA_H
+
+#include <common/types.h>                                    // Provides integral type definitions (e.g., uint16_t, uint32_t)
+#include <hardwarecommunication/port.h>                      // I/O port abstractions for the DISPI index/data ports
+#include <hardwarecommunication/pci.h>                       // PCI device descriptor (for the linear framebuffer BAR)
+#include <drivers/driver.h>                                  // Base Driver class
+#include <drivers/vga.h>                                     // VideoGraphicsArray, which this adapter extends
+
+namespace myos
+{
+    namespace drivers
+    {
+        /*
+         * BochsVisiblePage:
+         *  A GraphicsContext for the page of video memory that is currently on screen,
+         *  while the adapter itself draws into the hidden page.
+         */
+        class BochsVisiblePage : public common::GraphicsContext
+        {
+        public:
+            BochsVisiblePage();
+            ~BochsVisiblePage();
+
+            // Points the context at a page of 'width' x 'height' 32 bit pixels.
+            void SetPage(common::uint32_t* page, common::int32_t width, common::int32_t height);
+        };
+
+        /*
+         * BochsGraphicsAdapter:
+         *  Driver for the Bochs Graphics Adapter (BGA), the "std" VGA card of QEMU and Bochs
+         *  (PCI 1234:1111) and VirtualBox's VBoxVGA (PCI 80EE:BEEF), which implement the same
+         *  DISPI register interface.
+         *
+         *  Instead of the legacy VGA registers and the 64 KiB window at 0xA0000, the card is
+         *  programmed through two 16-bit I/O ports and exposes all of video memory as one linear
+         *  framebuffer at the address in PCI BAR 0. This allows high resolutions at 32 bits per
+         *  pixel (0x00RRGGBB) without any bank switching.
+         *
+         *  If video memory is large enough, the virtual screen is made twice as high as the
+         *  visible one: drawing goes to the hidden half (the back buffer) and SwapBuffers makes
+         *  it visible by moving the Y offset, so a frame is never shown half-drawn.
+         *
+         *  Legacy 320x200x8 is still supported by falling back to the VideoGraphicsArray code.
+         */
+        class BochsGraphicsAdapter : public VideoGraphicsArray, public Driver
+        {
+        protected:
+            // DISPI register indices (written to the index port before accessing the data port).
+            enum
+            {
+                DisplayIndexId          = 0x0,
+                DisplayIndexXResolution = 0x1,
+                DisplayIndexYResolution = 0x2,
+                DisplayIndexBitsPerPixel = 0x3,
+                DisplayIndexEnable      = 0x4,
+                DisplayIndexBank        = 0x5,
+                DisplayIndexVirtualWidth  = 0x6,
+                DisplayIndexVirtualHeight = 0x7,
+                DisplayIndexXOffset     = 0x8,
+                DisplayIndexYOffset     = 0x9,
+                DisplayIndexVideoMemory64K = 0xA
+            };
+
+            // Bits of the enable register.
+            enum
+            {
+                DisplayDisabled    = 0x00,
+                DisplayEnabled     = 0x01,
+                DisplayGetCaps     = 0x02,
+                DisplayLinearFrameBuffer = 0x40,
+                DisplayNoClearMemory = 0x80
+            };
+
+            // Ports of the DISPI interface: select a register, then read/write its value.
+            hardwarecommunication::FixedPort<common::uint16_t, 0x01CE> displayIndexPort;
+            hardwarecommunication::FixedPort<common::uint16_t, 0x01CF> displayDataPort;
+
+            // Linear framebuffer as mapped by PCI BAR 0 (identity mapped, like all of the lower 4 GB).
+            common::uint32_t* linearFrameBuffer;
+
+            // Current mode. 'bitsPerPixel' is 0 while the legacy VGA mode is active.
+            common::uint32_t width;
+            common::uint32_t height;
+            common::uint32_t bitsPerPixel;
+
+            // Page flipping: which half of the virtual screen is shown, and where drawing goes.
+            bool doubleBuffered;
+            common::uint32_t visiblePage;
+            common::uint32_t* backBuffer;
+
+            // Context for the page on screen (only used while double buffered).
+            BochsVisiblePage frontBuffer;
+
+            // Writes/reads one DISPI register.
+            void WriteRegister(common::uint16_t index, common::uint16_t value);
+            common::uint16_t ReadRegister(common::uint16_t index);
+
+        public:
+            /*
+             * Constructor:
+             *  - dev: the PCI descriptor of the adapter
+             *  - frameBuffer: the address of the linear framebuffer (memory BAR 0)
+             */
+            BochsGraphicsAdapter(hardwarecommunication::PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                 common::uint8_t* frameBuffer);
+
+            // Destructor (nothing to release).
+            ~BochsGraphicsAdapter();
+
+            // The PCI devices with the DISPI interface (Bochs/QEMU 1234:1111, VirtualBox 80EE:BEEF).
+            static const hardwarecommunication::PeripheralComponentInterconnectMatch pciMatches[];
+
+            // Creates the adapter on the framebuffer of BAR 0 (0 if there is none, or out of memory).
+            static Driver* Probe(hardwarecommunication::PeripheralComponentInterconnectController* controller,
+                                 hardwarecommunication::PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                 hardwarecommunication::InterruptManager* interrupts);
+
+            // The most recently detected adapter (or 0 if there is none), used by the kernel to
+            // prefer it over plain VGA.
+            static BochsGraphicsAdapter* activeAdapter;
+
+            /*
+             * IsPresent:
+             *  Returns true if the DISPI interface answers with a known version id.
+             */
+            bool IsPresent();
+
+            /*
+             * SupportsMode:
+             *  Accepts 32 bpp modes up to the maximum resolution reported by the card, and
+             *  the legacy 320x200x8 mode.
+             */
+            virtual bool SupportsMode(common::uint32_t width, common::uint32_t height, common::uint32_t colordepth);
+
+            /*
+             * SetMode:
+             *  Programs the resolution and color depth through the DISPI registers and
+             *  enables the linear framebuffer. Sets up double buffering if memory allows.
+             *  The GraphicsContext then draws XRGB8888 pixels into the back buffer.
+             */
+            virtual bool SetMode(common::uint32_t width, common::uint32_t height, common::uint32_t colordepth);
+
+            /*
+             * SwapBuffers:
+             *  Shows the page that was just drawn (by moving the Y offset) and makes the
+             *  previously visible page the new back buffer. Does nothing if the mode isn't
+             *  double buffered.
+             */
+            virtual void SwapBuffers();
+
+            /*
+             * GetFrontBuffer:
+             *  Returns a context for the visible page (the adapter itself if the mode
+             *  isn't double buffered).
+             */
+            virtual common::GraphicsContext* GetFrontBuffer();
+        };
+    }
+}
+
+#endif // __MYOS__DRIVERS__BGA_H
@@ -1,6 +1,8 @@
 #ifndef __MYOS__DRIVERS__DRIVER_H        // Header guard to prevent multiple inclusions of this file
 #define __MYOS__DRIVERS__DRIVER_H
 
+#include <common/intrusivelist.h>            // Drivers are linked into the DriverManager's list
+
 namespace myos
 {
     namespace drivers
@@ -10,6 +12,9 @@ namespace myos
         class Driver
         {
         public:
+            // Links the driver into its DriverManager's list.
+            common::IntrusiveListNode driverManagerNode;
+
             // Constructor: Initializes the driver (base constructor does not do anything special).
             Driver();
             
@@ -33,11 +38,8 @@ namespace myos
         class DriverManager
         {
         public:
-            // An array of pointers to Driver objects. 265 drivers is an arbitrary capacity.
-            Driver* drivers[265];
-            
-            // The current number of drivers stored in the array.
-            int numDrivers;
+            // The added drivers, in the order they were added (no fixed capacity).
+            common::IntrusiveList<Driver, &Driver::driverManagerNode> drivers;
             
         public:
             // Constructor initializes the DriverManager with zero drivers.
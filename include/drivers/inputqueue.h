@@ -0,0 +1,104 @@
+#ifndef __MYOS__DRIVERS__INPUTQUEUE_H                // Header guard to prevent multiple inclusion of this header
+#define __MYOS__DRIVERS__INPUTQUEUE_H
+
+#include <common/types.h>                            // Provides fixed-size integer types
+#include <common/lockfreering.h>                     // MultiProducerRing, the queue itself
+#include <perprocessor.h>                            // PerProcessorCounter for the dropped events
+#include <drivers/keyboard.h>                        // KeyboardEventHandler, the interface events arrive through
+#include <drivers/mouse.h>                           // MouseEventHandler, likewise for the mouse
+
+namespace myos
+{
+    namespace drivers
+    {
+        // One keyboard or mouse event, as recorded by the interrupt handler.
+        struct InputEvent
+        {
+            enum Type { Key, MouseDown, MouseUp, MouseMove, MouseWheel };
+
+            common::uint8_t type;                    // One of Type
+            common::uint8_t code;                    // Button (MouseDown/MouseUp)
+            common::int16_t dx;                      // Movement (MouseMove) or wheel turn in 'dy' (MouseWheel)
+            common::int16_t dy;
+            KeyEvent key;                            // The decoded key (Key)
+            common::uint64_t timestamp;              // TSC when the event arrived (0 without a TSC)
+        };
+
+        /*
+         * InputQueue:
+         *  Sits between the keyboard/mouse drivers and the GUI, so that the GUI never runs inside an
+         *  interrupt handler.
+         *
+         *  The drivers get the queue as their event handler. In the interrupt, OnKeyEvent, OnMouseMove,
+         *  etc. only append a timestamped InputEvent to a ring buffer and return. Dispatch, called
+         *  from the GUI loop with interrupts enabled, takes the events out again and passes them to
+         *  the real handlers (the desktop), so focus changes, dragging and rendering can't delay other
+         *  interrupts, such as the network card's.
+         *
+         *  The ring is a MultiProducerRing, since the keyboard and mouse handlers both push to it,
+         *  and needs no lock; their interrupt gates don't nest, so the pushes never overlap. If the
+         *  GUI falls behind and the ring fills up, new events are dropped and counted.
+         *
+         *  Consecutive mouse movements (and wheel turns) are merged into one OnMouseMove (and one
+         *  OnMouseWheel) while dispatching, so a burst of packets costs one hit-test and one window
+         *  move instead of one each. At 200 reports per second this is most of the mouse's events.
+         */
+        class InputQueue : public KeyboardEventHandler, public MouseEventHandler
+        {
+        protected:
+            // Capacity of the ring (a power of two, so indices wrap with a mask).
+            enum { Size = 256 };
+
+            common::MultiProducerRing<InputEvent, Size> events;
+            PerProcessorCounter dropped;             // Events lost because the ring was full
+
+            KeyboardEventHandler* keyboardTarget;    // Receivers of the dispatched events
+            MouseEventHandler* mouseTarget;
+            bool timestamps;                         // True if the CPU has a TSC
+
+            // Stamps 'event' and appends it to the ring (or counts it as dropped).
+            void Record(InputEvent& event);
+
+            // Passes the merged movement and wheel turns on to the mouse target and clears them.
+            void FlushMotion(common::int32_t& moveX, common::int32_t& moveY, common::int32_t& wheel);
+
+        public:
+            /*
+             * Constructor:
+             *  Creates an empty queue delivering keyboard events to 'keyboardTarget' and mouse
+             *  events to 'mouseTarget' (either may be 0).
+             */
+            InputQueue(KeyboardEventHandler* keyboardTarget, MouseEventHandler* mouseTarget);
+            ~InputQueue();
+
+            // Called by the drivers' interrupt handlers: record the event for later.
+            virtual void OnKeyEvent(const KeyEvent& event);
+            virtual void OnMouseDown(common::uint8_t button);
+            virtual void OnMouseUp(common::uint8_t button);
+            virtual void OnMouseMove(int x, int y);
+            virtual void OnMouseWheel(int delta);
+
+            // Called by MouseDriver::Activate (not an interrupt), so it is forwarded right away.
+            virtual void OnActivate();
+
+            /*
+             * Pop:
+             *  Removes the oldest event and copies it to 'event'. Returns false if the queue is empty.
+             */
+            bool Pop(InputEvent* event);
+
+            /*
+             * Dispatch:
+             *  Passes all events queued so far to the targets, merging consecutive mouse movements.
+             *  Events arriving meanwhile are left for the next call. Returns the number of events
+             *  taken out of the queue.
+             */
+            common::uint32_t Dispatch();
+
+            // Number of events dropped because the queue was full.
+            common::uint32_t GetDroppedCount();
+        };
+    }
+}
+
+#endif // __MYOS__DRIVERS__INPUTQUEUE_H
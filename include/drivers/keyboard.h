@@ -5,19 +5,34 @@
 #include <hardwarecommunication/interrupts.h>        // Allows handling hardware interrupts
 #include <drivers/driver.h>                          // Base Driver class definition
 #include <hardwarecommunication/port.h>              // I/O port abstractions
+#include <drivers/keyboardlayout.h>                  // Key codes, modifiers and the decoding tables
 
 namespace myos
 {
     namespace drivers
     {
+        // A decoded key press or release.
+        struct KeyEvent
+        {
+            common::uint8_t keycode;                 // The key (a KeyCode)
+            common::uint8_t modifiers;               // KeyModifier bits in effect for this key
+            char character;                          // Character the key types (0 if none)
+            bool pressed;                            // True for a press (or repeat), false for a release
+            bool repeat;                             // True if the key was already down (typematic repeat)
+        };
+
         // The KeyboardEventHandler class serves as a base or interface for handling keyboard events.
-        // It has two virtual methods: OnKeyDown and OnKeyUp, which can be overridden to define custom behavior.
+        // The driver calls OnKeyEvent for every key; by default that calls OnKeyDown or OnKeyUp with
+        // the typed character, so handlers only interested in text can override just those two.
         class KeyboardEventHandler
         {
         public:
             // Constructor initializes the event handler (empty by default).
             KeyboardEventHandler();
 
+            // Called for every press, repeat and release, including keys that type nothing.
+            virtual void OnKeyEvent(const KeyEvent& event);
+
             // Called when a key is pressed. The char parameter contains the pressed key's character representation.
             virtual void OnKeyDown(char);
 
@@ -33,26 +48,52 @@ namespace myos
                                public Driver
         {
             // Port used to read the data (scan code) sent from the keyboard.
-            myos::hardwarecommunication::Port8Bit dataport;
+            myos::hardwarecommunication::FixedPort<myos::common::uint8_t, 0x60> dataport;
 
             // Port used to send commands to the keyboard controller (e.g., to enable scanning).
-            myos::hardwarecommunication::Port8Bit commandport;
+            myos::hardwarecommunication::FixedPort<myos::common::uint8_t, 0x64> commandport;
             
             // Pointer to a KeyboardEventHandler that will process key events.
             KeyboardEventHandler* handler;
 
+            // Tables scan codes are decoded with.
+            const KeyboardLayout* layout;
+
+            // Decoder state: an E0 prefix was read, bytes of the Pause sequence still to skip.
+            bool extended;
+            myos::common::uint8_t pauseBytes;
+
+            // Current KeyModifier bits, and one bit per KeyCode that is held down.
+            myos::common::uint8_t modifiers;
+            myos::common::uint32_t keysDown[8];
+
+            // Returns true if the key is held down.
+            bool IsDown(myos::common::uint8_t keycode);
+
+            // Builds the KeyEvent for 'keycode' (modifiers, character) and sends it to the handler.
+            void Report(myos::common::uint8_t keycode, bool pressed, bool repeat);
+
         public:
             // Constructor sets up the ports, registers the interrupt handler with the provided interrupt manager,
             // and stores a pointer to the event handler that will handle keyboard events.
+            // Decoding starts with the QWERTZ layout.
             KeyboardDriver(myos::hardwarecommunication::InterruptManager* manager, KeyboardEventHandler *handler);
             
             // Destructor for cleanup (currently nothing specific).
             ~KeyboardDriver();
             
             // The HandleInterrupt method is called when the interrupt for the keyboard is triggered.
-            // 'esp' is the current stack pointer, which can be changed and returned if needed. 
-            // The method processes the scan code read from the keyboard and passes key events to the handler.
-            virtual myos::common::uint32_t HandleInterrupt(myos::common::uint32_t esp);
+            // 'esp' is the current stack pointer, which can be changed if needed.
+            // The method decodes the byte read from the keyboard (one table lookup) and passes presses,
+            // repeats and releases to the handler. It never prints; unknown scan codes are ignored.
+            // IRQ1 belongs to the keyboard alone, so the interrupt is always claimed.
+            virtual bool HandleInterrupt(myos::common::uintptr_t& esp);
+
+            // Switches to another layout (e.g. &KeyboardLayout::qwerty).
+            void SetLayout(const KeyboardLayout* layout);
+
+            // Returns the current KeyModifier bits.
+            myos::common::uint8_t GetModifiers();
             
             // Activate is called to enable the keyboard driver, typically enabling keyboard interrupts
             // and configuring the keyboard controller.
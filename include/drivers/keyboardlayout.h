@@ -0,0 +1,84 @@
+#ifndef __MYOS__DRIVERS__KEYBOARDLAYOUT_H             // Header guard to prevent multiple definitions
+#define __MYOS__DRIVERS__KEYBOARDLAYOUT_H
+
+#include <common/types.h>                            // Provides standard type aliases like uint8_t
+
+namespace myos
+{
+    namespace drivers
+    {
+        /*
+         * KeyCode:
+         *  Identifies a key independent of modifiers. Keys that type something use the
+         *  character they type without Shift ('a', '1', '-', ...; also '\b', '\t', '\n', ' '
+         *  and 27 for Escape), so the key code of a letter depends on the layout. All other
+         *  keys have codes from 0x80 up.
+         */
+        enum KeyCode
+        {
+            KeyNone = 0,
+            KeyBackspace = '\b',
+            KeyTab = '\t',
+            KeyEnter = '\n',
+            KeyEscape = 0x1B,
+            KeySpace = ' ',
+
+            KeyF1 = 0x80, KeyF2, KeyF3, KeyF4, KeyF5, KeyF6,
+            KeyF7, KeyF8, KeyF9, KeyF10, KeyF11, KeyF12,
+
+            KeyUp, KeyDown, KeyLeft, KeyRight,
+            KeyHome, KeyEnd, KeyPageUp, KeyPageDown, KeyInsert, KeyDelete,
+
+            KeyLeftShift, KeyRightShift, KeyLeftControl, KeyRightControl,
+            KeyLeftAlt, KeyRightAlt, KeyLeftGui, KeyRightGui, KeyMenu,
+            KeyCapsLock, KeyNumLock, KeyScrollLock, KeyPrintScreen, KeyPause,
+
+            KeyKeypad0, KeyKeypad1, KeyKeypad2, KeyKeypad3, KeyKeypad4,
+            KeyKeypad5, KeyKeypad6, KeyKeypad7, KeyKeypad8, KeyKeypad9,
+            KeyKeypadPeriod, KeyKeypadPlus, KeyKeypadMinus, KeyKeypadMultiply,
+            KeyKeypadDivide, KeyKeypadEnter,
+
+            // Keys of national layouts that type no ASCII character (e.g. the umlauts on QWERTZ).
+            KeyNational1, KeyNational2, KeyNational3, KeyNational4, KeyNational5
+        };
+
+        /*
+         * KeyModifier:
+         *  Bits of KeyEvent::modifiers. The lock bits are toggled by pressing the lock keys.
+         */
+        enum KeyModifier
+        {
+            ModifierShift      = 0x01,
+            ModifierControl    = 0x02,
+            ModifierAlt        = 0x04,                   // Left Alt
+            ModifierAltGr      = 0x08,                   // Right Alt
+            ModifierGui        = 0x10,                   // Windows keys
+            ModifierCapsLock   = 0x20,
+            ModifierNumLock    = 0x40,
+            ModifierScrollLock = 0x80
+        };
+
+        /*
+         * KeyboardLayout:
+         *  The tables the keyboard driver decodes with; every lookup is a single array access.
+         *
+         *  'keycodes' maps a scan code set 1 make code (the release bit removed) to a KeyCode:
+         *  entries 0..127 for plain scan codes, 128..255 for those following an E0 prefix.
+         *  'characters' maps a KeyCode to the character it types without Shift, with Shift and
+         *  with AltGr (0 if the key types nothing; without an AltGr character, AltGr is ignored).
+         *
+         *  The tables are computed at compile time; 'qwerty' is the US layout, 'qwertz' the
+         *  German one for the ASCII characters (it has been the driver's default so far).
+         */
+        struct KeyboardLayout
+        {
+            common::uint8_t keycodes[256];
+            char characters[3][256];
+
+            static const KeyboardLayout qwerty;
+            static const KeyboardLayout qwertz;
+        };
+    }
+}
+
+#endif  // __MYOS__DRIVERS__KEYBOARDLAYOUT_H
@@ -32,6 +32,9 @@ namespace myos
             // Called when the mouse is moved. 
             // 'x' and 'y' represent the distance moved in the horizontal and vertical directions.
             virtual void OnMouseMove(int x, int y);
+
+            // Called when the scroll wheel turns; 'delta' is positive towards the user.
+            virtual void OnMouseWheel(int delta);
         };
         
         
@@ -41,13 +44,17 @@ namespace myos
                             public Driver
         {
             // Ports used for communication with the mouse through the PS/2 controller.
-            myos::hardwarecommunication::Port8Bit dataport;    // Data port (commonly 0x60) to read mouse data (packets).
-            myos::hardwarecommunication::Port8Bit commandport;  // Command port (commonly 0x64) for sending commands to the mouse/PS/2 controller.
+            myos::hardwarecommunication::FixedPort<myos::common::uint8_t, 0x60> dataport;    // Data port (0x60) to read mouse data (packets).
+            myos::hardwarecommunication::FixedPort<myos::common::uint8_t, 0x64> commandport;  // Command port (0x64) for sending commands to the mouse/PS/2 controller.
 
-            // The mouse sends data in packets of three bytes. We store them here in 'buffer'.
-            // 'offset' indicates which of the three bytes we are currently processing.
-            myos::common::uint8_t buffer[3];
+            // The mouse sends data in packets of three bytes (four with a scroll wheel). We store them
+            // here in 'buffer'. 'offset' indicates which byte we are currently processing.
+            myos::common::uint8_t buffer[4];
             myos::common::uint8_t offset;
+            myos::common::uint8_t packetSize;
+
+            // Reports per second the mouse was set to (0 if it didn't accept any).
+            myos::common::uint8_t sampleRate;
 
             // Stores the status of the mouse buttons.
             // Each bit in 'buttons' can represent a button’s current pressed/released state.
@@ -56,6 +63,21 @@ namespace myos
             // Pointer to a MouseEventHandler that processes high-level mouse events (clicks, movement).
             MouseEventHandler* handler;
 
+            // Waits until the controller can take a byte / has a byte for us. False on timeout.
+            bool WaitForWrite();
+            bool WaitForRead();
+
+            // Sends a command (and optionally its argument) to the mouse and waits for the
+            // acknowledgement (0xFA). Returns false if the mouse didn't acknowledge.
+            bool SendCommand(myos::common::uint8_t command);
+            bool SendCommand(myos::common::uint8_t command, myos::common::uint8_t argument);
+
+            // Asks the mouse for its ID: 0 for a plain PS/2 mouse, 3 with a scroll wheel.
+            myos::common::uint8_t ReadDeviceId();
+
+            // Sets how many packets per second the mouse reports (10..200).
+            bool SetSampleRate(myos::common::uint8_t rate);
+
         public:
             // Constructor registers the driver with the interrupt manager,
             // initializes the ports, and sets the event handler.
@@ -66,13 +88,22 @@ namespace myos
 
             // Called by the interrupt manager when an IRQ for the mouse occurs (IRQ12).
             // 'esp' is the stack pointer; can be modified if needed.
-            // Reads the mouse data packet from 'dataport' and processes it.
-            // Returns the potentially updated stack pointer.
-            virtual myos::common::uint32_t HandleInterrupt(myos::common::uint32_t esp);
+            // Reads one byte of the mouse data packet from 'dataport' and processes complete packets.
+            // If a byte got lost, the packet boundary is found again with bit 3 of the first byte,
+            // which is always set.
+            // Returns false (not claimed) if the controller has no mouse data.
+            virtual bool HandleInterrupt(myos::common::uintptr_t& esp);
 
-            // Activates the driver: often sends commands to the mouse to start sending data,
-            // enables interrupts, and calls OnActivate on the handler.
+            // Activates the driver: enables the mouse port and IRQ12, switches an IntelliMouse into
+            // its four byte mode with the scroll wheel, raises the sample rate to 200 reports per
+            // second, starts data reporting and calls OnActivate on the handler.
             virtual void Activate();
+
+            // True if the mouse sends scroll wheel movements.
+            bool HasWheel();
+
+            // Reports per second (0 if the mouse kept its default).
+            myos::common::uint8_t GetSampleRate();
         };
 
     }
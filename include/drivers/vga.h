@@ -4,6 +4,7 @@
 #include <common/types.h>                                    // Provides integral type definitions (e.g., uint8_t, uint32_t)
 #include <hardwarecommunication/port.h>                      // I/O port abstractions for reading/writing to VGA hardware
 #include <drivers/driver.h>                                  // Base classes for drivers (not directly used here, but often included for consistency)
+#include <common/graphicscontext.h>                          // GraphicsContext, which implements all drawing primitives
 
 namespace myos
 {
@@ -11,25 +12,28 @@ namespace myos
     {
         /*
          * The VideoGraphicsArray class encapsulates control and interaction with a VGA-compatible graphics device.
-         * It exposes functionality to set the display mode and to draw basic graphics (pixels, rectangles).
+         * It exposes functionality to set the display mode; once a mode is set, the framebuffer is handed to
+         * the GraphicsContext base class, which does all drawing (pixels, spans, rectangles, blits) in memory.
          * Internally, it uses I/O ports to communicate with the VGA hardware registers.
          */
-        class VideoGraphicsArray
+        class VideoGraphicsArray : public common::GraphicsContext
         {
         protected:
             // Ports for accessing various VGA registers (miscellaneous, CRTC, sequencer, graphics controller, attribute controller).
             // These ports are used to configure the VGA mode, memory mapping, and palette.
-            hardwarecommunication::Port8Bit miscPort;                      // Port for miscellaneous VGA settings
-            hardwarecommunication::Port8Bit crtcIndexPort;                 // CRTC (Cathode Ray Tube Controller) index port
-            hardwarecommunication::Port8Bit crtcDataPort;                  // CRTC data port (writes register values specified by crtcIndexPort)
-            hardwarecommunication::Port8Bit sequencerIndexPort;            // Sequencer index port
-            hardwarecommunication::Port8Bit sequencerDataPort;             // Sequencer data port (writes register values specified by sequencerIndexPort)
-            hardwarecommunication::Port8Bit graphicsControllerIndexPort;   // Graphics controller index port
-            hardwarecommunication::Port8Bit graphicsControllerDataPort;    // Graphics controller data port (writes register values specified by graphicsControllerIndexPort)
-            hardwarecommunication::Port8Bit attributeControllerIndexPort;  // Attribute controller index port
-            hardwarecommunication::Port8Bit attributeControllerReadPort;   // Attribute controller read port
-            hardwarecommunication::Port8Bit attributeControllerWritePort;  // Attribute controller write port
-            hardwarecommunication::Port8Bit attributeControllerResetPort;  // Attribute controller reset port
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3C2> miscPort;  // Port for miscellaneous VGA settings
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3D4> crtcIndexPort;  // CRTC (Cathode Ray Tube Controller) index port
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3D5> crtcDataPort;  // CRTC data port (writes register values specified by crtcIndexPort)
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3C4> sequencerIndexPort;  // Sequencer index port
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3C5> sequencerDataPort;  // Sequencer data port (writes register values specified by sequencerIndexPort)
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3CE> graphicsControllerIndexPort;  // Graphics controller index port
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3CF> graphicsControllerDataPort;  // Graphics controller data port (writes register values specified by graphicsControllerIndexPort)
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3C0> attributeControllerIndexPort;  // Attribute controller index port
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3C1> attributeControllerReadPort;  // Attribute controller read port
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3C0> attributeControllerWritePort;  // Attribute controller write port
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3DA> attributeControllerResetPort;  // Attribute controller reset port
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3C8> paletteIndexPort;  // DAC write index port (first palette entry to set)
+            hardwarecommunication::FixedPort<common::uint8_t, 0x3C9> paletteDataPort;  // DAC data port (red, green, blue of each entry in turn)
             
             /*
              * WriteRegisters:
@@ -44,6 +48,13 @@ namespace myos
              */
             void WriteRegisters(common::uint8_t* registers);
 
+            /*
+             * WritePalette:
+             *  Loads the 256 colors of 'palette' (0x00RRGGBB each) into the DAC. The DAC only
+             *  keeps 6 bits per component, so the lowest two bits are dropped.
+             */
+            void WritePalette(common::uint32_t* palette);
+
             /*
              * GetFrameBufferSegment:
              *  Determines which segment of memory is used as the frame buffer (where actual pixel data is stored).
@@ -55,10 +66,9 @@ namespace myos
             /*
              * GetColorIndex:
              *  Given an RGB value, returns an 8-bit color index. In VGA's 256-color mode,
-             *  colors are often indexed rather than stored directly as 24-bit color.
-             *  The default implementation may return an index that approximates the input RGB.
-             *  Derived classes or specific implementations could override this to implement 
-             *  different color palettes or direct color modes.
+             *  colors are indexed rather than stored directly as 24-bit color.
+             *  SetMode loads a palette with a 6x7x6 color cube and a gray ramp, and this
+             *  returns the nearest entry using three table lookups (no search).
              */
             virtual common::uint8_t GetColorIndex(common::uint8_t r, common::uint8_t g, common::uint8_t b);
             
@@ -82,30 +92,37 @@ namespace myos
              *  If successful, returns true. Otherwise, returns false.
              */
             virtual bool SetMode(common::uint32_t width, common::uint32_t height, common::uint32_t colordepth);
-            
+
             /*
-             * PutPixel (overload 1):
-             *  Draws a pixel at coordinates (x, y) with the specified RGB color. 
-             *  Internally, this is usually converted to a color index for 256-color modes.
+             * MapColor:
+             *  Returns the palette index for an RGB color (see GetColorIndex), so drawing
+             *  code can convert a color once and then draw with the index.
              */
-            virtual void PutPixel(common::int32_t x, common::int32_t y, common::uint8_t r, common::uint8_t g, common::uint8_t b);
+            virtual common::uint32_t MapColor(common::uint8_t r, common::uint8_t g, common::uint8_t b);
 
             /*
-             * PutPixel (overload 2):
-             *  Draws a pixel at coordinates (x, y) with an already computed 8-bit colorIndex.
-             *  This allows faster drawing if the color index is known beforehand.
+             * GetFrontBuffer:
+             *  Returns a context for the pixels currently on screen. Plain VGA draws straight
+             *  to the screen, so this is the VGA context itself.
              */
-            virtual void PutPixel(common::int32_t x, common::int32_t y, common::uint8_t colorIndex);
-            
+            virtual common::GraphicsContext* GetFrontBuffer();
+
             /*
-             * FillRectangle:
-             *  Fills a rectangular area at (x, y) with dimensions w x h using the given RGB color.
-             *  Internally, each pixel within that rectangle will be set using the color index derived from (r,g,b).
+             * SwapBuffers:
+             *  Shows what was drawn since the last call. Does nothing without double buffering.
              */
-            virtual void FillRectangle(common::uint32_t x, common::uint32_t y, 
-                                       common::uint32_t w, common::uint32_t h, 
-                                       common::uint8_t r, common::uint8_t g, common::uint8_t b);
+            virtual void SwapBuffers();
+
+            // Returns true while the display is in vertical retrace (Input Status #1, bit 3).
+            bool InVerticalRetrace();
 
+            /*
+             * WaitForVerticalRetrace:
+             *  Waits for the beginning of the next vertical retrace, so a frame can be shown
+             *  without tearing. Returns false if no retrace was seen within about a second
+             *  (some emulated adapters never report one).
+             */
+            bool WaitForVerticalRetrace();
         };
         
     }
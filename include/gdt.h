@@ -2,6 +2,7 @@
 #define __MYOS__GDT_H
 
 #include <common/types.h>
+#include <perprocessor.h>
 
 namespace myos
 {
@@ -30,7 +31,8 @@ namespace myos
                     // Constructor to initialize the segment descriptor with the given
                     // base address, limit, and type. The type specifies the segment's
                     // access rights and purpose (e.g., code, data, or system segment).
-                    SegmentDescriptor(myos::common::uint32_t base, myos::common::uint32_t limit, myos::common::uint8_t type);
+                    // The defaults give a null descriptor.
+                    SegmentDescriptor(myos::common::uint32_t base = 0, myos::common::uint32_t limit = 0, myos::common::uint8_t type = 0);
 
                     // Returns the full 32-bit base address of the segment.
                     myos::common::uint32_t Base();
@@ -39,12 +41,41 @@ namespace myos
                     myos::common::uint32_t Limit();
             } __attribute__((packed)); // Ensures the structure is tightly packed with no padding.
 
+#ifdef __x86_64__
+            // The 64-bit task state segment. Long mode doesn't switch tasks in hardware; the TSS
+            // only holds the stacks the CPU switches to: rsp[0] when an interrupt or exception
+            // arrives from ring 3, and the IST stacks an IDT entry can ask for.
+            struct TaskStateSegment
+            {
+                myos::common::uint32_t reserved0;
+                myos::common::uint64_t rsp[3];         // Stack pointers for rings 0-2
+                myos::common::uint64_t reserved1;
+                myos::common::uint64_t ist[7];         // Interrupt stack table (IST1-IST7)
+                myos::common::uint64_t reserved2;
+                myos::common::uint16_t reserved3;
+                myos::common::uint16_t ioMapBase;      // Offset of the I/O permission bitmap
+            } __attribute__((packed));
+#endif
+
         private:
             // Predefined segment descriptors for the GDT.
             SegmentDescriptor nullSegmentSelector;   // Null segment (required by x86 architecture)
             SegmentDescriptor unusedSegmentSelector; // Unused segment for alignment
             SegmentDescriptor codeSegmentSelector;   // Code segment (executable memory)
             SegmentDescriptor dataSegmentSelector;   // Data segment (read/write memory)
+#ifdef __x86_64__
+            // SYSRET loads the user selectors relative to the kernel data segment
+            // (SS = base + 8, CS = base + 16), so these two have to follow it in this order.
+            SegmentDescriptor userDataSegmentSelector;   // Ring 3 data segment
+            SegmentDescriptor userCodeSegmentSelector;   // Ring 3 64-bit code segment
+            SegmentDescriptor taskStateSegmentSelector;  // TSS descriptor, lower half
+            myos::common::uint32_t taskStateSegmentBaseHigh; // TSS descriptor, upper half: base bits 32-63
+            myos::common::uint32_t taskStateSegmentReserved; // TSS descriptor, upper half: must be 0
+
+            static TaskStateSegment taskStateSegment;  // The one TSS (there is one CPU)
+#endif
+            // One data segment per processor, over its PerProcessorArea; loaded into GS.
+            SegmentDescriptor processorDataSegmentSelectors[PerProcessor::MaxProcessors];
 
         public:
 
@@ -61,6 +92,23 @@ namespace myos
             // Returns the selector for the data segment.
             // This is used to load the DS (Data Segment) register during runtime.
             myos::common::uint16_t DataSegmentSelector();
+
+#ifdef __x86_64__
+            // Return the selectors of the ring 3 segments and of the TSS.
+            myos::common::uint16_t UserCodeSegmentSelector();
+            myos::common::uint16_t UserDataSegmentSelector();
+            myos::common::uint16_t TaskStateSegmentSelector();
+
+            // Sets the stack the CPU switches to when an interrupt arrives in ring 3.
+            void SetKernelStack(myos::common::uintptr_t stackTop);
+#endif
+
+            // Returns the selector of processor 'index''s data segment.
+            myos::common::uint16_t ProcessorDataSegmentSelector(myos::common::uint32_t index);
+
+            // Points the running processor's GS at area 'index' and sets the area up. The
+            // constructor does this for the boot processor (0); others call it as they start.
+            void LoadProcessorDataSegment(myos::common::uint32_t index);
     };
 
 }
@@ -0,0 +1,58 @@
+#ifndef __MYOS__GUI__CURSOR_H                     // Header guard to prevent multiple inclusions
+#define __MYOS__GUI__CURSOR_H
+
+#include <common/types.h>                         // Provides fixed-size integer types
+#include <common/graphicscontext.h>               // The context the cursor is drawn on
+
+namespace myos
+{
+    namespace gui
+    {
+        /*
+         * MouseCursor:
+         *  A software cursor drawn on top of the finished frame, on the buffer that is on screen.
+         *
+         *  Before the sprite is drawn, the pixels it covers are saved ("save-under"). Moving the
+         *  cursor puts those pixels back and repeats the procedure at the new position, so the
+         *  scene below never has to be drawn again just because the mouse moved. Each move costs
+         *  two reads and writes per sprite pixel, no matter how many windows are open.
+         */
+        class MouseCursor
+        {
+        protected:
+            // The sprite: a white crosshair reaching 3 pixels from the hot spot in each direction
+            // (7 pixels across, the same cross Desktop used to draw with PutPixel).
+            enum { Size = 7, HotSpot = 3, MaxPixels = Size * Size };
+            static const char* shape[Size];
+
+            // Where the cursor is shown (0 while hidden), its hot spot, and the saved pixels,
+            // in the order the sprite's pixels are visited.
+            common::GraphicsContext* target;
+            common::int32_t x;
+            common::int32_t y;
+            common::uint32_t saved[MaxPixels];
+
+        public:
+            MouseCursor();
+            ~MouseCursor();
+
+            /*
+             * Show:
+             *  Saves the pixels under the sprite at (x, y) on 'gc' and draws the sprite.
+             *  A cursor already shown is hidden first.
+             */
+            void Show(common::GraphicsContext* gc, common::int32_t x, common::int32_t y);
+
+            /*
+             * Hide:
+             *  Writes the saved pixels back.
+             */
+            void Hide();
+
+            // Returns true if the cursor is currently shown on 'gc' at (x, y).
+            bool IsShownAt(common::GraphicsContext* gc, common::int32_t x, common::int32_t y);
+        };
+    }
+}
+
+#endif // __MYOS__GUI__CURSOR_H
@@ -3,6 +3,7 @@
 
 #include <gui/widget.h>                                           // Includes the definition of Widget and CompositeWidget
 #include <drivers/mouse.h>                                        // Includes MouseEventHandler interface
+#include <gui/cursor.h>                                           // Software mouse cursor with save-under
 
 namespace myos
 {
@@ -21,6 +22,14 @@ namespace myos
             // Tracks the current mouse position within the desktop (x and y coordinates).
             common::uint32_t MouseX;
             common::uint32_t MouseY;
+
+            // The mouse cursor, drawn over the finished frame on the visible buffer.
+            MouseCursor cursor;
+
+            // The screen areas that changed since the last Render, and those the last
+            // Render painted (a page-flipping display shows them only in one buffer).
+            common::Region damage;
+            common::Region previousDamage;
             
         public:
             /*
@@ -34,13 +43,53 @@ namespace myos
 
             // Destructor (empty for now but can be used to clean up resources).
             ~Desktop();
+
+            /*
+             * Resize:
+             *  Changes the desktop size, e.g. after switching to a higher video mode,
+             *  and moves the mouse back to the center of the new screen.
+             */
+            void Resize(common::int32_t w, common::int32_t h);
             
             /*
              * Draw:
              *  Renders the desktop and all its child widgets onto the provided GraphicsContext (gc).
-             *  This includes filling the background, then recursively drawing child widgets.
+             *  This includes filling the background, then recursively drawing child widgets,
+             *  and finally the mouse cursor.
              */
             void Draw(common::GraphicsContext* gc);
+
+            /*
+             * Render:
+             *  Repaints the invalidated parts of the desktop and its windows (without the
+             *  cursor) into 'gc'. Returns false, drawing nothing, if nothing was invalidated.
+             *  With 'flipping', 'gc' is the back buffer of two that are swapped after every
+             *  Render, so it still lacks the previous Render's changes; they are painted too.
+             */
+            bool Render(common::GraphicsContext* gc, bool flipping = false);
+
+            // Returns true if Render has anything to paint.
+            bool IsDamaged();
+
+            /*
+             * UpdateCursor:
+             *  Moves the cursor to the current mouse position on 'front', the buffer that is
+             *  on screen. Does nothing if it is already there.
+             */
+            void UpdateCursor(common::GraphicsContext* front);
+
+            /*
+             * HideCursor:
+             *  Restores the pixels under the cursor, before the buffer it is on is drawn
+             *  into or swapped away.
+             */
+            void HideCursor();
+
+            /*
+             * InvalidateRectangle:
+             *  Adds the area (clipped to the screen) to the parts the next Render repaints.
+             */
+            virtual void InvalidateRectangle(const common::Rectangle& area);
             
             /*
              * OnMouseDown:
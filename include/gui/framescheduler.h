@@ -0,0 +1,84 @@
+#ifndef __MYOS__GUI__FRAMESCHEDULER_H                             // Header guard to prevent multiple inclusions
+#define __MYOS__GUI__FRAMESCHEDULER_H
+
+#include <common/types.h>                                         // Provides fixed-size integer types
+#include <drivers/vga.h>                                          // The display frames are shown on
+#include <drivers/inputqueue.h>                                   // Keyboard and mouse events for the desktop
+#include <gui/desktop.h>                                          // The scene being rendered
+
+namespace myos
+{
+    namespace gui
+    {
+        /*
+         * FrameScheduler:
+         *  Paces the GUI to the display's refresh instead of drawing as fast as the CPU allows.
+         *
+         *  Each call to RunFrame waits for the start of a vertical retrace. During the retrace it
+         *  shows the frame rendered before (a buffer flip on the BGA) and moves the mouse cursor,
+         *  so neither tears. Queued input events are handed to the desktop right after the retrace
+         *  starts, so they show up in the very next frame. Afterwards it renders the next frame
+         *  into the back buffer, but only if the desktop was invalidated. The desktop is therefore
+         *  rendered at most once per refresh, and not at all while nothing changes.
+         *
+         *  If rendering a frame takes longer than one refresh, retraces pass unnoticed. With a
+         *  time stamp counter the scheduler measures the refresh period once and counts those
+         *  retraces as missed frames, which tells how smooth the GUI actually is.
+         */
+        class FrameScheduler
+        {
+        protected:
+            Desktop* desktop;                                     // Scene to render
+            drivers::VideoGraphicsArray* display;                 // Where frames are shown
+            drivers::InputQueue* input;                           // Events to dispatch each frame (may be 0)
+
+            bool retraceAvailable;                                // False if the display never reports a retrace
+            bool framePending;                                    // A rendered frame waits in the back buffer
+
+            common::uint32_t refreshPeriod;                       // TSC ticks per refresh (0 if unknown)
+            common::uint32_t lastRetrace;                         // TSC (low half) at the last retrace
+            common::uint32_t refreshRate;                         // Refreshes per second (0 if unknown)
+
+            common::uint32_t refreshes;                           // Refreshes since the display was set
+            common::uint32_t framesPresented;                     // Frames shown
+            common::uint32_t framesMissed;                        // Refreshes lost to slow rendering
+
+            // Times a few retraces with the TSC to find 'refreshPeriod' and 'refreshRate'.
+            void MeasureRefreshPeriod();
+
+        public:
+            /*
+             * Constructor:
+             *  Schedules frames of 'desktop' on 'display' (see SetDisplay), dispatching the
+             *  events of 'input' (if not 0) once per frame.
+             */
+            FrameScheduler(Desktop* desktop, drivers::VideoGraphicsArray* display,
+                           drivers::InputQueue* input);
+            ~FrameScheduler();
+
+            /*
+             * SetDisplay:
+             *  Switches to another display (or a new mode of the same one): checks that it
+             *  reports retraces, measures its refresh period and resets the counters.
+             */
+            void SetDisplay(drivers::VideoGraphicsArray* display);
+
+            /*
+             * RunFrame:
+             *  Handles one refresh: waits for the retrace, dispatches input, shows the pending
+             *  frame, moves the cursor and renders the next frame if anything changed.
+             */
+            void RunFrame();
+
+            // Counters since the last SetDisplay (missed frames are only counted with a TSC).
+            common::uint32_t GetRefreshCount();
+            common::uint32_t GetPresentedFrameCount();
+            common::uint32_t GetMissedFrameCount();
+
+            // Refresh rate in hertz, measured by SetDisplay (0 if unknown).
+            common::uint32_t GetRefreshRate();
+        };
+    }
+}
+
+#endif // __MYOS__GUI__FRAMESCHEDULER_H
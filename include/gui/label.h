@@ -0,0 +1,59 @@
+#ifndef __MYOS__GUI__LABEL_H                      // Header guard to prevent multiple inclusions
+#define __MYOS__GUI__LABEL_H
+
+#include <gui/widget.h>                           // Base Widget class
+#include <common/glyphcache.h>                    // Draws the text
+
+namespace myos
+{
+    namespace gui
+    {
+        /*
+         * Label:
+         *  A widget showing one line of text on its background color. The text isn't copied,
+         *  so it must stay valid while the label shows it (e.g. a string literal).
+         *  Text is drawn through the active GlyphCache; without one, only the background shows.
+         */
+        class Label : public Widget
+        {
+        protected:
+            // The zero-terminated text, and the color it is drawn in.
+            char* text;
+            common::uint8_t textR;
+            common::uint8_t textG;
+            common::uint8_t textB;
+
+        public:
+            /*
+             * Constructor:
+             *   - parent, x, y, w, h: as for every Widget
+             *   - text: the text to show
+             *   - textR, textG, textB: the text color
+             *   - r, g, b: the background color
+             */
+            Label(Widget* parent,
+                  common::int32_t x, common::int32_t y, common::int32_t w, common::int32_t h,
+                  char* text,
+                  common::uint8_t textR, common::uint8_t textG, common::uint8_t textB,
+                  common::uint8_t r, common::uint8_t g, common::uint8_t b);
+
+            ~Label();
+
+            /*
+             * SetText:
+             *  Shows a different text and invalidates the label.
+             */
+            void SetText(char* text);
+
+            /*
+             * Paint:
+             *  Draws the text (cut off at the label's right edge) in the top-left corner
+             *  and fills the rest of the clip list with the background.
+             */
+            virtual void Paint(common::GraphicsContext* gc, common::Region* clip,
+                               common::int32_t X, common::int32_t Y);
+        };
+    }
+}
+
+#endif // __MYOS__GUI__LABEL_H
@@ -0,0 +1,85 @@
+#ifndef __MYOS__GUI__SPATIALGRID_H                // Header guard to prevent multiple inclusions
+#define __MYOS__GUI__SPATIALGRID_H
+
+#include <common/types.h>                         // Provides fixed-size integer types
+#include <common/region.h>                        // Rectangle
+
+namespace myos
+{
+    namespace gui
+    {
+        class Widget;
+
+        /*
+         * SpatialGrid:
+         *  A uniform grid over the area of a CompositeWidget that remembers which children
+         *  overlap each cell, so finding the child under the mouse only looks at the few
+         *  children near the point instead of all of them.
+         *
+         *  The cells hold pointers to the children in no particular order, so raising a child
+         *  doesn't touch the grid at all; the caller picks the topmost candidate by its z-order
+         *  stamp. Rectangles reaching past the grid are stored in the border cells, and points
+         *  outside the grid are looked up in the nearest border cell, so the result is exact as
+         *  long as the caller still checks the candidates with ContainsCoordinate.
+         *
+         *  The cell lists live on the heap. If an allocation fails the grid becomes invalid,
+         *  and the caller has to fall back to checking every child until it is rebuilt.
+         */
+        class SpatialGrid
+        {
+        public:
+            // Number of cells in each direction.
+            enum { Columns = 8, Rows = 8 };
+
+        protected:
+            // The children overlapping one cell, unordered.
+            struct Cell
+            {
+                Widget** entries;
+                common::int32_t count;
+                common::int32_t capacity;
+            };
+
+            Cell cells[Rows * Columns];
+            common::int32_t cellWidth;                // Size of one cell in pixels (at least 1)
+            common::int32_t cellHeight;
+            bool valid;                               // False after an allocation failed
+
+            // Returns the column/row of a coordinate, clamped to the grid.
+            common::int32_t ColumnOf(common::int32_t x);
+            common::int32_t RowOf(common::int32_t y);
+
+            // Appends 'child' to one cell's list.
+            bool InsertIntoCell(Cell* cell, Widget* child);
+
+        public:
+            SpatialGrid();
+            ~SpatialGrid();
+
+            /*
+             * Reset:
+             *  Empties the grid and lays it out over an area of 'width' x 'height' pixels.
+             *  The grid is valid again afterwards.
+             */
+            void Reset(common::int32_t width, common::int32_t height);
+
+            // Returns false if an insert failed since the last Reset.
+            bool IsValid();
+
+            // Adds 'child' to every cell 'bounds' overlaps.
+            void Insert(Widget* child, const common::Rectangle& bounds);
+
+            // Removes 'child' from every cell 'bounds' (as inserted) overlaps.
+            void Remove(Widget* child, const common::Rectangle& bounds);
+
+            /*
+             * Query:
+             *  Points 'entries' at the children stored in the cell containing (x, y), in no
+             *  particular order, and returns how many there are.
+             */
+            common::int32_t Query(common::int32_t x, common::int32_t y, Widget* const** entries);
+        };
+    }
+}
+
+#endif // __MYOS__GUI__SPATIALGRID_H
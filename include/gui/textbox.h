@@ -0,0 +1,94 @@
+#ifndef __MYOS__GUI__TEXTBOX_H                    // Header guard to prevent multiple inclusions
+#define __MYOS__GUI__TEXTBOX_H
+
+#include <gui/widget.h>                           // Base Widget class
+#include <common/glyphcache.h>                    // Draws the text
+
+namespace myos
+{
+    namespace gui
+    {
+        /*
+         * TextBox:
+         *  A multi-line text area working like a terminal: a grid of character cells with a
+         *  cursor. Text written to it (or typed while it has the focus) appears at the cursor,
+         *  wraps at the right edge and scrolls up once the last line is full.
+         *
+         *  The grid is as large as the widget (one cell per glyph of the active GlyphCache's
+         *  font), up to MaxColumns x MaxRows.
+         */
+        class TextBox : public Widget
+        {
+        public:
+            // Largest grid (a 1024x768 screen full of 8x16 glyphs).
+            enum { MaxColumns = 128, MaxRows = 48 };
+
+        protected:
+            // The characters of every cell (' ' where nothing was written).
+            char cells[MaxRows][MaxColumns];
+
+            // Size of the grid and the cursor position in cells.
+            common::int32_t columns;
+            common::int32_t rows;
+            common::int32_t cursorColumn;
+            common::int32_t cursorRow;
+
+            // Whether typed characters are added to the text.
+            bool editable;
+
+            // The text color.
+            common::uint8_t textR;
+            common::uint8_t textG;
+            common::uint8_t textB;
+
+            // Moves all lines up by one, clearing the last one.
+            void Scroll();
+
+            // Adds one character at the cursor without invalidating.
+            void PutCharacter(char c);
+
+        public:
+            /*
+             * Constructor:
+             *   - parent, x, y, w, h: as for every Widget
+             *   - textR, textG, textB: the text color
+             *   - r, g, b: the background color
+             *  The grid starts empty with the cursor in the top-left cell.
+             */
+            TextBox(Widget* parent,
+                    common::int32_t x, common::int32_t y, common::int32_t w, common::int32_t h,
+                    common::uint8_t textR, common::uint8_t textG, common::uint8_t textB,
+                    common::uint8_t r, common::uint8_t g, common::uint8_t b);
+
+            ~TextBox();
+
+            /*
+             * Write:
+             *  Adds a zero-terminated string at the cursor. '\n' starts a new line and
+             *  '\b' removes the character before the cursor.
+             */
+            void Write(char* str);
+
+            // Empties the grid and moves the cursor home.
+            void Clear();
+
+            // Enables or disables adding typed characters (enabled by default).
+            void SetEditable(bool editable);
+
+            /*
+             * Paint:
+             *  Draws every line of the grid as one string and the cursor as an underline.
+             */
+            virtual void Paint(common::GraphicsContext* gc, common::Region* clip,
+                               common::int32_t X, common::int32_t Y);
+
+            /*
+             * OnKeyDown:
+             *  Adds the typed character at the cursor, if the text box is editable.
+             */
+            virtual void OnKeyDown(char c);
+        };
+    }
+}
+
+#endif // __MYOS__GUI__TEXTBOX_H
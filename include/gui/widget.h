@@ -3,6 +3,8 @@
 
 #include <common/types.h>                         // Provides fixed-size integer types (int32_t, uint8_t, etc.)
 #include <common/graphicscontext.h>               // Provides the GraphicsContext class used for drawing
+#include <common/region.h>                        // Provides Rectangle and Region (clip lists)
+#include <gui/spatialgrid.h>                      // Grid of child rectangles for hit-testing
 #include <drivers/keyboard.h>                     // Provides the KeyboardEventHandler interface
 
 namespace myos
@@ -18,6 +20,9 @@ namespace myos
          */
         class Widget : public myos::drivers::KeyboardEventHandler
         {
+            // The parent links its children into its z-order list through 'above' and 'below'.
+            friend class CompositeWidget;
+
         protected:
             // Pointer to the parent widget. If null, this widget is at the top-level.
             Widget* parent;
@@ -37,6 +42,17 @@ namespace myos
             // Indicates if the widget can receive focus for keyboard input.
             bool Focussable;
 
+            // False while the widget is hidden (e.g. a minimised window): it is neither
+            // painted nor hit by the mouse.
+            bool visible;
+
+            // Neighbours in the parent's z-order list (0 at the top/bottom end).
+            Widget* above;
+            Widget* below;
+
+            // Stacking stamp given by the parent; higher means further up.
+            common::int32_t zOrder;
+
         public:
             /*
              * Constructor:
@@ -72,14 +88,78 @@ namespace myos
              *  lies within this widget. Returns true if inside, false otherwise.
              */
             virtual bool ContainsCoordinate(common::int32_t x, common::int32_t y);
+
+            /*
+             * GetBounds:
+             *  Returns the widget's rectangle in its parent's coordinate space.
+             */
+            common::Rectangle GetBounds();
+
+            /*
+             * SetBounds:
+             *  Moves and/or resizes the widget (in its parent's coordinate space). The parent
+             *  is told about the change, so it can update its hit-testing grid and render again.
+             */
+            virtual void SetBounds(common::int32_t x, common::int32_t y,
+                                   common::int32_t w, common::int32_t h);
+
+            /*
+             * ChildBoundsChanged:
+             *  Called by a child's SetBounds with the rectangle it covered before.
+             *  Plain widgets have no children, so this does nothing.
+             */
+            virtual void ChildBoundsChanged(Widget* child, const common::Rectangle& oldBounds);
+
+            /*
+             * Hide / Show:
+             *  Takes the widget off the screen or puts it back. The parent repaints the
+             *  rectangle the widget covers.
+             */
+            void Hide();
+            void Show();
+            bool IsVisible();
+
+            /*
+             * ChildVisibilityChanged:
+             *  Called by a child's Hide and Show. Plain widgets have no children, so this
+             *  does nothing.
+             */
+            virtual void ChildVisibilityChanged(Widget* child);
             
             /*
              * Draw:
-             *  Called to render the widget onto the provided GraphicsContext. 
-             *  By default, it might fill a rectangle with the widget’s color.
+             *  Called to render the whole widget onto the provided GraphicsContext.
+             *  Computes the widget's screen position and calls Paint with the widget's
+             *  full rectangle as clip list.
              */
             virtual void Draw(common::GraphicsContext* gc);
 
+            /*
+             * Paint:
+             *  Renders only the pixels inside 'clip' (screen coordinates).
+             *  X, Y is the widget's top-left corner on the screen, as computed by the caller,
+             *  so the parent chain doesn't have to be walked again for every widget.
+             *  By default, fills each rectangle of the clip list with the widget's color.
+             */
+            virtual void Paint(common::GraphicsContext* gc, common::Region* clip,
+                               common::int32_t X, common::int32_t Y);
+
+            /*
+             * Invalidate:
+             *  Must be called whenever the widget's appearance changes. Same as
+             *  InvalidateRectangle with the widget's whole area.
+             */
+            virtual void Invalidate();
+
+            /*
+             * InvalidateRectangle:
+             *  Notes that the pixels of 'area' (in the widget's own coordinates) changed. By
+             *  default, passes the area up the parent chain, so a Window caching its contents
+             *  knows it has to render them again and the desktop knows what to repaint.
+             *  Hidden widgets don't show, so their changes stop here.
+             */
+            virtual void InvalidateRectangle(const common::Rectangle& area);
+
             /*
              * OnMouseDown:
              *  Called when a mouse button is pressed within the widget. 
@@ -109,19 +189,44 @@ namespace myos
          *  A special type of Widget that can contain child widgets. 
          *  It manages a list of children, handles focus changes, and 
          *  delegates drawing and input events to them.
+         *
+         *  The children form a doubly linked list in stacking order, threaded through their
+         *  'above'/'below' links, so bringing one to the front is a matter of relinking it,
+         *  no matter how many there are. Each child also carries a z-order stamp, which lets
+         *  the hit-testing grid stay unordered.
          */
         class CompositeWidget : public Widget
         {
         private:
-            // A fixed array of child widget pointers. 
-            // In a more dynamic implementation, this might be a vector or linked list.
-            Widget* children[100];
+            // Ends of the z-order list: the topmost and the bottommost child.
+            Widget* topChild;
+            Widget* bottomChild;
 
-            // The number of child widgets currently stored in 'children'.
+            // The number of children in the list.
             int numChildren;
 
+            // Next z-order stamps for a child put on top / at the bottom.
+            common::int32_t nextTopOrder;
+            common::int32_t nextBottomOrder;
+
             // Points to the child widget that currently has input focus, if any.
             Widget* focussedChild;
+
+            // Which children overlap which part of this widget, for hit-testing.
+            SpatialGrid grid;
+
+            // Lays the grid out over the current size and inserts all children again.
+            void RebuildGrid();
+
+            // Gives the children fresh stamps from the bottom up (when the counters run out).
+            void RenumberChildren();
+
+            /*
+             * FindChildAt:
+             *  Returns the topmost visible child containing (x, y), given in this widget's own
+             *  coordinates, or 0. Uses the grid (or every child, if the grid is invalid).
+             */
+            Widget* FindChildAt(common::int32_t x, common::int32_t y);
             
         public:
             /*
@@ -132,33 +237,65 @@ namespace myos
                             common::int32_t x, common::int32_t y, common::int32_t w, common::int32_t h,
                             common::uint8_t r, common::uint8_t g, common::uint8_t b);
 
-            // Destructor: may handle cleanup of child widgets if necessary.
+            // Destructor: the children themselves belong to the caller.
             ~CompositeWidget();
 
             /*
              * GetFocus:
              *  Overrides the Widget's GetFocus method to allow child widgets to request focus. 
-             *  If the child is focusable, sets 'focussedChild' to that child.
+             *  Sets 'focussedChild' to that child and raises it to the front.
              */
             virtual void GetFocus(Widget* widget);
 
             /*
              * AddChild:
-             *  Attempts to add a child widget to this CompositeWidget. 
-             *  Returns true if successful (and there is space in 'children'), or false otherwise.
+             *  Adds a child widget to this CompositeWidget, below the existing ones.
+             *  Returns true (linking the child in needs no memory).
+             *  The new child changes the widget's appearance, so its area is invalidated.
              */
             virtual bool AddChild(Widget* child);
+
+            /*
+             * Raise:
+             *  Moves 'child' to the top of the stacking order in constant time. Only the parts
+             *  of it that other children covered until now are invalidated.
+             */
+            void Raise(Widget* child);
+
+            /*
+             * ChildVisibilityChanged:
+             *  A hidden child loses the keyboard focus.
+             */
+            virtual void ChildVisibilityChanged(Widget* child);
+
+            /*
+             * SetBounds:
+             *  Like Widget::SetBounds; a new size also lays the hit-testing grid out again.
+             */
+            virtual void SetBounds(common::int32_t x, common::int32_t y,
+                                   common::int32_t w, common::int32_t h);
+
+            /*
+             * ChildBoundsChanged:
+             *  Moves the child from the grid cells of its old rectangle to those of its new one.
+             */
+            virtual void ChildBoundsChanged(Widget* child, const common::Rectangle& oldBounds);
             
             /*
-             * Draw:
-             *  Renders this widget, then iterates through its children and calls their Draw() methods.
+             * Paint:
+             *  Splits 'clip' into the visible part of every child (its rectangle minus the
+             *  rectangles of all visible siblings above it) and the part where only this widget's
+             *  background shows. Each pixel is therefore painted once per frame, no matter
+             *  how many windows overlap.
              */
-            virtual void Draw(common::GraphicsContext* gc);
+            virtual void Paint(common::GraphicsContext* gc, common::Region* clip,
+                               common::int32_t X, common::int32_t Y);
 
             /*
              * OnMouseDown:
              *  Checks if the click happened on any child widget; if so, passes the event to that child. 
-             *  Otherwise, processes the event for this widget itself.
+             *  Otherwise, the widget itself takes the focus (which raises it). The child is looked up
+             *  in the grid, so only children near the click are tested.
              */
             virtual void OnMouseDown(common::int32_t x, common::int32_t y, common::uint8_t button);
 
@@ -176,6 +313,13 @@ namespace myos
             virtual void OnMouseMove(common::int32_t oldx, common::int32_t oldy, 
                                      common::int32_t newx, common::int32_t newy);
             
+            /*
+             * OnKeyEvent:
+             *  If a child widget is focussed, forwards the whole key event (key code, modifiers)
+             *  to that child. Widgets that only care about text override OnKeyDown instead.
+             */
+            virtual void OnKeyEvent(const drivers::KeyEvent& event);
+
             /*
              * OnKeyDown:
              *  If a child widget is focussed, forwards the keyboard event to that child.
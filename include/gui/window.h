@@ -2,6 +2,7 @@
 #define __MYOS__GUI__WINDOW_H
 
 #include <gui/widget.h>                           // Includes the base Widget and CompositeWidget classes
+#include <common/surface.h>                       // Off-screen surface caching the window's contents
 #include <drivers/mouse.h>                        // Includes MouseEventHandler (indirectly used by CompositeWidget)
 
 namespace myos
@@ -13,12 +14,25 @@ namespace myos
          *  A specialized CompositeWidget that represents a movable, draggable window in a GUI.
          *  It can contain other widgets (e.g., buttons, text fields). 
          *  The 'Dragging' flag indicates whether the window is currently being moved via mouse interaction.
+         *
+         *  The window renders itself and its children into its own off-screen surface and only
+         *  copies that surface to the screen. The contents are rendered again only after
+         *  Invalidate was called, so moving a window or uncovering it costs a blit, not a repaint.
          */
         class Window : public CompositeWidget
         { 
         protected:
             // Keeps track of whether the user is currently dragging (moving) this window around.
             bool Dragging;
+
+            // Cached contents of the window (0 until first painted, or if the heap is full).
+            common::Surface* surface;
+
+            // True if the cached contents are outdated and have to be rendered again.
+            bool damaged;
+
+            // Makes sure 'surface' matches the window's size and the screen's pixel format.
+            bool PrepareSurface(common::GraphicsContext* gc);
             
         public:
             /*
@@ -34,9 +48,37 @@ namespace myos
                    common::int32_t x, common::int32_t y, common::int32_t w, common::int32_t h,
                    common::uint8_t r, common::uint8_t g, common::uint8_t b);
 
-            // Destructor for cleanup if necessary (currently empty).
+            // Destructor: releases the cached surface.
             ~Window();
 
+            /*
+             * Paint:
+             *  Renders the window into its surface if it is damaged, then blits the parts
+             *  of the surface inside 'clip' to the screen. Falls back to painting directly
+             *  if no surface could be allocated.
+             */
+            virtual void Paint(common::GraphicsContext* gc, common::Region* clip,
+                               common::int32_t X, common::int32_t Y);
+
+            /*
+             * InvalidateRectangle:
+             *  Marks the cached contents as outdated, and tells the parent which part of
+             *  the window looks different.
+             */
+            virtual void InvalidateRectangle(const common::Rectangle& area);
+
+            /*
+             * Minimise:
+             *  Hides the window; what it covered is repainted from the windows below.
+             */
+            void Minimise();
+
+            /*
+             * Restore:
+             *  Shows a minimised window again and brings it to the front with the focus.
+             */
+            void Restore();
+
             /*
              * OnMouseDown:
              *  Called when a mouse button is pressed within the window's area.
@@ -56,7 +98,8 @@ namespace myos
             /*
              * OnMouseMove:
              *  Called when the mouse moves within the window (or while dragging).
-             *  If Dragging is true, the window's position is updated based on the mouse's movement.
+             *  If Dragging is true, the window's position is updated based on the mouse's movement,
+             *  and the parent is invalidated (the window's own contents stay valid).
              *  Child widgets also receive this event if they need to handle mouse movement internally.
              */
             void OnMouseMove(common::int32_t oldx, common::int32_t oldy, 
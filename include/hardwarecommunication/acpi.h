@@ -0,0 +1,115 @@
+#ifndef __MYOS__HARDWARECOMMUNICATION__ACPI_H                 // Header guard to prevent multiple inclusions
+#define __MYOS__HARDWARECOMMUNICATION__ACPI_H
+
+#include <common/types.h>                                     // Fixed-size integer types
+
+namespace myos
+{
+    namespace hardwarecommunication
+    {
+        /*
+         * RootSystemDescriptionPointer:
+         *  The structure the firmware leaves in the EBDA or the BIOS area (0xE0000-0xFFFFF),
+         *  starting with the signature "RSD PTR ". It points to the RSDT and, from ACPI 2.0
+         *  on (revision >= 2), to the XSDT, whose entries are 64 bits wide.
+         */
+        struct RootSystemDescriptionPointer
+        {
+            common::int8_t signature[8];
+            common::uint8_t checksum;                 // Makes the first 20 bytes add up to 0
+            common::int8_t oemId[6];
+            common::uint8_t revision;                 // 0 for ACPI 1.0, 2 from ACPI 2.0 on
+            common::uint32_t rsdtAddress;
+
+            // ACPI 2.0 and later only:
+            common::uint32_t length;
+            common::uint64_t xsdtAddress;
+            common::uint8_t extendedChecksum;         // Makes all 'length' bytes add up to 0
+            common::uint8_t reserved[3];
+        } __attribute__((packed));
+
+        /*
+         * SystemDescriptionTableHeader:
+         *  The header every ACPI table (RSDT, XSDT, MCFG, ...) starts with. 'length' includes the
+         *  header, and all 'length' bytes add up to 0.
+         */
+        struct SystemDescriptionTableHeader
+        {
+            common::int8_t signature[4];
+            common::uint32_t length;
+            common::uint8_t revision;
+            common::uint8_t checksum;
+            common::int8_t oemId[6];
+            common::int8_t oemTableId[8];
+            common::uint32_t oemRevision;
+            common::uint32_t creatorId;
+            common::uint32_t creatorRevision;
+        } __attribute__((packed));
+
+        /*
+         * MemoryMappedConfigurationAllocation:
+         *  One entry of the MCFG table: the PCI Express configuration space (ECAM) of the
+         *  buses 'startBus' to 'endBus' of a PCI segment group, 4 KB per function, starting
+         *  at 'baseAddress' (which corresponds to bus 0, even if startBus isn't 0).
+         */
+        struct MemoryMappedConfigurationAllocation
+        {
+            common::uint64_t baseAddress;
+            common::uint16_t segmentGroup;
+            common::uint8_t startBus;
+            common::uint8_t endBus;
+            common::uint32_t reserved;
+        } __attribute__((packed));
+
+        /*
+         * MemoryMappedConfigurationTable:
+         *  The MCFG table: a header, 8 reserved bytes and as many allocations as fit in 'length'.
+         */
+        struct MemoryMappedConfigurationTable
+        {
+            SystemDescriptionTableHeader header;
+            common::uint64_t reserved;
+            MemoryMappedConfigurationAllocation allocations[];
+        } __attribute__((packed));
+
+
+        /*
+         * AdvancedConfigurationAndPowerInterface:
+         *  Finds the tables the firmware describes the machine with. Only reading is supported;
+         *  the kernel doesn't switch to ACPI mode or run AML.
+         *
+         *  The lower 4 GB are identity mapped, so tables are read at their physical addresses;
+         *  tables above 4 GB (possible through the XSDT) are out of reach and ignored.
+         */
+        class AdvancedConfigurationAndPowerInterface
+        {
+        protected:
+            static RootSystemDescriptionPointer* rootPointer;   // Found by FindRootPointer (0 if none)
+            static bool searched;                               // True once the search has run
+
+            // Returns the valid RSDP among the 'length' bytes at 'start', or 0.
+            static RootSystemDescriptionPointer* SearchRootPointer(common::uint32_t start, common::uint32_t length);
+
+        public:
+            // Returns true if the 'length' bytes at 'data' add up to 0 (mod 256).
+            static bool IsChecksumValid(const void* data, common::uint32_t length);
+
+            /*
+             * FindRootPointer:
+             *  Searches the first KB of the EBDA and then the BIOS area for the RSDP.
+             *  The result is remembered, so only the first call searches. Returns 0 if there
+             *  is no (valid) RSDP, e.g. on machines without ACPI.
+             */
+            static RootSystemDescriptionPointer* FindRootPointer();
+
+            /*
+             * FindTable:
+             *  Returns the first table with the four-character 'signature' (e.g. "MCFG") listed
+             *  in the XSDT (or the RSDT), or 0 if there is none or its checksum is wrong.
+             */
+            static SystemDescriptionTableHeader* FindTable(const char* signature);
+        };
+    }
+}
+
+#endif // __MYOS__HARDWARECOMMUNICATION__ACPI_H
@@ -0,0 +1,73 @@
+#ifndef __MYOS__HARDWARECOMMUNICATION__APIC_H                 // Header guard to prevent multiple inclusions
+#define __MYOS__HARDWARECOMMUNICATION__APIC_H
+
+#include <common/types.h>                                     // Fixed-size integer types
+#include <hardwarecommunication/mmio.h>                       // Register map and MemoryMappedRegion
+
+namespace myos
+{
+    namespace hardwarecommunication
+    {
+        /*
+         * LocalAdvancedProgrammableInterruptController:
+         *  The local APIC of the processor the kernel runs on. The legacy devices keep
+         *  interrupting through the 8259 PICs; the local APIC is needed for message signaled
+         *  interrupts (MSI/MSI-X), which PCI devices deliver as memory writes to the APIC of
+         *  the processor they target.
+         *
+         *  Enable switches the APIC on in "virtual wire" mode: the PICs' output stays connected
+         *  through LINT0, so the existing IRQs arrive exactly as before. Interrupts that come in
+         *  through the APIC itself (MSIs) have to be acknowledged with EndOfInterrupt rather
+         *  than at the PIC.
+         *
+         *  Every processor has its APIC at the same address, so the class is static, like
+         *  CentralProcessingUnit.
+         */
+        class LocalAdvancedProgrammableInterruptController
+        {
+        protected:
+            // Registers (offsets into the 4 KB register page), all 32 bits wide.
+            typedef Register<common::uint32_t, 0x020> IdRegister;
+            typedef Register<common::uint32_t, 0x080> TaskPriorityRegister;
+            typedef Register<common::uint32_t, 0x0B0> EndOfInterruptRegister;
+            typedef Register<common::uint32_t, 0x0F0> SpuriousInterruptRegister;
+            typedef Register<common::uint32_t, 0x350> LocalInterrupt0Register;
+            typedef Register<common::uint32_t, 0x360> LocalInterrupt1Register;
+
+            // The register page (invalid until Enable succeeds).
+            static MemoryMappedRegion registers;
+
+        public:
+            // Returns true if the processor has a local APIC (CPUID) and MSRs to find it with.
+            static bool IsPresent();
+
+            /*
+             * Enable:
+             *  Enables the APIC (IA32_APIC_BASE and the spurious interrupt register), routes the
+             *  PICs through LINT0 and NMI through LINT1, and accepts interrupts of every priority.
+             *  Spurious interrupts arrive on 'spuriousVector', which needs no acknowledgement.
+             *  Returns false if there is no APIC. Calling it again does nothing.
+             */
+            static bool Enable(common::uint8_t spuriousVector);
+
+            // Returns true once Enable has succeeded.
+            static bool IsEnabled();
+
+            // Returns the APIC ID of this processor (the destination for its MSIs).
+            static common::uint8_t GetId();
+
+            // Acknowledges the interrupt being handled (for interrupts delivered by the APIC).
+            static void EndOfInterrupt();
+
+            /*
+             * MessageAddress / MessageData:
+             *  The address and data a device has to write to raise 'vector' on the processor
+             *  with APIC ID 'destination' (fixed delivery, edge triggered, physical destination).
+             */
+            static common::uint32_t MessageAddress(common::uint8_t destination);
+            static common::uint32_t MessageData(common::uint8_t vector);
+        };
+    }
+}
+
+#endif // __MYOS__HARDWARECOMMUNICATION__APIC_H
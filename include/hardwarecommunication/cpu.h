@@ -0,0 +1,91 @@
+#ifndef __MYOS__HARDWARECOMMUNICATION__CPU_H                  // Header guard to prevent multiple inclusions
+#define __MYOS__HARDWARECOMMUNICATION__CPU_H
+
+#include <common/types.h>                                     // Provides fixed-size integer types (uint32_t, uint64_t)
+#include <hardwarecommunication/port.h>                       // Port8Bit, for the PIT used to calibrate the TSC
+
+namespace myos
+{
+    namespace hardwarecommunication
+    {
+        /*
+         * CentralProcessingUnit:
+         *  Queries and configures features of the processor the kernel runs on.
+         *
+         *  The kernel is compiled for a plain i386, so instruction set extensions like SSE2
+         *  are only used by code that checks HasSSE2() at runtime (see common::PixelKernels).
+         *  Before such code can touch the XMM registers, EnableSSE has to switch them on in
+         *  CR0/CR4, otherwise every SSE instruction raises an invalid opcode exception.
+         *
+         *  NOTE: The TaskManager doesn't save the FPU/SSE registers on a task switch yet.
+         *  This is fine as long as only one task uses them (the GUI loop in kernelMain).
+         */
+        class CentralProcessingUnit
+        {
+        public:
+            /*
+             * HasCPUID:
+             *  Returns true if the CPUID instruction exists (the ID bit of EFLAGS can be toggled).
+             */
+            static bool HasCPUID();
+
+            /*
+             * CPUID:
+             *  Executes CPUID for 'leaf' and returns the four result registers.
+             */
+            static void CPUID(common::uint32_t leaf,
+                              common::uint32_t& eax, common::uint32_t& ebx,
+                              common::uint32_t& ecx, common::uint32_t& edx);
+
+            // Feature flags from CPUID leaf 1 (EDX bits 4, 5, 9, 25 and 26).
+            static bool HasTimeStampCounter();
+            static bool HasModelSpecificRegisters();
+            static bool HasLocalAPIC();
+            static bool HasSSE();
+            static bool HasSSE2();
+
+            /*
+             * DisableInterrupts / RestoreInterrupts:
+             *  DisableInterrupts clears IF and returns the flags register from before;
+             *  RestoreInterrupts sets IF again only if it was set in those flags, so the
+             *  pairs nest and can be used where interrupts are already off.
+             */
+            static inline common::uintptr_t DisableInterrupts()
+            {
+                common::uintptr_t flags;
+                asm volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+                return flags;
+            }
+
+            static inline void RestoreInterrupts(common::uintptr_t flags)
+            {
+                if(flags & 0x200)
+                    asm volatile("sti" : : : "memory");
+            }
+
+            // Read/write a model specific register (RDMSR/WRMSR; check HasModelSpecificRegisters first).
+            static common::uint64_t ReadModelSpecificRegister(common::uint32_t msr);
+            static void WriteModelSpecificRegister(common::uint32_t msr, common::uint64_t value);
+
+            /*
+             * EnableSSE:
+             *  Lets the kernel use SSE instructions: clears CR0.EM, sets CR0.MP, and sets
+             *  CR4.OSFXSR and CR4.OSXMMEXCPT. Returns true if SSE2 is available and enabled.
+             */
+            static bool EnableSSE();
+
+            // Returns the number of cycles since reset (RDTSC).
+            static common::uint64_t ReadTimeStampCounter();
+
+            /*
+             * TimeStampCounterMHz:
+             *  Measures how many TSC ticks pass in 10 ms of the PIT's channel 2 (the one
+             *  wired to the PC speaker, which isn't used otherwise) and returns ticks per
+             *  microsecond. Returns 0 without a TSC.
+             */
+            static common::uint32_t TimeStampCounterMHz();
+        };
+    }
+}
+
+#endif // __MYOS__HARDWARECOMMUNICATION__CPU_H
@@ -2,6 +2,7 @@
 #define __MYOS__HARDWARECOMMUNICATION__INTERRUPTMANAGER_H
 
 #include <gdt.h>                                             // Global Descriptor Table definitions
+#include <perprocessor.h>                                    // PerProcessorCounter for the interrupt statistics
 #include <multitasking.h>                                    // TaskManager definitions
 #include <common/types.h>                                    // Common type aliases (uint8_t, uint16_t, etc.)
 #include <hardwarecommunication/port.h>                      // Definitions for Port I/O classes
@@ -18,9 +19,15 @@ namespace myos
          *  Represents a generic handler for a particular interrupt (e.g., keyboard, mouse, etc.).
          *  Each derived class can override HandleInterrupt to provide custom handling logic.
          *  The interruptManager pointer lets the handler interact with the interrupt management system.
+         *
+         *  Several handlers can register for the same vector (PCI devices sharing an IRQ line);
+         *  they are chained through 'nextHandler' and all asked in turn.
          */
         class InterruptHandler
         {
+            // The manager walks the chains.
+            friend class InterruptManager;
+
         protected:
             // The hardware interrupt number or IDT entry this handler will manage.
             myos::common::uint8_t InterruptNumber;
@@ -28,6 +35,9 @@ namespace myos
             // Reference back to the manager that controls overall interrupt functionality.
             InterruptManager* interruptManager;
 
+            // The next handler registered for the same vector (0 at the end of the chain).
+            InterruptHandler* nextHandler;
+
             // Protected constructor called by derived classes to initialize handler associations.
             InterruptHandler(InterruptManager* interruptManager, myos::common::uint8_t InterruptNumber);
 
@@ -37,11 +47,14 @@ namespace myos
         public:
             /*
              * HandleInterrupt:
-             *   - 'esp' is the current stack pointer when the interrupt occurred.
-             *   - Typically, we return the (potentially modified) stack pointer after handling.
+             *   - 'esp' is the current stack pointer when the interrupt occurred; a handler may
+             *     replace it (e.g., to switch tasks).
+             *   - Returns true if the interrupt came from this handler's device and was handled
+             *     ("claimed"), false if the device had nothing pending, so that handlers sharing
+             *     a line can tell whose interrupt it was.
              *   - Derived classes override this to implement device-specific interrupt logic.
              */
-            virtual myos::common::uint32_t HandleInterrupt(myos::common::uint32_t esp);
+            virtual bool HandleInterrupt(myos::common::uintptr_t& esp);
         };
 
 
@@ -52,19 +65,40 @@ namespace myos
          *  and managing the dispatch of hardware/software interrupts to appropriate handlers.
          *
          *  It also integrates with the TaskManager for context switching if needed.
+         *
+         *  Besides the 16 IRQ vectors, a block of vectors is reserved for message signaled
+         *  interrupts (MSI/MSI-X). A driver takes one per interrupt source (e.g. one per queue)
+         *  with AllocateMessageVector, so these vectors are never shared; they are acknowledged at
+         *  the local APIC, which is switched on when the first one is handed out.
          */
         class InterruptManager
         {
             // Allows the InterruptHandler class to access the private/protected members of InterruptManager.
             friend class InterruptHandler;
 
+        public:
+            // The vectors for message signaled interrupts, and the local APIC's spurious vector.
+            enum
+            {
+                MessageVectorBase = 0x60,
+                MessageVectorCount = 16,
+                SpuriousVector = 0xFF
+            };
+
         protected:
             // Pointer to the currently active (enabled) InterruptManager. Used for global interrupt dispatch.
             static InterruptManager* ActiveInterruptManager;
             
-            // An array of pointers to interrupt handlers, one for each possible interrupt (0..255).
+            // The first handler of each interrupt's chain (0..255), 0 if there is none.
             InterruptHandler* handlers[256];
 
+            // Interrupts nobody claimed, and spurious IRQ7/IRQ15s from the PICs.
+            PerProcessorCounter unclaimedInterrupts;
+            PerProcessorCounter spuriousInterrupts;
+
+            // Returns true if the PIC didn't really raise IRQ 'irq' (7 or 15), by its in-service register.
+            bool IsSpuriousInterruptRequest(myos::common::uint8_t irq);
+
             // Reference to the task manager, used for scheduling if an interrupt triggers task switching.
             TaskManager *taskManager;
 
@@ -80,7 +114,12 @@ namespace myos
                 myos::common::uint16_t gdt_codeSegmentSelector;    // GDT segment selector for code (e.g., kernel code segment)
                 myos::common::uint8_t  reserved;                   // Reserved (must be zero or set by system)
                 myos::common::uint8_t  access;                     // Access flags (e.g., present bit, DPL, type)
-                myos::common::uint16_t handlerAddressHighBits;     // High 16 bits of the ISR address
+                myos::common::uint16_t handlerAddressHighBits;     // Bits 16-31 of the ISR address
+#ifdef __x86_64__
+                // Long mode gates are 16 bytes: the rest of the 64-bit address follows.
+                myos::common::uint32_t handlerAddressUpperBits;    // Bits 32-63 of the ISR address
+                myos::common::uint32_t reserved2;                  // Must be zero
+#endif
             } __attribute__((packed));
             
             // The actual IDT with 256 entries, one for each interrupt vector.
@@ -94,12 +133,15 @@ namespace myos
             struct InterruptDescriptorTablePointer
             {
                 myos::common::uint16_t size;    // Size of the IDT (in bytes) - 1
-                myos::common::uint32_t base;    // Base address of the IDT
+                myos::common::uintptr_t base;   // Base address of the IDT
             } __attribute__((packed));
 
             // The offset where hardware interrupts start in the IDT (after remapping).
             myos::common::uint16_t hardwareInterruptOffset;
 
+            // Bit i is set while vector MessageVectorBase + i is allocated.
+            myos::common::uint16_t messageVectorsUsed;
+
             /*
              * SetInterruptDescriptorTableEntry:
              *  Helper function to configure one entry in the IDT.
@@ -133,9 +175,35 @@ namespace myos
             static void HandleInterruptRequest0x0F();
             static void HandleInterruptRequest0x31();
 
+            // Handlers for the message signaled interrupt vectors (MessageVectorBase + 0..15).
+            static void HandleMessageSignaledInterrupt0x00();
+            static void HandleMessageSignaledInterrupt0x01();
+            static void HandleMessageSignaledInterrupt0x02();
+            static void HandleMessageSignaledInterrupt0x03();
+            static void HandleMessageSignaledInterrupt0x04();
+            static void HandleMessageSignaledInterrupt0x05();
+            static void HandleMessageSignaledInterrupt0x06();
+            static void HandleMessageSignaledInterrupt0x07();
+            static void HandleMessageSignaledInterrupt0x08();
+            static void HandleMessageSignaledInterrupt0x09();
+            static void HandleMessageSignaledInterrupt0x0A();
+            static void HandleMessageSignaledInterrupt0x0B();
+            static void HandleMessageSignaledInterrupt0x0C();
+            static void HandleMessageSignaledInterrupt0x0D();
+            static void HandleMessageSignaledInterrupt0x0E();
+            static void HandleMessageSignaledInterrupt0x0F();
+
             // Software interrupt for system calls (int 0x80).
             static void HandleInterruptRequest0x80();
 
+#ifdef __x86_64__
+            // Entry point of the SYSCALL instruction; dispatches the call like int 0x80.
+            static void HandleSystemCall();
+
+            // Points SYSCALL at HandleSystemCall and sets the segments SYSCALL/SYSRET switch to.
+            static void EnableSystemCallInstruction(myos::GlobalDescriptorTable* globalDescriptorTable);
+#endif
+
             // Handlers for CPU exceptions/faults/traps (vectors 0..31). 
             // Each one corresponds to a specific processor exception (e.g., divide by zero, invalid opcode, page fault, etc.).
             static void HandleException0x00();
@@ -165,20 +233,20 @@ namespace myos
              *  The 'interrupt' parameter is the IDT vector that fired.
              *  'esp' is the stack pointer at the time. Returns a possibly new stack pointer.
              */
-            static myos::common::uint32_t HandleInterrupt(myos::common::uint8_t interrupt, myos::common::uint32_t esp);
+            static myos::common::uintptr_t HandleInterrupt(myos::common::uint8_t interrupt, myos::common::uintptr_t esp);
 
             /*
              * DoHandleInterrupt:
              *  Called by HandleInterrupt once it identifies the correct InterruptManager (ActiveInterruptManager).
              *  Looks up the registered handler (if any) and calls its HandleInterrupt method.
              */
-            myos::common::uint32_t DoHandleInterrupt(myos::common::uint8_t interrupt, myos::common::uint32_t esp);
+            myos::common::uintptr_t DoHandleInterrupt(myos::common::uint8_t interrupt, myos::common::uintptr_t esp);
 
             // Ports for communicating with the Programmable Interrupt Controller (PIC).
-            Port8BitSlow programmableInterruptControllerMasterCommandPort;
-            Port8BitSlow programmableInterruptControllerMasterDataPort;
-            Port8BitSlow programmableInterruptControllerSlaveCommandPort;
-            Port8BitSlow programmableInterruptControllerSlaveDataPort;
+            FixedPort8BitSlow<0x20> programmableInterruptControllerMasterCommandPort;
+            FixedPort8BitSlow<0x21> programmableInterruptControllerMasterDataPort;
+            FixedPort8BitSlow<0xA0> programmableInterruptControllerSlaveCommandPort;
+            FixedPort8BitSlow<0xA1> programmableInterruptControllerSlaveDataPort;
 
         public:
             /*
@@ -198,6 +266,21 @@ namespace myos
             // Returns the hardware interrupt offset (e.g., 0x20 for master PIC remap).
             myos::common::uint16_t HardwareInterruptOffset();
 
+            /*
+             * AllocateMessageVector:
+             *  Reserves an unused message signaled interrupt vector and returns it, enabling the
+             *  local APIC first if necessary. Returns 0 if the processor has no local APIC or all
+             *  vectors are taken; the caller then falls back to its IRQ line.
+             */
+            myos::common::uint8_t AllocateMessageVector();
+
+            // Returns a vector obtained from AllocateMessageVector.
+            void FreeMessageVector(myos::common::uint8_t vector);
+
+            // Number of interrupts that no registered handler claimed, and of spurious IRQ7/15s.
+            myos::common::uint32_t GetUnclaimedInterruptCount();
+            myos::common::uint32_t GetSpuriousInterruptCount();
+
             /*
              * Activate:
              *  Loads the IDT (via lidt), enables interrupt handling, and sets this as the ActiveInterruptManager.
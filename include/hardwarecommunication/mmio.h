@@ -0,0 +1,266 @@
+#ifndef __MYOS__HARDWARECOMMUNICATION__MMIO_H                 // Header guard to prevent multiple inclusions
+#define __MYOS__HARDWARECOMMUNICATION__MMIO_H
+
+#include <common/types.h>                                     // Fixed-size integer types
+#include <hardwarecommunication/port.h>                       // Port::Read8/16/32 for registers in I/O space
+
+/*
+ * Like the port accessors, the register accessors must not turn into calls in the
+ * unoptimised kernel build.
+ */
+#define MYOS_MMIO_INLINE inline __attribute__((always_inline))
+
+namespace myos
+{
+    namespace hardwarecommunication
+    {
+        /*
+         * CompilerBarrier:
+         *  Keeps GCC from moving memory accesses across this point. Device registers are
+         *  accessed through volatile pointers, which GCC keeps in order among themselves, but
+         *  ordinary stores (e.g. a DMA descriptor handed to the device) could still be moved
+         *  past the register write that tells the device about them. x86 itself keeps the order
+         *  of accesses to uncached memory and I/O ports, so no fence instruction is needed.
+         */
+        static MYOS_MMIO_INLINE void CompilerBarrier()
+        {
+            __asm__ volatile("" : : : "memory");
+        }
+
+        /*
+         * WriteCombiningBarrier:
+         *  Write-combining memory (e.g. a framebuffer mapped that way) may reach the device out
+         *  of order; 'sfence' drains the buffers before the device is told to look.
+         */
+        static MYOS_MMIO_INLINE void WriteCombiningBarrier()
+        {
+            __asm__ volatile("sfence" : : : "memory");
+        }
+
+        /*
+         * Register:
+         *  Describes one device register at compile time: 'T' is its width (uint8_t, uint16_t
+         *  or uint32_t) and 'offset' its byte offset from the start of the register block.
+         *  A driver lists its registers as typedefs, so every access states the register's
+         *  name and width and can be checked against the datasheet in one place.
+         */
+        template<typename T, common::uint32_t offset>
+        struct Register
+        {
+            typedef T Type;
+            static constexpr common::uint32_t Offset = offset;
+        };
+
+        /*
+         * BitField:
+         *  'width' bits of a 'T' value starting at bit 'shift', e.g. a flag in a status register.
+         *  Everything is constexpr, so a field costs no more than the hand-written mask.
+         */
+        template<typename T, common::uint32_t shift, common::uint32_t width = 1>
+        struct BitField
+        {
+            static constexpr T Mask = (T)((((common::uint64_t)1 << width) - 1) << shift);
+
+            // The field's value within 'value'.
+            static constexpr MYOS_MMIO_INLINE T Get(T value) { return (T)((value & Mask) >> shift); }
+
+            // 'field' moved into place (and cut to the field's width).
+            static constexpr MYOS_MMIO_INLINE T Make(T field) { return (T)((T)(field << shift) & Mask); }
+
+            // 'value' with the field replaced by 'field'.
+            static constexpr MYOS_MMIO_INLINE T Set(T value, T field) { return (T)((value & ~Mask) | Make(field)); }
+
+            // True if any bit of the field is set in 'value' (for one-bit flags).
+            static constexpr MYOS_MMIO_INLINE bool IsSet(T value) { return (value & Mask) != 0; }
+        };
+
+
+        /*
+         * MemoryMappedRegion:
+         *  A block of device registers in memory space, e.g. one described by a PCI memory BAR.
+         *
+         *  Every access is a single volatile load or store of the register's width, with a
+         *  compiler barrier on both sides, so the driver's ordinary memory accesses stay where
+         *  it wrote them relative to the register access. Offsets are not checked against the
+         *  region's size on each access; the register maps are fixed at compile time, and the
+         *  size is there for the bulk helpers and for audits.
+         */
+        class MemoryMappedRegion
+        {
+        protected:
+            volatile common::uint8_t* base;           // First register (0 if there is no region)
+            common::uint32_t size;                    // Length of the region in bytes
+
+        public:
+            // Creates an empty region; IsValid returns false.
+            MemoryMappedRegion();
+
+            // Creates a region of 'size' bytes starting at 'base' (as read from a BAR).
+            MemoryMappedRegion(common::uint8_t* base, common::uint32_t size);
+
+            // Returns true if the region has an address (checked on every DeviceRegisters access).
+            MYOS_MMIO_INLINE bool IsValid()
+            {
+                return base != 0;
+            }
+
+            // Returns the region's length in bytes.
+            common::uint32_t GetSize();
+
+            // Reads or writes the 'T' at byte 'offset'.
+            template<typename T>
+            MYOS_MMIO_INLINE T Read(common::uint32_t offset)
+            {
+                CompilerBarrier();
+                T value = *(volatile T*)(base + offset);
+                CompilerBarrier();
+                return value;
+            }
+
+            template<typename T>
+            MYOS_MMIO_INLINE void Write(common::uint32_t offset, T value)
+            {
+                CompilerBarrier();
+                *(volatile T*)(base + offset) = value;
+                CompilerBarrier();
+            }
+
+            // Reads or writes the register 'R' (a Register<...> typedef).
+            template<typename R>
+            MYOS_MMIO_INLINE typename R::Type Read()
+            {
+                return Read<typename R::Type>(R::Offset);
+            }
+
+            template<typename R>
+            MYOS_MMIO_INLINE void Write(typename R::Type value)
+            {
+                Write<typename R::Type>(R::Offset, value);
+            }
+
+            /*
+             * ReadBlock / WriteBlock:
+             *  Copy 'count' consecutive registers of type 'T', starting at 'offset', from or to
+             *  'buffer' (e.g. an address PROM or a block of filter registers). Each register is
+             *  still accessed once, with its own width.
+             */
+            template<typename T>
+            void ReadBlock(common::uint32_t offset, T* buffer, common::uint32_t count)
+            {
+                CompilerBarrier();
+                volatile T* source = (volatile T*)(base + offset);
+                for(common::uint32_t i = 0; i < count; i++)
+                    buffer[i] = source[i];
+                CompilerBarrier();
+            }
+
+            template<typename T>
+            void WriteBlock(common::uint32_t offset, const T* buffer, common::uint32_t count)
+            {
+                CompilerBarrier();
+                volatile T* target = (volatile T*)(base + offset);
+                for(common::uint32_t i = 0; i < count; i++)
+                    target[i] = buffer[i];
+                CompilerBarrier();
+            }
+        };
+
+
+        /*
+         * DeviceRegisters:
+         *  The registers of a device that offers the same register map both in memory space
+         *  and in I/O space (many PCI network cards do, through two BARs). Memory space is
+         *  used when it is available; otherwise the same offsets are added to the I/O base.
+         *
+         *  The interface is that of MemoryMappedRegion, so drivers written against a register
+         *  map don't care which space they end up in. The choice is one predictable branch
+         *  per access.
+         */
+        class DeviceRegisters
+        {
+        protected:
+            MemoryMappedRegion memory;                // Valid if the registers are memory mapped
+            common::uint16_t portBase;                // Otherwise, the first register's port
+
+        public:
+            // Creates registers with neither a memory region nor a port base.
+            DeviceRegisters();
+
+            // Uses 'memory' if it is valid, 'portBase' otherwise.
+            DeviceRegisters(const MemoryMappedRegion& memory, common::uint16_t portBase);
+
+            // Returns true if the registers are accessed in memory space.
+            MYOS_MMIO_INLINE bool IsMemoryMapped()
+            {
+                return memory.IsValid();
+            }
+
+            template<typename T>
+            MYOS_MMIO_INLINE T Read(common::uint32_t offset)
+            {
+                if(memory.IsValid())
+                    return memory.Read<T>(offset);
+
+                CompilerBarrier();
+                T value;
+                if constexpr(sizeof(T) == 1)
+                    value = Port::Read8(portBase + offset);
+                else if constexpr(sizeof(T) == 2)
+                    value = Port::Read16(portBase + offset);
+                else
+                    value = Port::Read32(portBase + offset);
+                CompilerBarrier();
+                return value;
+            }
+
+            template<typename T>
+            MYOS_MMIO_INLINE void Write(common::uint32_t offset, T value)
+            {
+                if(memory.IsValid())
+                {
+                    memory.Write<T>(offset, value);
+                    return;
+                }
+
+                CompilerBarrier();
+                if constexpr(sizeof(T) == 1)
+                    Port::Write8(portBase + offset, value);
+                else if constexpr(sizeof(T) == 2)
+                    Port::Write16(portBase + offset, value);
+                else
+                    Port::Write32(portBase + offset, value);
+                CompilerBarrier();
+            }
+
+            template<typename R>
+            MYOS_MMIO_INLINE typename R::Type Read()
+            {
+                return Read<typename R::Type>(R::Offset);
+            }
+
+            template<typename R>
+            MYOS_MMIO_INLINE void Write(typename R::Type value)
+            {
+                Write<typename R::Type>(R::Offset, value);
+            }
+
+            // Reads 'count' consecutive registers of type 'T' starting at 'offset'.
+            template<typename T>
+            void ReadBlock(common::uint32_t offset, T* buffer, common::uint32_t count)
+            {
+                for(common::uint32_t i = 0; i < count; i++)
+                    buffer[i] = Read<T>(offset + i * sizeof(T));
+            }
+
+            // Writes 'count' consecutive registers of type 'T' starting at 'offset'.
+            template<typename T>
+            void WriteBlock(common::uint32_t offset, const T* buffer, common::uint32_t count)
+            {
+                for(common::uint32_t i = 0; i < count; i++)
+                    Write<T>(offset + i * sizeof(T), buffer[i]);
+            }
+        };
+    }
+}
+
+#endif // __MYOS__HARDWARECOMMUNICATION__MMIO_H
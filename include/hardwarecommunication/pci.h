@@ -2,6 +2,7 @@
 #define __MYOS__HARDWARECOMMUNICATION__PCI_H
 
 #include <hardwarecommunication/port.h>                    // Provides classes for port-based I/O
+#include <hardwarecommunication/mmio.h>                    // MemoryMappedRegion, for the ECAM window
 #include <drivers/driver.h>                                // Provides the Driver and DriverManager classes
 #include <common/types.h>                                  // Common type aliases (e.g., uint8_t, uint32_t)
 #include <hardwarecommunication/interrupts.h>              // For handling hardware interrupts
@@ -49,13 +50,19 @@ namespace myos
          *  addresses, vendor/device IDs, class/subclass, revision, and so forth.
          *  
          *  portBase: base I/O port if the device is an I/O-mapped device.
+         *  memoryBase: start of the device's first memory BAR (0 if it has none, or if
+         *  memory decoding is disabled).
          *  interrupt: interrupt line or IRQ associated with this device.
          */
         class PeripheralComponentInterconnectDeviceDescriptor
         {
         public:
             myos::common::uint32_t portBase;
+            myos::common::uint8_t* memoryBase;
             myos::common::uint32_t interrupt;
+
+            // IDT vector chosen by AllocateInterrupt (MSI-X, MSI or the IRQ line; 0 until then).
+            myos::common::uint8_t interruptVector;
             
             myos::common::uint16_t bus;
             myos::common::uint16_t device;
@@ -69,6 +76,9 @@ namespace myos
             myos::common::uint8_t interface_id;
 
             myos::common::uint8_t revision;
+
+            // The driver bound to the device by SelectDrivers (0 if none).
+            myos::drivers::Driver* driver;
             
             // Default constructor, initializes fields to default values.
             PeripheralComponentInterconnectDeviceDescriptor();
@@ -78,6 +88,52 @@ namespace myos
         };
 
 
+        class PeripheralComponentInterconnectController;
+
+        /*
+         * PeripheralComponentInterconnectMatch:
+         *  One entry of a driver's match table. A device matches if every field equals the
+         *  device's, or is Any. Tables end with an entry whose vendor_id is 0 (no real device
+         *  has that vendor).
+         */
+        struct PeripheralComponentInterconnectMatch
+        {
+            enum { Any = 0xFFFF };
+
+            myos::common::uint16_t vendor_id;
+            myos::common::uint16_t device_id;
+            myos::common::uint16_t class_id;
+            myos::common::uint16_t subclass_id;
+            myos::common::uint16_t interface_id;   // Programming interface
+
+            // Returns true if 'dev' is described by this entry.
+            bool Matches(const PeripheralComponentInterconnectDeviceDescriptor& dev) const;
+        };
+
+        /*
+         * PeripheralComponentInterconnectProbe:
+         *  Creates a driver for a matched device (usually with placement new on the kernel heap).
+         *  Returns 0 if the device can't be used after all, so later table entries get a chance.
+         */
+        typedef myos::drivers::Driver* (*PeripheralComponentInterconnectProbe)(
+            PeripheralComponentInterconnectController* controller,
+            PeripheralComponentInterconnectDeviceDescriptor* dev,
+            InterruptManager* interrupts);
+
+        /*
+         * PeripheralComponentInterconnectDriverEntry:
+         *  One line of the driver registration table in pci.cpp: a driver's name, its match
+         *  table and its probe function. Adding a PCI driver means giving it a match table and
+         *  a static Probe and adding a line there.
+         */
+        struct PeripheralComponentInterconnectDriverEntry
+        {
+            const char* name;
+            const PeripheralComponentInterconnectMatch* matches;
+            PeripheralComponentInterconnectProbe probe;
+        };
+
+
         /*
          * PeripheralComponentInterconnectController:
          *  Manages scanning and interacting with PCI devices on the system.
@@ -86,24 +142,77 @@ namespace myos
          *  
          *  dataPort & commandPort: used to communicate with the PCI configuration space 
          *  (commonly at 0xCF8 (command) and 0xCFC (data)).
+         *
+         *  If the ACPI MCFG table describes a PCI Express configuration window (ECAM, e.g. on
+         *  QEMU's q35 machine), the buses it covers are accessed through memory instead: each
+         *  dword is a single load or store (the port method takes two port accesses that another
+         *  CPU could interleave with its own), and the extended configuration space (offsets
+         *  0x100-0xFFF, where PCI Express capabilities live) becomes reachable. The ports remain
+         *  the fallback for machines and buses without ECAM.
+         *
+         *  The bus is scanned once; the descriptors found are kept in 'devices', so binding
+         *  drivers and later lookups (FindDevice) don't touch configuration space again.
          */
         class PeripheralComponentInterconnectController
         {
+        public:
+            // Capacity of the device cache (a PC has far fewer functions than that).
+            enum { MaxDevices = 64 };
+
+            // IDs of the capabilities in a function's capability list.
+            enum
+            {
+                CapabilityMessageSignaledInterrupt = 0x05,
+                CapabilityExtendedMessageSignaledInterrupt = 0x11
+            };
+
+        private:
             // Ports for accessing PCI configuration space:
             //   0xCF8 - commandPort
             //   0xCFC - dataPort
-            Port32Bit dataPort;
-            Port32Bit commandPort;
+            FixedPort<common::uint32_t, 0xCFC> dataPort;
+            FixedPort<common::uint32_t, 0xCF8> commandPort;
+
+            // The ECAM window of segment group 0 (invalid if there is none) and the buses it covers.
+            MemoryMappedRegion configurationSpace;
+            common::uint8_t configurationStartBus;
+            common::uint8_t configurationEndBus;
+
+            // Looks for an MCFG allocation of segment group 0 and sets up configurationSpace.
+            void FindConfigurationSpace();
+
+            // Sets bits in the command register (without touching the status register).
+            void SetCommandBits(PeripheralComponentInterconnectDeviceDescriptor* dev, common::uint16_t bits);
+
+            // Returns the MSI-X table described by the capability at 'capability' (invalid if
+            // 'capability' is 0 or the table's BAR isn't usable).
+            MemoryMappedRegion GetExtendedMessageSignaledInterruptTable(PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                                                        common::uint8_t capability);
+
+            // Returns true if 'bus' is accessed through the ECAM window.
+            bool IsMemoryMapped(common::uint16_t bus);
+
+            // Every function found by EnumerateDevices, in bus/device/function order.
+            PeripheralComponentInterconnectDeviceDescriptor devices[MaxDevices];
+            int numDevices;
+            bool enumerated;
+
+            // The registered drivers, ending with an entry without a probe function.
+            static const PeripheralComponentInterconnectDriverEntry driverTable[];
             
         public:
-            // Constructor initializes the ports with the standard PCI config addresses.
+            // Constructor picks the configuration access method (ECAM if ACPI offers it, else the ports).
             PeripheralComponentInterconnectController();
             ~PeripheralComponentInterconnectController();
+
+            // Returns true if offsets 0x100-0xFFF can be accessed (bus 0 is reached through ECAM).
+            bool HasExtendedConfigurationSpace();
             
             /*
              * Read:
              *  Reads a 32-bit value from the PCI configuration space for a specific
-             *  bus/device/function and register offset.
+             *  bus/device/function and register offset. Offsets of 0x100 and above read as all
+             *  ones on buses without ECAM, like a missing register.
              */
             myos::common::uint32_t Read(myos::common::uint16_t bus, 
                                         myos::common::uint16_t device, 
@@ -113,7 +222,8 @@ namespace myos
             /*
              * Write:
              *  Writes a 32-bit value to the PCI configuration space for a specific
-             *  bus/device/function and register offset.
+             *  bus/device/function and register offset. Writes to offsets of 0x100 and above
+             *  are dropped on buses without ECAM.
              */
             void Write(myos::common::uint16_t bus, 
                        myos::common::uint16_t device, 
@@ -128,10 +238,25 @@ namespace myos
              */
             bool DeviceHasFunctions(myos::common::uint16_t bus, myos::common::uint16_t device);
             
+            /*
+             * EnumerateDevices:
+             *  Scans the buses once and fills the device cache (including each device's I/O
+             *  and memory base). Further calls do nothing.
+             */
+            void EnumerateDevices();
+
+            // Number of cached devices, and the i-th of them.
+            int GetDeviceCount();
+            PeripheralComponentInterconnectDeviceDescriptor* GetDevice(int i);
+
+            // Returns the first cached device with the given IDs, or 0.
+            PeripheralComponentInterconnectDeviceDescriptor* FindDevice(myos::common::uint16_t vendor_id,
+                                                                        myos::common::uint16_t device_id);
+
             /*
              * SelectDrivers:
-             *  Iterates over all possible PCI devices and obtains the appropriate driver 
-             *  for each device (via GetDriver). Then registers these drivers with the provided
+             *  Enumerates the devices (if not done yet) and binds a driver to each one in a single
+             *  pass over the cache (via GetDriver). Then registers these drivers with the provided
              *  driverManager. Also takes an InterruptManager to handle interrupts from those devices.
              */
             void SelectDrivers(myos::drivers::DriverManager* driverManager, 
@@ -139,11 +264,10 @@ namespace myos
 
             /*
              * GetDriver:
-             *  Given a PCI device descriptor, returns a pointer to a Driver object
-             *  capable of handling that device (e.g., a network card driver).
-             *  If no suitable driver is found, returns a generic Driver.
+             *  Looks the device up in the driver registration table and returns the driver created
+             *  by the first matching entry whose probe accepts it, or 0 if there is none.
              */
-            myos::drivers::Driver* GetDriver(PeripheralComponentInterconnectDeviceDescriptor dev, 
+            myos::drivers::Driver* GetDriver(PeripheralComponentInterconnectDeviceDescriptor* dev, 
                                              myos::hardwarecommunication::InterruptManager* interrupts);
 
             /*
@@ -164,6 +288,53 @@ namespace myos
                                                        myos::common::uint16_t device, 
                                                        myos::common::uint16_t function, 
                                                        myos::common::uint16_t bar);
+
+            /*
+             * FindCapability:
+             *  Returns the configuration space offset of the capability with the given ID
+             *  (e.g. CapabilityMessageSignaledInterrupt), or 0 if the function doesn't have it.
+             */
+            myos::common::uint8_t FindCapability(PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                                 myos::common::uint8_t id);
+
+            /*
+             * EnableMessageSignaledInterrupt:
+             *  Programs the MSI capability to raise 'vector' on the processor with APIC ID
+             *  'destination' and switches the IRQ line off. Only a single message is used.
+             *  Returns false if the function has no MSI capability.
+             */
+            bool EnableMessageSignaledInterrupt(PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                                myos::common::uint8_t vector,
+                                                myos::common::uint8_t destination);
+
+            // Returns the number of MSI-X table entries of 'dev' (0 if it has no usable MSI-X).
+            int GetExtendedMessageSignaledInterruptCount(PeripheralComponentInterconnectDeviceDescriptor* dev);
+
+            /*
+             * EnableExtendedMessageSignaledInterrupt:
+             *  Points MSI-X table entry 'entry' (e.g. a queue's) at 'vector' on the processor with
+             *  APIC ID 'destination', unmasks it and switches MSI-X on and the IRQ line off.
+             *  Each entry can be given its own vector, so queues don't share an interrupt.
+             *  Returns false if the function has no usable MSI-X table or no such entry.
+             */
+            bool EnableExtendedMessageSignaledInterrupt(PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                                        myos::common::uint16_t entry,
+                                                        myos::common::uint8_t vector,
+                                                        myos::common::uint8_t destination);
+
+            // Masks or unmasks MSI-X table entry 'entry' (e.g. while its queue is being reset).
+            void MaskExtendedMessageSignaledInterrupt(PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                                      myos::common::uint16_t entry,
+                                                      bool masked);
+
+            /*
+             * AllocateInterrupt:
+             *  Chooses how 'dev' interrupts (for drivers using a single interrupt): MSI-X entry 0
+             *  or MSI with a vector of its own if the device and processor support it, otherwise
+             *  its IRQ line. The vector is stored in dev->interruptVector and returned.
+             */
+            myos::common::uint8_t AllocateInterrupt(PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                                    myos::hardwarecommunication::InterruptManager* interrupts);
         };
 
     }
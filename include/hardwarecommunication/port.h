@@ -3,6 +3,13 @@
 
 #include <common/types.h>                                     // Includes common type definitions (e.g., uint8_t, uint16_t, etc.)
 
+/*
+ * The kernel is compiled without optimisation, where GCC ignores plain 'inline'. The port
+ * accessors are forced inline, so every register access is the 'in'/'out' instruction itself
+ * instead of a call.
+ */
+#define MYOS_PORT_INLINE inline __attribute__((always_inline))
+
 namespace myos
 {
     namespace hardwarecommunication
@@ -10,11 +17,14 @@ namespace myos
         /*
          * Port:
          *  A base class for port operations (in/out) on the x86 platform. It stores the port number
-         *  but does not provide read/write implementations by itself. Specialized classes (Port8Bit,
+         *  but does not provide read/write methods by itself. Specialized classes (Port8Bit,
          *  Port16Bit, Port32Bit) derive from this class to actually perform the I/O.
          *
-         *  NOTE: The destructor is not currently virtual because the kernel’s memory manager
-         *  may not support certain features yet. In a more advanced environment, it should be virtual.
+         *  The in/out instructions themselves are public static functions here, so FixedPort
+         *  (below) can use them as well.
+         *
+         *  None of the port classes has virtual functions: a register access is never an indirect
+         *  call, and a port object is only its number (or nothing at all, for FixedPort).
          */
         class Port
         {
@@ -22,19 +32,94 @@ namespace myos
             // Initializes the port with a specific I/O port number.
             Port(myos::common::uint16_t portnumber);
 
-            // Destructor for cleanup (currently non-virtual).
+            // Destructor for cleanup (non-virtual; ports are never deleted through a base pointer).
             ~Port();
 
             // The I/O port number (0–65535) associated with this port.
             myos::common::uint16_t portnumber;
+
+        public:
+            /*
+             * Read8:
+             *  Executes the 'inb' instruction to read a byte from the specified port.
+             *  The result is returned in 'result'. A constant port number below 256 is encoded
+             *  in the instruction; others go through DX.
+             */
+            static MYOS_PORT_INLINE myos::common::uint8_t Read8(myos::common::uint16_t _port)
+            {
+                myos::common::uint8_t result;
+                __asm__ volatile("inb %1, %0" : "=a" (result) : "Nd" (_port));
+                return result;
+            }
+
+            /*
+             * Write8:
+             *  Executes the 'outb' instruction to write a byte to the specified port.
+             */
+            static MYOS_PORT_INLINE void Write8(myos::common::uint16_t _port, myos::common::uint8_t _data)
+            {
+                __asm__ volatile("outb %0, %1" : : "a" (_data), "Nd" (_port));
+            }
+
+            /*
+             * Write8Slow:
+             *  Similar to Write8, but includes two jump instructions to force a short delay before continuing.
+             *  This can help older or sensitive hardware properly register the output.
+             */
+            static MYOS_PORT_INLINE void Write8Slow(myos::common::uint16_t _port, myos::common::uint8_t _data)
+            {
+                __asm__ volatile("outb %0, %1\n"
+                                 "jmp 1f\n1: jmp 1f\n1:"
+                                 : : "a" (_data), "Nd" (_port));
+            }
+
+            /*
+             * Read16:
+             *  Executes 'inw' to read 16 bits from the specified port into 'result'.
+             */
+            static MYOS_PORT_INLINE myos::common::uint16_t Read16(myos::common::uint16_t _port)
+            {
+                myos::common::uint16_t result;
+                __asm__ volatile("inw %1, %0" : "=a" (result) : "Nd" (_port));
+                return result;
+            }
+
+            /*
+             * Write16:
+             *  Executes 'outw' to write 16 bits from '_data' to '_port'.
+             */
+            static MYOS_PORT_INLINE void Write16(myos::common::uint16_t _port, myos::common::uint16_t _data)
+            {
+                __asm__ volatile("outw %0, %1" : : "a" (_data), "Nd" (_port));
+            }
+
+            /*
+             * Read32:
+             *  Uses 'inl' to read a 32-bit value from the specified port.
+             */
+            static MYOS_PORT_INLINE myos::common::uint32_t Read32(myos::common::uint16_t _port)
+            {
+                myos::common::uint32_t result;
+                __asm__ volatile("inl %1, %0" : "=a" (result) : "Nd" (_port));
+                return result;
+            }
+
+            /*
+             * Write32:
+             *  Uses 'outl' to write a 32-bit value to the specified port.
+             */
+            static MYOS_PORT_INLINE void Write32(myos::common::uint16_t _port, myos::common::uint32_t _data)
+            {
+                __asm__ volatile("outl %0, %1" : : "a"(_data), "Nd" (_port));
+            }
         };
 
 
         /*
          * Port8Bit:
-         *  Provides 8-bit read and write operations using inline assembly (inb/outb).
-         *  These operations are the building blocks for hardware communication on many devices
-         *  (e.g., keyboard controller, PIT, PIC).
+         *  Provides 8-bit read and write operations using inline assembly (inb/outb) on a port
+         *  number chosen at run time, e.g. relative to a PCI base address register. Devices at
+         *  fixed addresses (keyboard controller, PIT, PIC) use FixedPort instead.
          */
         class Port8Bit : public Port
         {
@@ -45,32 +130,16 @@ namespace myos
             // Destructor (usually empty, because no dynamic allocation is done).
             ~Port8Bit();
 
-            // Public read method, uses the static inline assembly function to return an 8-bit value from the port.
-            virtual myos::common::uint8_t Read();
-
-            // Public write method, uses the static inline assembly function to write an 8-bit value to the port.
-            virtual void Write(myos::common::uint8_t data);
-
-        protected:
-            /*
-             * Read8:
-             *  Static inline function that executes the 'inb' instruction to read a byte from the specified port.
-             *  The result is returned in 'result'. 
-             */
-            static inline myos::common::uint8_t Read8(myos::common::uint16_t _port)
+            // Returns an 8-bit value from the port.
+            MYOS_PORT_INLINE myos::common::uint8_t Read()
             {
-                myos::common::uint8_t result;
-                __asm__ volatile("inb %1, %0" : "=a" (result) : "Nd" (_port));
-                return result;
+                return Read8(portnumber);
             }
 
-            /*
-             * Write8:
-             *  Static inline function that executes the 'outb' instruction to write a byte to the specified port.
-             */
-            static inline void Write8(myos::common::uint16_t _port, myos::common::uint8_t _data)
+            // Writes an 8-bit value to the port.
+            MYOS_PORT_INLINE void Write(myos::common::uint8_t data)
             {
-                __asm__ volatile("outb %0, %1" : : "a" (_data), "Nd" (_port));
+                Write8(portnumber, data);
             }
         };
 
@@ -80,6 +149,9 @@ namespace myos
          *  This class behaves like Port8Bit but adds a small delay after writing. Some hardware
          *  controllers (e.g., older hardware or certain chipsets) require a delay to allow the operation
          *  to settle before subsequent operations occur.
+         *
+         *  Write hides Port8Bit::Write rather than overriding it, so it has to be called on a
+         *  Port8BitSlow (not through a Port8Bit reference) to get the delay.
          */
         class Port8BitSlow : public Port8Bit
         {
@@ -90,28 +162,17 @@ namespace myos
             // Destructor (empty, same reason as other port classes).
             ~Port8BitSlow();
 
-            // Overridden Write method inserts a small delay using a pair of jump instructions after outb.
-            virtual void Write(myos::common::uint8_t data);
-
-        protected:
-            /*
-             * Write8Slow:
-             *  Similar to Write8, but includes two jump instructions to force a short delay before continuing.
-             *  This can help older or sensitive hardware properly register the output.
-             */
-            static inline void Write8Slow(myos::common::uint16_t _port, myos::common::uint8_t _data)
+            // Writes the value and then waits a little, using a pair of jump instructions after outb.
+            MYOS_PORT_INLINE void Write(myos::common::uint8_t data)
             {
-                __asm__ volatile("outb %0, %1\n"
-                                 "jmp 1f\n1: jmp 1f\n1:"
-                                 : : "a" (_data), "Nd" (_port));
+                Write8Slow(portnumber, data);
             }
-
         };
 
 
         /*
          * Port16Bit:
-         *  Provides 16-bit read and write operations using 'inw' and 'outw'. 
+         *  Provides 16-bit read and write operations using 'inw' and 'outw'.
          *  Useful for devices that communicate using 16-bit registers (e.g., certain older network cards).
          */
         class Port16Bit : public Port
@@ -124,30 +185,15 @@ namespace myos
             ~Port16Bit();
 
             // Reads a 16-bit (2-byte) value from this port.
-            virtual myos::common::uint16_t Read();
-
-            // Writes a 16-bit value to this port.
-            virtual void Write(myos::common::uint16_t data);
-
-        protected:
-            /*
-             * Read16:
-             *  Executes 'inw' to read 16 bits from the specified port into 'result'.
-             */
-            static inline myos::common::uint16_t Read16(myos::common::uint16_t _port)
+            MYOS_PORT_INLINE myos::common::uint16_t Read()
             {
-                myos::common::uint16_t result;
-                __asm__ volatile("inw %1, %0" : "=a" (result) : "Nd" (_port));
-                return result;
+                return Read16(portnumber);
             }
 
-            /*
-             * Write16:
-             *  Executes 'outw' to write 16 bits from '_data' to '_port'.
-             */
-            static inline void Write16(myos::common::uint16_t _port, myos::common::uint16_t _data)
+            // Writes a 16-bit value to this port.
+            MYOS_PORT_INLINE void Write(myos::common::uint16_t data)
             {
-                __asm__ volatile("outw %0, %1" : : "a" (_data), "Nd" (_port));
+                Write16(portnumber, data);
             }
         };
 
@@ -155,7 +201,7 @@ namespace myos
         /*
          * Port32Bit:
          *  Provides 32-bit (4-byte) read and write operations using 'inl' and 'outl'.
-         *  This is used for devices or operations requiring a full 32-bit register transfer 
+         *  This is used for devices or operations requiring a full 32-bit register transfer
          *  (e.g., some PCI operations, video registers).
          */
         class Port32Bit : public Port
@@ -168,30 +214,67 @@ namespace myos
             ~Port32Bit();
 
             // Reads a 32-bit value from this port (e.g., out of PCI config space).
-            virtual myos::common::uint32_t Read();
+            MYOS_PORT_INLINE myos::common::uint32_t Read()
+            {
+                return Read32(portnumber);
+            }
 
             // Writes a 32-bit value to this port.
-            virtual void Write(myos::common::uint32_t data);
+            MYOS_PORT_INLINE void Write(myos::common::uint32_t data)
+            {
+                Write32(portnumber, data);
+            }
+        };
 
-        protected:
-            /*
-             * Read32:
-             *  Uses 'inl' to read a 32-bit value from the specified port.
-             */
-            static inline myos::common::uint32_t Read32(myos::common::uint16_t _port)
+
+        /*
+         * FixedPort:
+         *  A port whose number is known at compile time, e.g. FixedPort<uint8_t, 0x60> for the
+         *  keyboard controller's data port. 'T' (uint8_t, uint16_t or uint32_t) selects the
+         *  access width.
+         *
+         *  The number is part of the type, so the object stores nothing and Read/Write are
+         *  static: each call is a single in/out instruction with the port as an immediate
+         *  (or loaded into DX, for ports above 0xFF). Drivers can still keep one as a member
+         *  and call it like the other port classes.
+         */
+        template<typename T, myos::common::uint16_t number>
+        class FixedPort
+        {
+        public:
+            static MYOS_PORT_INLINE T Read()
             {
-                myos::common::uint32_t result;
-                __asm__ volatile("inl %1, %0" : "=a" (result) : "Nd" (_port));
-                return result;
+                if constexpr(sizeof(T) == 1)
+                    return Port::Read8(number);
+                else if constexpr(sizeof(T) == 2)
+                    return Port::Read16(number);
+                else
+                    return Port::Read32(number);
             }
 
-            /*
-             * Write32:
-             *  Uses 'outl' to write a 32-bit value to the specified port.
-             */
-            static inline void Write32(myos::common::uint16_t _port, myos::common::uint32_t _data)
+            static MYOS_PORT_INLINE void Write(T data)
             {
-                __asm__ volatile("outl %0, %1" : : "a"(_data), "Nd" (_port));
+                if constexpr(sizeof(T) == 1)
+                    Port::Write8(number, data);
+                else if constexpr(sizeof(T) == 2)
+                    Port::Write16(number, data);
+                else
+                    Port::Write32(number, data);
+            }
+        };
+
+
+        /*
+         * FixedPort8BitSlow:
+         *  The fixed-address counterpart of Port8BitSlow (used for the PICs).
+         */
+        template<myos::common::uint16_t number>
+        class FixedPort8BitSlow : public FixedPort<myos::common::uint8_t, number>
+        {
+        public:
+            static MYOS_PORT_INLINE void Write(myos::common::uint8_t data)
+            {
+                Port::Write8Slow(number, data);
             }
         };
 
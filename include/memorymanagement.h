@@ -41,15 +41,35 @@ namespace myos
         // Frees a previously allocated block of memory, making it available for future allocations.
         void free(void* ptr);
     };
+
+    // KernelAllocator is the default allocator of the growable containers in common/
+    // (HashMap, MinHeap). It takes memory from the active MemoryManager and returns 0 when
+    // there is none. Containers take the allocator as a template parameter, so other code
+    // (e.g. host-side tests) can plug in its own static Allocate/Free pair.
+    struct KernelAllocator
+    {
+        static void* Allocate(common::size_t size)
+        {
+            if(MemoryManager::activeMemoryManager == 0)
+                return 0;
+            return MemoryManager::activeMemoryManager->malloc(size);
+        }
+
+        static void Free(void* pointer)
+        {
+            if(pointer != 0 && MemoryManager::activeMemoryManager != 0)
+                MemoryManager::activeMemoryManager->free(pointer);
+        }
+    };
 }
 
 // Overloaded global `new` operator to allocate memory using the custom memory manager.
-void* operator new(unsigned size);
-void* operator new[](unsigned size);
+void* operator new(myos::common::size_t size);
+void* operator new[](myos::common::size_t size);
 
 // Placement new operator: Constructs an object at a specific memory location (provided by `ptr`).
-void* operator new(unsigned size, void* ptr);
-void* operator new[](unsigned size, void* ptr);
+void* operator new(myos::common::size_t size, void* ptr);
+void* operator new[](myos::common::size_t size, void* ptr);
 
 // Overloaded global `delete` operator to free memory using the custom memory manager.
 void operator delete(void* ptr);
@@ -2,12 +2,45 @@
 #define __MYOS__MULTITASKING_H
 
 #include <common/types.h>
+#include <common/intrusivelist.h>
 #include <gdt.h>
+#include <readcopyupdate.h>
 
 namespace myos
 {
     // The CPUState structure represents the state of the CPU registers during a task's execution.
     // This is used for saving and restoring a task's context during multitasking.
+    // Its layout is the stack frame the interrupt stubs build, so it has to match them.
+#ifdef __x86_64__
+    struct CPUState
+    {
+        // Pushed by the stub (interruptstubs64.s), in reverse order.
+        common::uint64_t rax;
+        common::uint64_t rbx;
+        common::uint64_t rcx;
+        common::uint64_t rdx;
+        common::uint64_t rsi;
+        common::uint64_t rdi;
+        common::uint64_t rbp;
+        common::uint64_t r8;
+        common::uint64_t r9;
+        common::uint64_t r10;
+        common::uint64_t r11;
+        common::uint64_t r12;
+        common::uint64_t r13;
+        common::uint64_t r14;
+        common::uint64_t r15;
+
+        common::uint64_t error;   // Error code pushed by the CPU, or 0 pushed by the stub
+
+        // Pushed by the CPU. In long mode SS:RSP is always part of the frame.
+        common::uint64_t rip;
+        common::uint64_t cs;
+        common::uint64_t rflags;
+        common::uint64_t rsp;
+        common::uint64_t ss;
+    } __attribute__((packed));
+#else
     struct CPUState
     {
         common::uint32_t eax;  // Accumulator register
@@ -36,6 +69,7 @@ namespace myos
         common::uint32_t esp;     // Stack pointer
         common::uint32_t ss;      // Stack segment register
     } __attribute__((packed)); // Ensures no padding is added by the compiler.
+#endif
 
     
     // The Task class represents a single task (or process) in the operating system.
@@ -46,6 +80,8 @@ namespace myos
     private:
         common::uint8_t stack[4096]; // Stack memory for the task (4 KiB per task)
         CPUState* cpustate;          // Pointer to the saved CPU state for the task
+        common::IntrusiveListNode schedulerNode; // Links the task into the TaskManager's run list
+        ReadCopyUpdateReader reader; // The task's read-side critical sections (see ReadCopyUpdate)
     public:
         // Constructor: Initializes a task with a given entry point function and sets up the stack.
         Task(GlobalDescriptorTable *gdt, void entrypoint());
@@ -60,9 +96,8 @@ namespace myos
     class TaskManager
     {
     private:
-        Task* tasks[256];    // Array of pointers to tasks (supports up to 256 tasks)
-        int numTasks;        // Number of tasks currently managed
-        int currentTask;     // Index of the currently running task
+        common::IntrusiveList<Task, &Task::schedulerNode> tasks; // Tasks in round-robin order (no fixed limit)
+        Task* currentTask;   // The currently running task, or 0 before the first switch
     public:
         // Constructor: Initializes the task manager, preparing it for task management.
         TaskManager();
@@ -70,7 +105,7 @@ namespace myos
         // Destructor: Cleans up resources used by the task manager.
         ~TaskManager();
 
-        // Adds a task to the task manager. Returns true if successful, false if the task list is full.
+        // Adds a task to the task manager. Returns false if the task is already managed.
         bool AddTask(Task* task);
 
         // Schedules the next task to run. Takes the current CPU state as input and returns the next task's CPU state.
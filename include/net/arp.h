@@ -2,6 +2,7 @@
 #define __MYOS__NET__ARP_H
 
 #include <common/types.h>                       // Provides fixed-size integer types (uint8_t, uint16_t, etc.)
+#include <readcopyupdate.h>                     // ReadCopyUpdateHashMap for the IP -> MAC cache
 #include <net/etherframe.h>                     // EtherFrameHandler and EtherFrameProvider definitions (Ethernet layer)
 
 namespace myos
@@ -48,7 +49,7 @@ namespace myos
         /*
          * AddressResolutionProtocol:
          *  Implements ARP handling on top of the Ethernet layer (via EtherFrameHandler).
-         *  Manages an ARP cache (IPcache/MACcache) to speed up lookups of IP -> MAC mappings.
+         *  Manages an ARP cache (a hash map from IP to MAC) to speed up lookups of IP -> MAC mappings.
          *
          *  Methods:
          *    - OnEtherFrameReceived: Processes incoming ARP messages (both requests and replies).
@@ -59,10 +60,10 @@ namespace myos
          */
         class AddressResolutionProtocol : public EtherFrameHandler
         {
-            // Arrays to store up to 128 IP->MAC mappings in cache.
-            common::uint32_t IPcache[128];
-            common::uint64_t MACcache[128];
-            int numCacheEntries;
+            // Up to MaxCacheEntries IP->MAC mappings. Lookups (Resolve, the send path) take no
+            // lock; a reply that changes the cache publishes a new copy of the table.
+            enum { MaxCacheEntries = 128 };
+            ReadCopyUpdateHashMap<common::uint32_t, common::uint64_t> cache;
             
         public:
             // Constructor takes a pointer to an EtherFrameProvider (the lower-level Ethernet driver).
@@ -96,8 +97,9 @@ namespace myos
             /*
              * Resolve:
              *  Tries to get the MAC address for IP_BE from the cache. If it's not in cache,
-             *  this method triggers an ARP request (RequestMACAddress) and then returns the MAC (if resolved).
-             *  In a synchronous design, it might wait or attempt more logic; here it returns 0 if unresolved.
+             *  this method triggers an ARP request (RequestMACAddress) and returns the broadcast
+             *  MAC without waiting for the reply: the reply is received later (by the main loop),
+             *  and frames sent meanwhile still reach the host by broadcast.
              */
             common::uint64_t Resolve(common::uint32_t IP_BE);
 
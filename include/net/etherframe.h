@@ -4,6 +4,8 @@
 #include <common/types.h>                            // Provides fixed-width integer types (e.g., uint8_t, uint64_t)
 #include <drivers/amd_am79c973.h>                    // Network driver for AMD AM79C973 NIC
 #include <memorymanagement.h>                        // Memory allocation/deallocation functions (if needed)
+#include <readcopyupdate.h>                          // Handler tables are read without locks
+#include <perprocessor.h>                            // PerProcessorCounter for the frame statistics
 
 namespace myos
 {
@@ -110,7 +112,13 @@ namespace myos
 
         protected:
             // Array of EtherFrameHandler pointers, indexed by EtherType (0..65534).
-            EtherFrameHandler* handlers[65535];
+            EtherFrameHandler* handlers[65535];   // Changed with ReadCopyUpdate::Publish, read in a read-side section
+
+            // Frames received, frames received for an EtherType no handler is registered for,
+            // and frames sent. Counted on the packet path, so per processor.
+            PerProcessorCounter receivedFrames;
+            PerProcessorCounter unhandledFrames;
+            PerProcessorCounter sentFrames;
 
         public:
             /*
@@ -153,6 +161,11 @@ namespace myos
              *  Retrieves the local IP address as configured on the AMD AM79C973 driver (if assigned).
              */
             common::uint32_t GetIPAddress();
+
+            // The frame statistics, summed over all processors.
+            common::uint32_t GetReceivedFrameCount();
+            common::uint32_t GetUnhandledFrameCount();
+            common::uint32_t GetSentFrameCount();
         };
         
     }
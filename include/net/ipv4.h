@@ -116,7 +116,7 @@ namespace myos
 
         protected:
             // Array of protocol-specific handlers. Index = protocol number (e.g., 1 for ICMP).
-            InternetProtocolHandler* handlers[255];
+            InternetProtocolHandler* handlers[255]; // Changed with ReadCopyUpdate::Publish, read in a read-side section
 
             // Pointer to ARP for resolving MAC addresses from IP addresses.
             AddressResolutionProtocol* arp;
@@ -0,0 +1,55 @@
+#ifndef __MYOS__NET__PORTALLOCATOR_H                  // Header guard to prevent multiple inclusions
+#define __MYOS__NET__PORTALLOCATOR_H
+
+#include <common/types.h>                             // Fixed-width type aliases (uint16_t, uint64_t, etc.)
+#include <common/bitmap.h>                            // Bitmap of the local ports in use
+
+namespace myos
+{
+    namespace net
+    {
+        /*
+         * PortAllocator:
+         *  The local ports of one transport protocol (TCP and UDP each have their own), and
+         *  the key their providers file sockets under.
+         *
+         *  All ports going in and out are in network byte order, like the ports in the
+         *  sockets and headers. Changes are made with interrupts off, since sockets are
+         *  opened by tasks and closed from the receive path as well.
+         */
+        class PortAllocator
+        {
+        protected:
+            common::Bitmap<65536> usedPorts;          // Local ports (in host byte order) that a socket uses
+            common::uint16_t freePort;                // Where the search for a free ephemeral port starts
+
+        public:
+            enum { FirstEphemeralPort = 1024 };
+
+            PortAllocator();
+
+            // Takes a free ephemeral port, or returns 0 if none is left.
+            common::uint16_t Allocate();
+
+            // Marks 'port_BE' as used (e.g. by a listening socket), so Allocate passes it over.
+            void Claim(common::uint16_t port_BE);
+
+            // Gives 'port_BE' back.
+            void Release(common::uint16_t port_BE);
+
+            /*
+             * SocketKey:
+             *  Packs a socket's remote IP, remote port and local port (all in network byte order)
+             *  into one 64-bit key. The local IP is left out: it is the NIC's one address, and
+             *  the providers still compare it after the lookup. A listening socket has no remote
+             *  endpoint yet and is keyed with remote IP and port 0.
+             */
+            static common::uint64_t SocketKey(common::uint32_t remoteIP, common::uint16_t remotePort, common::uint16_t localPort);
+
+            // Converts a port between host and network byte order.
+            static common::uint16_t SwapBytes(common::uint16_t port);
+        };
+    }
+}
+
+#endif // __MYOS__NET__PORTALLOCATOR_H
@@ -4,6 +4,9 @@
 #include <common/types.h>                                     // Common type definitions (e.g. uint8_t, uint16_t, etc.)
 #include <net/ipv4.h>                                         // InternetProtocolHandler for IPv4 layer integration
 #include <memorymanagement.h>                                 // Memory management helpers (if needed for dynamic allocations)
+#include <readcopyupdate.h>                                   // Lock-free table of the open sockets
+#include <net/portallocator.h>                               // Local ports and socket keys
+#include <common/minheap.h>                                   // Half-open connections ordered by deadline
 
 namespace myos
 {
@@ -180,6 +183,9 @@ namespace myos
             // The current state of this TCP socket (e.g., ESTABLISHED).
             TransmissionControlProtocolSocketState state;
 
+            // Frees the socket once no receive path can still be looking at it.
+            ReadCopyUpdateCallback reclaim;
+
         public:
             // Constructor links this socket to a specific TCP provider.
             TransmissionControlProtocolSocket(TransmissionControlProtocolProvider* backend);
@@ -206,6 +212,21 @@ namespace myos
         };
       
       
+        /*
+         * TransmissionControlProtocolHalfOpenConnection:
+         *   A connection accepted by a listener whose handshake hasn't completed yet. If its
+         *   socket is still in SYN_RECEIVED at 'deadline' (a TSC value), it is dropped.
+         */
+        struct TransmissionControlProtocolHalfOpenConnection
+        {
+            common::uint64_t deadline;
+            common::uint64_t key;                                     // The socket's key in 'sockets'
+            TransmissionControlProtocolSocket* socket;
+
+            bool operator<(const TransmissionControlProtocolHalfOpenConnection& other) const { return deadline < other.deadline; }
+        };
+
+
         /*
          * TransmissionControlProtocolProvider:
          *   Inherits from InternetProtocolHandler to handle TCP packets at the IP level (protocol = 6).
@@ -218,14 +239,31 @@ namespace myos
         class TransmissionControlProtocolProvider : InternetProtocolHandler
         {
         protected:
-            // Array of pointers to sockets, keyed by local port (simplified approach).
-            TransmissionControlProtocolSocket* sockets[65535];
+            // The open sockets, keyed by PortAllocator::SocketKey(remote IP, remote port, local port).
+            // Receive-path lookups take no lock; Connect, Listen and the rest publish a new table.
+            ReadCopyUpdateHashMap<common::uint64_t, TransmissionControlProtocolSocket*> sockets;
+
+            // The local ports the sockets use.
+            PortAllocator ports;
+
+            // Accepted connections still in the handshake, earliest deadline first. Only the
+            // receive path uses it, so it needs no lock.
+            enum { HalfOpenTimeoutSeconds = 10 };
+            common::MinHeap<TransmissionControlProtocolHalfOpenConnection> halfOpen;
+            common::uint64_t timeStampCounterHz;                      // TSC ticks per second (0: no timeouts)
+
+            // Drops the half-open connections whose deadline has passed.
+            void ExpireHalfOpenConnections();
 
-            // Number of sockets currently in use (not strictly necessary if we track them differently, but used here).
-            common::uint16_t numSockets;
+            // Forgets a socket (and its port, unless a listener still holds it) and frees it
+            // after a grace period.
+            void RemoveSocket(TransmissionControlProtocolSocket* socket);
 
-            // Used to allocate ephemeral ports (dynamic port assignment).
-            common::uint16_t freePort;
+            // Creates and files the socket for a connection requested from 'listener', which
+            // stays in place for the next request. Returns 0 if out of memory.
+            TransmissionControlProtocolSocket* Accept(TransmissionControlProtocolSocket* listener,
+                                                      common::uint32_t remoteIP_BE,
+                                                      common::uint16_t remotePort_BE);
             
         public:
             /*
@@ -275,6 +313,9 @@ namespace myos
              * Listen:
              *   Opens a socket in the LISTEN state on the specified local port, 
              *   ready to accept incoming TCP connections.
+             *   The listening socket lives as long as the provider. Each connection it accepts
+             *   gets a socket of its own (with the listener's handler), which is freed after
+             *   the connection has closed; handlers must not keep pointers to those.
              */
             virtual TransmissionControlProtocolSocket* Listen(common::uint16_t port);
 
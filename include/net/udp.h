@@ -4,6 +4,8 @@
 #include <common/types.h>                          // Common fixed-size types (uint8_t, uint16_t, etc.)
 #include <net/ipv4.h>                              // InternetProtocolHandler and InternetProtocolProvider
 #include <memorymanagement.h>                      // Memory management routines (if needed for dynamic allocations)
+#include <readcopyupdate.h>                        // Lock-free table of the open sockets
+#include <net/portallocator.h>                    // Local ports and socket keys
 
 namespace myos
 {
@@ -93,6 +95,9 @@ namespace myos
             // If true, this socket is awaiting incoming data on localPort.
             bool listening;
 
+            // Frees the socket once no receive path can still be looking at it.
+            ReadCopyUpdateCallback reclaim;
+
         public:
             // Constructor links the socket to a UDP provider.
             UserDatagramProtocolSocket(UserDatagramProtocolProvider* backend);
@@ -123,7 +128,7 @@ namespace myos
         /*
          * UserDatagramProtocolProvider:
          *  Inherits from InternetProtocolHandler, allowing it to process IPv4 packets with protocol = 17 (UDP).
-         *  Manages an array of UDP sockets, each identified by local (and possibly remote) IP/ports.
+         *  Manages a hash map of UDP sockets, each identified by local (and possibly remote) IP/ports.
          *
          *  Functionality:
          *    - Creating sockets for sending/receiving datagrams (Connect, Listen).
@@ -133,12 +138,12 @@ namespace myos
         class UserDatagramProtocolProvider : InternetProtocolHandler
         {
         protected:
-            // Array of all possible UDP sockets, indexed by local port (simplification).
-            UserDatagramProtocolSocket* sockets[65535];
-            // Number of sockets currently in use (optional, depending on management).
-            common::uint16_t numSockets;
-            // Used to allocate ephemeral ports when none is specified.
-            common::uint16_t freePort;
+            // The open sockets, keyed by PortAllocator::SocketKey(remote IP, remote port, local port).
+            // Receive-path lookups take no lock; Connect, Listen and the rest publish a new table.
+            ReadCopyUpdateHashMap<common::uint64_t, UserDatagramProtocolSocket*> sockets;
+
+            // The local ports the sockets use.
+            PortAllocator ports;
             
         public:
             /*
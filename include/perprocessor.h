@@ -0,0 +1,142 @@
+#ifndef __MYOS__PERPROCESSOR_H                    // Header guard to prevent multiple inclusions
+#define __MYOS__PERPROCESSOR_H
+
+#include <common/types.h>                         // Provides fixed-size integer types
+
+namespace myos
+{
+    /*
+     * PerProcessorArea:
+     *  The memory one processor keeps its own data in. While a processor runs kernel code,
+     *  its GS segment starts at its area (see GlobalDescriptorTable::LoadProcessorDataSegment),
+     *  so a field at offset N is '%gs:N' and no code has to find out which processor it is
+     *  on first. The areas are cache line aligned and written only by their own processor,
+     *  so processors never take lines from each other by updating their own data.
+     */
+    struct PerProcessorArea
+    {
+        enum { Size = 4096 };                     // Bytes per area, header included
+
+        PerProcessorArea* self;                   // The area's own address ('%gs:0' loads it)
+        common::uint32_t index;                   // The processor's number (0 = the boot processor)
+        common::uint8_t data[Size - sizeof(PerProcessorArea*) - sizeof(common::uint32_t)];
+    } __attribute__((aligned(64)));
+
+
+    /*
+     * PerProcessor:
+     *  Hands out room in the per-processor areas. A variable reserved with Reserve has
+     *  the same offset in every area and starts out zeroed. Room given back with Release
+     *  is zeroed again and handed out to the next Reserve of the same size, so objects
+     *  that come and go (e.g. a driver's counters) don't use the areas up.
+     */
+    class PerProcessor
+    {
+    public:
+        enum { MaxProcessors = 8 };
+        enum { MaxFreeRanges = 32 };              // Released ranges kept for reuse
+
+    protected:
+        struct FreeRange
+        {
+            common::size_t offset;
+            common::size_t size;
+        };
+
+        static PerProcessorArea areas[MaxProcessors];
+        static common::size_t reserved;           // Bytes of 'data' handed out so far
+        static common::uint32_t processorsOnline; // Areas that Initialize has set up
+        static FreeRange freeRanges[MaxFreeRanges];
+        static common::uint32_t freeRangeCount;
+
+    public:
+        // Returns the offset of 'size' free bytes (aligned to 'alignment', a power of two)
+        // in every area, or 0 if the areas are full.
+        static common::size_t Reserve(common::size_t size, common::size_t alignment);
+
+        // Gives back 'size' bytes at 'offset' (from Reserve; 0 is ignored) in every area.
+        static void Release(common::size_t offset, common::size_t size);
+
+        // Sets up processor 'index''s area; called when its GS segment is loaded.
+        static void Initialize(common::uint32_t index);
+
+        static PerProcessorArea* Area(common::uint32_t index) { return &areas[index]; }
+        static common::uint32_t ProcessorsOnline() { return processorsOnline; }
+
+        // The running processor's area and number.
+        static inline PerProcessorArea* This()
+        {
+            PerProcessorArea* area;
+            asm volatile("mov %%gs:0, %0" : "=r"(area));
+            return area;
+        }
+
+        static inline common::uint32_t CurrentIndex()
+        {
+            common::uint32_t index;
+            asm volatile("movl %%gs:%c1, %0" : "=r"(index) : "i"(sizeof(PerProcessorArea*)));
+            return index;
+        }
+    };
+
+
+    /*
+     * PerProcessorVariable:
+     *  One 'T' per processor, zeroed at first. Local() is the running processor's copy; it
+     *  stays the right one as long as the code can't be moved to another processor, e.g.
+     *  in an interrupt handler or with interrupts off. Returns 0 if the areas were full.
+     *  The room is given back when the variable is destroyed; it can't be copied.
+     */
+    template<typename T>
+    class PerProcessorVariable
+    {
+    protected:
+        common::size_t offset;                    // Where 'T' is in each area (0 if it got no room)
+
+    public:
+        PerProcessorVariable() : offset(PerProcessor::Reserve(sizeof(T), __alignof__(T))) {}
+        ~PerProcessorVariable() { PerProcessor::Release(offset, sizeof(T)); }
+
+        PerProcessorVariable(const PerProcessorVariable&) = delete;
+        PerProcessorVariable& operator=(const PerProcessorVariable&) = delete;
+
+        T* Local() { return offset != 0 ? (T*)((common::uint8_t*)PerProcessor::This() + offset) : 0; }
+        T* On(common::uint32_t index) { return offset != 0 ? (T*)((common::uint8_t*)PerProcessor::Area(index) + offset) : 0; }
+    };
+
+
+    /*
+     * PerProcessorCounter:
+     *  A statistic for hot paths. Each processor adds to its own word with a single
+     *  'add %gs:offset' instruction, so an update is never split by an interrupt or a move
+     *  to another processor, and needs neither a lock nor a locked instruction. Reading
+     *  sums the words of all processors; each word wraps at its width (32 bits in the
+     *  32-bit kernel). Like PerProcessorVariable, it gives its words back when destroyed
+     *  and can't be copied.
+     */
+    class PerProcessorCounter
+    {
+    protected:
+        common::size_t offset;                    // Where the counter is in each area (0 if it got no room)
+
+    public:
+        PerProcessorCounter();
+        ~PerProcessorCounter();
+
+        PerProcessorCounter(const PerProcessorCounter&) = delete;
+        PerProcessorCounter& operator=(const PerProcessorCounter&) = delete;
+
+        inline void Add(common::uintptr_t amount)
+        {
+            if(offset != 0)
+                asm volatile("add %1, %%gs:(%0)" : : "r"(offset), "r"(amount) : "memory", "cc");
+        }
+
+        inline void Increment() { Add(1); }
+
+        // The sum over all processors (a snapshot: others may be counting meanwhile).
+        common::uint64_t Sum();
+    };
+}
+
+#endif // __MYOS__PERPROCESSOR_H
@@ -0,0 +1,294 @@
+#ifndef __MYOS__READCOPYUPDATE_H                  // Header guard to prevent multiple inclusions
+#define __MYOS__READCOPYUPDATE_H
+
+#include <common/types.h>                         // Provides fixed-size integer types
+#include <common/intrusivelist.h>                 // Lists of readers and of waiting callbacks
+#include <common/hashmap.h>                       // The table behind ReadCopyUpdateHashMap
+#include <memorymanagement.h>                     // KernelAllocator and placement new
+#include <hardwarecommunication/cpu.h>            // Disabling interrupts for the writers
+
+namespace myos
+{
+    /*
+     * ReadCopyUpdateReader:
+     *  The read-side state of one execution context: a task, or the kernel's boot context
+     *  before the first task switch. Only the context itself changes 'nesting' and
+     *  'sectionsEnded' (interrupt handlers running on top of it add and remove their own
+     *  sections, which leaves the counts as they were).
+     */
+    struct ReadCopyUpdateReader
+    {
+        common::IntrusiveListNode node;           // Links the reader into ReadCopyUpdate's list
+        common::uint32_t nesting;                 // Read-side critical sections entered and not yet left
+        common::uint32_t sectionsEnded;           // Outermost sections left so far
+        common::uint32_t snapshot;                // 'sectionsEnded' when the grace period started
+        bool holdout;                             // Was inside a section when the grace period started
+
+        ReadCopyUpdateReader() : nesting(0), sectionsEnded(0), snapshot(0), holdout(false) {}
+    };
+
+    /*
+     * ReadCopyUpdateCallback:
+     *  A request to call 'function(object)' once every reader that might still see 'object'
+     *  is gone. It is embedded in whatever is to be reclaimed, so queueing never allocates.
+     */
+    struct ReadCopyUpdateCallback
+    {
+        common::IntrusiveListNode node;
+        void (*function)(void* object);
+        void* object;
+    };
+
+
+    /*
+     * ReadCopyUpdate:
+     *  Read-mostly synchronization. Readers of a shared structure run between ReadLock and
+     *  ReadUnlock and load the structure's pointer with Dereference. A writer never changes
+     *  what readers may be looking at: it builds a new version, publishes it with Publish,
+     *  and hands the old one to CallAfterGracePeriod, which reclaims it after a grace period,
+     *  i.e. once every read-side section that was running at the time has ended.
+     *
+     *  Readers take no lock and do no atomic operation: ReadLock and ReadUnlock count
+     *  sections in the running context's ReadCopyUpdateReader. Sections may nest and may
+     *  be preempted (the count stays with the task). Interrupt handlers never get preempted,
+     *  so their sections always end before the next task switch.
+     *
+     *  Quiescent states are tracked through the scheduler: TaskManager::Schedule, on every
+     *  timer tick, switches the current reader and calls OnSchedule. A grace period starts
+     *  there; every reader inside a section at that moment becomes a holdout, and it ends
+     *  at the first tick after the last holdout has left that section. Then the callbacks
+     *  run, in the timer interrupt.
+     *
+     *  Writers of one structure must exclude each other: LockUpdates and UnlockUpdates
+     *  (interrupts off) do that on our single CPU.
+     */
+    class ReadCopyUpdate
+    {
+    protected:
+        static ReadCopyUpdateReader bootReader;   // The boot context's sections
+        static bool bootReaderRetired;            // The boot context was left for a task for good
+        static common::IntrusiveList<ReadCopyUpdateReader, &ReadCopyUpdateReader::node> readers;
+
+        static common::IntrusiveList<ReadCopyUpdateCallback, &ReadCopyUpdateCallback::node> pending;  // For the next grace period
+        static common::IntrusiveList<ReadCopyUpdateCallback, &ReadCopyUpdateCallback::node> waiting;  // For the current one
+        static bool gracePeriodActive;
+        static common::uint32_t holdouts;         // Readers the current grace period still waits for
+
+        static void StartGracePeriod();
+        static void NoteReader(ReadCopyUpdateReader* reader);
+        static void CheckHoldout(ReadCopyUpdateReader* reader);
+        static void SetFlag(void* flag);
+
+    public:
+        static ReadCopyUpdateReader* currentReader; // The running context's reader
+
+        // Read side: enter and leave a read-side critical section.
+        static inline void ReadLock()
+        {
+            currentReader->nesting++;
+            asm volatile("" : : : "memory");
+        }
+
+        static inline void ReadUnlock()
+        {
+            asm volatile("" : : : "memory");
+            ReadCopyUpdateReader* reader = currentReader;
+            if(--reader->nesting == 0)
+                reader->sectionsEnded++;
+        }
+
+        // Loads a pointer published with Publish (inside a read-side section).
+        template<typename T>
+        static inline T* Dereference(T* const& pointer)
+        {
+            return __atomic_load_n(&pointer, __ATOMIC_CONSUME);
+        }
+
+        // Makes 'value', which must be complete, visible to readers of 'pointer'.
+        template<typename T>
+        static inline void Publish(T*& pointer, T* value)
+        {
+            __atomic_store_n(&pointer, value, __ATOMIC_RELEASE);
+        }
+
+        // Write side: exclude other writers (and interrupts); returns the state to restore.
+        static inline common::uintptr_t LockUpdates()
+        {
+            return hardwarecommunication::CentralProcessingUnit::DisableInterrupts();
+        }
+
+        static inline void UnlockUpdates(common::uintptr_t flags)
+        {
+            hardwarecommunication::CentralProcessingUnit::RestoreInterrupts(flags);
+        }
+
+        // Calls 'function(object)' after a grace period. Callable from any context.
+        static void CallAfterGracePeriod(ReadCopyUpdateCallback* callback, void (*function)(void*), void* object);
+
+        // Destroys a 'T' that was allocated with KernelAllocator and frees its memory.
+        template<typename T>
+        static void Destroy(void* object)
+        {
+            ((T*)object)->~T();
+            KernelAllocator::Free(object);
+        }
+
+        // Destroys and frees 'object' (allocated with KernelAllocator) after a grace period.
+        template<typename T>
+        static inline void FreeAfterGracePeriod(ReadCopyUpdateCallback* callback, T* object)
+        {
+            CallAfterGracePeriod(callback, &Destroy<T>, object);
+        }
+
+        // Waits for a grace period. Needs interrupts on and must not be called in a read-side section.
+        static void Synchronize();
+
+        // Scheduler hooks: a task's reader is tracked from AddTask on; SwitchReader is
+        // called for each task switch and OnSchedule on every tick (interrupts off).
+        static void AddReader(ReadCopyUpdateReader* reader);
+        static void SwitchReader(ReadCopyUpdateReader* reader);
+        static void OnSchedule();
+    };
+
+
+    /*
+     * ReadCopyUpdateHashMap:
+     *  A common::HashMap for lookups on the packet path: readers never wait and never see a
+     *  table in the middle of a change. Every change copies the table, changes the copy and
+     *  publishes it; the old table is freed after a grace period. Writes are O(n) and
+     *  allocate, so this is meant for small tables that change far less often than they
+     *  are read.
+     */
+    template<typename Key, typename Value>
+    class ReadCopyUpdateHashMap
+    {
+    protected:
+        struct Version
+        {
+            ReadCopyUpdateCallback reclaim;
+            common::HashMap<Key, Value> map;
+        };
+
+        Version* current;                         // The published table (0 while there has been no write)
+        common::size_t reserved;                  // Entries each new table has room for at least
+
+        // A new table with the entries of 'current' (which the writer holds still) and room for 'extra' more.
+        Version* Copy(common::size_t extra)
+        {
+            Version* version = (Version*)KernelAllocator::Allocate(sizeof(Version));
+            if(version == 0)
+                return 0;
+            new (version) Version();
+
+            common::size_t size = (current != 0 ? current->map.Size() : 0) + extra;
+            if(!version->map.Reserve(size > reserved ? size : reserved))
+            {
+                ReadCopyUpdate::Destroy<Version>(version);
+                return 0;
+            }
+            if(current != 0)
+                current->map.ForEach([version](const Key& key, const Value& value) { version->map.Insert(key, value); });
+            return version;
+        }
+
+        // Publishes 'version' and retires the table it replaces.
+        void Replace(Version* version)
+        {
+            Version* old = current;
+            ReadCopyUpdate::Publish(current, version);
+            if(old != 0)
+                ReadCopyUpdate::FreeAfterGracePeriod(&old->reclaim, old);
+        }
+
+    public:
+        ReadCopyUpdateHashMap() : current(0), reserved(0) {}
+
+        ~ReadCopyUpdateHashMap()
+        {
+            if(current != 0)
+                ReadCopyUpdate::Destroy<Version>(current);
+        }
+
+        ReadCopyUpdateHashMap(const ReadCopyUpdateHashMap&) = delete;
+        ReadCopyUpdateHashMap& operator=(const ReadCopyUpdateHashMap&) = delete;
+
+        // Read side (any context): copies the value stored for 'key' into 'value'.
+        bool Lookup(const Key& key, Value& value)
+        {
+            ReadCopyUpdate::ReadLock();
+            Version* version = ReadCopyUpdate::Dereference(current);
+            Value* found = version != 0 ? version->map.Find(key) : 0;
+            if(found != 0)
+                value = *found;
+            ReadCopyUpdate::ReadUnlock();
+            return found != 0;
+        }
+
+        bool Contains(const Key& key)
+        {
+            Value value;
+            return Lookup(key, value);
+        }
+
+        common::size_t Size()
+        {
+            ReadCopyUpdate::ReadLock();
+            Version* version = ReadCopyUpdate::Dereference(current);
+            common::size_t size = version != 0 ? version->map.Size() : 0;
+            ReadCopyUpdate::ReadUnlock();
+            return size;
+        }
+
+        // Write side: each new table gets room for 'entries' entries. Returns false if out of memory.
+        bool Reserve(common::size_t entries)
+        {
+            common::uintptr_t flags = ReadCopyUpdate::LockUpdates();
+            reserved = entries;
+            Version* version = Copy(0);
+            if(version != 0)
+                Replace(version);
+            ReadCopyUpdate::UnlockUpdates(flags);
+            return version != 0;
+        }
+
+        // Write side: stores 'value' for 'key'. Returns false if out of memory.
+        bool Insert(const Key& key, const Value& value)
+        {
+            common::uintptr_t flags = ReadCopyUpdate::LockUpdates();
+            Value* found = current != 0 ? current->map.Find(key) : 0;
+            bool result = true;
+            if(found == 0 || !(*found == value))
+            {
+                Version* version = Copy(1);
+                result = version != 0 && version->map.Insert(key, value);
+                if(result)
+                    Replace(version);
+                else if(version != 0)
+                    ReadCopyUpdate::Destroy<Version>(version);
+            }
+            ReadCopyUpdate::UnlockUpdates(flags);
+            return result;
+        }
+
+        // Write side: removes 'key'. Returns false if it wasn't there or out of memory.
+        bool Remove(const Key& key)
+        {
+            common::uintptr_t flags = ReadCopyUpdate::LockUpdates();
+            bool result = false;
+            if(current != 0 && current->map.Contains(key))
+            {
+                Version* version = Copy(0);
+                if(version != 0)
+                {
+                    version->map.Remove(key);
+                    Replace(version);
+                    result = true;
+                }
+            }
+            ReadCopyUpdate::UnlockUpdates(flags);
+            return result;
+        }
+    };
+}
+
+#endif // __MYOS__READCOPYUPDATE_H
@@ -27,7 +27,8 @@ namespace myos
         // - `esp`: The stack pointer of the interrupted process, which contains its context.
         // This method processes the syscall by reading parameters from the stack,
         // executing the requested system service, and returning the appropriate response.
-        virtual myos::common::uint32_t HandleInterrupt(myos::common::uint32_t esp);
+        // A software interrupt always belongs to this handler, so it is always claimed.
+        virtual bool HandleInterrupt(myos::common::uintptr_t& esp);
     };
 
 }
@@ -0,0 +1,203 @@
+#include <common/glyphcache.h>
+#include <common/pixelkernels.h>
+#include <memorymanagement.h>
+
+/*
+ * The namespace myos::common contains the basic types and the graphics contexts.
+ */
+using namespace myos;
+using namespace myos::common;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * GlyphCache Class
+ * --------------------------------------------------------------------------
+ *
+ * Keeps fonts expanded into native pixels, so strings are drawn by copying rows.
+ */
+
+/*
+ * activeGlyphCache:
+ *  The cache text widgets draw with (0 until one is created).
+ */
+GlyphCache* GlyphCache::activeGlyphCache = 0;
+
+/*
+ * Constructor:
+ *  - All slots start empty; atlases are built on first use.
+ */
+GlyphCache::GlyphCache(Font* font)
+{
+    this->font = font;
+    useCounter = 0;
+    for(int i = 0; i < NumAtlases; i++)
+    {
+        atlases[i].surface = 0;
+        atlases[i].lastUse = 0;
+    }
+    activeGlyphCache = this;
+}
+
+/*
+ * Destructor:
+ *  - Frees the atlases and stops being the active cache.
+ */
+GlyphCache::~GlyphCache()
+{
+    Flush();
+    if(activeGlyphCache == this)
+        activeGlyphCache = 0;
+}
+
+Font* GlyphCache::GetFont()
+{
+    return font;
+}
+
+/*
+ * FreeAtlas:
+ *  - The surface was built with placement new, so it is destroyed by hand.
+ */
+void GlyphCache::FreeAtlas(Atlas* atlas)
+{
+    if(atlas->surface == 0)
+        return;
+    atlas->surface->~Surface();
+    MemoryManager::activeMemoryManager->free(atlas->surface);
+    atlas->surface = 0;
+}
+
+/*
+ * Flush:
+ *  - Empties every slot.
+ */
+void GlyphCache::Flush()
+{
+    for(int i = 0; i < NumAtlases; i++)
+        FreeAtlas(&atlases[i]);
+}
+
+/*
+ * GetAtlas:
+ *  - A slot matches if its colors are the same and its surface has the format
+ *    (and palette) of 'gc', so its rows can be copied without conversion.
+ *  - Otherwise the least recently used slot (or an empty one) is rebuilt: every
+ *    glyph row is expanded bit by bit, once, into foreground and background pixels.
+ */
+Surface* GlyphCache::GetAtlas(GraphicsContext* gc, uint32_t foreground, uint32_t background)
+{
+    useCounter++;
+
+    Atlas* victim = &atlases[0];
+    for(int i = 0; i < NumAtlases; i++)
+    {
+        Atlas* atlas = &atlases[i];
+        if(atlas->surface != 0
+           && atlas->foreground == foreground && atlas->background == background
+           && atlas->surface->GetFormat() == gc->GetFormat()
+           && atlas->surface->GetPalette() == gc->GetPalette())
+        {
+            atlas->lastUse = useCounter;
+            return atlas->surface;
+        }
+
+        if(victim->surface != 0 && (atlas->surface == 0 || atlas->lastUse < victim->lastUse))
+            victim = atlas;
+    }
+
+    FreeAtlas(victim);
+    if(MemoryManager::activeMemoryManager == 0)
+        return 0;
+    void* memory = MemoryManager::activeMemoryManager->malloc(sizeof(Surface));
+    if(memory == 0)
+        return 0;
+
+    int32_t glyphWidth = font->GetWidth();
+    int32_t glyphHeight = font->GetHeight();
+    Surface* surface = new (memory) Surface(font->GetGlyphCount() * glyphWidth, glyphHeight,
+                                            gc->GetFormat(), gc->GetPalette());
+    victim->surface = surface;
+    if(!surface->IsValid())
+    {
+        FreeAtlas(victim);
+        return 0;
+    }
+
+    for(uint16_t glyph = 0; glyph < font->GetGlyphCount(); glyph++)
+    {
+        const uint8_t* bits = font->GetGlyph(glyph);
+        for(int32_t row = 0; row < glyphHeight; row++)
+            for(int32_t column = 0; column < glyphWidth; column++)
+                surface->PutPixel(glyph * glyphWidth + column, row,
+                                  (bits[row] & (0x80 >> column)) ? foreground : background);
+    }
+
+    victim->foreground = foreground;
+    victim->background = background;
+    victim->lastUse = useCounter;
+    return surface;
+}
+
+/*
+ * DrawText:
+ *  - Works on the part of the string's rectangle inside each clip rectangle
+ *    (and inside the context).
+ *  - With an atlas, each pixel row of that part is drawn by copying, glyph by
+ *    glyph, the matching row pieces out of the atlas with the active copy kernel.
+ *    Clipping, row addresses and the atlas lookup are done once per string
+ *    instead of once per glyph.
+ *  - Without an atlas (no memory), the font bits are expanded while drawing.
+ */
+void GlyphCache::DrawText(GraphicsContext* gc, Region* clip, int32_t x, int32_t y,
+                          const char* text, int32_t length,
+                          uint32_t foreground, uint32_t background)
+{
+    if(length <= 0 || gc->GetPixels() == 0)
+        return;
+
+    int32_t glyphWidth = font->GetWidth();
+    int32_t glyphHeight = font->GetHeight();
+    Rectangle textBounds = Rectangle(x, y, length * glyphWidth, glyphHeight)
+                           .Intersection(Rectangle(0, 0, gc->GetWidth(), gc->GetHeight()));
+    if(textBounds.IsEmpty())
+        return;
+
+    Surface* atlas = GetAtlas(gc, foreground, background);
+    int32_t bytesPerPixel = (gc->GetFormat() == Indexed8) ? 1 : 4;
+
+    for(int i = 0; i < clip->NumRectangles(); i++)
+    {
+        Rectangle area = textBounds.Intersection(clip->GetRectangle(i));
+        if(area.IsEmpty())
+            continue;
+
+        int32_t firstGlyph = (area.x - x) / glyphWidth;
+        int32_t lastGlyph = (area.x + area.w - 1 - x) / glyphWidth;
+
+        for(int32_t row = area.y; row < area.y + area.h; row++)
+        {
+            for(int32_t g = firstGlyph; g <= lastGlyph; g++)
+            {
+                int32_t cellX = x + g * glyphWidth;
+                int32_t left = (cellX < area.x) ? area.x : cellX;
+                int32_t right = (cellX + glyphWidth > area.x + area.w) ? area.x + area.w : cellX + glyphWidth;
+                uint16_t glyph = font->GetGlyphIndex(text[g]);
+
+                if(atlas != 0)
+                {
+                    uint8_t* src = atlas->GetPixels() + (row - y) * atlas->GetPitch()
+                                 + (glyph * glyphWidth + left - cellX) * bytesPerPixel;
+                    uint8_t* dst = gc->GetPixels() + row * gc->GetPitch() + left * bytesPerPixel;
+                    PixelKernels::active->CopyRow(dst, src, (right - left) * bytesPerPixel);
+                }
+                else
+                {
+                    uint8_t bits = font->GetGlyph(glyph)[row - y];
+                    for(int32_t px = left; px < right; px++)
+                        gc->PutPixel(px, row, (bits & (0x80 >> (px - cellX))) ? foreground : background);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,395 @@
+#include <common/graphicscontext.h>
+#include <common/pixelkernels.h>
+
+/*
+ * The namespace myos::common contains the basic types and the graphics contexts.
+ */
+using namespace myos::common;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * GraphicsContext Class
+ * --------------------------------------------------------------------------
+ *
+ * Software rasterizer working on a block of pixel memory. Every primitive first
+ * clips against the context and then works row by row, using the row pointer
+ * (pixels + y * pitch) instead of computing an address per pixel. The row loops
+ * themselves are the PixelKernels chosen at boot (scalar or SSE2).
+ */
+
+/*
+ * Constructor:
+ *  - Starts without pixel memory; drivers call SetPixelBuffer once a mode is
+ *    set, surfaces once their memory is allocated.
+ */
+GraphicsContext::GraphicsContext()
+{
+    pixels = 0;
+    width = 0;
+    height = 0;
+    pitch = 0;
+    format = Indexed8;
+    palette = 0;
+}
+
+/*
+ * Destructor: the context doesn't own the memory, so nothing to do.
+ */
+GraphicsContext::~GraphicsContext()
+{
+}
+
+/*
+ * SetPixelBuffer:
+ *  - Stores the description of the memory all primitives draw into.
+ */
+void GraphicsContext::SetPixelBuffer(uint8_t* pixels, int32_t width, int32_t height, int32_t pitch, PixelFormat format)
+{
+    this->pixels = pixels;
+    this->width = width;
+    this->height = height;
+    this->pitch = pitch;
+    this->format = format;
+}
+
+/*
+ * Accessors:
+ *  - Let other code (blits, compositors) look at the pixel memory directly.
+ */
+int32_t GraphicsContext::GetWidth()
+{
+    return width;
+}
+
+int32_t GraphicsContext::GetHeight()
+{
+    return height;
+}
+
+int32_t GraphicsContext::GetPitch()
+{
+    return pitch;
+}
+
+PixelFormat GraphicsContext::GetFormat()
+{
+    return format;
+}
+
+uint8_t* GraphicsContext::GetPixels()
+{
+    return pixels;
+}
+
+uint32_t* GraphicsContext::GetPalette()
+{
+    return palette;
+}
+
+/*
+ * MapColor:
+ *  - 32 bit formats just pack the components (ARGB8888 as fully opaque).
+ *  - Indexed contexts need to know their palette; drivers override this.
+ */
+uint32_t GraphicsContext::MapColor(uint8_t r, uint8_t g, uint8_t b)
+{
+    uint32_t rgb = ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    switch(format)
+    {
+        case XRGB8888: return rgb;
+        case ARGB8888: return 0xFF000000 | rgb;
+        default:       return 0;
+    }
+}
+
+/*
+ * ToRGB:
+ *  - Turns a pixel of any format into 0x00RRGGBB.
+ *  - Indexed pixels are looked up in the palette, or shown as grey without one.
+ */
+uint32_t GraphicsContext::ToRGB(uint32_t pixel, PixelFormat format, uint32_t* palette)
+{
+    if(format != Indexed8)
+        return pixel & 0x00FFFFFF;
+    if(palette != 0)
+        return palette[pixel & 0xFF];
+    return (pixel & 0xFF) * 0x010101;
+}
+
+/*
+ * FromRGB:
+ *  - Turns 0x00RRGGBB into a native color of this context.
+ */
+uint32_t GraphicsContext::FromRGB(uint32_t rgb)
+{
+    return MapColor((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF);
+}
+
+/*
+ * PutPixel (RGB):
+ *  - Maps the color, then stores it.
+ *  - Fine for single pixels; for areas, map once and use FillRectangle/FillSpan.
+ */
+void GraphicsContext::PutPixel(int32_t x, int32_t y, uint8_t r, uint8_t g, uint8_t b)
+{
+    PutPixel(x, y, MapColor(r, g, b));
+}
+
+/*
+ * PutPixel (native):
+ *  - Ignores pixels outside the context.
+ */
+void GraphicsContext::PutPixel(int32_t x, int32_t y, uint32_t color)
+{
+    if(pixels == 0
+    || x < 0 || width <= x
+    || y < 0 || height <= y)
+        return;
+
+    uint8_t* row = pixels + y * pitch;
+    if(format == Indexed8)
+        row[x] = color;
+    else
+        ((uint32_t*)row)[x] = color;
+}
+
+/*
+ * GetPixel:
+ *  - Returns the native color at (x, y), or 0 outside of the context.
+ */
+uint32_t GraphicsContext::GetPixel(int32_t x, int32_t y)
+{
+    if(pixels == 0
+    || x < 0 || width <= x
+    || y < 0 || height <= y)
+        return 0;
+
+    uint8_t* row = pixels + y * pitch;
+    if(format == Indexed8)
+        return row[x];
+    return ((uint32_t*)row)[x];
+}
+
+/*
+ * FillSpan:
+ *  - Clips the span to the row, then lets the active fill kernel store the
+ *    same value 'length' times.
+ */
+void GraphicsContext::FillSpan(int32_t x, int32_t y, int32_t length, uint32_t color)
+{
+    if(pixels == 0 || y < 0 || height <= y)
+        return;
+    if(x < 0)
+    {
+        length += x;
+        x = 0;
+    }
+    if(length > width - x)
+        length = width - x;
+    if(length <= 0)
+        return;
+
+    uint8_t* row = pixels + y * pitch;
+    if(format == Indexed8)
+        PixelKernels::active->FillRow8(row + x, color, length);
+    else
+        PixelKernels::active->FillRow32((uint32_t*)row + x, color, length);
+}
+
+/*
+ * FillRectangle (RGB):
+ *  - Maps the color once and fills with the native value.
+ */
+void GraphicsContext::FillRectangle(uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                                    uint8_t r, uint8_t g, uint8_t b)
+{
+    FillRectangle((int32_t)x, (int32_t)y, (int32_t)w, (int32_t)h, MapColor(r, g, b));
+}
+
+/*
+ * FillRectangle (native):
+ *  - Clips vertically here; FillSpan clips each row horizontally.
+ */
+void GraphicsContext::FillRectangle(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+{
+    int32_t top = y < 0 ? 0 : y;
+    int32_t bottom = (y + h > height) ? height : y + h;
+    for(int32_t Y = top; Y < bottom; Y++)
+        FillSpan(x, Y, w, color);
+}
+
+/*
+ * ClipBlit:
+ *  - Shrinks the block so that it lies inside the source and, once moved to
+ *    (dx, dy), inside this context. Moving the left/top edge moves both corners.
+ */
+bool GraphicsContext::ClipBlit(GraphicsContext* source, int32_t& sx, int32_t& sy,
+                               int32_t& w, int32_t& h, int32_t& dx, int32_t& dy)
+{
+    if(pixels == 0 || source == 0 || source->pixels == 0)
+        return false;
+
+    // Left and top edges, against the source and then the destination
+    if(sx < 0) { dx -= sx; w += sx; sx = 0; }
+    if(sy < 0) { dy -= sy; h += sy; sy = 0; }
+    if(dx < 0) { sx -= dx; w += dx; dx = 0; }
+    if(dy < 0) { sy -= dy; h += dy; dy = 0; }
+
+    // Right and bottom edges
+    if(w > source->width - sx) w = source->width - sx;
+    if(h > source->height - sy) h = source->height - sy;
+    if(w > width - dx) w = width - dx;
+    if(h > height - dy) h = height - dy;
+
+    return w > 0 && h > 0;
+}
+
+/*
+ * Blit:
+ *  - Same format: rows are copied by the active copy kernel.
+ *  - Indexed8 with a palette into a 32 bit context: the conversion kernel
+ *    looks each row up in the palette.
+ *  - Other format pairs: every pixel goes through RGB.
+ *  - If source and destination are the same context and overlap, rows are
+ *    copied bottom-up when moving down, so no pixel is read after being overwritten
+ *    (moving within a row to the right is not supported).
+ */
+void GraphicsContext::Blit(GraphicsContext* source, int32_t sx, int32_t sy,
+                           int32_t w, int32_t h, int32_t dx, int32_t dy)
+{
+    if(!ClipBlit(source, sx, sy, w, h, dx, dy))
+        return;
+
+    int32_t firstRow = 0, lastRow = h, step = 1;
+    if(source == this && dy > sy)
+    {
+        firstRow = h - 1;
+        lastRow = -1;
+        step = -1;
+    }
+
+    int32_t bytesPerPixel = (format == Indexed8) ? 1 : 4;
+    bool lookup = source->format == Indexed8 && format != Indexed8 && source->palette != 0;
+    uint32_t alphaMask = (format == ARGB8888) ? 0xFF000000 : 0;
+
+    for(int32_t i = firstRow; i != lastRow; i += step)
+    {
+        uint8_t* src = source->pixels + (sy + i) * source->pitch;
+        uint8_t* dst = pixels + (dy + i) * pitch;
+
+        if(source->format == format)
+            PixelKernels::active->CopyRow(dst + dx * bytesPerPixel, src + sx * bytesPerPixel, w * bytesPerPixel);
+        else if(lookup)
+            PixelKernels::active->ConvertRow8To32((uint32_t*)dst + dx, src + sx, w, source->palette, alphaMask);
+        else
+        {
+            for(int32_t j = 0; j < w; j++)
+            {
+                uint32_t pixel = (source->format == Indexed8) ? src[sx + j] : ((uint32_t*)src)[sx + j];
+                uint32_t rgb = ToRGB(pixel, source->format, source->palette);
+                uint32_t color = (format == Indexed8) ? FromRGB(rgb)
+                               : (format == ARGB8888) ? (0xFF000000 | rgb) : rgb;
+                if(format == Indexed8)
+                    dst[dx + j] = color;
+                else
+                    ((uint32_t*)dst)[dx + j] = color;
+            }
+        }
+    }
+}
+
+/*
+ * BlitColorKey:
+ *  - Copies like Blit, skipping source pixels equal to the key.
+ *  - The key is compared before any format conversion.
+ *  - Same format rows use the active color key kernel.
+ */
+void GraphicsContext::BlitColorKey(GraphicsContext* source, int32_t sx, int32_t sy,
+                                   int32_t w, int32_t h, int32_t dx, int32_t dy, uint32_t key)
+{
+    if(!ClipBlit(source, sx, sy, w, h, dx, dy))
+        return;
+
+    bool sameFormat = source->format == format;
+    for(int32_t i = 0; i < h; i++)
+    {
+        uint8_t* src = source->pixels + (sy + i) * source->pitch;
+        uint8_t* dst = pixels + (dy + i) * pitch;
+
+        if(sameFormat)
+        {
+            if(format == Indexed8)
+                PixelKernels::active->CopyRowColorKey8(dst + dx, src + sx, w, key);
+            else
+                PixelKernels::active->CopyRowColorKey32((uint32_t*)dst + dx, (uint32_t*)src + sx, w, key);
+            continue;
+        }
+
+        for(int32_t j = 0; j < w; j++)
+        {
+            uint32_t pixel = (source->format == Indexed8) ? src[sx + j] : ((uint32_t*)src)[sx + j];
+            if(pixel == key)
+                continue;
+
+            uint32_t rgb = ToRGB(pixel, source->format, source->palette);
+            pixel = (format == Indexed8) ? FromRGB(rgb)
+                  : (format == ARGB8888) ? (0xFF000000 | rgb) : rgb;
+
+            if(format == Indexed8)
+                dst[dx + j] = pixel;
+            else
+                ((uint32_t*)dst)[dx + j] = pixel;
+        }
+    }
+}
+
+/*
+ * BlitAlpha:
+ *  - For every pixel: a = alpha * sourceAlpha / 255 (sourceAlpha is 255 unless the
+ *    source is ARGB8888), then out = (src * a + dst * (255 - a)) / 255 per component.
+ *  - Fully transparent pixels are skipped, fully opaque ones copied.
+ *  - Indexed destinations are read through their palette and the result is mapped
+ *    back with MapColor.
+ */
+void GraphicsContext::BlitAlpha(GraphicsContext* source, int32_t sx, int32_t sy,
+                                int32_t w, int32_t h, int32_t dx, int32_t dy, uint8_t alpha)
+{
+    if(alpha == 0 || !ClipBlit(source, sx, sy, w, h, dx, dy))
+        return;
+
+    for(int32_t i = 0; i < h; i++)
+    {
+        uint8_t* src = source->pixels + (sy + i) * source->pitch;
+        uint8_t* dst = pixels + (dy + i) * pitch;
+
+        for(int32_t j = 0; j < w; j++)
+        {
+            uint32_t pixel = (source->format == Indexed8) ? src[sx + j] : ((uint32_t*)src)[sx + j];
+            uint32_t a = alpha;
+            if(source->format == ARGB8888)
+                a = (a * (pixel >> 24)) / 255;
+            if(a == 0)
+                continue;
+
+            uint32_t s = ToRGB(pixel, source->format, source->palette);
+            uint32_t d = (format == Indexed8) ? ToRGB(dst[dx + j], format, palette)
+                                              : ((uint32_t*)dst)[dx + j] & 0x00FFFFFF;
+            uint32_t out = s;
+            if(a < 255)
+            {
+                out = 0;
+                for(uint32_t shift = 0; shift <= 16; shift += 8)
+                {
+                    uint32_t c = (((s >> shift) & 0xFF) * a + ((d >> shift) & 0xFF) * (255 - a)) / 255;
+                    out |= c << shift;
+                }
+            }
+
+            if(format == Indexed8)
+                dst[dx + j] = FromRGB(out);
+            else
+                ((uint32_t*)dst)[dx + j] = (format == ARGB8888) ? (0xFF000000 | out) : out;
+        }
+    }
+}
@@ -0,0 +1,295 @@
+#include <common/pixelkernels.h>
+
+/*
+ * The namespace myos::common contains the basic types and the graphics contexts.
+ */
+using namespace myos::common;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * Scalar kernels
+ * --------------------------------------------------------------------------
+ *
+ * Plain loops that work on every processor. Byte rows are handled four pixels
+ * at a time once the destination is aligned to 32 bits.
+ */
+
+/*
+ * ScalarFillRow8:
+ *  - Bytes up to the next 32 bit boundary, then whole words, then the rest.
+ */
+static void ScalarFillRow8(uint8_t* dst, uint8_t color, int32_t count)
+{
+    uint8_t* end = dst + count;
+    while(dst < end && ((uintptr_t)dst & 3) != 0)
+        *dst++ = color;
+
+    uint32_t quad = color * 0x01010101;
+    for(; dst + 4 <= end; dst += 4)
+        *(uint32_t*)dst = quad;
+
+    while(dst < end)
+        *dst++ = color;
+}
+
+static void ScalarFillRow32(uint32_t* dst, uint32_t color, int32_t count)
+{
+    for(int32_t i = 0; i < count; i++)
+        dst[i] = color;
+}
+
+/*
+ * ScalarCopyRow:
+ *  - If source and destination share their alignment, the middle part is copied
+ *    as words. Otherwise every byte is copied on its own.
+ */
+static void ScalarCopyRow(uint8_t* dst, uint8_t* src, int32_t bytes)
+{
+    if((((uintptr_t)src ^ (uintptr_t)dst) & 3) == 0)
+    {
+        for(; bytes > 0 && ((uintptr_t)dst & 3) != 0; bytes--)
+            *dst++ = *src++;
+        for(; bytes >= 4; bytes -= 4, src += 4, dst += 4)
+            *(uint32_t*)dst = *(uint32_t*)src;
+    }
+    for(; bytes > 0; bytes--)
+        *dst++ = *src++;
+}
+
+static void ScalarCopyRowColorKey8(uint8_t* dst, uint8_t* src, int32_t count, uint8_t key)
+{
+    for(int32_t i = 0; i < count; i++)
+        if(src[i] != key)
+            dst[i] = src[i];
+}
+
+static void ScalarCopyRowColorKey32(uint32_t* dst, uint32_t* src, int32_t count, uint32_t key)
+{
+    for(int32_t i = 0; i < count; i++)
+        if(src[i] != key)
+            dst[i] = src[i];
+}
+
+static void ScalarConvertRow8To32(uint32_t* dst, uint8_t* src, int32_t count,
+                                  uint32_t* palette, uint32_t alphaMask)
+{
+    for(int32_t i = 0; i < count; i++)
+        dst[i] = palette[src[i]] | alphaMask;
+}
+
+
+/*
+ * --------------------------------------------------------------------------
+ * SSE2 kernels
+ * --------------------------------------------------------------------------
+ *
+ * The kernel is compiled for i386, so these functions ask GCC for SSE2 code
+ * explicitly and are only called after the CPU check. They use GCC's vector
+ * extensions instead of the intrinsics headers, which need the C library.
+ *
+ * Interrupts may leave the stack 4-byte aligned, so every kernel realigns it
+ * on entry; otherwise spilled XMM registers could fault. Loads from the source
+ * are unaligned (v4si_u), stores go to a destination aligned to 16 bytes first.
+ */
+#define SSE2_KERNEL __attribute__((target("sse2"), force_align_arg_pointer))
+
+typedef int32_t v4si    __attribute__((vector_size(16)));
+typedef int8_t  v16qi   __attribute__((vector_size(16)));
+typedef int32_t v4si_u  __attribute__((vector_size(16), aligned(1), may_alias));
+typedef int8_t  v16qi_u __attribute__((vector_size(16), aligned(1), may_alias));
+
+/*
+ * SSE2FillRow8 / SSE2FillRow32:
+ *  - Scalar head up to a 16 byte boundary, then 64 bytes per iteration,
+ *    then 16 bytes, then a scalar tail.
+ */
+SSE2_KERNEL static void SSE2FillRow8(uint8_t* dst, uint8_t color, int32_t count)
+{
+    for(; count > 0 && ((uintptr_t)dst & 15) != 0; count--)
+        *dst++ = color;
+
+    int8_t c = color;
+    v16qi value = { c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c };
+    for(; count >= 64; count -= 64, dst += 64)
+    {
+        ((v16qi*)dst)[0] = value;
+        ((v16qi*)dst)[1] = value;
+        ((v16qi*)dst)[2] = value;
+        ((v16qi*)dst)[3] = value;
+    }
+    for(; count >= 16; count -= 16, dst += 16)
+        *(v16qi*)dst = value;
+
+    for(; count > 0; count--)
+        *dst++ = color;
+}
+
+SSE2_KERNEL static void SSE2FillRow32(uint32_t* dst, uint32_t color, int32_t count)
+{
+    for(; count > 0 && ((uintptr_t)dst & 15) != 0; count--)
+        *dst++ = color;
+
+    int32_t c = color;
+    v4si value = { c, c, c, c };
+    for(; count >= 16; count -= 16, dst += 16)
+    {
+        ((v4si*)dst)[0] = value;
+        ((v4si*)dst)[1] = value;
+        ((v4si*)dst)[2] = value;
+        ((v4si*)dst)[3] = value;
+    }
+    for(; count >= 4; count -= 4, dst += 4)
+        *(v4si*)dst = value;
+
+    for(; count > 0; count--)
+        *dst++ = color;
+}
+
+/*
+ * SSE2CopyRow:
+ *  - Each iteration loads 64 bytes before storing any of them, so copying to
+ *    a lower address within the same row stays correct.
+ */
+SSE2_KERNEL static void SSE2CopyRow(uint8_t* dst, uint8_t* src, int32_t bytes)
+{
+    for(; bytes > 0 && ((uintptr_t)dst & 15) != 0; bytes--)
+        *dst++ = *src++;
+
+    for(; bytes >= 64; bytes -= 64, src += 64, dst += 64)
+    {
+        v16qi a = ((v16qi_u*)src)[0];
+        v16qi b = ((v16qi_u*)src)[1];
+        v16qi c = ((v16qi_u*)src)[2];
+        v16qi d = ((v16qi_u*)src)[3];
+        ((v16qi*)dst)[0] = a;
+        ((v16qi*)dst)[1] = b;
+        ((v16qi*)dst)[2] = c;
+        ((v16qi*)dst)[3] = d;
+    }
+    for(; bytes >= 16; bytes -= 16, src += 16, dst += 16)
+        *(v16qi*)dst = *(v16qi_u*)src;
+
+    for(; bytes > 0; bytes--)
+        *dst++ = *src++;
+}
+
+/*
+ * SSE2CopyRowColorKey8 / SSE2CopyRowColorKey32:
+ *  - Compares 16 bytes of source against the key at once. PMOVMSKB turns the
+ *    result into a bit mask: blocks without keyed pixels are stored directly,
+ *    fully keyed blocks are skipped, and only mixed blocks read the destination
+ *    to blend old and new pixels. Reading is slow on video memory, so the two
+ *    common cases (opaque and fully transparent areas) avoid it.
+ */
+SSE2_KERNEL static void SSE2CopyRowColorKey8(uint8_t* dst, uint8_t* src, int32_t count, uint8_t key)
+{
+    int8_t k = key;
+    v16qi keys = { k, k, k, k, k, k, k, k, k, k, k, k, k, k, k, k };
+    for(; count >= 16; count -= 16, src += 16, dst += 16)
+    {
+        v16qi s = *(v16qi_u*)src;
+        v16qi keyed = (s == keys);
+        int mask = __builtin_ia32_pmovmskb128(keyed);
+        if(mask == 0xFFFF)
+            continue;
+        if(mask == 0)
+        {
+            *(v16qi_u*)dst = s;
+            continue;
+        }
+        v16qi d = *(v16qi_u*)dst;
+        *(v16qi_u*)dst = (s & ~keyed) | (d & keyed);
+    }
+
+    for(int32_t i = 0; i < count; i++)
+        if(src[i] != key)
+            dst[i] = src[i];
+}
+
+SSE2_KERNEL static void SSE2CopyRowColorKey32(uint32_t* dst, uint32_t* src, int32_t count, uint32_t key)
+{
+    int32_t k = key;
+    v4si keys = { k, k, k, k };
+    for(; count >= 4; count -= 4, src += 4, dst += 4)
+    {
+        v4si s = *(v4si_u*)src;
+        v4si keyed = (s == keys);
+        int mask = __builtin_ia32_pmovmskb128((v16qi)keyed);
+        if(mask == 0xFFFF)
+            continue;
+        if(mask == 0)
+        {
+            *(v4si_u*)dst = s;
+            continue;
+        }
+        v4si d = *(v4si_u*)dst;
+        *(v4si_u*)dst = (s & ~keyed) | (d & keyed);
+    }
+
+    for(int32_t i = 0; i < count; i++)
+        if(src[i] != key)
+            dst[i] = src[i];
+}
+
+/*
+ * SSE2ConvertRow8To32:
+ *  - SSE2 has no gather, so the palette lookups stay scalar; four results are
+ *    combined with the alpha mask and written with one 16 byte store, which
+ *    matters most when the destination is the framebuffer.
+ */
+SSE2_KERNEL static void SSE2ConvertRow8To32(uint32_t* dst, uint8_t* src, int32_t count,
+                                            uint32_t* palette, uint32_t alphaMask)
+{
+    int32_t a = alphaMask;
+    v4si alpha = { a, a, a, a };
+    for(; count >= 4; count -= 4, src += 4, dst += 4)
+    {
+        v4si p = { (int32_t)palette[src[0]], (int32_t)palette[src[1]],
+                   (int32_t)palette[src[2]], (int32_t)palette[src[3]] };
+        *(v4si_u*)dst = p | alpha;
+    }
+
+    for(int32_t i = 0; i < count; i++)
+        dst[i] = palette[src[i]] | alphaMask;
+}
+
+
+/*
+ * --------------------------------------------------------------------------
+ * PixelKernels Class
+ * --------------------------------------------------------------------------
+ */
+
+PixelKernels PixelKernels::scalar =
+{
+    "scalar",
+    ScalarFillRow8,
+    ScalarFillRow32,
+    ScalarCopyRow,
+    ScalarCopyRowColorKey8,
+    ScalarCopyRowColorKey32,
+    ScalarConvertRow8To32
+};
+
+PixelKernels PixelKernels::sse2 =
+{
+    "sse2",
+    SSE2FillRow8,
+    SSE2FillRow32,
+    SSE2CopyRow,
+    SSE2CopyRowColorKey8,
+    SSE2CopyRowColorKey32,
+    SSE2ConvertRow8To32
+};
+
+PixelKernels* PixelKernels::active = &PixelKernels::scalar;
+
+/*
+ * Select:
+ *  - Called once during boot, after the CPU has been set up.
+ */
+void PixelKernels::Select(bool sse2Enabled)
+{
+    active = sse2Enabled ? &sse2 : &scalar;
+}
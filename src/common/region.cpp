@@ -0,0 +1,268 @@
+#include <common/region.h>
+
+/*
+ * The namespace myos::common contains the basic types and geometry helpers
+ * shared by the drivers and the GUI.
+ */
+using namespace myos::common;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * Rectangle Class
+ * --------------------------------------------------------------------------
+ */
+
+/*
+ * Constructor:
+ *  - Creates an empty rectangle at the origin.
+ */
+Rectangle::Rectangle()
+{
+    this->x = 0;
+    this->y = 0;
+    this->w = 0;
+    this->h = 0;
+}
+
+/*
+ * Constructor:
+ *  - Stores the top-left corner (x, y) and the size (w, h).
+ */
+Rectangle::Rectangle(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    this->x = x;
+    this->y = y;
+    this->w = w;
+    this->h = h;
+}
+
+/*
+ * IsEmpty:
+ *  - A rectangle without width or height covers no pixels.
+ */
+bool Rectangle::IsEmpty() const
+{
+    return w <= 0 || h <= 0;
+}
+
+/*
+ * Intersects:
+ *  - Two rectangles overlap if they overlap on both the x and the y axis.
+ */
+bool Rectangle::Intersects(const Rectangle& other) const
+{
+    return !IsEmpty() && !other.IsEmpty()
+        && x < other.x + other.w && other.x < x + w
+        && y < other.y + other.h && other.y < y + h;
+}
+
+/*
+ * Intersection:
+ *  - Computes the overlapping part of the two rectangles.
+ *  - Returns an empty rectangle if they don't overlap.
+ */
+Rectangle Rectangle::Intersection(const Rectangle& other) const
+{
+    int32_t left   = x > other.x ? x : other.x;
+    int32_t top    = y > other.y ? y : other.y;
+    int32_t right  = (x + w < other.x + other.w) ? x + w : other.x + other.w;
+    int32_t bottom = (y + h < other.y + other.h) ? y + h : other.y + other.h;
+
+    if(right <= left || bottom <= top)
+        return Rectangle();
+    return Rectangle(left, top, right - left, bottom - top);
+}
+
+
+/*
+ * --------------------------------------------------------------------------
+ * Region Class
+ * --------------------------------------------------------------------------
+ *
+ * A clip list made of non-overlapping rectangles. The rectangles are kept in a
+ * fixed array; the order of the rectangles has no meaning.
+ */
+
+/*
+ * Constructor:
+ *  - Creates a region without any rectangles.
+ */
+Region::Region()
+{
+    numRectangles = 0;
+}
+
+/*
+ * Constructor:
+ *  - Creates a region covering a single rectangle (or nothing, if it is empty).
+ */
+Region::Region(const Rectangle& rectangle)
+{
+    numRectangles = 0;
+    if(!rectangle.IsEmpty())
+        rectangles[numRectangles++] = rectangle;
+}
+
+/*
+ * Clear:
+ *  - Forgets all rectangles.
+ */
+void Region::Clear()
+{
+    numRectangles = 0;
+}
+
+/*
+ * IsEmpty:
+ *  - Empty rectangles are never stored, so the region is empty exactly when
+ *    the list is empty.
+ */
+bool Region::IsEmpty() const
+{
+    return numRectangles == 0;
+}
+
+/*
+ * NumRectangles / GetRectangle:
+ *  - Give read access to the clip list, e.g. for painting it rectangle by rectangle.
+ */
+int Region::NumRectangles() const
+{
+    return numRectangles;
+}
+
+const Rectangle& Region::GetRectangle(int i) const
+{
+    return rectangles[i];
+}
+
+/*
+ * Intersect:
+ *  - Clips each rectangle against 'rectangle'.
+ *  - Rectangles that become empty are removed by moving the last rectangle
+ *    into their slot (order doesn't matter).
+ */
+void Region::Intersect(const Rectangle& rectangle)
+{
+    for(int i = 0; i < numRectangles; )
+    {
+        rectangles[i] = rectangles[i].Intersection(rectangle);
+        if(rectangles[i].IsEmpty())
+            rectangles[i] = rectangles[--numRectangles];
+        else
+            i++;
+    }
+}
+
+/*
+ * Subtract:
+ *  - For every rectangle overlapping 'rectangle', the parts outside of it are
+ *    cut into at most four pieces:
+ *
+ *        +-------------------+
+ *        |        top        |
+ *        +-----+-------+-----+
+ *        |left | (cut) |right|
+ *        +-----+-------+-----+
+ *        |      bottom       |
+ *        +-------------------+
+ *
+ *  - The first piece replaces the original rectangle, the others are appended.
+ *    Appended pieces don't overlap 'rectangle', so visiting them again is harmless.
+ *  - If there is no room for the extra pieces, the rectangle is left untouched
+ *    and false is returned (see the class comment).
+ */
+bool Region::Subtract(const Rectangle& rectangle)
+{
+    if(rectangle.IsEmpty())
+        return true;
+
+    bool exact = true;
+    for(int i = 0; i < numRectangles; )
+    {
+        Rectangle r = rectangles[i];
+        Rectangle cut = r.Intersection(rectangle);
+        if(cut.IsEmpty())
+        {
+            i++;
+            continue;
+        }
+
+        Rectangle pieces[4];
+        int numPieces = 0;
+        if(cut.y > r.y)                                   // top band
+            pieces[numPieces++] = Rectangle(r.x, r.y, r.w, cut.y - r.y);
+        if(cut.y + cut.h < r.y + r.h)                     // bottom band
+            pieces[numPieces++] = Rectangle(r.x, cut.y + cut.h, r.w, r.y + r.h - cut.y - cut.h);
+        if(cut.x > r.x)                                   // left part of the middle band
+            pieces[numPieces++] = Rectangle(r.x, cut.y, cut.x - r.x, cut.h);
+        if(cut.x + cut.w < r.x + r.w)                     // right part of the middle band
+            pieces[numPieces++] = Rectangle(cut.x + cut.w, cut.y, r.x + r.w - cut.x - cut.w, cut.h);
+
+        if(numPieces == 0)
+        {
+            // Fully covered: drop it and look at the rectangle moved into slot i
+            rectangles[i] = rectangles[--numRectangles];
+            continue;
+        }
+
+        if(numRectangles + numPieces - 1 > MaxRectangles)
+        {
+            // Out of room: keep the rectangle whole (conservative)
+            exact = false;
+            i++;
+            continue;
+        }
+
+        rectangles[i] = pieces[0];
+        for(int p = 1; p < numPieces; p++)
+            rectangles[numRectangles++] = pieces[p];
+        i++;
+    }
+    return exact;
+}
+
+/*
+ * Add:
+ *  - The new rectangle is cut down to the pixels the region doesn't cover yet;
+ *    a temporary region does the splitting, and the pieces are appended.
+ *  - If they don't fit, everything collapses into one bounding box. That covers
+ *    extra pixels, which only means some of them are painted needlessly.
+ */
+bool Region::Add(const Rectangle& rectangle)
+{
+    if(rectangle.IsEmpty())
+        return true;
+
+    Region pieces(rectangle);
+    for(int i = 0; i < numRectangles && !pieces.IsEmpty(); i++)
+        pieces.Subtract(rectangles[i]);
+
+    if(numRectangles + pieces.numRectangles <= MaxRectangles)
+    {
+        for(int p = 0; p < pieces.numRectangles; p++)
+            rectangles[numRectangles++] = pieces.rectangles[p];
+        return true;
+    }
+
+    int32_t left = rectangle.x;
+    int32_t top = rectangle.y;
+    int32_t right = rectangle.x + rectangle.w;
+    int32_t bottom = rectangle.y + rectangle.h;
+    for(int i = 0; i < numRectangles; i++)
+    {
+        const Rectangle& r = rectangles[i];
+        if(r.x < left)
+            left = r.x;
+        if(r.y < top)
+            top = r.y;
+        if(r.x + r.w > right)
+            right = r.x + r.w;
+        if(r.y + r.h > bottom)
+            bottom = r.y + r.h;
+    }
+    rectangles[0] = Rectangle(left, top, right - left, bottom - top);
+    numRectangles = 1;
+    return false;
+}
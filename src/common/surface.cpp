@@ -0,0 +1,61 @@
+#include <common/surface.h>
+#include <memorymanagement.h>
+
+/*
+ * The namespace myos::common contains the basic types and the graphics contexts.
+ */
+using namespace myos::common;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * Surface Class
+ * --------------------------------------------------------------------------
+ *
+ * A GraphicsContext whose pixels are allocated on the kernel heap.
+ */
+
+/*
+ * Constructor:
+ *  - Computes the bytes per pixel from the format and pads each row to a
+ *    multiple of 4 bytes, so 32 bit rows always start aligned.
+ *  - Allocates pitch * height bytes from the active MemoryManager.
+ *    If that fails (returns 0), the surface stays empty.
+ */
+Surface::Surface(int32_t width, int32_t height, PixelFormat format, uint32_t* palette)
+: GraphicsContext()
+{
+    if(width <= 0 || height <= 0)
+        return;
+
+    int32_t bytesPerPixel = (format == Indexed8) ? 1 : 4;
+    int32_t pitch = (width * bytesPerPixel + 3) & ~3;
+
+    if(myos::MemoryManager::activeMemoryManager == 0)
+        return;
+    uint8_t* memory = (uint8_t*)myos::MemoryManager::activeMemoryManager->malloc(pitch * height);
+    if(memory == 0)
+        return;
+
+    SetPixelBuffer(memory, width, height, pitch, format);
+    this->palette = palette;
+}
+
+/*
+ * Destructor:
+ *  - Frees the pixel memory (if any was allocated).
+ */
+Surface::~Surface()
+{
+    if(pixels != 0 && myos::MemoryManager::activeMemoryManager != 0)
+        myos::MemoryManager::activeMemoryManager->free(pixels);
+}
+
+/*
+ * IsValid:
+ *  - True if the constructor got its memory.
+ */
+bool Surface::IsValid()
+{
+    return pixels != 0;
+}
@@ -76,37 +76,71 @@ extern void printfHex(uint8_t);
  * ----------------------------------
  */
 
+/*
+ * pciMatches:
+ *  - The PCnet-FAST III; QEMU and VirtualBox emulate it as "pcnet".
+ */
+const PeripheralComponentInterconnectMatch amd_am79c973::pciMatches[] =
+{
+    { 0x1022, 0x2000, PeripheralComponentInterconnectMatch::Any,
+      PeripheralComponentInterconnectMatch::Any, PeripheralComponentInterconnectMatch::Any },
+    { 0, 0, 0, 0, 0 }
+};
+
+/*
+ * Probe:
+ *  - The driver is constructed using placement new on memory allocated by the active MemoryManager.
+ *  - The card gets an MSI vector of its own if it offers MSI/MSI-X (the emulated PCnet
+ *    doesn't), otherwise it keeps its IRQ line.
+ */
+Driver* amd_am79c973::Probe(PeripheralComponentInterconnectController* controller,
+                            PeripheralComponentInterconnectDeviceDescriptor* dev,
+                            InterruptManager* interrupts)
+{
+    // The receive ring keeps each side on its own cache line, so the driver starts on a
+    // line boundary. Drivers are never freed, so the pointer needn't be the one malloc returned.
+    uint8_t* memory = (uint8_t*)MemoryManager::activeMemoryManager->malloc(sizeof(amd_am79c973) + CacheLineSize - 1);
+    if(memory == 0)
+    {
+        printf("instantiation failed");
+        return 0;
+    }
+    amd_am79c973* driver = (amd_am79c973*)(((uintptr_t)memory + CacheLineSize - 1) & ~(uintptr_t)(CacheLineSize - 1));
+    controller->AllocateInterrupt(dev, interrupts);
+    new (driver) amd_am79c973(dev, interrupts); // Placement new: construct the driver in allocated memory
+    return driver;
+}
+
 /*
  * Constructor:
  *  - Initializes the amd_am79c973 driver based on information in the PCI descriptor 'dev',
- *    and sets up interrupt handling via 'interrupts'.
- *  - Maps I/O ports used by the NIC (MACAddress0Port, registerDataPort, etc.).
+ *    and sets up interrupt handling via 'interrupts' on the vector chosen by
+ *    PeripheralComponentInterconnectController::AllocateInterrupt.
+ *  - Sets up the register block: memory space (BAR 1) if the PCI code found it enabled,
+ *    the I/O ports of BAR 0 otherwise. The register map is the same in both.
  *  - Reads and composes the MAC address from hardware.
  *  - Sets up the Initialization Block (initBlock) and configures send/receive buffers.
  */
 amd_am79c973::amd_am79c973(PeripheralComponentInterconnectDeviceDescriptor *dev,
                            InterruptManager* interrupts)
 :   Driver(),
-    InterruptHandler(interrupts, dev->interrupt + interrupts->HardwareInterruptOffset()),
-    MACAddress0Port(dev->portBase),
-    MACAddress2Port(dev->portBase + 0x02),
-    MACAddress4Port(dev->portBase + 0x04),
-    registerDataPort(dev->portBase + 0x10),
-    registerAddressPort(dev->portBase + 0x12),
-    resetPort(dev->portBase + 0x14),
-    busControlRegisterDataPort(dev->portBase + 0x16)
+    InterruptHandler(interrupts, dev->interruptVector),
+    registers(MemoryMappedRegion(dev->memoryBase, 0x20), dev->portBase)
 {
     this->handler = 0;               // No handler initially set
+    deferReceive = false;            // Hand frames to the handler in the interrupt
     currentSendBuffer = 0;
     currentRecvBuffer = 0;
     
-    // Read the MAC address from the hardware ports
-    uint64_t MAC0 = MACAddress0Port.Read() % 256;   // Lower byte of MACAddress0
-    uint64_t MAC1 = MACAddress0Port.Read() / 256;   // Upper byte of MACAddress0
-    uint64_t MAC2 = MACAddress2Port.Read() % 256;   // Lower byte of MACAddress2
-    uint64_t MAC3 = MACAddress2Port.Read() / 256;   // Upper byte of MACAddress2
-    uint64_t MAC4 = MACAddress4Port.Read() % 256;   // Lower byte of MACAddress4
-    uint64_t MAC5 = MACAddress4Port.Read() / 256;   // Upper byte of MACAddress4
+    // Read the MAC address from the address PROM (three little-endian words)
+    uint16_t prom[3];
+    registers.ReadBlock<uint16_t>(AddressPROM::Offset, prom, 3);
+    uint64_t MAC0 = prom[0] % 256;   // Lower byte of the first word
+    uint64_t MAC1 = prom[0] / 256;   // Upper byte of the first word
+    uint64_t MAC2 = prom[1] % 256;
+    uint64_t MAC3 = prom[1] / 256;
+    uint64_t MAC4 = prom[2] % 256;
+    uint64_t MAC5 = prom[2] / 256;
     
     // Combine into a 48-bit MAC (stored in a 64-bit container)
     uint64_t MAC = (MAC5 << 40)
@@ -116,13 +150,11 @@ amd_am79c973::amd_am79c973(PeripheralComponentInterconnectDeviceDescriptor *dev,
                  | (MAC1 << 8)
                  | (MAC0);
     
-    // Set 32-bit mode via the bus control register (Register #20)
-    registerAddressPort.Write(20);
-    busControlRegisterDataPort.Write(0x102);
+    // Set 32-bit mode via the bus control register (BCR20: software style 2, 32-bit sizes)
+    WriteBusControl(BCRSoftwareStyle, 0x102);
     
-    // Stop/reset the card (Register #0, write 0x04 = STOP)
-    registerAddressPort.Write(0);
-    registerDataPort.Write(0x04);
+    // Stop/reset the card
+    WriteControlStatus(CSRStatus, StatusStop::Mask);
     
     // Prepare the Initialization Block
     initBlock.mode       = 0x0000;   // Normal mode (non-promiscuous)
@@ -134,23 +166,24 @@ amd_am79c973::amd_am79c973(PeripheralComponentInterconnectDeviceDescriptor *dev,
     initBlock.reserved3  = 0;
     initBlock.logicalAddress = 0;    // No IP set yet (will be updated later)
     
-    // Align and store the addresses of send/receive descriptor arrays
+    // Align and store the addresses of send/receive descriptor arrays.
+    // The card takes 32 bit physical addresses; the kernel lives below 4 GB in both builds.
     sendBufferDescr = (BufferDescriptor*)(
-        (((uint32_t)&sendBufferDescrMemory[0]) + 15) & ~((uint32_t)0xF)
+        (((uintptr_t)&sendBufferDescrMemory[0]) + 15) & ~((uintptr_t)0xF)
     );
-    initBlock.sendBufferDescrAddress = (uint32_t)sendBufferDescr;
+    initBlock.sendBufferDescrAddress = (uint32_t)(uintptr_t)sendBufferDescr;
     
     recvBufferDescr = (BufferDescriptor*)(
-        (((uint32_t)&recvBufferDescrMemory[0]) + 15) & ~((uint32_t)0xF)
+        (((uintptr_t)&recvBufferDescrMemory[0]) + 15) & ~((uintptr_t)0xF)
     );
-    initBlock.recvBufferDescrAddress = (uint32_t)recvBufferDescr;
+    initBlock.recvBufferDescrAddress = (uint32_t)(uintptr_t)recvBufferDescr;
     
     // Initialize each descriptor
     for(uint8_t i = 0; i < 8; i++)
     {
         // Set address (aligned) for send buffers
         sendBufferDescr[i].address = 
-            ((((uint32_t)&sendBuffers[i]) + 15 ) & ~(uint32_t)0xF);
+            (uint32_t)((((uintptr_t)&sendBuffers[i]) + 15 ) & ~(uintptr_t)0xF);
 
         // Descriptor flags: size, ownership bit, etc.
         sendBufferDescr[i].flags  = 0x7FF | 0xF000;    // 0xF000 => owned by driver, 7FF => buffer size
@@ -159,7 +192,7 @@ amd_am79c973::amd_am79c973(PeripheralComponentInterconnectDeviceDescriptor *dev,
         
         // Set address (aligned) for receive buffers
         recvBufferDescr[i].address = 
-            ((((uint32_t)&recvBuffers[i]) + 15 ) & ~(uint32_t)0xF);
+            (uint32_t)((((uintptr_t)&recvBuffers[i]) + 15 ) & ~(uintptr_t)0xF);
 
         // 0xF7FF => buffer size (2047 bytes?), 0x80000000 => owned by card
         recvBufferDescr[i].flags = 0xF7FF | 0x80000000;
@@ -168,13 +201,9 @@ amd_am79c973::amd_am79c973(PeripheralComponentInterconnectDeviceDescriptor *dev,
         sendBufferDescr[i].avail = 0;  
     }
     
-    // Store the lower 16 bits of initBlock address in register #1
-    registerAddressPort.Write(1);
-    registerDataPort.Write( (uint32_t)(&initBlock) & 0xFFFF );
-
-    // Store the upper 16 bits of initBlock address in register #2
-    registerAddressPort.Write(2);
-    registerDataPort.Write( ((uint32_t)(&initBlock) >> 16) & 0xFFFF );
+    // Store the lower and upper 16 bits of initBlock's address in CSR1 and CSR2
+    WriteControlStatus(CSRInitBlockLow, (uintptr_t)(&initBlock) & 0xFFFF);
+    WriteControlStatus(CSRInitBlockHigh, ((uintptr_t)(&initBlock) >> 16) & 0xFFFF);
 }
 
 /*
@@ -185,37 +214,59 @@ amd_am79c973::~amd_am79c973()
 }
             
 
+/*
+ * ReadControlStatus / WriteControlStatus / WriteBusControl:
+ *  - RAP selects the register, RDP (CSRs) or BDP (BCRs) then holds its value.
+ *  - Only Send uses them with interrupts enabled, and it only touches CSR0. The
+ *    interrupt handler leaves RAP at CSR0 as well, so an interrupt between the two
+ *    accesses can't make Send write another register.
+ */
+uint16_t amd_am79c973::ReadControlStatus(uint16_t number)
+{
+    registers.Write<RegisterAddress>(number);
+    return registers.Read<RegisterData>();
+}
+
+void amd_am79c973::WriteControlStatus(uint16_t number, uint16_t value)
+{
+    registers.Write<RegisterAddress>(number);
+    registers.Write<RegisterData>(value);
+}
+
+void amd_am79c973::WriteBusControl(uint16_t number, uint16_t value)
+{
+    registers.Write<RegisterAddress>(number);
+    registers.Write<BusControlData>(value);
+}
+
 /*
  * Activate:
  *  - Performs final steps to enable the card, such as turning on interrupts (Init Done) and the start command.
- *  - Bits 0x41 and 0x42 are written to Register #0 to issue START & INIT commands, etc.
+ *  - INIT and START are written to CSR0 together with the interrupt enable bit.
+ *  - CSR4 bits 10 and 11 make the card strip padding from received frames and pad short frames it sends.
  */
 void amd_am79c973::Activate()
 {
-    // Issue START command (write 0x41 to reg #0)
-    registerAddressPort.Write(0);
-    registerDataPort.Write(0x41);
-
-    // Enable interrupts by setting bits in register #4
-    registerAddressPort.Write(4);
-    uint32_t temp = registerDataPort.Read();
-    registerAddressPort.Write(4);
-    registerDataPort.Write(temp | 0xC00);
+    // Issue INIT command (interrupts enabled)
+    WriteControlStatus(CSRStatus, StatusInterruptEnable::Mask | StatusInit::Mask);
+
+    // Automatic padding and pad stripping
+    uint16_t features = ReadControlStatus(CSRFeatures);
+    WriteControlStatus(CSRFeatures, features | 0xC00);
     
-    // Issue INIT command (write 0x42 to reg #0)
-    registerAddressPort.Write(0);
-    registerDataPort.Write(0x42);
+    // Issue START command (interrupts enabled)
+    WriteControlStatus(CSRStatus, StatusInterruptEnable::Mask | StatusStart::Mask);
 }
 
 /*
  * Reset:
- *  - Triggers a reset via resetPort by reading and then writing 0.
+ *  - Triggers a reset by reading the reset register and then writing 0.
  *  - Returns an arbitrary integer (10), possibly used as a delay or status code.
  */
 int amd_am79c973::Reset()
 {
-    resetPort.Read();
-    resetPort.Write(0);
+    registers.Read<ResetRegister>();
+    registers.Write<ResetRegister>(0);
     return 10;
 }
 
@@ -226,35 +277,37 @@ int amd_am79c973::Reset()
  *  - Invoked by the interrupt manager when the AMD NIC triggers an interrupt.
  *  - Reads the status register (#0), checks various error/status bits, and acknowledges them.
  *  - Calls Receive() if data is available or logs collisions/missed frames/etc.
- *  - Returns the stack pointer (esp) unchanged in this implementation.
+ *  - If the card isn't requesting an interrupt (INTR, bit 7), the interrupt came from another
+ *    device on the same line and isn't claimed.
+ *  - Leaves the stack pointer (esp) unchanged in this implementation.
  */
-uint32_t amd_am79c973::HandleInterrupt(common::uint32_t esp)
+bool amd_am79c973::HandleInterrupt(common::uintptr_t& esp)
 {
     // Read status
-    registerAddressPort.Write(0);
-    uint32_t temp = registerDataPort.Read();
+    uint16_t temp = ReadControlStatus(CSRStatus);
+    if(!StatusInterruptPending::IsSet(temp))
+        return false;
     
-    if((temp & 0x8000) == 0x8000)
+    if(StatusError::IsSet(temp))
         printf("AMD am79c973 ERROR\n");
-    if((temp & 0x2000) == 0x2000)
+    if(StatusCollisionError::IsSet(temp))
         printf("AMD am79c973 COLLISION ERROR\n");
-    if((temp & 0x1000) == 0x1000)
+    if(StatusMissedFrame::IsSet(temp))
         printf("AMD am79c973 MISSED FRAME\n");
-    if((temp & 0x0800) == 0x0800)
+    if(StatusMemoryError::IsSet(temp))
         printf("AMD am79c973 MEMORY ERROR\n");
-    if((temp & 0x0400) == 0x0400)
+    if(StatusReceiveInterrupt::IsSet(temp))
         Receive();
-    if((temp & 0x0200) == 0x0200)
+    if(StatusTransmitInterrupt::IsSet(temp))
         printf(" SENT");
 
     // Acknowledge interrupt by writing back the status bits
-    registerAddressPort.Write(0);
-    registerDataPort.Write(temp);
+    WriteControlStatus(CSRStatus, temp);
     
-    if((temp & 0x0100) == 0x0100)
+    if(StatusInitDone::IsSet(temp))
         printf("AMD am79c973 INIT DONE\n");
     
-    return esp;
+    return true;
 }
 
        
@@ -275,7 +328,7 @@ void amd_am79c973::Send(uint8_t* buffer, int size)
     
     // Copy payload into the buffer, from end to start
     for(uint8_t *src = buffer + size -1,
-                *dst = (uint8_t*)(sendBufferDescr[sendDescriptor].address + size -1);
+                *dst = (uint8_t*)(uintptr_t)(sendBufferDescr[sendDescriptor].address + size -1);
                 src >= buffer; src--, dst--)
     {
         *dst = *src;
@@ -295,54 +348,110 @@ void amd_am79c973::Send(uint8_t* buffer, int size)
     sendBufferDescr[sendDescriptor].flags = 0x8300F000
                                           | ((uint16_t)((-size) & 0xFFF));
                                           
-    // Write to register #0 to notify the NIC to transmit (bit 4 = transmit demand)
-    registerAddressPort.Write(0);
-    registerDataPort.Write(0x48);
+    // Tell the NIC to look at the send ring now. The register write is a compiler
+    // barrier, so the descriptor above is complete in memory before the card looks.
+    WriteControlStatus(CSRStatus, StatusInterruptEnable::Mask | StatusTransmitDemand::Mask);
 }
 
 /*
  * Receive:
  *  - Processes all receive buffers that are marked as complete by the NIC (ownership bit cleared).
- *  - For each valid packet (flags & 0x03000000 == 0x03000000 implies good packet),
- *    prints partial data, then calls the handler->OnRawDataReceived if set.
- *  - Resets the descriptor ownership bit (0x80000000) for the NIC to reuse.
+ *  - Normally each frame is delivered right away (DeliverFrame) and its descriptor goes back
+ *    to the card.
+ *  - With deferred receiving, the descriptor's index is only pushed to 'receivedDescriptors';
+ *    the card gets it back once ProcessReceived has delivered the frame. If all 8 are queued,
+ *    the rest waits for the next interrupt.
  */
 void amd_am79c973::Receive()
 {
-    printf("\nRECV: ");
-    
     // Loop through all receive buffers until we find one still owned by the NIC (bit 31 set)
     for(; (recvBufferDescr[currentRecvBuffer].flags & 0x80000000) == 0;
         currentRecvBuffer = (currentRecvBuffer + 1) % 8)
     {
-        // If it's a valid packet (not an error frame, etc.)
-        if(!(recvBufferDescr[currentRecvBuffer].flags & 0x40000000)  // no error
-         && (recvBufferDescr[currentRecvBuffer].flags & 0x03000000) == 0x03000000) // 0x03 => packet received OK
+        if(deferReceive)
         {
-            uint32_t size = recvBufferDescr[currentRecvBuffer].flags & 0xFFF; // Lower 12 bits = packet length
-            if(size > 64)
-                size -= 4;  // Remove checksum if size > 64
-            
-            // Pointer to the received data
-            uint8_t* buffer = (uint8_t*)(recvBufferDescr[currentRecvBuffer].address);
-
-            // Print partial contents of the received packet
-            for(int i = 14+20; i < (size>64?64:size); i++)
-            {
-                printfHex(buffer[i]);
-                printf(" ");
-            }
-
-            // If we have a handler and it returns true, we echo the packet back (for testing)
-            if(handler != 0)
-                if(handler->OnRawDataReceived(buffer, size))
-                    Send(buffer, size);
+            if(!receivedDescriptors.Push(currentRecvBuffer))
+                break;
+            continue;
         }
+
+        DeliverFrame(currentRecvBuffer);
+        ReturnReceiveDescriptor(currentRecvBuffer);
+    }
+}
+
+/*
+ * DeliverFrame:
+ *  - For a valid packet (flags & 0x03000000 == 0x03000000 implies good packet),
+ *    prints partial data, then calls the handler->OnRawDataReceived if set.
+ */
+void amd_am79c973::DeliverFrame(uint8_t descriptor)
+{
+    printf("\nRECV: ");
+
+    // If it's a valid packet (not an error frame, etc.)
+    if(!(recvBufferDescr[descriptor].flags & 0x40000000)  // no error
+     && (recvBufferDescr[descriptor].flags & 0x03000000) == 0x03000000) // 0x03 => packet received OK
+    {
+        uint32_t size = recvBufferDescr[descriptor].flags & 0xFFF; // Lower 12 bits = packet length
+        if(size > 64)
+            size -= 4;  // Remove checksum if size > 64
         
-        // Reset descriptor ownership to the NIC and restore buffer length flags
-        recvBufferDescr[currentRecvBuffer].flags2 = 0;
-        recvBufferDescr[currentRecvBuffer].flags = 0x8000F7FF;
+        // Pointer to the received data
+        uint8_t* buffer = (uint8_t*)(uintptr_t)(recvBufferDescr[descriptor].address);
+
+        // Print partial contents of the received packet
+        for(int i = 14+20; i < (size>64?64:size); i++)
+        {
+            printfHex(buffer[i]);
+            printf(" ");
+        }
+
+        // If we have a handler and it returns true, we echo the packet back (for testing)
+        if(handler != 0)
+            if(handler->OnRawDataReceived(buffer, size))
+                Send(buffer, size);
+    }
+}
+
+/*
+ * ReturnReceiveDescriptor:
+ *  - Resets the descriptor ownership bit (0x80000000) for the NIC to reuse,
+ *    and restores the buffer length flags.
+ */
+void amd_am79c973::ReturnReceiveDescriptor(uint8_t descriptor)
+{
+    recvBufferDescr[descriptor].flags2 = 0;
+    recvBufferDescr[descriptor].flags = 0x8000F7FF;
+}
+
+/*
+ * SetDeferredReceive:
+ *  - Switches between handling frames in the interrupt and queueing them for ProcessReceived.
+ *  - Before switching back, the caller should empty the queue with ProcessReceived.
+ */
+void amd_am79c973::SetDeferredReceive(bool defer)
+{
+    deferReceive = defer;
+}
+
+/*
+ * ProcessReceived:
+ *  - Consumer side of 'receivedDescriptors'. Each frame is handled in place in its receive
+ *    buffer; only then does the descriptor go back to the card and leave the ring, so
+ *    the interrupt handler never sees a descriptor that is still being handled.
+ */
+uint32_t amd_am79c973::ProcessReceived()
+{
+    uint32_t frames = 0;
+    for(uint8_t* descriptor = receivedDescriptors.Front(); descriptor != 0; descriptor = receivedDescriptors.Front())
+    {
+        DeliverFrame(*descriptor);
+        ReturnReceiveDescriptor(*descriptor);
+        receivedDescriptors.PopFront();
+        frames++;
     }
+    return frames;
 }
 
 /*
@@ -0,0 +1,250 @@
+#include <drivers/bga.h>
+
+/*
+ * Namespaces:
+ *   - myos::common contains the basic integer types
+ *   - myos::drivers groups driver-related classes
+ *   - myos::hardwarecommunication provides ports and PCI descriptors
+ */
+using namespace myos::common;
+using namespace myos::drivers;
+using namespace myos::hardwarecommunication;
+
+// Console output, defined in kernel.cpp.
+extern void printf(char*);
+
+
+/*
+ * ---------------------------------------------------------------------------------
+ * BochsGraphicsAdapter Class
+ * ---------------------------------------------------------------------------------
+ *
+ * Drives the DISPI interface of the Bochs/QEMU (and VirtualBox) display adapter.
+ * Once a mode is set, the GraphicsContext base draws 32-bit pixels straight into
+ * the linear framebuffer.
+ */
+
+/*
+ * BochsVisiblePage:
+ *  - Starts without pixels; the adapter points it at a page after each flip.
+ */
+BochsVisiblePage::BochsVisiblePage()
+: GraphicsContext()
+{
+}
+
+BochsVisiblePage::~BochsVisiblePage()
+{
+}
+
+void BochsVisiblePage::SetPage(uint32_t* page, int32_t width, int32_t height)
+{
+    SetPixelBuffer((uint8_t*)page, width, height, width * 4, XRGB8888);
+}
+
+/*
+ * activeAdapter:
+ *  The adapter found during PCI enumeration, if any.
+ */
+BochsGraphicsAdapter* BochsGraphicsAdapter::activeAdapter = 0;
+
+/*
+ * pciMatches:
+ *  - The VirtualBox adapter offers the same DISPI interface.
+ */
+const PeripheralComponentInterconnectMatch BochsGraphicsAdapter::pciMatches[] =
+{
+    { 0x1234, 0x1111, PeripheralComponentInterconnectMatch::Any,
+      PeripheralComponentInterconnectMatch::Any, PeripheralComponentInterconnectMatch::Any },
+    { 0x80EE, 0xBEEF, PeripheralComponentInterconnectMatch::Any,
+      PeripheralComponentInterconnectMatch::Any, PeripheralComponentInterconnectMatch::Any },
+    { 0, 0, 0, 0, 0 }
+};
+
+/*
+ * Probe:
+ *   - The linear framebuffer is the memory region of BAR 0.
+ *   - The adapter has nothing to activate, but is returned (and so added to the
+ *     DriverManager) like any other driver; the GUI finds it through activeAdapter
+ *     when it picks a video mode.
+ */
+Driver* BochsGraphicsAdapter::Probe(PeripheralComponentInterconnectController* controller,
+                                    PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                    InterruptManager* interrupts)
+{
+    BaseAddressRegister bar = controller->GetBaseAddressRegister(dev->bus, dev->device, dev->function, 0);
+    if(bar.type != MemoryMapping || bar.address == 0)
+        return 0;
+
+    BochsGraphicsAdapter* bga = (BochsGraphicsAdapter*)MemoryManager::activeMemoryManager->malloc(sizeof(BochsGraphicsAdapter));
+    if(bga == 0)
+    {
+        printf("instantiation failed");
+        return 0;
+    }
+    new (bga) BochsGraphicsAdapter(dev, bar.address);
+    return bga;
+}
+
+/*
+ * Constructor:
+ *   - The DISPI ports are fixed at 0x01CE (index) and 0x01CF (data).
+ *   - The framebuffer address comes from the memory BAR of the PCI device.
+ */
+BochsGraphicsAdapter::BochsGraphicsAdapter(PeripheralComponentInterconnectDeviceDescriptor* dev,
+                                           uint8_t* frameBuffer)
+  : VideoGraphicsArray(),
+    Driver()
+{
+    linearFrameBuffer = (uint32_t*)frameBuffer;
+    width = 0;
+    height = 0;
+    bitsPerPixel = 0;
+    doubleBuffered = false;
+    visiblePage = 0;
+    backBuffer = linearFrameBuffer;
+
+    activeAdapter = this;
+}
+
+/*
+ * Destructor:
+ *   - Forgets the adapter if it is the active one.
+ */
+BochsGraphicsAdapter::~BochsGraphicsAdapter()
+{
+    if(activeAdapter == this)
+        activeAdapter = 0;
+}
+
+/*
+ * WriteRegister / ReadRegister:
+ *   - Select the register through the index port, then access the data port.
+ */
+void BochsGraphicsAdapter::WriteRegister(uint16_t index, uint16_t value)
+{
+    displayIndexPort.Write(index);
+    displayDataPort.Write(value);
+}
+
+uint16_t BochsGraphicsAdapter::ReadRegister(uint16_t index)
+{
+    displayIndexPort.Write(index);
+    return displayDataPort.Read();
+}
+
+/*
+ * IsPresent:
+ *   - The id register holds 0xB0C0 .. 0xB0C5 depending on the interface version.
+ *   - 32 bpp needs at least version 2 (0xB0C2).
+ */
+bool BochsGraphicsAdapter::IsPresent()
+{
+    uint16_t id = ReadRegister(DisplayIndexId);
+    return linearFrameBuffer != 0 && 0xB0C2 <= id && id <= 0xB0C5;
+}
+
+/*
+ * SupportsMode:
+ *   - 320x200x8 is handled by the legacy VGA code.
+ *   - For 32 bpp, the maximum resolution is asked from the card: while the
+ *     "get capabilities" bit is set, the resolution registers read back their maxima.
+ *     Versions before 0xB0C3 don't know that bit and are limited to 1024x768.
+ */
+bool BochsGraphicsAdapter::SupportsMode(uint32_t width, uint32_t height, uint32_t colordepth)
+{
+    if(VideoGraphicsArray::SupportsMode(width, height, colordepth))
+        return true;
+
+    if(colordepth != 32 || !IsPresent())
+        return false;
+
+    uint32_t maxWidth = 1024;
+    uint32_t maxHeight = 768;
+    if(ReadRegister(DisplayIndexId) >= 0xB0C3)
+    {
+        uint16_t enable = ReadRegister(DisplayIndexEnable);
+        WriteRegister(DisplayIndexEnable, enable | DisplayGetCaps);
+        maxWidth = ReadRegister(DisplayIndexXResolution);
+        maxHeight = ReadRegister(DisplayIndexYResolution);
+        WriteRegister(DisplayIndexEnable, enable);
+    }
+
+    return 0 < width && width <= maxWidth
+        && 0 < height && height <= maxHeight;
+}
+
+/*
+ * SetMode:
+ *   - Legacy 320x200x8: disable DISPI and program the VGA registers instead.
+ *   - Otherwise, the display must be disabled while resolution and depth change.
+ *   - The virtual height is doubled if video memory holds two screens, giving a
+ *     hidden page to draw into (see SwapBuffers).
+ *   - Enabling with the LFB bit maps all of video memory at the BAR address.
+ */
+bool BochsGraphicsAdapter::SetMode(uint32_t width, uint32_t height, uint32_t colordepth)
+{
+    if(!SupportsMode(width, height, colordepth))
+        return false;
+
+    if(VideoGraphicsArray::SupportsMode(width, height, colordepth))
+    {
+        if(IsPresent())
+            WriteRegister(DisplayIndexEnable, DisplayDisabled);
+        bitsPerPixel = 0;
+        return VideoGraphicsArray::SetMode(width, height, colordepth);
+    }
+
+    uint32_t videoMemory = ReadRegister(DisplayIndexVideoMemory64K) * 64 * 1024;
+    uint32_t screenSize = width * height * 4;
+    doubleBuffered = videoMemory >= 2 * screenSize;
+
+    WriteRegister(DisplayIndexEnable, DisplayDisabled);
+    WriteRegister(DisplayIndexXResolution, width);
+    WriteRegister(DisplayIndexYResolution, height);
+    WriteRegister(DisplayIndexBitsPerPixel, colordepth);
+    WriteRegister(DisplayIndexVirtualWidth, width);
+    WriteRegister(DisplayIndexVirtualHeight, doubleBuffered ? 2 * height : height);
+    WriteRegister(DisplayIndexEnable, DisplayEnabled | DisplayLinearFrameBuffer);
+    WriteRegister(DisplayIndexXOffset, 0);
+    WriteRegister(DisplayIndexYOffset, 0);
+
+    this->width = width;
+    this->height = height;
+    this->bitsPerPixel = colordepth;
+
+    // Page 0 is shown; draw into page 1 (or directly into page 0 without a second page)
+    visiblePage = 0;
+    backBuffer = linearFrameBuffer + (doubleBuffered ? width * height : 0);
+    SetPixelBuffer((uint8_t*)backBuffer, width, height, width * 4, XRGB8888);
+    frontBuffer.SetPage(linearFrameBuffer, width, height);
+    return true;
+}
+
+/*
+ * SwapBuffers:
+ *   - Scrolls the visible window of the virtual screen to the page that was
+ *     just drawn, then redirects drawing to the other page.
+ */
+void BochsGraphicsAdapter::SwapBuffers()
+{
+    if(!doubleBuffered || bitsPerPixel == 0)
+        return;
+
+    visiblePage = 1 - visiblePage;
+    WriteRegister(DisplayIndexYOffset, visiblePage * height);
+    backBuffer = linearFrameBuffer + (1 - visiblePage) * width * height;
+    pixels = (uint8_t*)backBuffer;
+    frontBuffer.SetPage(linearFrameBuffer + visiblePage * width * height, width, height);
+}
+
+/*
+ * GetFrontBuffer:
+ *   - Without a second page, drawing already goes to the screen.
+ */
+GraphicsContext* BochsGraphicsAdapter::GetFrontBuffer()
+{
+    if(!doubleBuffered || bitsPerPixel == 0)
+        return this;
+    return &frontBuffer;
+}
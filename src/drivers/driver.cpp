@@ -77,24 +77,23 @@ void Driver::Deactivate()
 
 /*
  * Constructor:
- *  Initializes the driver counter (numDrivers) to 0. 
- *  The drivers array is sized at 265 in the header, though only 'numDrivers'
- *  are actually used at a given time.
+ *  Starts with an empty driver list.
  */
 DriverManager::DriverManager()
 {
-    numDrivers = 0;
 }
 
 /*
  * AddDriver:
- *  Adds a new Driver pointer to the 'drivers' array, then increments 'numDrivers'.
- *  The caller is responsible for ensuring that 'numDrivers' does not exceed array bounds.
+ *  Links the Driver to the end of the 'drivers' list through its own node,
+ *  so any number of drivers can be added without allocating.
+ *  A driver that is already on the list is not added twice.
  */
 void DriverManager::AddDriver(Driver* drv)
 {
-    drivers[numDrivers] = drv;
-    numDrivers++;
+    if(drv->driverManagerNode.IsLinked())
+        return;
+    drivers.PushBack(drv);
 }
 
 /*
@@ -105,6 +104,6 @@ void DriverManager::AddDriver(Driver* drv)
  */
 void DriverManager::ActivateAll()
 {
-    for(int i = 0; i < numDrivers; i++)
-        drivers[i]->Activate();
+    for(Driver* driver = drivers.Front(); driver != 0; driver = drivers.Next(driver))
+        driver->Activate();
 }
@@ -0,0 +1,197 @@
+#include <drivers/inputqueue.h>
+#include <hardwarecommunication/cpu.h>
+
+/*
+ * Using namespaces from the OS codebase:
+ *   - myos::common: for integral types like uint8_t, int32_t, etc.
+ *   - myos::drivers: for the event handler interfaces
+ *   - myos::hardwarecommunication: for the time stamp counter
+ */
+using namespace myos::common;
+using namespace myos::drivers;
+using namespace myos::hardwarecommunication;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * InputQueue Class
+ * --------------------------------------------------------------------------
+ *
+ * A lock-free ring of input events, filled by interrupt handlers and emptied
+ * by the GUI loop.
+ */
+
+/*
+ * Constructor:
+ *  - Checks for a TSC once; CPUID is far too slow to run in every interrupt.
+ */
+InputQueue::InputQueue(KeyboardEventHandler* keyboardTarget, MouseEventHandler* mouseTarget)
+: KeyboardEventHandler(),
+  MouseEventHandler()
+{
+    this->keyboardTarget = keyboardTarget;
+    this->mouseTarget = mouseTarget;
+    timestamps = CentralProcessingUnit::HasTimeStampCounter();
+}
+
+InputQueue::~InputQueue()
+{
+}
+
+/*
+ * Record:
+ *  - Stamps the event and pushes it. Runs in the keyboard or mouse interrupt
+ *    handler; interrupt gates don't nest, so one push is finished before the
+ *    other handler or the GUI loop runs again.
+ *  - If the GUI loop has fallen behind and the ring is full, the event is
+ *    dropped and counted.
+ */
+void InputQueue::Record(InputEvent& event)
+{
+    event.timestamp = timestamps ? CentralProcessingUnit::ReadTimeStampCounter() : 0;
+    if(!events.Push(event))
+        dropped.Increment();
+}
+
+void InputQueue::OnKeyEvent(const KeyEvent& key)
+{
+    InputEvent event;
+    event.type = InputEvent::Key;
+    event.key = key;
+    Record(event);
+}
+
+void InputQueue::OnMouseDown(uint8_t button)
+{
+    InputEvent event;
+    event.type = InputEvent::MouseDown;
+    event.code = button;
+    Record(event);
+}
+
+void InputQueue::OnMouseUp(uint8_t button)
+{
+    InputEvent event;
+    event.type = InputEvent::MouseUp;
+    event.code = button;
+    Record(event);
+}
+
+void InputQueue::OnMouseMove(int x, int y)
+{
+    InputEvent event;
+    event.type = InputEvent::MouseMove;
+    event.dx = x;
+    event.dy = y;
+    Record(event);
+}
+
+void InputQueue::OnMouseWheel(int delta)
+{
+    InputEvent event;
+    event.type = InputEvent::MouseWheel;
+    event.dx = 0;
+    event.dy = delta;
+    Record(event);
+}
+
+void InputQueue::OnActivate()
+{
+    if(mouseTarget != 0)
+        mouseTarget->OnActivate();
+}
+
+bool InputQueue::Pop(InputEvent* event)
+{
+    return events.Pop(*event);
+}
+
+/*
+ * Dispatch:
+ *  - Only the events present on entry are handled, so a stream of new ones
+ *    can't keep the GUI loop in here. They are taken out a batch at a time.
+ *  - A keyboard or mouse interrupt may push more events meanwhile; they are left
+ *    for the next frame.
+ *  - Movements and wheel turns are added up until an event of another type (or
+ *    the end) comes along; button and key events keep their order relative to them.
+ */
+uint32_t InputQueue::Dispatch()
+{
+    uint32_t available = events.Size();
+    uint32_t dispatched = 0;
+    int32_t moveX = 0;
+    int32_t moveY = 0;
+    int32_t wheel = 0;
+
+    InputEvent batch[16];
+    uint32_t batchSize = 0;
+    for(uint32_t next = 0; ; next++)
+    {
+        if(next == batchSize)
+        {
+            uint32_t wanted = available - dispatched;
+            batchSize = events.PopBatch(batch, wanted < 16 ? wanted : 16);
+            dispatched += batchSize;
+            next = 0;
+            if(batchSize == 0)
+                break;
+        }
+
+        InputEvent& event = batch[next];
+        if(event.type == InputEvent::MouseMove)
+        {
+            moveX += event.dx;
+            moveY += event.dy;
+            continue;
+        }
+        if(event.type == InputEvent::MouseWheel)
+        {
+            wheel += event.dy;
+            continue;
+        }
+
+        FlushMotion(moveX, moveY, wheel);
+
+        switch(event.type)
+        {
+            case InputEvent::Key:
+                if(keyboardTarget != 0)
+                    keyboardTarget->OnKeyEvent(event.key);
+                break;
+            case InputEvent::MouseDown:
+                if(mouseTarget != 0)
+                    mouseTarget->OnMouseDown(event.code);
+                break;
+            case InputEvent::MouseUp:
+                if(mouseTarget != 0)
+                    mouseTarget->OnMouseUp(event.code);
+                break;
+        }
+    }
+
+    FlushMotion(moveX, moveY, wheel);
+    return dispatched;
+}
+
+/*
+ * FlushMotion:
+ *  - Passes on and clears the accumulated movement and wheel turns.
+ */
+void InputQueue::FlushMotion(int32_t& moveX, int32_t& moveY, int32_t& wheel)
+{
+    if(mouseTarget != 0)
+    {
+        if(moveX != 0 || moveY != 0)
+            mouseTarget->OnMouseMove(moveX, moveY);
+        if(wheel != 0)
+            mouseTarget->OnMouseWheel(wheel);
+    }
+    moveX = 0;
+    moveY = 0;
+    wheel = 0;
+}
+
+uint32_t InputQueue::GetDroppedCount()
+{
+    return dropped.Sum();
+}
@@ -29,6 +29,21 @@ KeyboardEventHandler::KeyboardEventHandler()
 {
 }
 
+/*
+ * OnKeyEvent:
+ *   Triggered for every decoded key event. By default, keys that type a
+ *   character are passed on to OnKeyDown (presses and repeats) or OnKeyUp.
+ */
+void KeyboardEventHandler::OnKeyEvent(const KeyEvent& event)
+{
+    if(event.character == 0)
+        return;
+    if(event.pressed)
+        OnKeyDown(event.character);
+    else
+        OnKeyUp(event.character);
+}
+
 /*
  * OnKeyDown:
  *   Triggered when a key is pressed (scan code in the 0..0x7F range).
@@ -57,8 +72,9 @@ void KeyboardEventHandler::OnKeyUp(char)
  * Handles the low-level communication with the PS/2 keyboard controller by:
  *   - Reading scancodes from the data port (0x60).
  *   - Sending commands to the command port (0x64).
- *   - Translating scancodes into ASCII characters (for selected keys).
- *   - Notifying a KeyboardEventHandler about key presses.
+ *   - Translating scancodes into key codes and characters with the tables of a KeyboardLayout.
+ *   - Tracking Shift, Control, Alt, AltGr and the lock keys.
+ *   - Notifying a KeyboardEventHandler about key presses, repeats and releases.
  *
  * The keyboard typically raises IRQ1 (interrupt 0x21 on the PIC).
  */
@@ -67,14 +83,18 @@ void KeyboardEventHandler::OnKeyUp(char)
  * Constructor:
  *   - manager: The InterruptManager responsible for handling IRQs.
  *   - handler: An object implementing the KeyboardEventHandler interface to receive key events.
- * It initializes I/O ports for data (0x60) and command (0x64) and registers this driver at interrupt 0x21.
+ * The ports for data (0x60) and command (0x64) are fixed by their types; the driver is registered at interrupt 0x21.
  */
 KeyboardDriver::KeyboardDriver(InterruptManager* manager, KeyboardEventHandler* handler)
-: InterruptHandler(manager, 0x21),  // IRQ1 for PS/2 keyboard
-  dataport(0x60),
-  commandport(0x64)
+: InterruptHandler(manager, 0x21)   // IRQ1 for PS/2 keyboard
 {
     this->handler = handler;
+    layout = &KeyboardLayout::qwertz;
+    extended = false;
+    pauseBytes = 0;
+    modifiers = 0;
+    for(int i = 0; i < 8; i++)
+        keysDown[i] = 0;
 }
 
 /*
@@ -85,13 +105,15 @@ KeyboardDriver::~KeyboardDriver()
 {
 }
 
-/*
- * External C-style functions for printing:
- *   - printf: prints a null-terminated string to the screen.
- *   - printfHex: prints a byte as two hexadecimal digits.
- */
-extern void printf(char*);
-extern void printfHex(uint8_t);
+void KeyboardDriver::SetLayout(const KeyboardLayout* layout)
+{
+    this->layout = layout;
+}
+
+uint8_t KeyboardDriver::GetModifiers()
+{
+    return modifiers;
+}
 
 /*
  * Activate:
@@ -128,86 +150,126 @@ void KeyboardDriver::Activate()
 /*
  * HandleInterrupt:
  *   - Called when IRQ1 (keyboard interrupt) is triggered.
- *   - Reads the scancode from the data port (0x60). 
- *   - If there's a valid handler and the scancode is less than 0x80 (a key press, not release),
- *     it translates the scancode to an ASCII character for certain keys and calls OnKeyDown.
- *   - If the key is not recognized, prints "KEYBOARD 0x.." with the scancode in hex.
- *   - Returns the stack pointer (esp) unchanged.
+ *   - Reads one byte from the data port (0x60). 0xE0 marks the next byte as an extended key;
+ *     0xE1 starts the six byte sequence of Pause, which is reported at once (Pause has no release).
+ *   - Any other byte is a make code (bit 7 clear) or break code (bit 7 set). The key code is
+ *     a single lookup in the layout's table; bytes that map to no key, like the keyboard's
+ *     acknowledgements (0xFA) or the fake Shift codes around Print Screen, are dropped.
+ *   - A make code for a key that is already down is the keyboard's typematic repeat.
+ *   - Leaves the stack pointer (esp) unchanged and claims the interrupt.
  */
-uint32_t KeyboardDriver::HandleInterrupt(uint32_t esp)
+bool KeyboardDriver::HandleInterrupt(uintptr_t& esp)
 {
     // Read scancode
-    uint8_t key = dataport.Read();
-    
-    // If no event handler is set, there's nothing to do
-    if(handler == 0)
-        return esp;
-    
-    // Only handle key-down events (scancodes < 0x80)
-    if(key < 0x80)
+    uint8_t code = dataport.Read();
+
+    if(pauseBytes > 0)
+    {
+        pauseBytes--;
+        return true;
+    }
+    if(code == 0xE0)
+    {
+        extended = true;
+        return true;
+    }
+    if(code == 0xE1)
     {
-        switch(key)
-        {
-            // Numeric keys above QWERTY row
-            case 0x02: handler->OnKeyDown('1'); break;
-            case 0x03: handler->OnKeyDown('2'); break;
-            case 0x04: handler->OnKeyDown('3'); break;
-            case 0x05: handler->OnKeyDown('4'); break;
-            case 0x06: handler->OnKeyDown('5'); break;
-            case 0x07: handler->OnKeyDown('6'); break;
-            case 0x08: handler->OnKeyDown('7'); break;
-            case 0x09: handler->OnKeyDown('8'); break;
-            case 0x0A: handler->OnKeyDown('9'); break;
-            case 0x0B: handler->OnKeyDown('0'); break;
-
-            // QWERT row
-            case 0x10: handler->OnKeyDown('q'); break;
-            case 0x11: handler->OnKeyDown('w'); break;
-            case 0x12: handler->OnKeyDown('e'); break;
-            case 0x13: handler->OnKeyDown('r'); break;
-            case 0x14: handler->OnKeyDown('t'); break;
-            case 0x15: handler->OnKeyDown('z'); break; // Key 0x15 is 'z' on some layouts (QWERTZ)
-            case 0x16: handler->OnKeyDown('u'); break;
-            case 0x17: handler->OnKeyDown('i'); break;
-            case 0x18: handler->OnKeyDown('o'); break;
-            case 0x19: handler->OnKeyDown('p'); break;
-
-            // ASDF row
-            case 0x1E: handler->OnKeyDown('a'); break;
-            case 0x1F: handler->OnKeyDown('s'); break;
-            case 0x20: handler->OnKeyDown('d'); break;
-            case 0x21: handler->OnKeyDown('f'); break;
-            case 0x22: handler->OnKeyDown('g'); break;
-            case 0x23: handler->OnKeyDown('h'); break;
-            case 0x24: handler->OnKeyDown('j'); break;
-            case 0x25: handler->OnKeyDown('k'); break;
-            case 0x26: handler->OnKeyDown('l'); break;
-
-            // ZXCV row
-            case 0x2C: handler->OnKeyDown('y'); break;
-            case 0x2D: handler->OnKeyDown('x'); break;
-            case 0x2E: handler->OnKeyDown('c'); break;
-            case 0x2F: handler->OnKeyDown('v'); break;
-            case 0x30: handler->OnKeyDown('b'); break;
-            case 0x31: handler->OnKeyDown('n'); break;
-            case 0x32: handler->OnKeyDown('m'); break;
-            case 0x33: handler->OnKeyDown(','); break;
-            case 0x34: handler->OnKeyDown('.'); break;
-            case 0x35: handler->OnKeyDown('-'); break;
-
-            // Enter (0x1C) and Space (0x39)
-            case 0x1C: handler->OnKeyDown('\n'); break;
-            case 0x39: handler->OnKeyDown(' ');  break;
-
-            // Default case: scancode not mapped here
-            default:
-            {
-                printf("KEYBOARD 0x");
-                printfHex(key);
-                break;
-            }
-        }
+        pauseBytes = 5;
+        Report(KeyPause, true, false);
+        Report(KeyPause, false, false);
+        return true;
     }
+
+    uint8_t keycode = layout->keycodes[(extended ? 0x80 : 0x00) | (code & 0x7F)];
+    extended = false;
+    if(keycode == KeyNone)
+        return true;
+
+    bool pressed = (code & 0x80) == 0;
+    bool repeat = pressed && IsDown(keycode);
+    if(pressed)
+        keysDown[keycode >> 5] |= 1 << (keycode & 31);
+    else
+        keysDown[keycode >> 5] &= ~(1 << (keycode & 31));
+
+    switch(keycode)
+    {
+        case KeyLeftShift:
+        case KeyRightShift:
+        case KeyLeftControl:
+        case KeyRightControl:
+        case KeyLeftAlt:
+        case KeyRightAlt:
+        case KeyLeftGui:
+        case KeyRightGui:
+            // Left and right keys share a bit, which stays set while either is down
+            modifiers &= ~(ModifierShift | ModifierControl | ModifierAlt | ModifierAltGr | ModifierGui);
+            if(IsDown(KeyLeftShift) || IsDown(KeyRightShift))
+                modifiers |= ModifierShift;
+            if(IsDown(KeyLeftControl) || IsDown(KeyRightControl))
+                modifiers |= ModifierControl;
+            if(IsDown(KeyLeftAlt))
+                modifiers |= ModifierAlt;
+            if(IsDown(KeyRightAlt))
+                modifiers |= ModifierAltGr;
+            if(IsDown(KeyLeftGui) || IsDown(KeyRightGui))
+                modifiers |= ModifierGui;
+            break;
+        case KeyCapsLock:
+            if(pressed && !repeat)
+                modifiers ^= ModifierCapsLock;
+            break;
+        case KeyNumLock:
+            if(pressed && !repeat)
+                modifiers ^= ModifierNumLock;
+            break;
+        case KeyScrollLock:
+            if(pressed && !repeat)
+                modifiers ^= ModifierScrollLock;
+            break;
+    }
+
+    Report(keycode, pressed, repeat);
+
     // Return the (potentially) unchanged stack pointer after handling
-    return esp;
+    return true;
+}
+
+bool KeyboardDriver::IsDown(uint8_t keycode)
+{
+    return (keysDown[keycode >> 5] & (1 << (keycode & 31))) != 0;
+}
+
+/*
+ * Report:
+ *   - The character comes from the AltGr table if AltGr is held and the key has an
+ *     AltGr character, otherwise from the Shift table if Shift is held. Caps Lock
+ *     inverts Shift for letters only.
+ *   - Keypad digits type only with Num Lock on.
+ *   - Control turns letters into the control characters 1..26 (Control+H is '\b').
+ */
+void KeyboardDriver::Report(uint8_t keycode, bool pressed, bool repeat)
+{
+    if(handler == 0)
+        return;
+
+    bool letter = (keycode >= 'a' && keycode <= 'z');
+    bool shift = ((modifiers & ModifierShift) != 0) != (letter && (modifiers & ModifierCapsLock) != 0);
+
+    char character = layout->characters[shift ? 1 : 0][keycode];
+    if((modifiers & ModifierAltGr) && layout->characters[2][keycode] != 0)
+        character = layout->characters[2][keycode];
+    if(keycode >= KeyKeypad0 && keycode <= KeyKeypadPeriod && !(modifiers & ModifierNumLock))
+        character = 0;
+    if((modifiers & ModifierControl) && letter)
+        character &= 0x1F;
+
+    KeyEvent event;
+    event.keycode = keycode;
+    event.modifiers = modifiers;
+    event.character = character;
+    event.pressed = pressed;
+    event.repeat = repeat;
+    handler->OnKeyEvent(event);
 }
@@ -0,0 +1,149 @@
+#include <drivers/keyboardlayout.h>
+
+/*
+ * Using namespaces from the OS codebase:
+ *   - myos::common: for integral types like uint8_t
+ *   - myos::drivers: for the keyboard layout tables
+ */
+using namespace myos::common;
+using namespace myos::drivers;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * Layout tables
+ * --------------------------------------------------------------------------
+ *
+ * Built by constexpr functions, so the kernel image contains the finished
+ * tables and the driver never runs any setup code for them. Scan codes are
+ * those of set 1, which the PS/2 controller translates every keyboard to.
+ */
+
+// Maps 'scancode' to 'keycode', and 'keycode' to the characters it types (0: none)
+static constexpr void SetKey(KeyboardLayout& layout, uint32_t scancode, uint8_t keycode,
+                             char normal, char shifted, char altGr = 0)
+{
+    layout.keycodes[scancode] = keycode;
+    layout.characters[0][keycode] = normal;
+    layout.characters[1][keycode] = shifted;
+    if(altGr != 0)
+        layout.characters[2][keycode] = altGr;
+}
+
+// A row of character keys with consecutive scan codes; each key's code is its unshifted character
+static constexpr void SetRow(KeyboardLayout& layout, uint32_t firstScancode,
+                             const char* normal, const char* shifted)
+{
+    for(uint32_t i = 0; normal[i] != 0; i++)
+        SetKey(layout, firstScancode + i, normal[i], normal[i], shifted[i]);
+}
+
+// Keys that are the same on every layout (E0-prefixed ones at 0x80 + scan code)
+static constexpr void SetCommonKeys(KeyboardLayout& layout)
+{
+    SetKey(layout, 0x01, KeyEscape, 0x1B, 0x1B);
+    SetKey(layout, 0x0E, KeyBackspace, '\b', '\b');
+    SetKey(layout, 0x0F, KeyTab, '\t', '\t');
+    SetKey(layout, 0x1C, KeyEnter, '\n', '\n');
+    SetKey(layout, 0x39, KeySpace, ' ', ' ');
+
+    SetKey(layout, 0x1D, KeyLeftControl, 0, 0);
+    SetKey(layout, 0x2A, KeyLeftShift, 0, 0);
+    SetKey(layout, 0x36, KeyRightShift, 0, 0);
+    SetKey(layout, 0x38, KeyLeftAlt, 0, 0);
+    SetKey(layout, 0x3A, KeyCapsLock, 0, 0);
+    SetKey(layout, 0x45, KeyNumLock, 0, 0);
+    SetKey(layout, 0x46, KeyScrollLock, 0, 0);
+
+    for(uint32_t i = 0; i < 10; i++)
+        SetKey(layout, 0x3B + i, KeyF1 + i, 0, 0);
+    SetKey(layout, 0x57, KeyF11, 0, 0);
+    SetKey(layout, 0x58, KeyF12, 0, 0);
+
+    SetKey(layout, 0x37, KeyKeypadMultiply, '*', '*');
+    SetKey(layout, 0x47, KeyKeypad7, '7', '7');
+    SetKey(layout, 0x48, KeyKeypad8, '8', '8');
+    SetKey(layout, 0x49, KeyKeypad9, '9', '9');
+    SetKey(layout, 0x4A, KeyKeypadMinus, '-', '-');
+    SetKey(layout, 0x4B, KeyKeypad4, '4', '4');
+    SetKey(layout, 0x4C, KeyKeypad5, '5', '5');
+    SetKey(layout, 0x4D, KeyKeypad6, '6', '6');
+    SetKey(layout, 0x4E, KeyKeypadPlus, '+', '+');
+    SetKey(layout, 0x4F, KeyKeypad1, '1', '1');
+    SetKey(layout, 0x50, KeyKeypad2, '2', '2');
+    SetKey(layout, 0x51, KeyKeypad3, '3', '3');
+    SetKey(layout, 0x52, KeyKeypad0, '0', '0');
+    SetKey(layout, 0x53, KeyKeypadPeriod, '.', '.');
+
+    SetKey(layout, 0x80 + 0x1C, KeyKeypadEnter, '\n', '\n');
+    SetKey(layout, 0x80 + 0x1D, KeyRightControl, 0, 0);
+    SetKey(layout, 0x80 + 0x35, KeyKeypadDivide, '/', '/');
+    SetKey(layout, 0x80 + 0x37, KeyPrintScreen, 0, 0);
+    SetKey(layout, 0x80 + 0x38, KeyRightAlt, 0, 0);
+    SetKey(layout, 0x80 + 0x47, KeyHome, 0, 0);
+    SetKey(layout, 0x80 + 0x48, KeyUp, 0, 0);
+    SetKey(layout, 0x80 + 0x49, KeyPageUp, 0, 0);
+    SetKey(layout, 0x80 + 0x4B, KeyLeft, 0, 0);
+    SetKey(layout, 0x80 + 0x4D, KeyRight, 0, 0);
+    SetKey(layout, 0x80 + 0x4F, KeyEnd, 0, 0);
+    SetKey(layout, 0x80 + 0x50, KeyDown, 0, 0);
+    SetKey(layout, 0x80 + 0x51, KeyPageDown, 0, 0);
+    SetKey(layout, 0x80 + 0x52, KeyInsert, 0, 0);
+    SetKey(layout, 0x80 + 0x53, KeyDelete, 0, 0);
+    SetKey(layout, 0x80 + 0x5B, KeyLeftGui, 0, 0);
+    SetKey(layout, 0x80 + 0x5C, KeyRightGui, 0, 0);
+    SetKey(layout, 0x80 + 0x5D, KeyMenu, 0, 0);
+}
+
+/*
+ * MakeQwerty:
+ *  - US layout. The extra key next to the left Shift of ISO keyboards types '\' as well.
+ */
+static constexpr KeyboardLayout MakeQwerty()
+{
+    KeyboardLayout layout = {};
+    SetCommonKeys(layout);
+    SetRow(layout, 0x02, "1234567890-=", "!@#$%^&*()_+");
+    SetRow(layout, 0x10, "qwertyuiop[]", "QWERTYUIOP{}");
+    SetRow(layout, 0x1E, "asdfghjkl;'`", "ASDFGHJKL:\"~");
+    SetKey(layout, 0x2B, '\\', '\\', '|');
+    SetRow(layout, 0x2C, "zxcvbnm,./", "ZXCVBNM<>?");
+    SetKey(layout, 0x56, '\\', '\\', '|');
+    return layout;
+}
+
+/*
+ * MakeQwertz:
+ *  - German layout, as far as it types ASCII: the umlauts, sharp s and the dead
+ *    accent key get national key codes and type nothing on their own, and so
+ *    does Shift+3 (the section sign). AltGr gives the usual ASCII characters.
+ */
+static constexpr KeyboardLayout MakeQwertz()
+{
+    KeyboardLayout layout = {};
+    SetCommonKeys(layout);
+    SetRow(layout, 0x02, "1234567890", "!\"3$%&/()=");
+    layout.characters[1]['3'] = 0;
+    SetKey(layout, 0x0C, KeyNational1, 0, '?', '\\');
+    SetKey(layout, 0x0D, KeyNational2, 0, '`');
+    SetRow(layout, 0x10, "qwertzuiop", "QWERTZUIOP");
+    SetKey(layout, 0x1A, KeyNational3, 0, 0);
+    SetKey(layout, 0x1B, '+', '+', '*', '~');
+    SetRow(layout, 0x1E, "asdfghjkl", "ASDFGHJKL");
+    SetKey(layout, 0x27, KeyNational4, 0, 0);
+    SetKey(layout, 0x28, KeyNational5, 0, 0);
+    SetKey(layout, 0x29, '^', '^', 0);
+    SetKey(layout, 0x2B, '#', '#', '\'');
+    SetRow(layout, 0x2C, "yxcvbnm,.-", "YXCVBNM;:_");
+    SetKey(layout, 0x56, '<', '<', '>', '|');
+
+    layout.characters[2]['q'] = '@';
+    layout.characters[2]['7'] = '{';
+    layout.characters[2]['8'] = '[';
+    layout.characters[2]['9'] = ']';
+    layout.characters[2]['0'] = '}';
+    return layout;
+}
+
+const KeyboardLayout KeyboardLayout::qwerty = MakeQwerty();
+const KeyboardLayout KeyboardLayout::qwertz = MakeQwertz();
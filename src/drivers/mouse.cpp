@@ -69,6 +69,14 @@ void MouseEventHandler::OnMouseMove(int x, int y)
 {
 }
 
+/*
+ * OnMouseWheel:
+ *  Called when the scroll wheel of an IntelliMouse turns. Default implementation is empty.
+ */
+void MouseEventHandler::OnMouseWheel(int delta)
+{
+}
+
 
 /*
  * --------------------------------------------------------------------------
@@ -87,12 +95,10 @@ void MouseEventHandler::OnMouseMove(int x, int y)
  * Constructor:
  *   - manager: The system's interrupt manager (to register this driver for IRQ12).
  *   - handler: The MouseEventHandler to delegate mouse events to.
- * Initializes the I/O ports for the data (0x60) and command (0x64).
+ * The I/O ports for the data (0x60) and command (0x64) are fixed by their types.
  */
 MouseDriver::MouseDriver(InterruptManager* manager, MouseEventHandler* handler)
-    : InterruptHandler(manager, 0x2C),  // 0x2C = IRQ12 after PIC remapping
-      dataport(0x60),
-      commandport(0x64)
+    : InterruptHandler(manager, 0x2C)   // 0x2C = IRQ12 after PIC remapping
 {
     this->handler = handler;
 }
@@ -104,45 +110,141 @@ MouseDriver::~MouseDriver()
 {
 }
 
+/*
+ * WaitForWrite / WaitForRead:
+ *   - Bit 1 of the status register is set while the controller's input buffer is full,
+ *     bit 0 when a byte is waiting in its output buffer; bit 5 tells that byte is from
+ *     the mouse. Keyboard bytes arriving in between are dropped.
+ *   - Both give up after a bounded number of polls, so a missing mouse can't hang the boot.
+ */
+bool MouseDriver::WaitForWrite()
+{
+    for(uint32_t polls = 0; polls < 100000; polls++)
+        if((commandport.Read() & 0x02) == 0)
+            return true;
+    return false;
+}
+
+bool MouseDriver::WaitForRead()
+{
+    for(uint32_t polls = 0; polls < 100000; polls++)
+    {
+        uint8_t status = commandport.Read();
+        if(status & 0x01)
+        {
+            if(status & 0x20)
+                return true;
+            dataport.Read();
+        }
+    }
+    return false;
+}
+
+/*
+ * SendCommand:
+ *   - 0xD4 tells the controller that the next data byte is for the mouse.
+ *   - The mouse answers every byte with 0xFA (acknowledge).
+ */
+bool MouseDriver::SendCommand(uint8_t command)
+{
+    if(!WaitForWrite())
+        return false;
+    commandport.Write(0xD4);
+    if(!WaitForWrite())
+        return false;
+    dataport.Write(command);
+    return WaitForRead() && dataport.Read() == 0xFA;
+}
+
+bool MouseDriver::SendCommand(uint8_t command, uint8_t argument)
+{
+    return SendCommand(command) && SendCommand(argument);
+}
+
+/*
+ * ReadDeviceId:
+ *   - 0xF2 = get device ID; the ID follows the acknowledgement.
+ */
+uint8_t MouseDriver::ReadDeviceId()
+{
+    if(!SendCommand(0xF2) || !WaitForRead())
+        return 0;
+    return dataport.Read();
+}
+
+/*
+ * SetSampleRate:
+ *   - 0xF3 = set sample rate; valid rates are 10, 20, 40, 60, 80, 100 and 200.
+ */
+bool MouseDriver::SetSampleRate(uint8_t rate)
+{
+    if(!SendCommand(0xF3, rate))
+        return false;
+    sampleRate = rate;
+    return true;
+}
+
+bool MouseDriver::HasWheel()
+{
+    return packetSize == 4;
+}
+
+uint8_t MouseDriver::GetSampleRate()
+{
+    return sampleRate;
+}
+
 /*
  * Activate:
- *   - Initializes mouse-related states, including 'offset' (for 3-byte packets) and 'buttons'.
+ *   - Initializes mouse-related states, including 'offset' (for the packets) and 'buttons'.
  *   - If there's a MouseEventHandler, calls OnActivate().
  *   - Sends commands to the PS/2 controller to enable the mouse:
  *       0xA8: enable auxiliary mouse device.
  *       0x20: read current controller command byte.
  *     Then modifies the command byte to enable IRQ12 and writes it back:
  *       0x60: set command byte.
- *       0xD4/0xF4: send "enable data reporting" command to the mouse itself.
- *   - Finally, an extra read is done to clear any residual input.
+ *   - An IntelliMouse only sends the scroll wheel (in a fourth byte) after the "knock"
+ *     sequence of sample rates 200, 100, 80; it then reports ID 3 instead of 0.
+ *   - Then the sample rate is set to 200 (falling back to 100 if refused), so the
+ *     pointer moves in smaller, more frequent steps.
+ *   - Finally, 0xF4 ("enable data reporting") is sent to the mouse itself.
+ *   - This all runs before interrupts are enabled, so the answers can be polled.
  */
 void MouseDriver::Activate()
 {
     offset = 0;
     buttons = 0;
+    packetSize = 3;
+    sampleRate = 0;
 
     if(handler != 0)
         handler->OnActivate();
     
     // 0xA8 = enable PS/2 mouse device
+    WaitForWrite();
     commandport.Write(0xA8);
     // 0x20 = read controller command byte
+    WaitForWrite();
     commandport.Write(0x20);
 
     // Combine the read data with bitmask to enable IRQ12 and possibly other bits
+    for(uint32_t polls = 0; polls < 100000 && !(commandport.Read() & 0x01); polls++);
     uint8_t status = dataport.Read() | 2;
 
     // 0x60 = write controller command byte
+    WaitForWrite();
     commandport.Write(0x60);
+    WaitForWrite();
     dataport.Write(status);
 
-    // 0xD4 instructs the PS/2 controller that the next byte is for the mouse
-    commandport.Write(0xD4);
-    // 0xF4 = enable data reporting from the mouse
-    dataport.Write(0xF4);
+    // Unlock the scroll wheel, then pick the sample rate
+    if(SetSampleRate(200) && SetSampleRate(100) && SetSampleRate(80) && ReadDeviceId() == 3)
+        packetSize = 4;
+    if(!SetSampleRate(200))
+        SetSampleRate(100);
 
-    // Read once more to flush any leftover data
-    dataport.Read();
+    // 0xF4 = enable data reporting from the mouse
+    SendCommand(0xF4);
 }
 
 /*
@@ -151,40 +253,64 @@ void MouseDriver::Activate()
  *   - Reads the status byte from commandport (0x64). If the 5th bit (0x20) isn't set,
  *     the data isn't from the mouse, so returns immediately.
  *   - Reads one byte of mouse data from dataport (0x60), storing it in 'buffer'.
- *   - Every 3 bytes, it interprets the packet:
- *       buffer[0] = buttons state
+ *   - The first byte of every packet has bit 3 set. If it isn't, a byte was lost and
+ *     this one belongs to the middle of a packet, so it is dropped until a byte with
+ *     bit 3 comes along. This realigns within a packet or two.
+ *   - Once a packet is complete, it is interpreted:
+ *       buffer[0] = buttons, sign bits (4, 5) and overflow bits (6, 7) of X/Y
  *       buffer[1] = X displacement
  *       buffer[2] = Y displacement
- *     The driver calls OnMouseMove if X/Y != 0, adjusting Y sign as negative.
+ *       buffer[3] = wheel displacement in the low 4 bits (IntelliMouse only)
+ *     X and Y are 9 bit values with the sign in byte 0. Packets with overflow are
+ *     ignored for movement. The driver calls OnMouseMove if X/Y != 0, adjusting Y sign
+ *     as negative, and OnMouseWheel if the wheel turned.
  *     It also detects changes in button states (left, right, middle) and
  *     calls OnMouseDown/OnMouseUp appropriately.
- *   - Returns the stack pointer unchanged.
+ *   - Leaves the stack pointer unchanged. The interrupt is claimed unless the
+ *     controller has no mouse byte waiting.
  */
-uint32_t MouseDriver::HandleInterrupt(uint32_t esp)
+bool MouseDriver::HandleInterrupt(uintptr_t& esp)
 {
     // Read status from command port to check if it's a mouse event
     uint8_t status = commandport.Read();
     if (!(status & 0x20))  // bit 5 indicates mouse data
-        return esp;
+        return false;
 
     // Read the next byte of mouse data
-    buffer[offset] = dataport.Read();
+    uint8_t data = dataport.Read();
 
     // If there's no handler, nothing to do
     if(handler == 0)
-        return esp;
+        return true;
+
+    // Resynchronize: the first byte of a packet always has bit 3 set
+    if(offset == 0 && !(data & 0x08))
+        return true;
+    buffer[offset] = data;
     
-    // Move to the next byte in the 3-byte cycle
-    offset = (offset + 1) % 3;
+    // Move to the next byte of the packet
+    offset = (offset + 1) % packetSize;
 
-    // Once we have all 3 bytes, interpret them
+    // Once we have all bytes, interpret them
     if(offset == 0)
     {
-        // If X or Y displacement is non-zero, report movement.
-        if(buffer[1] != 0 || buffer[2] != 0)
+        if(!(buffer[0] & 0xC0))
+        {
+            // 9 bit displacements: the sign is in bit 4 (X) and bit 5 (Y) of the first byte
+            int x = (int)buffer[1] - ((buffer[0] << 4) & 0x100);
+            int y = (int)buffer[2] - ((buffer[0] << 3) & 0x100);
+
+            // If X or Y displacement is non-zero, report movement (Y inverted).
+            if(x != 0 || y != 0)
+                handler->OnMouseMove(x, -y);
+        }
+
+        if(packetSize == 4)
         {
-            // buffer[1] is X move, buffer[2] is Y move (inverted)
-            handler->OnMouseMove((int8_t)buffer[1], -((int8_t)buffer[2]));
+            // Sign-extend the low 4 bits
+            int wheel = (int)(buffer[3] & 0x0F) - ((buffer[3] & 0x08) << 1);
+            if(wheel != 0)
+                handler->OnMouseWheel(wheel);
         }
 
         // Check each of the three mouse buttons (bits 0,1,2 in buffer[0])
@@ -201,9 +327,9 @@ uint32_t MouseDriver::HandleInterrupt(uint32_t esp)
                     handler->OnMouseDown(i + 1);
             }
         }
-        // Update buttons state
-        buttons = buffer[0];
+        // Update buttons state (only the button bits)
+        buttons = buffer[0] & 0x07;
     }
     
-    return esp;
+    return true;
 }
@@ -8,35 +8,95 @@
 using namespace myos::common;
 using namespace myos::drivers;
 
+
+/*
+ * ---------------------------------------------------------------------------------
+ * Color tables
+ * ---------------------------------------------------------------------------------
+ *
+ * The palette loaded in mode 13h:
+ *   - Entries 0..251 form a color cube with 6 levels of red, 7 of green and 6 of blue
+ *     (the eye distinguishes green best). Entry = red * 42 + green * 6 + blue.
+ *   - Entries 252..255 are the grays 51, 102, 153, 204, which together with black (0)
+ *     and white (251) make an even ramp of 6 grays; the cube itself has no grays
+ *     besides black and white, as its red and green levels differ.
+ *
+ * All tables are computed by the compiler, so mapping a color at runtime is just
+ * three lookups and two additions.
+ */
+static const uint8_t RedLevels = 6;
+static const uint8_t GreenLevels = 7;
+static const uint8_t BlueLevels = 6;
+static const uint8_t GrayLevels = 6;
+static const uint8_t FirstGray = RedLevels * GreenLevels * BlueLevels;
+
+struct ColorTables
+{
+    uint8_t red[256];       // Component value -> its share of the cube index
+    uint8_t green[256];
+    uint8_t blue[256];
+    uint8_t gray[256];      // Gray value -> index of the nearest gray
+    uint32_t palette[256];  // Index -> 0x00RRGGBB
+};
+
+// Value of step 'step' out of 'levels' steps spread evenly over 0..255
+static constexpr uint32_t Level(uint32_t step, uint32_t levels)
+{
+    return step * 255 / (levels - 1);
+}
+
+// Nearest step (out of 'levels') to a component value
+static constexpr uint32_t NearestStep(uint32_t value, uint32_t levels)
+{
+    return (value * (levels - 1) + 127) / 255;
+}
+
+static constexpr ColorTables MakeColorTables()
+{
+    ColorTables tables = {};
+    for(uint32_t value = 0; value < 256; value++)
+    {
+        tables.red[value]   = NearestStep(value, RedLevels) * GreenLevels * BlueLevels;
+        tables.green[value] = NearestStep(value, GreenLevels) * BlueLevels;
+        tables.blue[value]  = NearestStep(value, BlueLevels);
+
+        uint32_t step = NearestStep(value, GrayLevels);
+        tables.gray[value] = (step == 0) ? 0
+                           : (step == GrayLevels - 1) ? FirstGray - 1
+                           : FirstGray + step - 1;
+    }
+
+    for(uint32_t index = 0; index < FirstGray; index++)
+        tables.palette[index] = (Level(index / (GreenLevels * BlueLevels), RedLevels) << 16)
+                              | (Level((index / BlueLevels) % GreenLevels, GreenLevels) << 8)
+                              |  Level(index % BlueLevels, BlueLevels);
+    for(uint32_t index = FirstGray; index < 256; index++)
+        tables.palette[index] = Level(index - FirstGray + 1, GrayLevels) * 0x010101;
+
+    return tables;
+}
+
+static constexpr ColorTables colorTables = MakeColorTables();
+
 /*
  * ---------------------------------------------------------------------------------
  * VideoGraphicsArray Class
  * ---------------------------------------------------------------------------------
  *
  * This class encapsulates control of a standard VGA-compatible card. It allows us 
- * to configure the VGA card to a particular mode (e.g., 320x200x256-color mode) and 
- * provides basic drawing primitives (PutPixel, FillRectangle). It interacts with 
- * specific VGA registers via port I/O.
+ * to configure the VGA card to a particular mode (e.g., 320x200x256-color mode). The
+ * drawing primitives (PutPixel, FillRectangle, Blit, ...) come from GraphicsContext,
+ * which works directly on the framebuffer. It interacts with specific VGA registers
+ * via port I/O.
  */
 
 /*
  * Constructor:
- *   - Initializes all the port objects (misc, CRTC, sequencer, graphics controller, 
- *     attribute controller). These ports correspond to specific I/O addresses used 
- *     by the VGA hardware.
+ *   - The port objects (misc, CRTC, sequencer, graphics controller, attribute
+ *     controller, DAC) need no setup: the VGA's I/O addresses are fixed, so they
+ *     are part of the members' types (see vga.h).
  */
 VideoGraphicsArray::VideoGraphicsArray() 
-  : miscPort(0x3c2),
-    crtcIndexPort(0x3d4),
-    crtcDataPort(0x3d5),
-    sequencerIndexPort(0x3c4),
-    sequencerDataPort(0x3c5),
-    graphicsControllerIndexPort(0x3ce),
-    graphicsControllerDataPort(0x3cf),
-    attributeControllerIndexPort(0x3c0),
-    attributeControllerReadPort(0x3c1),
-    attributeControllerWritePort(0x3c0),
-    attributeControllerResetPort(0x3da)
 {
 }
 
@@ -115,6 +175,22 @@ void VideoGraphicsArray::WriteRegisters(uint8_t* registers)
     attributeControllerIndexPort.Write(0x20);
 }
 
+/*
+ * WritePalette:
+ *   - Setting the write index once is enough: the DAC advances to the next entry
+ *     after every third data byte.
+ */
+void VideoGraphicsArray::WritePalette(uint32_t* palette)
+{
+    paletteIndexPort.Write(0);
+    for(int i = 0; i < 256; i++)
+    {
+        paletteDataPort.Write((palette[i] >> 18) & 0x3F);
+        paletteDataPort.Write((palette[i] >> 10) & 0x3F);
+        paletteDataPort.Write((palette[i] >> 2) & 0x3F);
+    }
+}
+
 /*
  * SupportsMode:
  *   - Returns true if the requested resolution (width x height) and color depth 
@@ -161,6 +237,14 @@ bool VideoGraphicsArray::SetMode(uint32_t width, uint32_t height, uint32_t color
     
     // Write the register table to the VGA hardware
     WriteRegisters(g_320x200x256);
+
+    // Load the color cube, and tell the drawing code what the indices mean
+    // (used when blitting indexed surfaces to other formats, or blending)
+    palette = (uint32_t*)colorTables.palette;
+    WritePalette(palette);
+
+    // Mode 13h maps all 320*200 bytes linearly, so the drawing code can use it as plain memory
+    SetPixelBuffer(GetFrameBufferSegment(), 320, 200, 320, common::Indexed8);
     return true;
 }
 
@@ -186,57 +270,69 @@ uint8_t* VideoGraphicsArray::GetFrameBufferSegment()
 }
 
 /*
- * PutPixel (overload #1):
- *   - Writes an 8-bit color index into the VGA frame buffer at (x,y).
- *   - If x or y is out of bounds for 320x200, we simply return (no drawing).
+ * GetColorIndex:
+ *   - Grays use the gray ramp, which is finer than the cube's diagonal.
+ *   - Other colors pick the nearest level of each component in the cube;
+ *     the tables already hold each level's share of the index.
  */
-void VideoGraphicsArray::PutPixel(int32_t x, int32_t y, uint8_t colorIndex)
+uint8_t VideoGraphicsArray::GetColorIndex(uint8_t r, uint8_t g, uint8_t b)
 {
-    if(x < 0 || 320 <= x
-    || y < 0 || 200 <= y)
-        return;
+    if(r == g && g == b)
+        return colorTables.gray[r];
+    return colorTables.red[r] + colorTables.green[g] + colorTables.blue[b];
+}
 
-    // Compute the address of the pixel in the linear 320*200 buffer
-    uint8_t* pixelAddress = GetFrameBufferSegment() + 320*y + x;
-    *pixelAddress = colorIndex;
+/*
+ * MapColor:
+ *   - Drawing in mode 13h stores palette indices, so RGB colors are converted
+ *     through GetColorIndex. Fills convert their color once, not per pixel.
+ *   - Derived drivers with direct color modes get the packed RGB value.
+ */
+uint32_t VideoGraphicsArray::MapColor(uint8_t r, uint8_t g, uint8_t b)
+{
+    if(format != common::Indexed8)
+        return GraphicsContext::MapColor(r, g, b);
+    return GetColorIndex(r, g, b);
 }
 
 /*
- * GetColorIndex:
- *   - A simple color lookup that returns a VGA palette index for a given RGB triple.
- *   - This is a minimal approach for demonstration, translating a few predefined colors 
- *     to specific 8-bit palette indices. Others map to black (0x00).
+ * GetFrontBuffer / SwapBuffers:
+ *   - Mode 13h has a single buffer: whatever is drawn is visible immediately.
  */
-uint8_t VideoGraphicsArray::GetColorIndex(uint8_t r, uint8_t g, uint8_t b)
+GraphicsContext* VideoGraphicsArray::GetFrontBuffer()
+{
+    return this;
+}
+
+void VideoGraphicsArray::SwapBuffers()
 {
-    if(r == 0x00 && g == 0x00 && b == 0x00) return 0x00; // black
-    if(r == 0x00 && g == 0x00 && b == 0xA8) return 0x01; // blue
-    if(r == 0x00 && g == 0xA8 && b == 0x00) return 0x02; // green
-    if(r == 0xA8 && g == 0x00 && b == 0x00) return 0x04; // red
-    if(r == 0xFF && g == 0xFF && b == 0xFF) return 0x3F; // white
-    return 0x00; // default to black for unknown colors
 }
 
 /*
- * PutPixel (overload #2):
- *   - Draws a pixel at (x,y) in the color derived from the RGB triple (r,g,b).
- *   - Internally, we map (r,g,b) to a palette index using GetColorIndex().
+ * InVerticalRetrace:
+ *   - Port 0x3DA is Input Status #1 when read; reading it also resets the attribute
+ *     controller's flip-flop, which only matters while SetMode writes registers.
+ *   - The BGA is VGA compatible, so this works for it as well.
  */
-void VideoGraphicsArray::PutPixel(int32_t x, int32_t y,  uint8_t r, uint8_t g, uint8_t b)
+bool VideoGraphicsArray::InVerticalRetrace()
 {
-    PutPixel(x, y, GetColorIndex(r, g, b));
+    return (attributeControllerResetPort.Read() & 0x08) != 0;
 }
 
 /*
- * FillRectangle:
- *   - Fills a rectangular region at (x,y) with width 'w' and height 'h' 
- *     with a given RGB color.
- *   - Internally, calls PutPixel on each pixel in that region.
+ * WaitForVerticalRetrace:
+ *   - If a retrace is in progress, first waits for it to end, so the caller always gets
+ *     the start of a retrace (and the whole of it to work in).
+ *   - Each port read takes at least a microsecond, which bounds the wait.
  */
-void VideoGraphicsArray::FillRectangle(uint32_t x, uint32_t y, uint32_t w, uint32_t h,
-                                       uint8_t r, uint8_t g, uint8_t b)
+bool VideoGraphicsArray::WaitForVerticalRetrace()
 {
-    for(int32_t Y = y; Y < (int32_t)(y + h); Y++)
-        for(int32_t X = x; X < (int32_t)(x + w); X++)
-            PutPixel(X, Y, r, g, b);
+    uint32_t polls = 0;
+    while(InVerticalRetrace())
+        if(++polls == 0x100000)
+            return false;
+    while(!InVerticalRetrace())
+        if(++polls == 0x100000)
+            return false;
+    return true;
 }
@@ -1,4 +1,5 @@
 #include <gdt.h>
+#include <hardwarecommunication/cpu.h>
 
 /*
  * We use the myos namespace for OS-level classes, and myos::common for basic type definitions.
@@ -7,6 +8,7 @@
  */
 using namespace myos;
 using namespace myos::common;
+using namespace myos::hardwarecommunication;
 
 /*
  * ----------------------------------------------------------------------------
@@ -29,9 +31,16 @@ using namespace myos::common;
  */
 struct __attribute__((packed)) GDTR {
     uint16_t limit;  // Size of the GDT in bytes minus one
-    uint32_t base;   // Base address of the GDT
+    uintptr_t base;  // Base address of the GDT (64 bits wide in long mode)
 };
 
+#ifdef __x86_64__
+GlobalDescriptorTable::TaskStateSegment GlobalDescriptorTable::taskStateSegment;
+
+// The stack used for interrupts that arrive in ring 3 until SetKernelStack names another one.
+static uint8_t privilegeChangeStack[16384] __attribute__((aligned(16)));
+#endif
+
 /*
  * Constructor:
  *   - Initializes four segments:
@@ -40,14 +49,34 @@ struct __attribute__((packed)) GDTR {
  *       3) codeSegmentSelector: a code segment descriptor (0x9A type => present, executable, readable)
  *       4) dataSegmentSelector: a data segment descriptor (0x92 type => present, writable)
  *   - Sets each segment to have a 64MB limit. (64*1024*1024 bytes)
- *   - Loads this GDT into the CPU via the lgdt instruction.
+ *   - Adds one data segment per processor over its PerProcessorArea.
+ *   - Loads this GDT into the CPU via the lgdt instruction, and GS with the boot
+ *     processor's data segment. Per-processor counters work from then on, so the
+ *     GDT has to be the first thing kernelMain sets up.
  */
 GlobalDescriptorTable::GlobalDescriptorTable()
     : nullSegmentSelector(0, 0, 0),
       unusedSegmentSelector(0, 0, 0),
       codeSegmentSelector(0, 64 * 1024 * 1024, 0x9A),
       dataSegmentSelector(0, 64 * 1024 * 1024, 0x92)
+#ifdef __x86_64__
+      , userDataSegmentSelector(0, 64 * 1024 * 1024, 0xF2),
+      userCodeSegmentSelector(0, 64 * 1024 * 1024, 0xFA),
+      taskStateSegmentSelector((uint32_t)(uintptr_t)&taskStateSegment, sizeof(TaskStateSegment) - 1, 0x89),
+      taskStateSegmentBaseHigh((uint64_t)(uintptr_t)&taskStateSegment >> 32),
+      taskStateSegmentReserved(0)
+#endif
 {
+#ifdef __x86_64__
+    // No I/O bitmap: the offset points past the end of the TSS.
+    taskStateSegment.ioMapBase = sizeof(TaskStateSegment);
+    SetKernelStack((uintptr_t)&privilegeChangeStack[sizeof(privilegeChangeStack)]);
+#endif
+
+    for(uint32_t i = 0; i < PerProcessor::MaxProcessors; i++)
+        processorDataSegmentSelectors[i] = SegmentDescriptor((uint32_t)(uintptr_t)PerProcessor::Area(i),
+                                                             sizeof(PerProcessorArea) - 1, 0x92);
+
     // Create a GDTR structure to hold the size and base address of the GDT
     GDTR gdtr;
     
@@ -55,10 +84,17 @@ GlobalDescriptorTable::GlobalDescriptorTable()
     gdtr.limit = sizeof(GlobalDescriptorTable) - 1;
     
     // Set the base to the address of this GDT instance
-    gdtr.base = (uint32_t)this;
+    gdtr.base = (uintptr_t)this;
     
     // Load the GDTR using the LGDT instruction
     asm volatile("lgdt (%0)" : : "p" (&gdtr));
+
+#ifdef __x86_64__
+    // Load the task register; the CPU marks the TSS descriptor busy.
+    asm volatile("ltr %0" : : "r" (TaskStateSegmentSelector()));
+#endif
+
+    LoadProcessorDataSegment(0);
 }
 
 /*
@@ -90,6 +126,58 @@ uint16_t GlobalDescriptorTable::CodeSegmentSelector()
     return (uint8_t*)&codeSegmentSelector - (uint8_t*)this;
 }
 
+/*
+ * ProcessorDataSegmentSelector:
+ *   - The byte offset of processor 'index''s data segment descriptor.
+ */
+uint16_t GlobalDescriptorTable::ProcessorDataSegmentSelector(uint32_t index)
+{
+    return (uint8_t*)&processorDataSegmentSelectors[index] - (uint8_t*)this;
+}
+
+/*
+ * LoadProcessorDataSegment:
+ *   - Loads GS with the processor's data segment, so '%gs:N' is byte N of its area.
+ *   - In long mode the descriptor only supplies the low 32 bits of the base, so the
+ *     full address also goes into IA32_GS_BASE (MSR 0xC0000101). Nothing in ring 3
+ *     gets a GS of its own yet; once it does, kernel entries need SWAPGS.
+ */
+void GlobalDescriptorTable::LoadProcessorDataSegment(uint32_t index)
+{
+    PerProcessor::Initialize(index);
+    asm volatile("mov %0, %%gs" : : "r" (ProcessorDataSegmentSelector(index)) : "memory");
+#ifdef __x86_64__
+    CentralProcessingUnit::WriteModelSpecificRegister(0xC0000101, (uintptr_t)PerProcessor::Area(index));
+#endif
+}
+
+#ifdef __x86_64__
+/*
+ * UserCodeSegmentSelector / UserDataSegmentSelector:
+ *   - The byte offsets of the ring 3 descriptors, with the requested privilege level (3)
+ *     in the low two bits, as they are loaded into CS and SS.
+ */
+uint16_t GlobalDescriptorTable::UserCodeSegmentSelector()
+{
+    return ((uint8_t*)&userCodeSegmentSelector - (uint8_t*)this) | 3;
+}
+
+uint16_t GlobalDescriptorTable::UserDataSegmentSelector()
+{
+    return ((uint8_t*)&userDataSegmentSelector - (uint8_t*)this) | 3;
+}
+
+uint16_t GlobalDescriptorTable::TaskStateSegmentSelector()
+{
+    return (uint8_t*)&taskStateSegmentSelector - (uint8_t*)this;
+}
+
+void GlobalDescriptorTable::SetKernelStack(uintptr_t stackTop)
+{
+    taskStateSegment.rsp[0] = stackTop;
+}
+#endif
+
 /*
  * ----------------------------------------------------------------------------
  * GlobalDescriptorTable::SegmentDescriptor
@@ -144,6 +232,15 @@ GlobalDescriptorTable::SegmentDescriptor::SegmentDescriptor(uint32_t base, uint3
 
     // Set the access byte
     target[5] = type;
+
+#ifdef __x86_64__
+    // In long mode, code segments set the L flag (and must clear D); limit and base are
+    // ignored. System descriptors such as the TSS have neither flag.
+    if((type & 0x18) == 0x18)
+        target[6] = (target[6] & 0x8F) | 0x20;
+    else if((type & 0x10) == 0)
+        target[6] &= 0x8F;
+#endif
 }
 
 /*
@@ -0,0 +1,92 @@
+#include <gui/cursor.h>
+
+/*
+ * Namespaces:
+ *   - myos::common: integer types and graphics contexts
+ *   - myos::gui: GUI components
+ */
+using namespace myos::common;
+using namespace myos::gui;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * MouseCursor Class
+ * --------------------------------------------------------------------------
+ *
+ * A small sprite with save-under, drawn directly onto the visible buffer.
+ */
+
+/*
+ * shape:
+ *  - '#' marks the pixels of the sprite; the hot spot is the center.
+ */
+const char* MouseCursor::shape[MouseCursor::Size] =
+{
+    "...#...",
+    "...#...",
+    "...#...",
+    "#######",
+    "...#...",
+    "...#...",
+    "...#..."
+};
+
+MouseCursor::MouseCursor()
+{
+    target = 0;
+    x = 0;
+    y = 0;
+}
+
+MouseCursor::~MouseCursor()
+{
+}
+
+/*
+ * Show:
+ *  - Reads every covered pixel before writing any, so the sprite never saves
+ *    its own pixels. Pixels outside the context read as 0 and aren't written,
+ *    so the cursor can stand at the screen's edge.
+ */
+void MouseCursor::Show(GraphicsContext* gc, int32_t x, int32_t y)
+{
+    Hide();
+    target = gc;
+    this->x = x;
+    this->y = y;
+
+    int n = 0;
+    for(int32_t row = 0; row < Size; row++)
+        for(int32_t column = 0; column < Size; column++)
+            if(shape[row][column] == '#')
+                saved[n++] = gc->GetPixel(x + column - HotSpot, y + row - HotSpot);
+
+    uint32_t white = gc->MapColor(0xFF, 0xFF, 0xFF);
+    for(int32_t row = 0; row < Size; row++)
+        for(int32_t column = 0; column < Size; column++)
+            if(shape[row][column] == '#')
+                gc->PutPixel(x + column - HotSpot, y + row - HotSpot, white);
+}
+
+/*
+ * Hide:
+ *  - Visits the sprite's pixels in the same order as Show.
+ */
+void MouseCursor::Hide()
+{
+    if(target == 0)
+        return;
+
+    int n = 0;
+    for(int32_t row = 0; row < Size; row++)
+        for(int32_t column = 0; column < Size; column++)
+            if(shape[row][column] == '#')
+                target->PutPixel(x + column - HotSpot, y + row - HotSpot, saved[n++]);
+    target = 0;
+}
+
+bool MouseCursor::IsShownAt(GraphicsContext* gc, int32_t x, int32_t y)
+{
+    return target == gc && this->x == x && this->y == y;
+}
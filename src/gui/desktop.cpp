@@ -32,6 +32,7 @@ Desktop::Desktop(common::int32_t w, common::int32_t h,
 {
     MouseX = w/2;
     MouseY = h/2;
+    damage.Add(Rectangle(0, 0, w, h));
 }
 
 /*
@@ -42,26 +43,96 @@ Desktop::~Desktop()
 {
 }
 
+/*
+ * Resize:
+ *  - Adopts the new width and height; the mouse is recentered so it is guaranteed
+ *    to lie inside the new bounds.
+ *  - Nothing of the new mode's buffers has been drawn yet, so all of both is damaged.
+ */
+void Desktop::Resize(common::int32_t w, common::int32_t h)
+{
+    SetBounds(x, y, w, h);
+    MouseX = w/2;
+    MouseY = h/2;
+    Invalidate();
+    previousDamage = Region(Rectangle(0, 0, w, h));
+}
+
 /*
  * Draw:
- *  - First calls CompositeWidget::Draw to render the desktop background 
- *    and its child widgets.
- *  - Then draws a simple cross for the mouse cursor at (MouseX, MouseY), using white pixels.
- *  - The cross is 4 pixels in each direction from the center.
+ *  - First calls CompositeWidget::Draw, which composites the frame: the desktop
+ *    background is filled where no window is, and each window blits the visible
+ *    part of its cached surface, back to front. Overlapping windows are clipped
+ *    against each other, so every screen pixel is written once.
+ *  - Then shows the mouse cursor on top.
+ *  - Everything was drawn, so nothing is damaged anymore.
  */
 void Desktop::Draw(common::GraphicsContext* gc)
 {
-    // Draw the background and child widgets
+    cursor.Hide();
+    damage.Clear();
+    previousDamage = Region(Rectangle(0, 0, w, h));
     CompositeWidget::Draw(gc);
+    cursor.Show(gc, MouseX, MouseY);
+}
+
+/*
+ * Render:
+ *  - Only the damaged rectangles are painted: the clip list keeps every widget
+ *    outside them untouched, so moving a window repaints its old and new place,
+ *    and raising one repaints just the parts that come into view.
+ *  - The damage is taken over before painting, so invalidations that happen
+ *    meanwhile lead to another frame.
+ *  - The cursor must not be on 'gc' (see HideCursor), or its sprite would be
+ *    saved as background.
+ */
+bool Desktop::Render(common::GraphicsContext* gc, bool flipping)
+{
+    if(damage.IsEmpty())
+        return false;
+
+    Region clip = damage;
+    if(flipping)
+        for(int i = 0; i < previousDamage.NumRectangles(); i++)
+            clip.Add(previousDamage.GetRectangle(i));
+    clip.Intersect(Rectangle(0, 0, w, h));
+    previousDamage = damage;
+    damage.Clear();
+
+    CompositeWidget::Paint(gc, &clip, x, y);
+    return true;
+}
 
-    // Draw a mouse cursor as a cross
-    for(int i = 0; i < 4; i++)
-    {
-        gc->PutPixel(MouseX - i, MouseY,   0xFF, 0xFF, 0xFF);
-        gc->PutPixel(MouseX + i, MouseY,   0xFF, 0xFF, 0xFF);
-        gc->PutPixel(MouseX,   MouseY - i, 0xFF, 0xFF, 0xFF);
-        gc->PutPixel(MouseX,   MouseY + i, 0xFF, 0xFF, 0xFF);
-    }
+bool Desktop::IsDamaged()
+{
+    return !damage.IsEmpty();
+}
+
+/*
+ * UpdateCursor:
+ *  - Restores the pixels at the old position and draws the sprite at the new one;
+ *    the scene itself isn't touched.
+ */
+void Desktop::UpdateCursor(common::GraphicsContext* front)
+{
+    if(!cursor.IsShownAt(front, MouseX, MouseY))
+        cursor.Show(front, MouseX, MouseY);
+}
+
+void Desktop::HideCursor()
+{
+    cursor.Hide();
+}
+
+/*
+ * InvalidateRectangle:
+ *  - The desktop is the root of the widget tree, so the notice stops here.
+ *  - If the region runs out of rectangles it grows to their bounding box, which
+ *    only repaints a few pixels too many.
+ */
+void Desktop::InvalidateRectangle(const Rectangle& area)
+{
+    damage.Add(area.Intersection(Rectangle(0, 0, w, h)));
 }
             
 /*
@@ -0,0 +1,184 @@
+#include <gui/framescheduler.h>
+#include <hardwarecommunication/cpu.h>
+
+/*
+ * Namespaces:
+ *   - myos::common: integer types and graphics contexts
+ *   - myos::drivers: the VGA/BGA display
+ *   - myos::hardwarecommunication: the time stamp counter
+ *   - myos::gui: GUI components
+ */
+using namespace myos::common;
+using namespace myos::drivers;
+using namespace myos::hardwarecommunication;
+using namespace myos::gui;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * FrameScheduler Class
+ * --------------------------------------------------------------------------
+ *
+ * Renders the desktop at most once per refresh and shows frames during the
+ * vertical retrace.
+ */
+
+/*
+ * Number of refreshes timed by MeasureRefreshPeriod.
+ */
+static const uint32_t MeasuredRefreshes = 4;
+
+FrameScheduler::FrameScheduler(Desktop* desktop, VideoGraphicsArray* display, InputQueue* input)
+{
+    this->desktop = desktop;
+    this->input = input;
+    SetDisplay(display);
+}
+
+FrameScheduler::~FrameScheduler()
+{
+}
+
+/*
+ * SetDisplay:
+ *  - The first wait tells whether the display reports retraces at all; without
+ *    them RunFrame falls back to drawing unpaced.
+ *  - The old display's back buffer doesn't matter anymore, so nothing is pending.
+ */
+void FrameScheduler::SetDisplay(VideoGraphicsArray* display)
+{
+    this->display = display;
+    framePending = false;
+    refreshes = 0;
+    framesPresented = 0;
+    framesMissed = 0;
+    refreshPeriod = 0;
+    lastRetrace = 0;
+    refreshRate = 0;
+
+    retraceAvailable = display->WaitForVerticalRetrace();
+    if(retraceAvailable)
+        MeasureRefreshPeriod();
+}
+
+/*
+ * MeasureRefreshPeriod:
+ *  - Only the low half of the TSC is used: it wraps after a second or more, much
+ *    longer than a refresh, and avoids 64 bit divisions.
+ *  - The rate is ticks per second over ticks per refresh; both are divided by 1000
+ *    first to stay within 32 bits.
+ */
+void FrameScheduler::MeasureRefreshPeriod()
+{
+    if(!CentralProcessingUnit::HasTimeStampCounter())
+        return;
+
+    if(!display->WaitForVerticalRetrace())
+    {
+        retraceAvailable = false;
+        return;
+    }
+    uint32_t start = (uint32_t)CentralProcessingUnit::ReadTimeStampCounter();
+    for(uint32_t i = 0; i < MeasuredRefreshes; i++)
+        if(!display->WaitForVerticalRetrace())
+        {
+            retraceAvailable = false;
+            return;
+        }
+    uint32_t end = (uint32_t)CentralProcessingUnit::ReadTimeStampCounter();
+
+    refreshPeriod = (end - start) / MeasuredRefreshes;
+
+    uint32_t mhz = CentralProcessingUnit::TimeStampCounterMHz();
+    if(refreshPeriod >= 1000)
+        refreshRate = (mhz * 1000 + refreshPeriod / 2000) / (refreshPeriod / 1000);
+
+    // Calibrating the TSC took a while, so start counting at a fresh retrace
+    display->WaitForVerticalRetrace();
+    lastRetrace = (uint32_t)CentralProcessingUnit::ReadTimeStampCounter();
+}
+
+/*
+ * RunFrame:
+ *  - The time since the previous retrace is rounded to whole refreshes. More than
+ *    one means the last frame took too long and the retraces in between were missed.
+ *  - Input is dispatched next; it may move the mouse or invalidate the desktop.
+ *  - With two buffers, the pending frame and the cursor are shown first, while the
+ *    retrace lasts; the next frame is rendered afterwards, while the screen is
+ *    scanned out from the other buffer.
+ *  - With a single buffer (plain VGA), rendering goes straight to the screen, so it
+ *    is done right away during the retrace, followed by the cursor.
+ *  - Without retraces the loop behaves like before: render and show right away.
+ *  - Frames only repaint what was damaged, so they don't cover the cursor's sprite;
+ *    it is taken off a buffer before rendering into it or swapping it away.
+ */
+void FrameScheduler::RunFrame()
+{
+    if(retraceAvailable && !display->WaitForVerticalRetrace())
+        retraceAvailable = false;
+
+    if(retraceAvailable)
+    {
+        uint32_t elapsedRefreshes = 1;
+        if(refreshPeriod != 0)
+        {
+            uint32_t now = (uint32_t)CentralProcessingUnit::ReadTimeStampCounter();
+            elapsedRefreshes = (now - lastRetrace + refreshPeriod / 2) / refreshPeriod;
+            if(elapsedRefreshes == 0)
+                elapsedRefreshes = 1;
+            lastRetrace = now;
+        }
+        refreshes += elapsedRefreshes;
+        framesMissed += elapsedRefreshes - 1;
+    }
+
+    if(input != 0)
+        input->Dispatch();
+
+    GraphicsContext* front = display->GetFrontBuffer();
+    bool flipping = (front != display);
+    if(!retraceAvailable || !flipping)
+    {
+        if(desktop->IsDamaged())
+        {
+            desktop->HideCursor();
+            desktop->Render(display, flipping);
+            display->SwapBuffers();
+            framesPresented++;
+        }
+        desktop->UpdateCursor(display->GetFrontBuffer());
+        return;
+    }
+
+    if(framePending)
+    {
+        desktop->HideCursor();
+        display->SwapBuffers();
+        framePending = false;
+        framesPresented++;
+    }
+    desktop->UpdateCursor(display->GetFrontBuffer());
+
+    if(desktop->Render(display, true))
+        framePending = true;
+}
+
+uint32_t FrameScheduler::GetRefreshCount()
+{
+    return refreshes;
+}
+
+uint32_t FrameScheduler::GetPresentedFrameCount()
+{
+    return framesPresented;
+}
+
+uint32_t FrameScheduler::GetMissedFrameCount()
+{
+    return framesMissed;
+}
+
+uint32_t FrameScheduler::GetRefreshRate()
+{
+    return refreshRate;
+}
@@ -0,0 +1,79 @@
+#include <gui/label.h>
+
+/*
+ * Namespaces:
+ *   - myos::common: integer types, graphics contexts and the glyph cache
+ *   - myos::gui: the widget classes
+ */
+using namespace myos::common;
+using namespace myos::gui;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * Label Class
+ * --------------------------------------------------------------------------
+ *
+ * A single line of static text.
+ */
+
+/*
+ * Constructor:
+ *  - Labels only display text, so they don't take the keyboard focus.
+ */
+Label::Label(Widget* parent, int32_t x, int32_t y, int32_t w, int32_t h,
+             char* text,
+             uint8_t textR, uint8_t textG, uint8_t textB,
+             uint8_t r, uint8_t g, uint8_t b)
+: Widget(parent, x, y, w, h, r, g, b)
+{
+    this->text = text;
+    this->textR = textR;
+    this->textG = textG;
+    this->textB = textB;
+    Focussable = false;
+}
+
+Label::~Label()
+{
+}
+
+/*
+ * SetText:
+ *  - The window holding the label has to render its contents again.
+ */
+void Label::SetText(char* text)
+{
+    this->text = text;
+    Invalidate();
+}
+
+/*
+ * Paint:
+ *  - Only whole characters that fit into the label are drawn.
+ *  - The background is filled around the text only, as the glyph cells
+ *    already contain their background.
+ */
+void Label::Paint(GraphicsContext* gc, Region* clip, int32_t X, int32_t Y)
+{
+    GlyphCache* cache = GlyphCache::activeGlyphCache;
+    if(cache == 0 || text == 0)
+    {
+        Widget::Paint(gc, clip, X, Y);
+        return;
+    }
+
+    Font* font = cache->GetFont();
+    int32_t length = 0;
+    while(text[length] != '\0' && (length + 1) * font->GetWidth() <= w)
+        length++;
+    if(font->GetHeight() > h)
+        length = 0;
+
+    Region background = *clip;
+    background.Subtract(Rectangle(X, Y, length * font->GetWidth(), font->GetHeight()));
+    Widget::Paint(gc, &background, X, Y);
+
+    cache->DrawText(gc, clip, X, Y, text, length,
+                    gc->MapColor(textR, textG, textB), gc->MapColor(r, g, b));
+}
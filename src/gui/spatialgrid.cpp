@@ -0,0 +1,163 @@
+#include <gui/spatialgrid.h>
+#include <memorymanagement.h>
+
+/*
+ * Namespaces:
+ *   - myos::common: integer types and rectangles
+ *   - myos::gui: GUI components
+ */
+using namespace myos;
+using namespace myos::common;
+using namespace myos::gui;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * SpatialGrid Class
+ * --------------------------------------------------------------------------
+ *
+ * Cells with unordered lists of children, for hit-testing.
+ */
+
+/*
+ * Constructor:
+ *  - All cells start empty; nothing is allocated until a child is inserted.
+ */
+SpatialGrid::SpatialGrid()
+{
+    for(int i = 0; i < Rows * Columns; i++)
+    {
+        cells[i].entries = 0;
+        cells[i].count = 0;
+        cells[i].capacity = 0;
+    }
+    cellWidth = 1;
+    cellHeight = 1;
+    valid = true;
+}
+
+/*
+ * Destructor:
+ *  - Frees the cell lists.
+ */
+SpatialGrid::~SpatialGrid()
+{
+    for(int i = 0; i < Rows * Columns; i++)
+        if(cells[i].entries != 0)
+            MemoryManager::activeMemoryManager->free(cells[i].entries);
+}
+
+/*
+ * Reset:
+ *  - The lists keep their memory; only their counts are cleared.
+ */
+void SpatialGrid::Reset(int32_t width, int32_t height)
+{
+    for(int i = 0; i < Rows * Columns; i++)
+        cells[i].count = 0;
+    cellWidth = (width + Columns - 1) / Columns;
+    cellHeight = (height + Rows - 1) / Rows;
+    if(cellWidth < 1)
+        cellWidth = 1;
+    if(cellHeight < 1)
+        cellHeight = 1;
+    valid = true;
+}
+
+bool SpatialGrid::IsValid()
+{
+    return valid;
+}
+
+int32_t SpatialGrid::ColumnOf(int32_t x)
+{
+    if(x < 0)
+        return 0;
+    int32_t column = x / cellWidth;
+    return (column < Columns) ? column : Columns - 1;
+}
+
+int32_t SpatialGrid::RowOf(int32_t y)
+{
+    if(y < 0)
+        return 0;
+    int32_t row = y / cellHeight;
+    return (row < Rows) ? row : Rows - 1;
+}
+
+/*
+ * InsertIntoCell:
+ *  - Grows the list by doubling when it is full.
+ */
+bool SpatialGrid::InsertIntoCell(Cell* cell, Widget* child)
+{
+    if(cell->count == cell->capacity)
+    {
+        if(MemoryManager::activeMemoryManager == 0)
+            return false;
+        int32_t capacity = (cell->capacity == 0) ? 8 : cell->capacity * 2;
+        Widget** entries = (Widget**)MemoryManager::activeMemoryManager->malloc(capacity * sizeof(Widget*));
+        if(entries == 0)
+            return false;
+        for(int32_t i = 0; i < cell->count; i++)
+            entries[i] = cell->entries[i];
+        if(cell->entries != 0)
+            MemoryManager::activeMemoryManager->free(cell->entries);
+        cell->entries = entries;
+        cell->capacity = capacity;
+    }
+
+    cell->entries[cell->count++] = child;
+    return true;
+}
+
+/*
+ * Insert:
+ *  - Empty rectangles can't be hit, so they aren't stored at all.
+ */
+void SpatialGrid::Insert(Widget* child, const Rectangle& bounds)
+{
+    if(bounds.IsEmpty() || !valid)
+        return;
+
+    int32_t lastColumn = ColumnOf(bounds.x + bounds.w - 1);
+    int32_t lastRow = RowOf(bounds.y + bounds.h - 1);
+    for(int32_t row = RowOf(bounds.y); row <= lastRow; row++)
+        for(int32_t column = ColumnOf(bounds.x); column <= lastColumn; column++)
+            if(!InsertIntoCell(&cells[row * Columns + column], child))
+            {
+                valid = false;
+                return;
+            }
+}
+
+/*
+ * Remove:
+ *  - The order doesn't matter, so the last entry fills the gap.
+ */
+void SpatialGrid::Remove(Widget* child, const Rectangle& bounds)
+{
+    if(bounds.IsEmpty())
+        return;
+
+    int32_t lastColumn = ColumnOf(bounds.x + bounds.w - 1);
+    int32_t lastRow = RowOf(bounds.y + bounds.h - 1);
+    for(int32_t row = RowOf(bounds.y); row <= lastRow; row++)
+        for(int32_t column = ColumnOf(bounds.x); column <= lastColumn; column++)
+        {
+            Cell* cell = &cells[row * Columns + column];
+            for(int32_t i = 0; i < cell->count; i++)
+                if(cell->entries[i] == child)
+                {
+                    cell->entries[i] = cell->entries[--cell->count];
+                    break;
+                }
+        }
+}
+
+int32_t SpatialGrid::Query(int32_t x, int32_t y, Widget* const** entries)
+{
+    Cell* cell = &cells[RowOf(y) * Columns + ColumnOf(x)];
+    *entries = cell->entries;
+    return cell->count;
+}
@@ -0,0 +1,192 @@
+#include <gui/textbox.h>
+
+/*
+ * Namespaces:
+ *   - myos::common: integer types, graphics contexts and the glyph cache
+ *   - myos::gui: the widget classes
+ */
+using namespace myos::common;
+using namespace myos::gui;
+
+
+/*
+ * --------------------------------------------------------------------------
+ * TextBox Class
+ * --------------------------------------------------------------------------
+ *
+ * A terminal-like grid of characters, e.g. for a console in a window.
+ */
+
+/*
+ * Constructor:
+ *  - The grid size follows from the font of the active glyph cache. Without a
+ *    cache, 8x16 cells are assumed (nothing is drawn anyway).
+ */
+TextBox::TextBox(Widget* parent, int32_t x, int32_t y, int32_t w, int32_t h,
+                 uint8_t textR, uint8_t textG, uint8_t textB,
+                 uint8_t r, uint8_t g, uint8_t b)
+: Widget(parent, x, y, w, h, r, g, b)
+{
+    this->textR = textR;
+    this->textG = textG;
+    this->textB = textB;
+    editable = true;
+
+    int32_t glyphWidth = 8;
+    int32_t glyphHeight = 16;
+    if(GlyphCache::activeGlyphCache != 0)
+    {
+        glyphWidth = GlyphCache::activeGlyphCache->GetFont()->GetWidth();
+        glyphHeight = GlyphCache::activeGlyphCache->GetFont()->GetHeight();
+    }
+    columns = w / glyphWidth;
+    rows = h / glyphHeight;
+    if(columns > MaxColumns) columns = MaxColumns;
+    if(rows > MaxRows) rows = MaxRows;
+
+    Clear();
+}
+
+TextBox::~TextBox()
+{
+}
+
+/*
+ * Clear:
+ *  - Fills all cells with spaces.
+ */
+void TextBox::Clear()
+{
+    for(int32_t row = 0; row < MaxRows; row++)
+        for(int32_t column = 0; column < MaxColumns; column++)
+            cells[row][column] = ' ';
+    cursorColumn = 0;
+    cursorRow = 0;
+    Invalidate();
+}
+
+void TextBox::SetEditable(bool editable)
+{
+    this->editable = editable;
+}
+
+/*
+ * Scroll:
+ *  - Copies every line onto the one above it and blanks the last line.
+ */
+void TextBox::Scroll()
+{
+    for(int32_t row = 1; row < rows; row++)
+        for(int32_t column = 0; column < columns; column++)
+            cells[row - 1][column] = cells[row][column];
+    for(int32_t column = 0; column < columns; column++)
+        cells[rows - 1][column] = ' ';
+}
+
+/*
+ * PutCharacter:
+ *  - '\n' moves to the start of the next line, '\b' steps back (also into the
+ *    previous line) and blanks that cell.
+ *  - Writing past the last column wraps; moving past the last row scrolls.
+ */
+void TextBox::PutCharacter(char c)
+{
+    if(columns <= 0 || rows <= 0)
+        return;
+
+    switch(c)
+    {
+        case '\n':
+            cursorColumn = 0;
+            cursorRow++;
+            break;
+
+        case '\b':
+            if(cursorColumn > 0)
+                cursorColumn--;
+            else if(cursorRow > 0)
+            {
+                cursorRow--;
+                cursorColumn = columns - 1;
+            }
+            cells[cursorRow][cursorColumn] = ' ';
+            break;
+
+        default:
+            cells[cursorRow][cursorColumn] = c;
+            if(++cursorColumn >= columns)
+            {
+                cursorColumn = 0;
+                cursorRow++;
+            }
+            break;
+    }
+
+    if(cursorRow >= rows)
+    {
+        Scroll();
+        cursorRow = rows - 1;
+    }
+}
+
+/*
+ * Write:
+ *  - Invalidates once for the whole string.
+ */
+void TextBox::Write(char* str)
+{
+    for(int i = 0; str[i] != '\0'; i++)
+        PutCharacter(str[i]);
+    Invalidate();
+}
+
+/*
+ * OnKeyDown:
+ *  - Typed characters are written like any other text.
+ */
+void TextBox::OnKeyDown(char c)
+{
+    if(!editable)
+        return;
+    PutCharacter(c);
+    Invalidate();
+}
+
+/*
+ * Paint:
+ *  - Each line is one DrawText call, so the glyph cache can copy the whole line
+ *    row by row. The strip right of and below the grid gets the background.
+ *  - The cursor is a two pixel underline in the text color, clipped like the rest.
+ */
+void TextBox::Paint(GraphicsContext* gc, Region* clip, int32_t X, int32_t Y)
+{
+    GlyphCache* cache = GlyphCache::activeGlyphCache;
+    if(cache == 0)
+    {
+        Widget::Paint(gc, clip, X, Y);
+        return;
+    }
+
+    Font* font = cache->GetFont();
+    int32_t glyphWidth = font->GetWidth();
+    int32_t glyphHeight = font->GetHeight();
+
+    Region background = *clip;
+    background.Subtract(Rectangle(X, Y, columns * glyphWidth, rows * glyphHeight));
+    if(!background.IsEmpty())
+        Widget::Paint(gc, &background, X, Y);
+
+    uint32_t foreground = gc->MapColor(textR, textG, textB);
+    uint32_t backgroundColor = gc->MapColor(r, g, b);
+    for(int32_t row = 0; row < rows; row++)
+        cache->DrawText(gc, clip, X, Y + row * glyphHeight, cells[row], columns,
+                        foreground, backgroundColor);
+
+    Rectangle cursor(X + cursorColumn * glyphWidth, Y + (cursorRow + 1) * glyphHeight - 2, glyphWidth, 2);
+    for(int i = 0; i < clip->NumRectangles(); i++)
+    {
+        Rectangle part = cursor.Intersection(clip->GetRectangle(i));
+        if(!part.IsEmpty())
+            gc->FillRectangle(part.x, part.y, part.w, part.h, foreground);
+    }
+}
@@ -1,10 +1,12 @@
 #include <gui/widget.h>
+#include <memorymanagement.h>
 
 /*
  * The namespaces:
  *   - myos::common: contains integer types and other common definitions
  *   - myos::gui: contains GUI-related classes (Widget, CompositeWidget, etc.)
  */
+using namespace myos;
 using namespace myos::common;
 using namespace myos::gui;
 
@@ -43,6 +45,10 @@ Widget::Widget(Widget* parent, int32_t x, int32_t y, int32_t w, int32_t h,
     this->g = g;
     this->b = b;
     this->Focussable = true;
+    this->visible = true;
+    this->above = 0;
+    this->below = 0;
+    this->zOrder = 0;
 }
 
 /*
@@ -79,18 +85,135 @@ void Widget::ModelToScreen(int32_t &x, int32_t &y)
     y += this->y;
 }
 
+/*
+ * GetBounds:
+ *  - Returns (x, y, w, h) as a Rectangle in the parent's coordinate space.
+ */
+Rectangle Widget::GetBounds()
+{
+    return Rectangle(x, y, w, h);
+}
+
+/*
+ * SetBounds:
+ *  - The parent updates its grid first and then repaints the rectangles the widget
+ *    covered before and covers now; the rest of the parent stays as it is.
+ */
+void Widget::SetBounds(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    Rectangle oldBounds = GetBounds();
+    this->x = x;
+    this->y = y;
+    this->w = w;
+    this->h = h;
+    if(parent != 0)
+    {
+        parent->ChildBoundsChanged(this, oldBounds);
+        if(visible)
+        {
+            parent->InvalidateRectangle(oldBounds);
+            parent->InvalidateRectangle(GetBounds());
+        }
+    }
+}
+
+void Widget::ChildBoundsChanged(Widget* child, const Rectangle& oldBounds)
+{
+}
+
+/*
+ * Hide / Show:
+ *  - The parent is told first (so it can drop the focus), then the uncovered or
+ *    newly covered rectangle is repainted.
+ */
+void Widget::Hide()
+{
+    if(!visible)
+        return;
+    visible = false;
+    if(parent != 0)
+    {
+        parent->ChildVisibilityChanged(this);
+        parent->InvalidateRectangle(GetBounds());
+    }
+}
+
+void Widget::Show()
+{
+    if(visible)
+        return;
+    visible = true;
+    if(parent != 0)
+    {
+        parent->ChildVisibilityChanged(this);
+        parent->InvalidateRectangle(GetBounds());
+    }
+}
+
+bool Widget::IsVisible()
+{
+    return visible;
+}
+
+void Widget::ChildVisibilityChanged(Widget* child)
+{
+}
+
 /*
  * Draw:
- *  - Draws this widget by filling its rectangle with its (r, g, b) color.
+ *  - Draws the whole widget.
  *  - The coordinates are converted to absolute screen coordinates by calling ModelToScreen.
- *  - A GraphicsContext (gc) provides the drawing functions (FillRectangle, PutPixel, etc.).
+ *  - The widget's own rectangle becomes the clip list for Paint.
  */
 void Widget::Draw(GraphicsContext* gc)
 {
     int X = 0;
     int Y = 0;
     ModelToScreen(X, Y);
-    gc->FillRectangle(X, Y, w, h, r, g, b);
+
+    Region clip(Rectangle(X, Y, w, h));
+    Paint(gc, &clip, X, Y);
+}
+
+/*
+ * Paint:
+ *  - Fills every rectangle of the clip list with the widget's (r, g, b) color.
+ *  - A GraphicsContext (gc) provides the drawing functions (FillRectangle, PutPixel, etc.).
+ */
+void Widget::Paint(GraphicsContext* gc, Region* clip, int32_t X, int32_t Y)
+{
+    for(int i = 0; i < clip->NumRectangles(); i++)
+    {
+        const Rectangle& rect = clip->GetRectangle(i);
+        gc->FillRectangle(rect.x, rect.y, rect.w, rect.h, r, g, b);
+    }
+}
+
+/*
+ * Invalidate:
+ *  - The whole widget changed.
+ */
+void Widget::Invalidate()
+{
+    InvalidateRectangle(Rectangle(0, 0, w, h));
+}
+
+/*
+ * InvalidateRectangle:
+ *  - A plain widget keeps no cached pixels, so only its parent needs to know.
+ *  - The area is clipped to the widget and moved into the parent's coordinates.
+ */
+void Widget::InvalidateRectangle(const Rectangle& area)
+{
+    if(parent == 0 || !visible)
+        return;
+
+    Rectangle changed = area.Intersection(Rectangle(0, 0, w, h));
+    if(changed.IsEmpty())
+        return;
+    changed.x += x;
+    changed.y += y;
+    parent->InvalidateRectangle(changed);
 }
 
 /*
@@ -147,7 +270,8 @@ void Widget::OnMouseMove(int32_t oldx, int32_t oldy, int32_t newx, int32_t newy)
 /*
  * Constructor:
  *   - Forwards arguments to the base Widget constructor.
- *   - Initializes no focussedChild and zero children.
+ *   - Initializes no focussedChild and an empty z-order list.
+ *   - Lays the grid out over the widget's area.
  */
 CompositeWidget::CompositeWidget(Widget* parent,
                                  int32_t x, int32_t y, 
@@ -156,13 +280,18 @@ CompositeWidget::CompositeWidget(Widget* parent,
 : Widget(parent, x, y, w, h, r, g, b)
 {
     focussedChild = 0;
+    topChild = 0;
+    bottomChild = 0;
     numChildren = 0;
+    nextTopOrder = 0;
+    nextBottomOrder = -1;
+    grid.Reset(w, h);
 }
 
 /*
  * Destructor: 
- *  - Here, if the widget owned children that were dynamically allocated, 
- *    we might free them. Currently empty.
+ *  - Nothing to free: the list lives in the children, which are owned by whoever
+ *    created them (in the kernel they live on the stack).
  */
 CompositeWidget::~CompositeWidget()
 {
@@ -171,104 +300,288 @@ CompositeWidget::~CompositeWidget()
 /*
  * GetFocus:
  *  - Called when a child widget (or this widget itself) needs focus.
- *  - The composite widget stores 'widget' as the new focussedChild.
- *  - Passes focus up to the parent as well, so the parent can track which child subtree has focus.
+ *  - The composite widget stores 'widget' as the new focussedChild and, if it is one
+ *    of its own children, raises it. Focus requests from deeper down arrive with the
+ *    grandchild, which this widget doesn't stack.
+ *  - A request for the widget itself (a click on its background) keeps the focussed
+ *    child, since forwarding keys to itself would never end.
+ *  - Passes focus up to the parent as well, so the parent can track which child subtree
+ *    has focus (and raises this widget in turn).
  */
 void CompositeWidget::GetFocus(Widget* widget)
 {
-    this->focussedChild = widget;
+    if(widget != this)
+        this->focussedChild = widget;
+    if(widget->parent == this)
+        Raise(widget);
     if(parent != 0)
         parent->GetFocus(this);
 }
 
 /*
  * AddChild:
- *  - Adds a new child to the 'children' array, up to 100 children.
- *  - Returns false if there's no space left, otherwise true.
+ *  - Links the child in at the bottom of the list, below the existing children.
+ *  - Returns true; the list needs no memory of its own. (If the grid can't grow,
+ *    hit-testing falls back to walking the list.)
+ *  - Invalidates the child's area, since the child now shows on top of this widget.
  */
 bool CompositeWidget::AddChild(Widget* child)
 {
-    if(numChildren >= 100)
-        return false;
-    children[numChildren++] = child;
+    if(nextBottomOrder == -0x7FFFFFFF - 1)
+        RenumberChildren();
+
+    child->above = bottomChild;
+    child->below = 0;
+    if(bottomChild != 0)
+        bottomChild->below = child;
+    else
+        topChild = child;
+    bottomChild = child;
+    child->zOrder = nextBottomOrder--;
+    numChildren++;
+
+    grid.Insert(child, child->GetBounds());
+    if(child->visible)
+        InvalidateRectangle(child->GetBounds());
     return true;
 }
 
 /*
- * Draw:
- *  - First draws itself (background, etc.) via Widget::Draw.
- *  - Then iterates through the children in reverse order, drawing each child on top.
- *  - The reverse order ensures the first child in the array is drawn last (potentially 
- *    ensuring it’s "on top" if overlapping).
+ * Raise:
+ *  - The parts of the child that become visible are where it overlaps the visible
+ *    siblings above it; they are collected before relinking and invalidated afterwards.
+ *    Everything else on the screen looks the same as before.
+ *  - Unlinking and linking at the top touch only the neighbours, and the new stamp
+ *    makes the grid see the child as topmost without changing any cell.
  */
-void CompositeWidget::Draw(GraphicsContext* gc)
+void CompositeWidget::Raise(Widget* child)
 {
-    Widget::Draw(gc);
-    for(int i = numChildren - 1; i >= 0; --i)
-        children[i]->Draw(gc);
+    if(child == topChild)
+        return;
+
+    Rectangle bounds = child->GetBounds();
+    Region exposed;
+    for(Widget* sibling = child->above; sibling != 0; sibling = sibling->above)
+        if(sibling->visible)
+            exposed.Add(bounds.Intersection(sibling->GetBounds()));
+
+    // Unlink (the child isn't the top one, so 'above' is set)
+    child->above->below = child->below;
+    if(child->below != 0)
+        child->below->above = child->above;
+    else
+        bottomChild = child->above;
+
+    // Link in at the top
+    child->above = 0;
+    child->below = topChild;
+    topChild->above = child;
+    topChild = child;
+
+    if(nextTopOrder == 0x7FFFFFFF)
+        RenumberChildren();
+    child->zOrder = nextTopOrder++;
+
+    if(child->visible)
+        for(int i = 0; i < exposed.NumRectangles(); i++)
+            InvalidateRectangle(exposed.GetRectangle(i));
+}
+
+/*
+ * RenumberChildren:
+ *  - Only needed after billions of raises; keeps the stamps in list order.
+ */
+void CompositeWidget::RenumberChildren()
+{
+    int32_t order = 0;
+    for(Widget* child = bottomChild; child != 0; child = child->above)
+        child->zOrder = order++;
+    nextTopOrder = order;
+    nextBottomOrder = -1;
+}
+
+/*
+ * ChildVisibilityChanged:
+ *  - Keys typed after minimising a window shouldn't end up in it.
+ */
+void CompositeWidget::ChildVisibilityChanged(Widget* child)
+{
+    if(!child->visible && focussedChild == child)
+        focussedChild = 0;
+}
+
+/*
+ * SetBounds:
+ *  - The grid covers this widget's own area, so only a change of size matters.
+ */
+void CompositeWidget::SetBounds(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    bool resized = (w != this->w || h != this->h);
+    Widget::SetBounds(x, y, w, h);
+    if(resized)
+        RebuildGrid();
+}
+
+/*
+ * ChildBoundsChanged:
+ *  - The grid identifies children by pointer, so no lookup is needed.
+ */
+void CompositeWidget::ChildBoundsChanged(Widget* child, const Rectangle& oldBounds)
+{
+    grid.Remove(child, oldBounds);
+    grid.Insert(child, child->GetBounds());
+}
+
+/*
+ * RebuildGrid:
+ *  - Also the way back after the grid ran out of memory.
+ */
+void CompositeWidget::RebuildGrid()
+{
+    grid.Reset(w, h);
+    for(Widget* child = topChild; child != 0; child = child->below)
+        grid.Insert(child, child->GetBounds());
+}
+
+/*
+ * FindChildAt:
+ *  - The cell's candidates are unordered, so the one with the highest stamp among
+ *    those that really contain the point is the topmost one there. Hidden children
+ *    stay in the grid and are skipped here.
+ *  - If the grid is invalid, it is rebuilt once; if that fails too, the list is
+ *    walked from the top, like before.
+ */
+Widget* CompositeWidget::FindChildAt(int32_t x, int32_t y)
+{
+    if(!grid.IsValid())
+        RebuildGrid();
+
+    if(grid.IsValid())
+    {
+        Widget* const* candidates;
+        int32_t count = grid.Query(x, y, &candidates);
+        Widget* found = 0;
+        for(int32_t i = 0; i < count; ++i)
+        {
+            Widget* child = candidates[i];
+            if(child->visible && (found == 0 || child->zOrder > found->zOrder)
+               && child->ContainsCoordinate(x, y))
+                found = child;
+        }
+        return found;
+    }
+
+    for(Widget* child = topChild; child != 0; child = child->below)
+        if(child->visible && child->ContainsCoordinate(x, y))
+            return child;
+    return 0;
+}
+
+/*
+ * Paint:
+ *  - The list runs from the topmost child (which also gets mouse events first) down.
+ *  - The background is painted only where 'clip' isn't covered by any visible child.
+ *  - Each child gets 'clip' restricted to its own rectangle, minus the rectangles of
+ *    the visible children above it. Fully hidden children aren't painted at all.
+ *  - Painting still goes back to front (background first, then from the bottom child
+ *    up), so if a Region runs out of capacity and stays too large, the widgets above
+ *    simply paint over the extra pixels.
+ */
+void CompositeWidget::Paint(GraphicsContext* gc, Region* clip, int32_t X, int32_t Y)
+{
+    Region background = *clip;
+    for(Widget* child = topChild; child != 0 && !background.IsEmpty(); child = child->below)
+    {
+        if(!child->visible)
+            continue;
+        Rectangle bounds = child->GetBounds();
+        background.Subtract(Rectangle(X + bounds.x, Y + bounds.y, bounds.w, bounds.h));
+    }
+    if(!background.IsEmpty())
+        Widget::Paint(gc, &background, X, Y);
+
+    for(Widget* child = bottomChild; child != 0; child = child->above)
+    {
+        if(!child->visible)
+            continue;
+        Rectangle bounds = child->GetBounds();
+        bounds.x += X;
+        bounds.y += Y;
+
+        Region visible = *clip;
+        visible.Intersect(bounds);
+        for(Widget* sibling = child->above; sibling != 0 && !visible.IsEmpty(); sibling = sibling->above)
+        {
+            if(!sibling->visible)
+                continue;
+            Rectangle above = sibling->GetBounds();
+            visible.Subtract(Rectangle(X + above.x, Y + above.y, above.w, above.h));
+        }
+
+        if(!visible.IsEmpty())
+            child->Paint(gc, &visible, bounds.x, bounds.y);
+    }
 }
 
 /*
  * OnMouseDown:
  *  - Called when a mouse button is pressed, with coordinates (x, y) relative to the parent.
- *  - We check each child in order. The first child that contains (x - this->x, y - this->y) 
- *    gets the OnMouseDown event. We break after dispatching to one child.
+ *  - The topmost child that contains (x - this->x, y - this->y) gets the OnMouseDown event.
+ *  - A click on the background focusses (and so raises) this widget itself.
  */
 void CompositeWidget::OnMouseDown(int32_t x, int32_t y, uint8_t button)
 {
-    for(int i = 0; i < numChildren; ++i)
-        if(children[i]->ContainsCoordinate(x - this->x, y - this->y))
-        {
-            children[i]->OnMouseDown(x - this->x, y - this->y, button);
-            break;
-        }
+    Widget* child = FindChildAt(x - this->x, y - this->y);
+    if(child != 0)
+        child->OnMouseDown(x - this->x, y - this->y, button);
+    else if(Focussable)
+        GetFocus(this);
 }
 
 /*
  * OnMouseUp:
- *  - Similar to OnMouseDown, passes the event to the first child containing the coordinate.
+ *  - Similar to OnMouseDown, passes the event to the topmost child containing the coordinate.
  */
 void CompositeWidget::OnMouseUp(int32_t x, int32_t y, uint8_t button)
 {
-    for(int i = 0; i < numChildren; ++i)
-        if(children[i]->ContainsCoordinate(x - this->x, y - this->y))
-        {
-            children[i]->OnMouseUp(x - this->x, y - this->y, button);
-            break;
-        }
+    Widget* child = FindChildAt(x - this->x, y - this->y);
+    if(child != 0)
+        child->OnMouseUp(x - this->x, y - this->y, button);
 }
 
 /*
  * OnMouseMove:
- *  - We check which child (if any) contained the old mouse coordinates, 
- *    and pass the movement to it. Then we check if a different child (or the same) 
- *    contains the new coordinates, passing it the movement if needed.
+ *  - We look up which child (if any) contained the old mouse coordinates and which
+ *    contains the new ones. Both are found before any event is passed on, because a
+ *    dragged window moves (and changes the grid) while handling it.
+ *  - The child under the old position gets the movement, and so does the child
+ *    under the new position if it is a different one.
  *  - This allows widgets to handle cases like mouse entering or leaving them.
  */
 void CompositeWidget::OnMouseMove(int32_t oldx, int32_t oldy, int32_t newx, int32_t newy)
 {
-    int firstchild = -1;
-    
-    // Find child under the old mouse position
-    for(int i = 0; i < numChildren; ++i)
-        if(children[i]->ContainsCoordinate(oldx - this->x, oldy - this->y))
-        {
-            children[i]->OnMouseMove(oldx - this->x, oldy - this->y, 
-                                     newx - this->x, newy - this->y);
-            firstchild = i;
-            break;
-        }
+    Widget* firstchild = FindChildAt(oldx - this->x, oldy - this->y);
+    Widget* secondchild = FindChildAt(newx - this->x, newy - this->y);
 
-    // Find child under the new mouse position
-    for(int i = 0; i < numChildren; ++i)
-        if(children[i]->ContainsCoordinate(newx - this->x, newy - this->y))
-        {
-            // If it's a different child than before, pass the event too 
-            if(firstchild != i)
-                children[i]->OnMouseMove(oldx - this->x, oldy - this->y, 
-                                         newx - this->x, newy - this->y);
-            break;
-        }
+    if(firstchild != 0)
+        firstchild->OnMouseMove(oldx - this->x, oldy - this->y, 
+                                newx - this->x, newy - this->y);
+
+    // If it's a different child than before, pass the event too 
+    if(secondchild != 0 && secondchild != firstchild)
+        secondchild->OnMouseMove(oldx - this->x, oldy - this->y, 
+                                 newx - this->x, newy - this->y);
+}
+
+/*
+ * OnKeyEvent:
+ *  - If there's a focussed child, forward the event; a plain widget turns it into
+ *    OnKeyDown/OnKeyUp calls (see KeyboardEventHandler::OnKeyEvent).
+ */
+void CompositeWidget::OnKeyEvent(const myos::drivers::KeyEvent& event)
+{
+    if(focussedChild != 0)
+        focussedChild->OnKeyEvent(event);
 }
 
 /*
@@ -1,10 +1,12 @@
 #include <gui/window.h>
+#include <memorymanagement.h>
 
 /*
  * Namespaces:
  *   - myos::common: provides basic integer types.
  *   - myos::gui: provides the Widget, CompositeWidget, and Window classes for GUI construction.
  */
+using namespace myos;
 using namespace myos::common;
 using namespace myos::gui;
 
@@ -19,6 +21,8 @@ using namespace myos::gui;
  * Constructor:
  *   - Forwards the arguments to the CompositeWidget constructor, which sets up position, size, and background color.
  *   - Initializes 'Dragging' to false, indicating the window isn't being moved initially.
+ *   - The surface is only allocated when the window is painted for the first time,
+ *     because only then the pixel format of the screen is known.
  */
 Window::Window(Widget* parent,
                common::int32_t x, common::int32_t y, 
@@ -27,15 +31,121 @@ Window::Window(Widget* parent,
 : CompositeWidget(parent, x, y, w, h, r, g, b)
 {
     Dragging = false;
+    surface = 0;
+    damaged = true;
 }
 
 /*
  * Destructor:
- *  - Currently does nothing special. If the window allocated additional resources, 
- *    they would be released here.
+ *  - Destroys the cached surface (which frees its pixels) and its own memory.
  */
 Window::~Window()
 {
+    if(surface != 0)
+    {
+        surface->~Surface();
+        MemoryManager::activeMemoryManager->free(surface);
+    }
+}
+
+/*
+ * PrepareSurface:
+ *  - Keeps the existing surface if it still has the window's size and the format of 'gc',
+ *    so blitting it is a plain copy of rows.
+ *  - Otherwise replaces it. The memory comes straight from the MemoryManager, so a full
+ *    heap shows up as 0 instead of constructing a Surface at address 0.
+ *  - Returns false if there is no usable surface.
+ */
+bool Window::PrepareSurface(GraphicsContext* gc)
+{
+    if(surface != 0
+       && surface->GetWidth() == w && surface->GetHeight() == h
+       && surface->GetFormat() == gc->GetFormat()
+       && surface->GetPalette() == gc->GetPalette())
+        return true;
+
+    if(surface != 0)
+    {
+        surface->~Surface();
+        MemoryManager::activeMemoryManager->free(surface);
+        surface = 0;
+    }
+
+    void* memory = MemoryManager::activeMemoryManager->malloc(sizeof(Surface));
+    if(memory == 0)
+        return false;
+    surface = new (memory) Surface(w, h, gc->GetFormat(), gc->GetPalette());
+    damaged = true;
+
+    if(!surface->IsValid())
+    {
+        surface->~Surface();
+        MemoryManager::activeMemoryManager->free(surface);
+        surface = 0;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Paint:
+ *  - Renders the whole window into the surface (at 0, 0) only if it is damaged.
+ *  - Then copies each rectangle of the clip list from the surface to the screen.
+ *    X, Y is where the surface's top-left corner lands on the screen.
+ */
+void Window::Paint(GraphicsContext* gc, Region* clip, int32_t X, int32_t Y)
+{
+    if(!PrepareSurface(gc))
+    {
+        CompositeWidget::Paint(gc, clip, X, Y);
+        return;
+    }
+
+    if(damaged)
+    {
+        Region all(Rectangle(0, 0, w, h));
+        CompositeWidget::Paint(surface, &all, 0, 0);
+        damaged = false;
+    }
+
+    for(int i = 0; i < clip->NumRectangles(); i++)
+    {
+        const Rectangle& rect = clip->GetRectangle(i);
+        gc->Blit(surface, rect.x - X, rect.y - Y, rect.w, rect.h, rect.x, rect.y);
+    }
+}
+
+/*
+ * InvalidateRectangle:
+ *  - The next Paint renders the contents again.
+ *  - The parent has to show the new contents, so the area is passed on as well.
+ */
+void Window::InvalidateRectangle(const Rectangle& area)
+{
+    damaged = true;
+    CompositeWidget::InvalidateRectangle(area);
+}
+
+/*
+ * Minimise:
+ *  - A drag in progress ends, since the window can't receive the button release.
+ */
+void Window::Minimise()
+{
+    Dragging = false;
+    Hide();
+}
+
+/*
+ * Restore:
+ *  - Show repaints the window's rectangle; asking the parent for the focus then
+ *    raises it above the windows that were opened meanwhile.
+ */
+void Window::Restore()
+{
+    Show();
+    if(parent != 0)
+        parent->GetFocus(this);
 }
 
 /*
@@ -70,17 +180,18 @@ void Window::OnMouseUp(common::int32_t x, common::int32_t y, common::uint8_t but
  * OnMouseMove:
  *  - Called whenever the mouse moves while over this window. 
  *  - If Dragging is true, we update the window’s position by the offset 
- *    (newx - oldx, newy - oldy).
+ *    (newx - oldx, newy - oldy). The contents stay the same, so only the parent
+ *    is invalidated, and the cached surface is blitted at the new position.
+ *    Moving the mouse without dragging doesn't change the scene at all.
  *  - Then, we call CompositeWidget::OnMouseMove so child widgets can handle the movement as well.
  */
 void Window::OnMouseMove(common::int32_t oldx, common::int32_t oldy, 
                          common::int32_t newx, common::int32_t newy)
 {
-    // If we're dragging, shift the window by the mouse delta
-    if(Dragging)
+    // If we're dragging, shift the window by the mouse delta (SetBounds tells the parent)
+    if(Dragging && (newx != oldx || newy != oldy))
     {
-        this->x += newx - oldx;
-        this->y += newy - oldy;
+        SetBounds(x + newx - oldx, y + newy - oldy, w, h);
     }
     
     // Let children know the mouse moved
@@ -0,0 +1,123 @@
+#include <hardwarecommunication/acpi.h>
+
+/*
+ * Using namespaces:
+ *   - myos::common: for integral types
+ *   - myos::hardwarecommunication: for the ACPI table structures
+ */
+using namespace myos::common;
+using namespace myos::hardwarecommunication;
+
+
+/*
+ * ----------------------------------------------------------------------------
+ * AdvancedConfigurationAndPowerInterface Class
+ * ----------------------------------------------------------------------------
+ *
+ * Locates the RSDP and looks tables up by their signature.
+ */
+
+RootSystemDescriptionPointer* AdvancedConfigurationAndPowerInterface::rootPointer = 0;
+bool AdvancedConfigurationAndPowerInterface::searched = false;
+
+bool AdvancedConfigurationAndPowerInterface::IsChecksumValid(const void* data, uint32_t length)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint8_t sum = 0;
+    for(uint32_t i = 0; i < length; i++)
+        sum += bytes[i];
+    return sum == 0;
+}
+
+/*
+ * SearchRootPointer:
+ *  - The RSDP is aligned to 16 bytes. Besides the signature, the checksum has to
+ *    match (and the extended one for ACPI 2.0), as the signature alone also turns
+ *    up in BIOS code or data by chance.
+ */
+RootSystemDescriptionPointer* AdvancedConfigurationAndPowerInterface::SearchRootPointer(uint32_t start, uint32_t length)
+{
+    static const char signature[8] = { 'R', 'S', 'D', ' ', 'P', 'T', 'R', ' ' };
+
+    for(uint32_t address = start; address + 20 <= start + length; address += 16)
+    {
+        RootSystemDescriptionPointer* candidate = (RootSystemDescriptionPointer*)(uintptr_t)address;
+
+        int i = 0;
+        while(i < 8 && candidate->signature[i] == signature[i])
+            i++;
+        if(i < 8 || !IsChecksumValid(candidate, 20))
+            continue;
+
+        if(candidate->revision >= 2 && !IsChecksumValid(candidate, candidate->length))
+            continue;
+
+        return candidate;
+    }
+    return 0;
+}
+
+/*
+ * FindRootPointer:
+ *  - The word at 0x40E (in the BIOS data area) holds the EBDA's segment.
+ */
+RootSystemDescriptionPointer* AdvancedConfigurationAndPowerInterface::FindRootPointer()
+{
+    if(searched)
+        return rootPointer;
+    searched = true;
+
+    uint32_t ebda = (uint32_t)(*(volatile uint16_t*)0x40E) << 4;
+    if(ebda != 0)
+        rootPointer = SearchRootPointer(ebda, 1024);
+    if(rootPointer == 0)
+        rootPointer = SearchRootPointer(0xE0000, 0x20000);
+    return rootPointer;
+}
+
+/*
+ * FindTable:
+ *  - The XSDT is preferred if the RSDP has one that can be reached; its entries are
+ *    64 bit addresses, those of the RSDT 32 bit ones. Both lists follow the header.
+ */
+SystemDescriptionTableHeader* AdvancedConfigurationAndPowerInterface::FindTable(const char* signature)
+{
+    RootSystemDescriptionPointer* rsdp = FindRootPointer();
+    if(rsdp == 0)
+        return 0;
+
+    SystemDescriptionTableHeader* root;
+    uint32_t entrySize;
+    if(rsdp->revision >= 2 && rsdp->xsdtAddress != 0 && (rsdp->xsdtAddress >> 32) == 0)
+    {
+        root = (SystemDescriptionTableHeader*)(uintptr_t)rsdp->xsdtAddress;
+        entrySize = 8;
+    }
+    else
+    {
+        root = (SystemDescriptionTableHeader*)(uintptr_t)rsdp->rsdtAddress;
+        entrySize = 4;
+    }
+
+    if(root == 0 || !IsChecksumValid(root, root->length))
+        return 0;
+
+    uint8_t* entries = (uint8_t*)root + sizeof(SystemDescriptionTableHeader);
+    uint32_t numEntries = (root->length - sizeof(SystemDescriptionTableHeader)) / entrySize;
+    for(uint32_t i = 0; i < numEntries; i++)
+    {
+        uint64_t address = (entrySize == 8) ? *(uint64_t*)(entries + 8 * i)
+                                            : *(uint32_t*)(entries + 4 * i);
+        if(address == 0 || (address >> 32) != 0)
+            continue;
+
+        SystemDescriptionTableHeader* table = (SystemDescriptionTableHeader*)(uintptr_t)address;
+        if(table->signature[0] != signature[0] || table->signature[1] != signature[1]
+        || table->signature[2] != signature[2] || table->signature[3] != signature[3])
+            continue;
+
+        if(IsChecksumValid(table, table->length))
+            return table;
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <hardwarecommunication/apic.h>
+#include <hardwarecommunication/cpu.h>
+
+/*
+ * Using namespaces:
+ *   - myos::common: for integral types
+ *   - myos::hardwarecommunication: for the APIC, CPU and register access classes
+ */
+using namespace myos::common;
+using namespace myos::hardwarecommunication;
+
+
+/*
+ * ----------------------------------------------------------------------------
+ * LocalAdvancedProgrammableInterruptController Class
+ * ----------------------------------------------------------------------------
+ */
+
+MemoryMappedRegion LocalAdvancedProgrammableInterruptController::registers;
+
+bool LocalAdvancedProgrammableInterruptController::IsPresent()
+{
+    return CentralProcessingUnit::HasLocalAPIC() && CentralProcessingUnit::HasModelSpecificRegisters();
+}
+
+/*
+ * Enable:
+ *  - IA32_APIC_BASE (MSR 0x1B) holds the register page's address in bits 12-31 and the
+ *    global enable flag in bit 11. The lower 4 GB are identity mapped (the 32-bit kernel
+ *    runs without paging, the 64-bit one maps them 1:1), so the page (usually at
+ *    0xFEE00000) is accessed at its physical address.
+ *  - Bit 8 of the spurious interrupt register software-enables the APIC.
+ *  - LINT0 in ExtINT mode (0x700) passes the PICs' interrupts on as before; LINT1 in
+ *    NMI mode (0x400) does the same for NMIs. This is what the firmware normally sets up.
+ *  - A task priority of 0 lets every vector through.
+ */
+bool LocalAdvancedProgrammableInterruptController::Enable(uint8_t spuriousVector)
+{
+    if(registers.IsValid())
+        return true;
+    if(!IsPresent())
+        return false;
+
+    uint64_t base = CentralProcessingUnit::ReadModelSpecificRegister(0x1B);
+    base |= (1 << 11);
+    CentralProcessingUnit::WriteModelSpecificRegister(0x1B, base);
+
+    registers = MemoryMappedRegion((uint8_t*)(uintptr_t)(base & 0xFFFFF000), 0x1000);
+    registers.Write<SpuriousInterruptRegister>(0x100 | spuriousVector);
+    registers.Write<LocalInterrupt0Register>(0x700);
+    registers.Write<LocalInterrupt1Register>(0x400);
+    registers.Write<TaskPriorityRegister>(0);
+    return true;
+}
+
+bool LocalAdvancedProgrammableInterruptController::IsEnabled()
+{
+    return registers.IsValid();
+}
+
+/*
+ * GetId:
+ *  - The ID is in bits 24-31 of the ID register.
+ */
+uint8_t LocalAdvancedProgrammableInterruptController::GetId()
+{
+    if(!registers.IsValid())
+        return 0;
+    return registers.Read<IdRegister>() >> 24;
+}
+
+void LocalAdvancedProgrammableInterruptController::EndOfInterrupt()
+{
+    registers.Write<EndOfInterruptRegister>(0);
+}
+
+/*
+ * MessageAddress:
+ *  - 0xFEExxxxx with the destination APIC ID in bits 12-19; redirection hint and
+ *    destination mode (bits 3 and 2) are 0, i.e. exactly this processor.
+ */
+uint32_t LocalAdvancedProgrammableInterruptController::MessageAddress(uint8_t destination)
+{
+    return 0xFEE00000 | ((uint32_t)destination << 12);
+}
+
+/*
+ * MessageData:
+ *  - Delivery mode fixed (bits 8-10 = 0) and edge trigger (bit 15 = 0), so only the vector is set.
+ */
+uint32_t LocalAdvancedProgrammableInterruptController::MessageData(uint8_t vector)
+{
+    return vector;
+}
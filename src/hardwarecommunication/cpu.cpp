@@ -0,0 +1,195 @@
+#include <hardwarecommunication/cpu.h>
+
+/*
+ * Using namespaces:
+ *   - myos::common contains basic type definitions
+ *   - myos::hardwarecommunication contains the CPU and port classes
+ */
+using namespace myos::common;
+using namespace myos::hardwarecommunication;
+
+
+/*
+ * ----------------------------------------------------------------------------
+ * CentralProcessingUnit Class
+ * ----------------------------------------------------------------------------
+ *
+ * Thin wrappers around CPUID, the control registers and RDTSC.
+ */
+
+/*
+ * HasCPUID:
+ *  - Flips bit 21 (ID) of EFLAGS and checks whether the change sticks.
+ *    Processors without CPUID (i386, early i486) keep the bit constant.
+ *  - Every processor that runs the 64-bit build has CPUID (the loader needed it).
+ */
+bool CentralProcessingUnit::HasCPUID()
+{
+#ifdef __x86_64__
+    return true;
+#else
+    uint32_t before, after;
+    asm volatile("pushfl\n\t"
+                 "popl %0\n\t"
+                 "movl %0, %1\n\t"
+                 "xorl $0x00200000, %1\n\t"
+                 "pushl %1\n\t"
+                 "popfl\n\t"
+                 "pushfl\n\t"
+                 "popl %1\n\t"
+                 "pushl %0\n\t"
+                 "popfl"
+                 : "=&r" (before), "=&r" (after));
+    return ((before ^ after) & 0x00200000) != 0;
+#endif
+}
+
+/*
+ * CPUID:
+ *  - ECX is cleared, as some leaves use it as a sub-leaf index.
+ */
+void CentralProcessingUnit::CPUID(uint32_t leaf, uint32_t& eax, uint32_t& ebx, uint32_t& ecx, uint32_t& edx)
+{
+    asm volatile("cpuid"
+                 : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                 : "a" (leaf), "c" (0));
+}
+
+/*
+ * HasTimeStampCounter / HasModelSpecificRegisters / HasLocalAPIC / HasSSE / HasSSE2:
+ *  - Read the feature bits from CPUID leaf 1, EDX.
+ */
+bool CentralProcessingUnit::HasTimeStampCounter()
+{
+    if(!HasCPUID())
+        return false;
+    uint32_t eax, ebx, ecx, edx;
+    CPUID(1, eax, ebx, ecx, edx);
+    return (edx & (1 << 4)) != 0;
+}
+
+bool CentralProcessingUnit::HasModelSpecificRegisters()
+{
+    if(!HasCPUID())
+        return false;
+    uint32_t eax, ebx, ecx, edx;
+    CPUID(1, eax, ebx, ecx, edx);
+    return (edx & (1 << 5)) != 0;
+}
+
+bool CentralProcessingUnit::HasLocalAPIC()
+{
+    if(!HasCPUID())
+        return false;
+    uint32_t eax, ebx, ecx, edx;
+    CPUID(1, eax, ebx, ecx, edx);
+    return (edx & (1 << 9)) != 0;
+}
+
+bool CentralProcessingUnit::HasSSE()
+{
+    if(!HasCPUID())
+        return false;
+    uint32_t eax, ebx, ecx, edx;
+    CPUID(1, eax, ebx, ecx, edx);
+    return (edx & (1 << 25)) != 0;
+}
+
+bool CentralProcessingUnit::HasSSE2()
+{
+    if(!HasCPUID())
+        return false;
+    uint32_t eax, ebx, ecx, edx;
+    CPUID(1, eax, ebx, ecx, edx);
+    return (edx & (1 << 26)) != 0;
+}
+
+/*
+ * ReadModelSpecificRegister / WriteModelSpecificRegister:
+ *  - The register number goes in ECX, the value in EDX:EAX.
+ */
+uint64_t CentralProcessingUnit::ReadModelSpecificRegister(uint32_t msr)
+{
+    uint32_t low, high;
+    asm volatile("rdmsr" : "=a" (low), "=d" (high) : "c" (msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+void CentralProcessingUnit::WriteModelSpecificRegister(uint32_t msr, uint64_t value)
+{
+    asm volatile("wrmsr" : : "c" (msr), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32)));
+}
+
+/*
+ * EnableSSE:
+ *  - CR0.EM (bit 2) must be clear, or SSE instructions fault.
+ *  - CR0.MP (bit 1) makes WAIT/FWAIT respect the TS flag.
+ *  - CR4.OSFXSR (bit 9) tells the CPU the OS knows about FXSAVE/FXRSTOR and SSE.
+ *  - CR4.OSXMMEXCPT (bit 10) reports SIMD floating point errors as exception 19.
+ *  - FNINIT puts the x87 unit into a known state.
+ */
+bool CentralProcessingUnit::EnableSSE()
+{
+    if(!HasSSE() || !HasSSE2())
+        return false;
+
+    // Control registers are as wide as a pointer.
+    uintptr_t cr0, cr4;
+    asm volatile("mov %%cr0, %0" : "=r" (cr0));
+    cr0 &= ~(1 << 2);
+    cr0 |= (1 << 1);
+    asm volatile("mov %0, %%cr0" : : "r" (cr0));
+
+    asm volatile("mov %%cr4, %0" : "=r" (cr4));
+    cr4 |= (1 << 9) | (1 << 10);
+    asm volatile("mov %0, %%cr4" : : "r" (cr4));
+
+    asm volatile("fninit");
+    return true;
+}
+
+/*
+ * ReadTimeStampCounter:
+ *  - RDTSC returns the 64 bit counter in EDX:EAX.
+ */
+uint64_t CentralProcessingUnit::ReadTimeStampCounter()
+{
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a" (low), "=d" (high));
+    return ((uint64_t)high << 32) | low;
+}
+
+/*
+ * TimeStampCounterMHz:
+ *  - Port 0x61 bit 0 gates PIT channel 2, bit 1 connects it to the speaker (kept off),
+ *    bit 5 reads back the channel's output.
+ *  - Channel 2 is programmed in mode 0 (interrupt on terminal count) with 11932 ticks of
+ *    the 1.193182 MHz PIT clock, i.e. 10 ms. Its output goes high when the count runs out.
+ *  - Raising the gate (re)starts the count, then the TSC is read before and after.
+ */
+uint32_t CentralProcessingUnit::TimeStampCounterMHz()
+{
+    if(!HasTimeStampCounter())
+        return 0;
+
+    FixedPort<uint8_t, 0x61> speakerPort;
+    FixedPort<uint8_t, 0x43> commandPort;
+    FixedPort<uint8_t, 0x42> channel2Port;
+
+    uint16_t count = 11932;
+    uint8_t speaker = speakerPort.Read();
+    speakerPort.Write((speaker & ~0x03));
+
+    commandPort.Write(0xB0);                  // Channel 2, low byte then high byte, mode 0, binary
+    channel2Port.Write(count & 0xFF);
+    channel2Port.Write(count >> 8);
+
+    speakerPort.Write((speaker & ~0x03) | 0x01);
+    uint64_t start = ReadTimeStampCounter();
+    while((speakerPort.Read() & 0x20) == 0)
+        ;
+    uint64_t end = ReadTimeStampCounter();
+
+    speakerPort.Write(speaker);
+    return (uint32_t)(end - start) / 10000;
+}
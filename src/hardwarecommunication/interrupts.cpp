@@ -1,4 +1,6 @@
 #include <hardwarecommunication/interrupts.h>
+#include <hardwarecommunication/apic.h>
+#include <hardwarecommunication/cpu.h>
 
 /*
  * Using namespaces for clarity:
@@ -29,32 +31,42 @@ extern void printfHex(uint8_t);
  *   - interruptManager: pointer to the owning InterruptManager
  *   - InterruptNumber: the specific IDT vector this handler will manage
  *
- * The constructor registers this handler in the manager's 'handlers' array at the given index.
+ * The constructor appends this handler to the chain of the given vector in the manager's
+ * 'handlers' array, behind any handlers already registered for it. Registration happens
+ * before interrupts are enabled, so the chain isn't changed while it is being walked.
  */
 InterruptHandler::InterruptHandler(InterruptManager* interruptManager, uint8_t InterruptNumber)
 {
     this->InterruptNumber = InterruptNumber;
     this->interruptManager = interruptManager;
-    interruptManager->handlers[InterruptNumber] = this;
+    this->nextHandler = 0;
+
+    InterruptHandler** link = &interruptManager->handlers[InterruptNumber];
+    while(*link != 0)
+        link = &(*link)->nextHandler;
+    *link = this;
 }
 
 /*
  * Destructor:
- *  - If this handler is still the registered handler for its vector, remove it.
+ *  - Unlinks this handler from its vector's chain.
  */
 InterruptHandler::~InterruptHandler()
 {
-    if(interruptManager->handlers[InterruptNumber] == this)
-        interruptManager->handlers[InterruptNumber] = 0;
+    InterruptHandler** link = &interruptManager->handlers[InterruptNumber];
+    while(*link != 0 && *link != this)
+        link = &(*link)->nextHandler;
+    if(*link == this)
+        *link = nextHandler;
 }
 
 /*
  * HandleInterrupt:
- *  - Default implementation returns 'esp' unchanged. Subclasses can override to implement handling logic.
+ *  - Default implementation leaves 'esp' unchanged and claims the interrupt. Subclasses can override to implement handling logic.
  */
-uint32_t InterruptHandler::HandleInterrupt(uint32_t esp)
+bool InterruptHandler::HandleInterrupt(uintptr_t& esp)
 {
-    return esp;
+    return true;
 }
 
 
@@ -86,7 +98,8 @@ InterruptManager* InterruptManager::ActiveInterruptManager = 0;
  *
  * The GateDescriptor fields:
  *   - handlerAddressLowBits: low 16 bits of the function pointer.
- *   - handlerAddressHighBits: high 16 bits of the function pointer.
+ *   - handlerAddressHighBits: bits 16-31 of the function pointer (and, in the 64-bit
+ *     build, handlerAddressUpperBits: bits 32-63).
  *   - gdt_codeSegmentSelector: segment selector in the GDT that contains the code for this ISR.
  *   - access: indicates present bit, descriptor type (interrupt gate), DPL, etc.
  */
@@ -94,8 +107,12 @@ void InterruptManager::SetInterruptDescriptorTableEntry(uint8_t interrupt,
     uint16_t CodeSegment, void (*handler)(),
     uint8_t DescriptorPrivilegeLevel, uint8_t DescriptorType)
 {
-    interruptDescriptorTable[interrupt].handlerAddressLowBits = ((uint32_t)handler) & 0xFFFF;
-    interruptDescriptorTable[interrupt].handlerAddressHighBits = (((uint32_t)handler) >> 16) & 0xFFFF;
+    interruptDescriptorTable[interrupt].handlerAddressLowBits = ((uintptr_t)handler) & 0xFFFF;
+    interruptDescriptorTable[interrupt].handlerAddressHighBits = (((uintptr_t)handler) >> 16) & 0xFFFF;
+#ifdef __x86_64__
+    interruptDescriptorTable[interrupt].handlerAddressUpperBits = (uint64_t)(uintptr_t)handler >> 32;
+    interruptDescriptorTable[interrupt].reserved2 = 0;
+#endif
     interruptDescriptorTable[interrupt].gdt_codeSegmentSelector = CodeSegment;
 
     const uint8_t IDT_DESC_PRESENT = 0x80;
@@ -127,13 +144,10 @@ void InterruptManager::SetInterruptDescriptorTableEntry(uint8_t interrupt,
 InterruptManager::InterruptManager(uint16_t hardwareInterruptOffset,
                                    GlobalDescriptorTable* globalDescriptorTable,
                                    TaskManager* taskManager)
-: programmableInterruptControllerMasterCommandPort(0x20),
-  programmableInterruptControllerMasterDataPort(0x21),
-  programmableInterruptControllerSlaveCommandPort(0xA0),
-  programmableInterruptControllerSlaveDataPort(0xA1)
 {
     this->taskManager = taskManager;
     this->hardwareInterruptOffset = hardwareInterruptOffset;
+    this->messageVectorsUsed = 0;
 
     uint32_t CodeSegment = globalDescriptorTable->CodeSegmentSelector();
     const uint8_t IDT_INTERRUPT_GATE = 0xE;
@@ -188,9 +202,32 @@ InterruptManager::InterruptManager(uint16_t hardwareInterruptOffset,
     SetInterruptDescriptorTableEntry(hardwareInterruptOffset + 0x0E, CodeSegment, &HandleInterruptRequest0x0E, 0, IDT_INTERRUPT_GATE);
     SetInterruptDescriptorTableEntry(hardwareInterruptOffset + 0x0F, CodeSegment, &HandleInterruptRequest0x0F, 0, IDT_INTERRUPT_GATE);
 
+    // Message signaled interrupts at MessageVectorBase..MessageVectorBase+15
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x00, CodeSegment, &HandleMessageSignaledInterrupt0x00, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x01, CodeSegment, &HandleMessageSignaledInterrupt0x01, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x02, CodeSegment, &HandleMessageSignaledInterrupt0x02, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x03, CodeSegment, &HandleMessageSignaledInterrupt0x03, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x04, CodeSegment, &HandleMessageSignaledInterrupt0x04, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x05, CodeSegment, &HandleMessageSignaledInterrupt0x05, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x06, CodeSegment, &HandleMessageSignaledInterrupt0x06, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x07, CodeSegment, &HandleMessageSignaledInterrupt0x07, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x08, CodeSegment, &HandleMessageSignaledInterrupt0x08, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x09, CodeSegment, &HandleMessageSignaledInterrupt0x09, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x0A, CodeSegment, &HandleMessageSignaledInterrupt0x0A, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x0B, CodeSegment, &HandleMessageSignaledInterrupt0x0B, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x0C, CodeSegment, &HandleMessageSignaledInterrupt0x0C, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x0D, CodeSegment, &HandleMessageSignaledInterrupt0x0D, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x0E, CodeSegment, &HandleMessageSignaledInterrupt0x0E, 0, IDT_INTERRUPT_GATE);
+    SetInterruptDescriptorTableEntry(MessageVectorBase + 0x0F, CodeSegment, &HandleMessageSignaledInterrupt0x0F, 0, IDT_INTERRUPT_GATE);
+
     // A separate software interrupt for syscalls at vector 0x80
     SetInterruptDescriptorTableEntry(0x80, CodeSegment, &HandleInterruptRequest0x80, 0, IDT_INTERRUPT_GATE);
 
+#ifdef __x86_64__
+    // In long mode, system calls can also come in through SYSCALL
+    EnableSystemCallInstruction(globalDescriptorTable);
+#endif
+
     // Initialize PIC (Programmable Interrupt Controller) in cascade mode
     // 0x11 = start initialization
     programmableInterruptControllerMasterCommandPort.Write(0x11);
@@ -215,10 +252,34 @@ InterruptManager::InterruptManager(uint16_t hardwareInterruptOffset,
     // Load IDT by setting up the IDT pointer
     InterruptDescriptorTablePointer idt_pointer;
     idt_pointer.size = 256 * sizeof(GateDescriptor) - 1;
-    idt_pointer.base = (uint32_t)interruptDescriptorTable;
+    idt_pointer.base = (uintptr_t)interruptDescriptorTable;
     asm volatile("lidt %0" : : "m"(idt_pointer));
 }
 
+#ifdef __x86_64__
+/*
+ * EnableSystemCallInstruction:
+ *  - IA32_EFER.SCE (MSR 0xC0000080, bit 0) enables SYSCALL/SYSRET.
+ *  - IA32_STAR (0xC0000081): bits 32-47 give the kernel CS (SS is CS + 8); bits 48-63
+ *    the base SYSRET adds 8 (SS) and 16 (CS) to, i.e. the kernel data segment, which
+ *    the user data and code segments follow in the GDT.
+ *  - IA32_LSTAR (0xC0000082) is the 64-bit entry point.
+ *  - IA32_FMASK (0xC0000084) clears IF and DF on entry, so the handler runs like an
+ *    interrupt gate would have it.
+ */
+void InterruptManager::EnableSystemCallInstruction(GlobalDescriptorTable* globalDescriptorTable)
+{
+    uint64_t efer = CentralProcessingUnit::ReadModelSpecificRegister(0xC0000080);
+    CentralProcessingUnit::WriteModelSpecificRegister(0xC0000080, efer | 1);
+
+    uint64_t star = ((uint64_t)globalDescriptorTable->DataSegmentSelector() << 48)
+                  | ((uint64_t)globalDescriptorTable->CodeSegmentSelector() << 32);
+    CentralProcessingUnit::WriteModelSpecificRegister(0xC0000081, star);
+    CentralProcessingUnit::WriteModelSpecificRegister(0xC0000082, (uintptr_t)&HandleSystemCall);
+    CentralProcessingUnit::WriteModelSpecificRegister(0xC0000084, 0x200 | 0x400);
+}
+#endif
+
 /*
  * Destructor:
  *  - Deactivates this interrupt manager if it's active.
@@ -237,6 +298,33 @@ uint16_t InterruptManager::HardwareInterruptOffset()
     return hardwareInterruptOffset;
 }
 
+/*
+ * AllocateMessageVector:
+ *  - Hands out the lowest free vector of the block. The vectors all have the same
+ *    priority class (0x6x), so the choice doesn't matter otherwise.
+ */
+uint8_t InterruptManager::AllocateMessageVector()
+{
+    if(!LocalAdvancedProgrammableInterruptController::Enable(SpuriousVector))
+        return 0;
+
+    for(int i = 0; i < MessageVectorCount; i++)
+    {
+        if((messageVectorsUsed & (1 << i)) == 0)
+        {
+            messageVectorsUsed |= (1 << i);
+            return MessageVectorBase + i;
+        }
+    }
+    return 0;
+}
+
+void InterruptManager::FreeMessageVector(uint8_t vector)
+{
+    if(MessageVectorBase <= vector && vector < MessageVectorBase + MessageVectorCount)
+        messageVectorsUsed &= ~(1 << (vector - MessageVectorBase));
+}
+
 /*
  * Activate:
  *  - If there is already an active interrupt manager, deactivate it.
@@ -271,27 +359,78 @@ void InterruptManager::Deactivate()
  *  - A static function called by the assembly stubs for each interrupt vector.
  *  - If there's an active manager, it delegates to DoHandleInterrupt; otherwise, returns esp.
  */
-uint32_t InterruptManager::HandleInterrupt(uint8_t interrupt, uint32_t esp)
+uintptr_t InterruptManager::HandleInterrupt(uint8_t interrupt, uintptr_t esp)
 {
     if(ActiveInterruptManager != 0)
         return ActiveInterruptManager->DoHandleInterrupt(interrupt, esp);
     return esp;
 }
 
+uint32_t InterruptManager::GetUnclaimedInterruptCount()
+{
+    return unclaimedInterrupts.Sum();
+}
+
+uint32_t InterruptManager::GetSpuriousInterruptCount()
+{
+    return spuriousInterrupts.Sum();
+}
+
+/*
+ * IsSpuriousInterruptRequest:
+ *  - When an IRQ line drops again before the CPU acknowledges it, the PIC still delivers
+ *    an interrupt, as its lowest priority line (IRQ7, or IRQ15 on the slave). Its bit in
+ *    the in-service register (read after OCW3 0x0B) is then clear.
+ */
+bool InterruptManager::IsSpuriousInterruptRequest(uint8_t irq)
+{
+    if(irq == 7)
+    {
+        programmableInterruptControllerMasterCommandPort.Write(0x0B);
+        return (programmableInterruptControllerMasterCommandPort.Read() & 0x80) == 0;
+    }
+    if(irq == 15)
+    {
+        programmableInterruptControllerSlaveCommandPort.Write(0x0B);
+        return (programmableInterruptControllerSlaveCommandPort.Read() & 0x80) == 0;
+    }
+    return false;
+}
+
 /*
  * DoHandleInterrupt:
  *  - The core logic for handling an interrupt in the active manager context.
- *  - If a specific handler is registered, it calls that handler’s HandleInterrupt method.
+ *  - A spurious IRQ7 is dropped without an EOI (the master PIC has nothing in service);
+ *    a spurious IRQ15 only gets an EOI at the master, which did see the cascade line.
+ *  - Every handler in the vector's chain is called, since on a shared, level triggered
+ *    line more than one device can be requesting at once. If handlers are registered
+ *    but none claims the interrupt, it is counted.
  *  - If it's the timer interrupt (interrupt == hardwareInterruptOffset), 
  *    we invoke the TaskManager to switch tasks.
- *  - If it's a hardware IRQ, we send end-of-interrupt (EOI) to the PICs.
+ *  - If it's a hardware IRQ, we send end-of-interrupt (EOI) to the PICs; message signaled
+ *    interrupts are acknowledged at the local APIC instead.
  */
-uint32_t InterruptManager::DoHandleInterrupt(uint8_t interrupt, uint32_t esp)
+uintptr_t InterruptManager::DoHandleInterrupt(uint8_t interrupt, uintptr_t esp)
 {
-    // Call the registered handler, if any
+    if(interrupt == hardwareInterruptOffset + 7 || interrupt == hardwareInterruptOffset + 15)
+    {
+        if(IsSpuriousInterruptRequest(interrupt - hardwareInterruptOffset))
+        {
+            spuriousInterrupts.Increment();
+            if(interrupt == hardwareInterruptOffset + 15)
+                programmableInterruptControllerMasterCommandPort.Write(0x20);
+            return esp;
+        }
+    }
+
+    // Call the registered handlers, if any
     if(handlers[interrupt] != 0)
     {
-        esp = handlers[interrupt]->HandleInterrupt(esp);
+        bool claimed = false;
+        for(InterruptHandler* handler = handlers[interrupt]; handler != 0; handler = handler->nextHandler)
+            claimed |= handler->HandleInterrupt(esp);
+        if(!claimed)
+            unclaimedInterrupts.Increment();
     }
     else if(interrupt != hardwareInterruptOffset)
     {
@@ -303,7 +442,7 @@ uint32_t InterruptManager::DoHandleInterrupt(uint8_t interrupt, uint32_t esp)
     // If this is the timer interrupt, schedule a new task if TaskManager is available
     if(interrupt == hardwareInterruptOffset)
     {
-        esp = (uint32_t)taskManager->Schedule((CPUState*)esp);
+        esp = (uintptr_t)taskManager->Schedule((CPUState*)esp);
     }
 
     // Acknowledge the PIC for hardware interrupts
@@ -315,6 +454,10 @@ uint32_t InterruptManager::DoHandleInterrupt(uint8_t interrupt, uint32_t esp)
         if(hardwareInterruptOffset + 8 <= interrupt)
             programmableInterruptControllerSlaveCommandPort.Write(0x20);
     }
+    else if(MessageVectorBase <= interrupt && interrupt < MessageVectorBase + MessageVectorCount)
+    {
+        LocalAdvancedProgrammableInterruptController::EndOfInterrupt();
+    }
 
     return esp;
 }
@@ -2,6 +2,9 @@
 # Define the base interrupt vector for hardware IRQs. Typically, the PIC is
 # remapped so that IRQ0 (timer) is mapped to 0x20.
 
+.set MSI_BASE, 0x60
+# The first vector for message signaled interrupts (InterruptManager::MessageVectorBase).
+
 .section .text
 # Begin the text (code) section.
 
@@ -74,6 +77,35 @@ HandleInterruptRequest 0x0D
 HandleInterruptRequest 0x0E
 HandleInterruptRequest 0x0F
 
+# Macro: HandleMessageSignaledInterrupt
+# Like HandleInterruptRequest, for the vectors reserved for message signaled
+# interrupts (InterruptManager::MessageVectorBase + num).
+.macro HandleMessageSignaledInterrupt num
+.global _ZN4myos21hardwarecommunication16InterruptManager34HandleMessageSignaledInterrupt\num\()Ev
+_ZN4myos21hardwarecommunication16InterruptManager34HandleMessageSignaledInterrupt\num\()Ev:
+    movb $\num + MSI_BASE, (interruptnumber)
+    pushl $0
+    jmp int_bottom
+.endm
+
+# Create handlers for the message signaled interrupt vectors 0x60 to 0x6F.
+HandleMessageSignaledInterrupt 0x00
+HandleMessageSignaledInterrupt 0x01
+HandleMessageSignaledInterrupt 0x02
+HandleMessageSignaledInterrupt 0x03
+HandleMessageSignaledInterrupt 0x04
+HandleMessageSignaledInterrupt 0x05
+HandleMessageSignaledInterrupt 0x06
+HandleMessageSignaledInterrupt 0x07
+HandleMessageSignaledInterrupt 0x08
+HandleMessageSignaledInterrupt 0x09
+HandleMessageSignaledInterrupt 0x0A
+HandleMessageSignaledInterrupt 0x0B
+HandleMessageSignaledInterrupt 0x0C
+HandleMessageSignaledInterrupt 0x0D
+HandleMessageSignaledInterrupt 0x0E
+HandleMessageSignaledInterrupt 0x0F
+
 # Create handler for a specific additional IRQ (vector 0x31).
 HandleInterruptRequest 0x31
 
@@ -0,0 +1,269 @@
+.set IRQ_BASE, 0x20
+# Define the base interrupt vector for hardware IRQs. Typically, the PIC is
+# remapped so that IRQ0 (timer) is mapped to 0x20.
+
+.set MSI_BASE, 0x60
+# The first vector for message signaled interrupts (InterruptManager::MessageVectorBase).
+
+.set SYSCALL_VECTOR, 0x80
+# The vector SYSCALL is dispatched as, so the int 0x80 handlers serve both.
+
+.set USER_CODE_SELECTOR, 0x2B
+# GlobalDescriptorTable::UserCodeSegmentSelector(), the CS SYSCALL came from.
+
+# The 64-bit counterpart of interruptstubs.s. The stubs build the 64-bit CPUState
+# (see multitasking.h) on the stack and pass its address to the C++ handler, which
+# returns the frame to resume (possibly another task's).
+
+.code64
+.section .text
+
+.extern _ZN4myos21hardwarecommunication16InterruptManager15HandleInterruptEhm
+# myos::hardwarecommunication::InterruptManager::HandleInterrupt(uint8_t, uintptr_t)
+# (uintptr_t is 'unsigned long' in the 64-bit build, hence the 'm').
+
+# Macro: HandleException
+# For exceptions without an error code: pushes 0 in its place, so that every
+# frame has the same layout.
+.macro HandleException num
+.global _ZN4myos21hardwarecommunication16InterruptManager19HandleException\num\()Ev
+_ZN4myos21hardwarecommunication16InterruptManager19HandleException\num\()Ev:
+    movb $\num, interruptnumber(%rip)
+    pushq $0
+    jmp int_bottom
+.endm
+
+# Macro: HandleExceptionWithErrorCode
+# For the exceptions the CPU pushes an error code for (8, 10-14 and 17).
+.macro HandleExceptionWithErrorCode num
+.global _ZN4myos21hardwarecommunication16InterruptManager19HandleException\num\()Ev
+_ZN4myos21hardwarecommunication16InterruptManager19HandleException\num\()Ev:
+    movb $\num, interruptnumber(%rip)
+    jmp int_bottom
+.endm
+
+# Macro: HandleInterruptRequest
+# Sets the interrupt number to the IRQ plus IRQ_BASE and pushes a dummy error code.
+.macro HandleInterruptRequest num
+.global _ZN4myos21hardwarecommunication16InterruptManager26HandleInterruptRequest\num\()Ev
+_ZN4myos21hardwarecommunication16InterruptManager26HandleInterruptRequest\num\()Ev:
+    movb $\num + IRQ_BASE, interruptnumber(%rip)
+    pushq $0
+    jmp int_bottom
+.endm
+
+# Macro: HandleMessageSignaledInterrupt
+# Like HandleInterruptRequest, for the vectors MessageVectorBase + num.
+.macro HandleMessageSignaledInterrupt num
+.global _ZN4myos21hardwarecommunication16InterruptManager34HandleMessageSignaledInterrupt\num\()Ev
+_ZN4myos21hardwarecommunication16InterruptManager34HandleMessageSignaledInterrupt\num\()Ev:
+    movb $\num + MSI_BASE, interruptnumber(%rip)
+    pushq $0
+    jmp int_bottom
+.endm
+
+# Create exception handlers for exceptions 0x00 to 0x13.
+HandleException 0x00
+HandleException 0x01
+HandleException 0x02
+HandleException 0x03
+HandleException 0x04
+HandleException 0x05
+HandleException 0x06
+HandleException 0x07
+HandleExceptionWithErrorCode 0x08
+HandleException 0x09
+HandleExceptionWithErrorCode 0x0A
+HandleExceptionWithErrorCode 0x0B
+HandleExceptionWithErrorCode 0x0C
+HandleExceptionWithErrorCode 0x0D
+HandleExceptionWithErrorCode 0x0E
+HandleException 0x0F
+HandleException 0x10
+HandleExceptionWithErrorCode 0x11
+HandleException 0x12
+HandleException 0x13
+
+# Create handlers for hardware interrupts (IRQs) for IRQs 0x00 to 0x0F.
+HandleInterruptRequest 0x00
+HandleInterruptRequest 0x01
+HandleInterruptRequest 0x02
+HandleInterruptRequest 0x03
+HandleInterruptRequest 0x04
+HandleInterruptRequest 0x05
+HandleInterruptRequest 0x06
+HandleInterruptRequest 0x07
+HandleInterruptRequest 0x08
+HandleInterruptRequest 0x09
+HandleInterruptRequest 0x0A
+HandleInterruptRequest 0x0B
+HandleInterruptRequest 0x0C
+HandleInterruptRequest 0x0D
+HandleInterruptRequest 0x0E
+HandleInterruptRequest 0x0F
+
+# Create handlers for the message signaled interrupt vectors 0x60 to 0x6F.
+HandleMessageSignaledInterrupt 0x00
+HandleMessageSignaledInterrupt 0x01
+HandleMessageSignaledInterrupt 0x02
+HandleMessageSignaledInterrupt 0x03
+HandleMessageSignaledInterrupt 0x04
+HandleMessageSignaledInterrupt 0x05
+HandleMessageSignaledInterrupt 0x06
+HandleMessageSignaledInterrupt 0x07
+HandleMessageSignaledInterrupt 0x08
+HandleMessageSignaledInterrupt 0x09
+HandleMessageSignaledInterrupt 0x0A
+HandleMessageSignaledInterrupt 0x0B
+HandleMessageSignaledInterrupt 0x0C
+HandleMessageSignaledInterrupt 0x0D
+HandleMessageSignaledInterrupt 0x0E
+HandleMessageSignaledInterrupt 0x0F
+
+# Create handler for a specific additional IRQ (vector 0x31).
+HandleInterruptRequest 0x31
+
+# Create handler for the syscall interrupt (vector 0x80).
+HandleInterruptRequest 0x80
+
+
+# int_bottom:
+#   The common part of all handlers. The CPU has pushed SS, RSP, RFLAGS, CS and RIP
+#   (always, in long mode) and the stub the error code; the general purpose registers
+#   complete the CPUState.
+int_bottom:
+    pushq %r15
+    pushq %r14
+    pushq %r13
+    pushq %r12
+    pushq %r11
+    pushq %r10
+    pushq %r9
+    pushq %r8
+    pushq %rbp
+    pushq %rdi
+    pushq %rsi
+    pushq %rdx
+    pushq %rcx
+    pushq %rbx
+    pushq %rax
+
+    # HandleInterrupt(interruptnumber, rsp): the arguments go in RDI and RSI. The frame
+    # leaves RSP 8 bytes off the 16 byte alignment the ABI asks for at a call; the old
+    # value needn't be kept, as the handler returns the frame to continue with.
+    cld
+    movzbl interruptnumber(%rip), %edi
+    mov %rsp, %rsi
+    and $~0xF, %rsp
+    call _ZN4myos21hardwarecommunication16InterruptManager15HandleInterruptEhm
+    mov %rax, %rsp                # Switch to the returned frame (context switch if needed)
+
+int_restore:
+    popq %rax
+    popq %rbx
+    popq %rcx
+    popq %rdx
+    popq %rsi
+    popq %rdi
+    popq %rbp
+    popq %r8
+    popq %r9
+    popq %r10
+    popq %r11
+    popq %r12
+    popq %r13
+    popq %r14
+    popq %r15
+
+    # Drop the error code.
+    add $8, %rsp
+
+.global _ZN4myos21hardwarecommunication16InterruptManager15InterruptIgnoreEv
+_ZN4myos21hardwarecommunication16InterruptManager15InterruptIgnoreEv:
+    iretq
+
+
+# HandleSystemCall:
+#   The entry point of the SYSCALL instruction (IA32_LSTAR). SYSCALL doesn't switch
+#   stacks and leaves RIP in RCX and RFLAGS in R11; interrupts are masked on entry
+#   (IA32_FMASK). The stub moves to its own stack, builds the same CPUState an
+#   'int 0x80' from ring 3 would have produced and dispatches it as vector 0x80.
+#   System calls never switch tasks: only the timer vector does, and it can't arrive
+#   while interrupts are masked here. So the handler always returns this frame, and
+#   SYSRET goes back to the caller. All system calls share 'syscall_stack'; one that
+#   blocks or reschedules would need a kernel stack per task (TSS rsp0) instead.
+.global _ZN4myos21hardwarecommunication16InterruptManager16HandleSystemCallEv
+_ZN4myos21hardwarecommunication16InterruptManager16HandleSystemCallEv:
+    mov %rsp, syscall_user_stack(%rip)
+    lea syscall_stack(%rip), %rsp
+
+    pushq $USER_CODE_SELECTOR - 8 # ss
+    pushq syscall_user_stack(%rip) # rsp
+    pushq %r11                    # rflags
+    pushq $USER_CODE_SELECTOR     # cs
+    pushq %rcx                    # rip
+    pushq $0                      # error
+
+    movb $SYSCALL_VECTOR, interruptnumber(%rip)
+
+    pushq %r15
+    pushq %r14
+    pushq %r13
+    pushq %r12
+    pushq %r11
+    pushq %r10
+    pushq %r9
+    pushq %r8
+    pushq %rbp
+    pushq %rdi
+    pushq %rsi
+    pushq %rdx
+    pushq %rcx
+    pushq %rbx
+    pushq %rax
+
+    cld
+    movzbl interruptnumber(%rip), %edi
+    mov %rsp, %rsi
+    and $~0xF, %rsp
+    call _ZN4myos21hardwarecommunication16InterruptManager15HandleInterruptEhm
+    mov %rax, %rsp
+
+    popq %rax
+    popq %rbx
+    popq %rcx                     # Overwritten below with the return address
+    popq %rdx
+    popq %rsi
+    popq %rdi
+    popq %rbp
+    popq %r8
+    popq %r9
+    popq %r10
+    popq %r11                     # Overwritten below with the flags
+    popq %r12
+    popq %r13
+    popq %r14
+    popq %r15
+
+    add $8, %rsp                  # error
+    popq %rcx                     # rip
+    add $8, %rsp                  # cs
+    popq %r11                     # rflags
+    popq %rsp                     # rsp (ss is implied by SYSRET)
+    sysretq
+
+
+.section .data
+    interruptnumber: .byte 0
+    # This global data element holds the current interrupt number.
+    # Each handler macro writes a specific value to this byte before calling int_bottom.
+
+    .align 8
+    syscall_user_stack: .quad 0
+    # The caller's RSP while a system call is being handled.
+
+.section .bss
+    .align 16
+    .space 16384
+    syscall_stack:
+    # The stack system calls are handled on (there is one CPU, and SYSCALL masks interrupts).
@@ -0,0 +1,58 @@
+#include <hardwarecommunication/mmio.h>
+
+/*
+ * Using namespaces:
+ *   - myos::common: for integral types
+ *   - myos::hardwarecommunication: for the register access classes
+ */
+using namespace myos::common;
+using namespace myos::hardwarecommunication;
+
+
+/*
+ * ----------------------------------------------------------------------------
+ * MemoryMappedRegion Class
+ * ----------------------------------------------------------------------------
+ *
+ * The accessors are templates in mmio.h; only the setup is here.
+ */
+
+MemoryMappedRegion::MemoryMappedRegion()
+{
+    base = 0;
+    size = 0;
+}
+
+/*
+ * Constructor:
+ *  - The lower 4 GB are identity mapped, so the physical address from the BAR is
+ *    used directly.
+ */
+MemoryMappedRegion::MemoryMappedRegion(uint8_t* base, uint32_t size)
+{
+    this->base = base;
+    this->size = size;
+}
+
+uint32_t MemoryMappedRegion::GetSize()
+{
+    return size;
+}
+
+
+/*
+ * ----------------------------------------------------------------------------
+ * DeviceRegisters Class
+ * ----------------------------------------------------------------------------
+ */
+
+DeviceRegisters::DeviceRegisters()
+{
+    portBase = 0;
+}
+
+DeviceRegisters::DeviceRegisters(const MemoryMappedRegion& memory, uint16_t portBase)
+: memory(memory)
+{
+    this->portBase = portBase;
+}
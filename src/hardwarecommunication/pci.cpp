@@ -1,5 +1,8 @@
 #include <hardwarecommunication/pci.h>
+#include <hardwarecommunication/acpi.h>
+#include <hardwarecommunication/apic.h>
 #include <drivers/amd_am79c973.h>
+#include <drivers/bga.h>
 
 /*
  * Using namespaces:
@@ -11,6 +14,12 @@ using namespace myos::common;
 using namespace myos::drivers;
 using namespace myos::hardwarecommunication;
 
+/*
+ * External functions for printing, defined in kernel.cpp.
+ */
+extern void printf(char* str);
+extern void printfHex(uint8_t);
+
 
 /*
  * ----------------------------------------------------------------------------
@@ -20,7 +29,8 @@ using namespace myos::hardwarecommunication;
  * This class encapsulates the PCI device descriptor information. It holds
  * data about a device's bus, device, function numbers, vendor and device IDs,
  * class and subclass information, revision, interrupt line, and optionally
- * the base I/O port (portBase) if the device uses I/O-mapped registers.
+ * the base I/O port (portBase) if the device uses I/O-mapped registers and
+ * the first memory region (memoryBase) if it has memory-mapped ones.
  */
 
 PeripheralComponentInterconnectDeviceDescriptor::PeripheralComponentInterconnectDeviceDescriptor()
@@ -43,17 +53,22 @@ PeripheralComponentInterconnectDeviceDescriptor::~PeripheralComponentInterconnec
  * It uses two port objects:
  *   - commandPort (0xCF8): used to specify the configuration address.
  *   - dataPort (0xCFC): used to read from/write to the configuration space.
+ * or, for the buses covered by the ACPI MCFG table, the memory-mapped ECAM window.
  *
  * It includes functions for reading and writing to PCI configuration registers,
- * checking for multi-function devices, retrieving device descriptors, and
- * selecting and instantiating drivers for PCI devices.
+ * checking for multi-function devices, retrieving device descriptors, caching the
+ * devices found, and selecting and instantiating drivers for them from a table.
  */
 
 PeripheralComponentInterconnectController::PeripheralComponentInterconnectController()
-: dataPort(0xCFC),
-  commandPort(0xCF8)
 {
-    // The constructor initializes the configuration ports.
+    // The configuration ports are fixed by their types; the device cache starts out empty.
+    numDevices = 0;
+    enumerated = false;
+
+    configurationStartBus = 0;
+    configurationEndBus = 0;
+    FindConfigurationSpace();
 }
 
 PeripheralComponentInterconnectController::~PeripheralComponentInterconnectController()
@@ -61,6 +76,52 @@ PeripheralComponentInterconnectController::~PeripheralComponentInterconnectContr
     // Destructor. No dynamic cleanup required.
 }
 
+/*
+ * FindConfigurationSpace:
+ *  - Takes the MCFG allocation for segment group 0 (the only one a PC normally has).
+ *  - The window's base address corresponds to bus 0; it is moved to startBus so the
+ *    region covers exactly the buses listed, 1 MB (32 devices * 8 functions * 4 KB) each.
+ *  - Only the lower 4 GB are identity mapped, so windows above 4 GB are out of reach
+ *    and ignored.
+ */
+void PeripheralComponentInterconnectController::FindConfigurationSpace()
+{
+    MemoryMappedConfigurationTable* mcfg =
+        (MemoryMappedConfigurationTable*)AdvancedConfigurationAndPowerInterface::FindTable("MCFG");
+    if(mcfg == 0)
+        return;
+
+    uint32_t numAllocations = (mcfg->header.length - sizeof(MemoryMappedConfigurationTable))
+                            / sizeof(MemoryMappedConfigurationAllocation);
+    for(uint32_t i = 0; i < numAllocations; i++)
+    {
+        MemoryMappedConfigurationAllocation* allocation = &mcfg->allocations[i];
+        if(allocation->segmentGroup != 0 || allocation->endBus < allocation->startBus)
+            continue;
+
+        uint64_t start = allocation->baseAddress + ((uint64_t)allocation->startBus << 20);
+        uint32_t size = (uint32_t)(allocation->endBus - allocation->startBus + 1) << 20;
+        if(allocation->baseAddress == 0 || start + size - 1 > 0xFFFFFFFF)
+            continue;
+
+        configurationSpace = MemoryMappedRegion((uint8_t*)(uintptr_t)start, size);
+        configurationStartBus = allocation->startBus;
+        configurationEndBus = allocation->endBus;
+        return;
+    }
+}
+
+bool PeripheralComponentInterconnectController::IsMemoryMapped(uint16_t bus)
+{
+    return configurationSpace.IsValid()
+        && bus >= configurationStartBus && bus <= configurationEndBus;
+}
+
+bool PeripheralComponentInterconnectController::HasExtendedConfigurationSpace()
+{
+    return IsMemoryMapped(0);
+}
+
 /*
  * Read:
  *  - Reads a 32-bit value from the PCI configuration space for a given bus,
@@ -75,9 +136,25 @@ PeripheralComponentInterconnectController::~PeripheralComponentInterconnectContr
  *  - After writing this address to commandPort, the dataPort is read.
  *  - The returned result is then shifted right by a multiple of 8, depending on
  *    registeroffset modulo 4, to align the desired 8/16/32-bit field.
+ *  - With ECAM, the same fields (plus 4 more bits of register offset) form the
+ *    offset into the window instead, and the dword is read directly.
  */
 uint32_t PeripheralComponentInterconnectController::Read(uint16_t bus, uint16_t device, uint16_t function, uint32_t registeroffset)
 {
+    if(IsMemoryMapped(bus))
+    {
+        uint32_t offset =
+            ((bus - configurationStartBus) << 20)
+            | ((device & 0x1F) << 15)
+            | ((function & 0x07) << 12)
+            | (registeroffset & 0xFFC);
+        return configurationSpace.Read<uint32_t>(offset) >> (8 * (registeroffset % 4));
+    }
+
+    // The port method only reaches the first 256 bytes
+    if(registeroffset >= 0x100)
+        return 0xFFFFFFFF;
+
     uint32_t id =
         0x1 << 31                              // Enable bit to indicate a configuration space access
         | ((bus & 0xFF) << 16)                   // Bus number: 8 bits
@@ -96,9 +173,24 @@ uint32_t PeripheralComponentInterconnectController::Read(uint16_t bus, uint16_t
  *    and register offset.
  *  - Constructs the configuration address similarly to the Read() function.
  *  - Writes the address to the commandPort, then writes the value to the dataPort.
+ *  - With ECAM, it is a single store into the window.
  */
 void PeripheralComponentInterconnectController::Write(uint16_t bus, uint16_t device, uint16_t function, uint32_t registeroffset, uint32_t value)
 {
+    if(IsMemoryMapped(bus))
+    {
+        uint32_t offset =
+            ((bus - configurationStartBus) << 20)
+            | ((device & 0x1F) << 15)
+            | ((function & 0x07) << 12)
+            | (registeroffset & 0xFFC);
+        configurationSpace.Write<uint32_t>(offset, value);
+        return;
+    }
+
+    if(registeroffset >= 0x100)
+        return;
+
     uint32_t id =
         0x1 << 31                              // Enable bit
         | ((bus & 0xFF) << 16)
@@ -122,19 +214,23 @@ bool PeripheralComponentInterconnectController::DeviceHasFunctions(common::uint1
 
 
 /*
- * SelectDrivers:
- *  - Scans the PCI bus for connected devices and attempts to select an appropriate driver for each.
- *  - For each bus (0-7) and for each device (0-31), it checks whether the device supports multiple functions.
- *  - For each function of the device, it retrieves the device descriptor.
+ * EnumerateDevices:
+ *  - Scans buses 0-7 once. For each device (0-31) it checks whether the device supports
+ *    multiple functions, and retrieves the descriptor of each function.
  *  - If the vendor_id is 0x0000 or 0xFFFF, the slot is considered unused and is skipped.
  *  - For each Base Address Register (BAR) on the device (up to 6 BARs),
  *    if the BAR is valid and is of type InputOutput, the device's portBase is set to that address.
- *  - After processing, it attempts to instantiate a driver with GetDriver() and, if successful,
- *    adds it to the provided DriverManager.
- *  - Finally, prints out basic information (bus, device, function, vendor_id, device_id) for each device found.
+ *    The first valid memory BAR becomes memoryBase, provided the device decodes memory
+ *    accesses at all (bit 1 of the command register); otherwise its registers would read
+ *    as all ones.
+ *  - The descriptors are kept in 'devices'; functions beyond MaxDevices are reported and ignored.
  */
-void PeripheralComponentInterconnectController::SelectDrivers(DriverManager* driverManager, myos::hardwarecommunication::InterruptManager* interrupts)
+void PeripheralComponentInterconnectController::EnumerateDevices()
 {
+    if(enumerated)
+        return;
+    enumerated = true;
+
     for(int bus = 0; bus < 8; bus++)
     {
         for(int device = 0; device < 32; device++)
@@ -147,44 +243,103 @@ void PeripheralComponentInterconnectController::SelectDrivers(DriverManager* dri
                 // Skip empty or invalid devices (vendor_id 0x0000 or 0xFFFF)
                 if(dev.vendor_id == 0x0000 || dev.vendor_id == 0xFFFF)
                     continue;
+
+                if(numDevices == MaxDevices)
+                {
+                    printf("PCI: too many devices\n");
+                    return;
+                }
                 
                 // Check each of the 6 possible Base Address Registers (BARs)
+                bool memoryDecoding = (Read(bus, device, function, 0x04) & 0x2) != 0;
                 for(int barNum = 0; barNum < 6; barNum++)
                 {
                     BaseAddressRegister bar = GetBaseAddressRegister(bus, device, function, barNum);
                     // If the BAR indicates an I/O-mapped region and has a valid address,
                     // set the device's portBase to that address.
                     if(bar.address && (bar.type == InputOutput))
-                        dev.portBase = (uint32_t)bar.address;
+                        dev.portBase = (uint32_t)(uintptr_t)bar.address;
+                    else if(bar.address && memoryDecoding && dev.memoryBase == 0)
+                        dev.memoryBase = bar.address;
                 }
-                
-                // Try to get a driver for the device, given its descriptor and the interrupt manager.
-                Driver* driver = GetDriver(dev, interrupts);
-                if(driver != 0)
-                    driverManager->AddDriver(driver);
-
-                // Print out basic PCI device information for debugging purposes.
-                printf("PCI BUS ");
-                printfHex(bus & 0xFF);
-                
-                printf(", DEVICE ");
-                printfHex(device & 0xFF);
 
-                printf(", FUNCTION ");
-                printfHex(function & 0xFF);
-                
-                printf(" = VENDOR ");
-                printfHex((dev.vendor_id & 0xFF00) >> 8);
-                printfHex(dev.vendor_id & 0xFF);
-                printf(", DEVICE ");
-                printfHex((dev.device_id & 0xFF00) >> 8);
-                printfHex(dev.device_id & 0xFF);
-                printf("\n");
+                devices[numDevices++] = dev;
             }
         }
     }
 }
 
+int PeripheralComponentInterconnectController::GetDeviceCount()
+{
+    EnumerateDevices();
+    return numDevices;
+}
+
+PeripheralComponentInterconnectDeviceDescriptor* PeripheralComponentInterconnectController::GetDevice(int i)
+{
+    EnumerateDevices();
+    if(i < 0 || i >= numDevices)
+        return 0;
+    return &devices[i];
+}
+
+/*
+ * FindDevice:
+ *  - Lets the kernel find a device (and the driver bound to it) by its IDs instead of
+ *    relying on the order in which drivers were registered.
+ */
+PeripheralComponentInterconnectDeviceDescriptor* PeripheralComponentInterconnectController::FindDevice(uint16_t vendor_id, uint16_t device_id)
+{
+    EnumerateDevices();
+    for(int i = 0; i < numDevices; i++)
+        if(devices[i].vendor_id == vendor_id && devices[i].device_id == device_id)
+            return &devices[i];
+    return 0;
+}
+
+/*
+ * SelectDrivers:
+ *  - Walks the device cache once (filling it first if necessary) and attempts to
+ *    select an appropriate driver for each device with GetDriver().
+ *  - A driver that is created is recorded in the descriptor and added to the provided DriverManager.
+ *  - Finally, prints out basic information (bus, device, function, vendor_id, device_id) for each device found.
+ */
+void PeripheralComponentInterconnectController::SelectDrivers(DriverManager* driverManager, myos::hardwarecommunication::InterruptManager* interrupts)
+{
+    EnumerateDevices();
+
+    for(int i = 0; i < numDevices; i++)
+    {
+        PeripheralComponentInterconnectDeviceDescriptor* dev = &devices[i];
+
+        // Try to get a driver for the device, given its descriptor and the interrupt manager.
+        if(dev->driver == 0)
+        {
+            dev->driver = GetDriver(dev, interrupts);
+            if(dev->driver != 0)
+                driverManager->AddDriver(dev->driver);
+        }
+
+        // Print out basic PCI device information for debugging purposes.
+        printf("PCI BUS ");
+        printfHex(dev->bus & 0xFF);
+        
+        printf(", DEVICE ");
+        printfHex(dev->device & 0xFF);
+
+        printf(", FUNCTION ");
+        printfHex(dev->function & 0xFF);
+        
+        printf(" = VENDOR ");
+        printfHex((dev->vendor_id & 0xFF00) >> 8);
+        printfHex(dev->vendor_id & 0xFF);
+        printf(", DEVICE ");
+        printfHex((dev->device_id & 0xFF00) >> 8);
+        printfHex(dev->device_id & 0xFF);
+        printf("\n");
+    }
+}
+
 /*
  * GetBaseAddressRegister:
  *  - Retrieves one of the device's Base Address Registers (BARs) from the PCI configuration space.
@@ -200,6 +355,10 @@ void PeripheralComponentInterconnectController::SelectDrivers(DriverManager* dri
 BaseAddressRegister PeripheralComponentInterconnectController::GetBaseAddressRegister(uint16_t bus, uint16_t device, uint16_t function, uint16_t bar)
 {
     BaseAddressRegister result;
+    result.address = 0;
+    result.size = 0;
+    result.prefetchable = false;
+    result.type = MemoryMapping;
     
     // Get the header type (header type is in register 0x0E, masked by 0x7F to ignore multi-function flag)
     uint32_t headertype = Read(bus, device, function, 0x0E) & 0x7F;
@@ -214,68 +373,89 @@ BaseAddressRegister PeripheralComponentInterconnectController::GetBaseAddressReg
     
     if(result.type == MemoryMapping)
     {
-        // For memory-mapped BARs, additional interpretation of bits may be required
-        // (e.g., handling 32-bit vs. 64-bit BARs), but here the code is minimal.
+        // Bits 2:1 give the BAR width. A 64 bit BAR continues in the next register; only
+        // the lower 4 GB are identity mapped, so the kernel can reach it only if the upper
+        // half is zero.
         switch((bar_value >> 1) & 0x3)
         {
             case 0: // 32 Bit Mode
             case 1: // 20 Bit Mode
+                result.address = (uint8_t*)(uintptr_t)(bar_value & ~0xF);
+                break;
             case 2: // 64 Bit Mode
+                if(bar + 1 < maxBARs && Read(bus, device, function, 0x10 + 4 * (bar + 1)) == 0)
+                    result.address = (uint8_t*)(uintptr_t)(bar_value & ~0xF);
                 break;
         }
+        // Bit 3 marks the region as prefetchable (e.g., framebuffers)
+        result.prefetchable = ((bar_value >> 3) & 0x1) == 0x1;
     }
     else // For I/O BARs:
     {
         // Mask off the lower two bits to get the base I/O address
-        result.address = (uint8_t*)(bar_value & ~0x3);
+        result.address = (uint8_t*)(uintptr_t)(bar_value & ~0x3);
         result.prefetchable = false;  // I/O regions are not prefetchable.
     }
     
     return result;
 }
 
+/*
+ * driverTable:
+ *  - The drivers the kernel knows, tried in this order. Each driver lists the devices
+ *    it handles in its own pciMatches table and creates itself in its static Probe.
+ */
+const PeripheralComponentInterconnectDriverEntry PeripheralComponentInterconnectController::driverTable[] =
+{
+    { "AMD am79c973", amd_am79c973::pciMatches, amd_am79c973::Probe },
+    { "BGA", BochsGraphicsAdapter::pciMatches, BochsGraphicsAdapter::Probe },
+    { 0, 0, 0 }
+};
+
+/*
+ * Matches:
+ *  - Every field has to be equal or a wildcard. The class codes are compared as the
+ *    8-bit values they are in configuration space.
+ */
+bool PeripheralComponentInterconnectMatch::Matches(const PeripheralComponentInterconnectDeviceDescriptor& dev) const
+{
+    return (vendor_id == Any || vendor_id == dev.vendor_id)
+        && (device_id == Any || device_id == dev.device_id)
+        && (class_id == Any || class_id == dev.class_id)
+        && (subclass_id == Any || subclass_id == dev.subclass_id)
+        && (interface_id == Any || interface_id == dev.interface_id);
+}
+
 /*
  * GetDriver:
- *  - Based on the device descriptor, attempts to instantiate an appropriate driver.
- *  - For known vendors and devices, this function creates a new driver object.
- *
- *  Example:
- *    - For vendor 0x1022 (AMD) and device 0x2000, an instance of amd_am79c973 is allocated.
- *    - The driver is constructed using placement new on memory allocated by the active MemoryManager.
- *
- *  If a known driver cannot be created, additional checks (such as checking dev.class_id)
- *  can be performed (e.g., for VGA, network, etc.). Currently, only the AMD am79c973 is handled.
+ *  - Tries the entries of driverTable in order. The first entry with a match for the device
+ *    gets to probe it; if the probe declines (returns 0), the search goes on with the next entry.
+ *  - The driver's name is printed in front of the device's line, as before.
+ *  - Devices without a driver that are graphics (class_id 0x03) and specifically VGA
+ *    (subclass_id 0x00) are reported; plain VGA is driven through its fixed ports and
+ *    needs no PCI driver.
  */
-Driver* PeripheralComponentInterconnectController::GetDriver(PeripheralComponentInterconnectDeviceDescriptor dev, InterruptManager* interrupts)
+Driver* PeripheralComponentInterconnectController::GetDriver(PeripheralComponentInterconnectDeviceDescriptor* dev, InterruptManager* interrupts)
 {
-    Driver* driver = 0;
-    switch(dev.vendor_id)
+    for(const PeripheralComponentInterconnectDriverEntry* entry = driverTable; entry->probe != 0; entry++)
     {
-        case 0x1022: // AMD
-            switch(dev.device_id)
-            {
-                case 0x2000: // am79c973 network card
-                    printf("AMD am79c973 ");
-                    driver = (amd_am79c973*)MemoryManager::activeMemoryManager->malloc(sizeof(amd_am79c973));
-                    if(driver != 0)
-                        new (driver) amd_am79c973(&dev, interrupts); // Placement new: construct the driver in allocated memory
-                    else
-                        printf("instantiation failed");
-                    return driver;
-                    break;
-            }
-            break;
+        const PeripheralComponentInterconnectMatch* match = entry->matches;
+        while(match->vendor_id != 0 && !match->Matches(*dev))
+            match++;
+        if(match->vendor_id == 0)
+            continue;
 
-        case 0x8086: // Intel devices
-            break;
+        printf((char*)entry->name);
+        printf(" ");
+        Driver* driver = entry->probe(this, dev, interrupts);
+        if(driver != 0)
+            return driver;
     }
     
-    // As an additional check, for devices classified as graphics (class_id 0x03)
-    // and specifically VGA (subclass_id 0x00), you might instantiate a VGA driver.
-    switch(dev.class_id)
+    switch(dev->class_id)
     {
         case 0x03: // Graphics devices
-            switch(dev.subclass_id)
+            switch(dev->subclass_id)
             {
                 case 0x00: // VGA-compliant device
                     printf("VGA ");
@@ -284,7 +464,7 @@ Driver* PeripheralComponentInterconnectController::GetDriver(PeripheralComponent
             break;
     }
     
-    return driver;
+    return 0;
 }
 
 /*
@@ -300,6 +480,10 @@ PeripheralComponentInterconnectDeviceDescriptor PeripheralComponentInterconnectC
     result.bus = bus;
     result.device = device;
     result.function = function;
+    result.portBase = 0;
+    result.memoryBase = 0;
+    result.driver = 0;
+    result.interruptVector = 0;
     
     // Vendor and Device ID are stored in the first 4 bytes
     result.vendor_id = Read(bus, device, function, 0x00);
@@ -317,3 +501,172 @@ PeripheralComponentInterconnectDeviceDescriptor PeripheralComponentInterconnectC
     
     return result;
 }
+
+/*
+ * FindCapability:
+ *  - Bit 4 of the status register says whether there is a capability list; its first
+ *    entry is at the offset in register 0x34. Each entry starts with its ID and the
+ *    offset of the next one (0 at the end).
+ *  - The walk is bounded, so a broken list can't loop forever.
+ */
+uint8_t PeripheralComponentInterconnectController::FindCapability(PeripheralComponentInterconnectDeviceDescriptor* dev, uint8_t id)
+{
+    if((Read(dev->bus, dev->device, dev->function, 0x06) & (1 << 4)) == 0)
+        return 0;
+
+    uint8_t offset = Read(dev->bus, dev->device, dev->function, 0x34) & 0xFC;
+    for(int i = 0; i < 48 && offset >= 0x40; i++)
+    {
+        uint32_t header = Read(dev->bus, dev->device, dev->function, offset);
+        if((header & 0xFF) == id)
+            return offset;
+        offset = (header >> 8) & 0xFC;
+    }
+    return 0;
+}
+
+/*
+ * SetCommandBits:
+ *  - The command register shares its dword with the status register, whose bits are
+ *    cleared by writing ones, so the upper half is written as 0.
+ */
+void PeripheralComponentInterconnectController::SetCommandBits(PeripheralComponentInterconnectDeviceDescriptor* dev, uint16_t bits)
+{
+    uint16_t command = Read(dev->bus, dev->device, dev->function, 0x04);
+    Write(dev->bus, dev->device, dev->function, 0x04, command | bits);
+}
+
+/*
+ * EnableMessageSignaledInterrupt:
+ *  - Message control (upper half of the first dword): bit 0 enables MSI, bits 4-6 select
+ *    how many messages are used (0 = one), bit 7 says whether the address is 64 bits wide,
+ *    which moves the data register from 0x08 to 0x0C.
+ *  - A message is a memory write by the device, so bus mastering (command bit 2) must be
+ *    on; command bit 10 disables the IRQ line.
+ */
+bool PeripheralComponentInterconnectController::EnableMessageSignaledInterrupt(PeripheralComponentInterconnectDeviceDescriptor* dev, uint8_t vector, uint8_t destination)
+{
+    uint8_t capability = FindCapability(dev, CapabilityMessageSignaledInterrupt);
+    if(capability == 0)
+        return false;
+
+    uint32_t header = Read(dev->bus, dev->device, dev->function, capability);
+    uint16_t control = header >> 16;
+
+    Write(dev->bus, dev->device, dev->function, capability + 0x04,
+          LocalAdvancedProgrammableInterruptController::MessageAddress(destination));
+    if(control & (1 << 7))
+    {
+        Write(dev->bus, dev->device, dev->function, capability + 0x08, 0);
+        Write(dev->bus, dev->device, dev->function, capability + 0x0C,
+              LocalAdvancedProgrammableInterruptController::MessageData(vector));
+    }
+    else
+    {
+        Write(dev->bus, dev->device, dev->function, capability + 0x08,
+              LocalAdvancedProgrammableInterruptController::MessageData(vector));
+    }
+
+    control = (control & ~0x0070) | 0x0001;
+    Write(dev->bus, dev->device, dev->function, capability, ((uint32_t)control << 16) | (header & 0xFFFF));
+    SetCommandBits(dev, (1 << 2) | (1 << 10));
+    return true;
+}
+
+/*
+ * GetExtendedMessageSignaledInterruptTable:
+ *  - The dword after the capability header gives the table's BAR (bits 0-2) and its
+ *    offset in that BAR. Message control bits 0-10 hold the number of entries minus one;
+ *    each entry is 16 bytes.
+ */
+MemoryMappedRegion PeripheralComponentInterconnectController::GetExtendedMessageSignaledInterruptTable(PeripheralComponentInterconnectDeviceDescriptor* dev, uint8_t capability)
+{
+    if(capability == 0)
+        return MemoryMappedRegion();
+
+    uint16_t control = Read(dev->bus, dev->device, dev->function, capability + 0x02);
+    uint32_t table = Read(dev->bus, dev->device, dev->function, capability + 0x04);
+    BaseAddressRegister bar = GetBaseAddressRegister(dev->bus, dev->device, dev->function, table & 0x7);
+    if(bar.type != MemoryMapping || bar.address == 0)
+        return MemoryMappedRegion();
+
+    return MemoryMappedRegion(bar.address + (table & ~0x7), ((control & 0x7FF) + 1) * 16);
+}
+
+int PeripheralComponentInterconnectController::GetExtendedMessageSignaledInterruptCount(PeripheralComponentInterconnectDeviceDescriptor* dev)
+{
+    uint8_t capability = FindCapability(dev, CapabilityExtendedMessageSignaledInterrupt);
+    return GetExtendedMessageSignaledInterruptTable(dev, capability).GetSize() / 16;
+}
+
+/*
+ * EnableExtendedMessageSignaledInterrupt:
+ *  - An entry holds the message address (low, high), the data and the vector control
+ *    word, whose bit 0 masks it. Entries come out of reset masked.
+ *  - Message control bit 15 enables MSI-X, bit 14 masks all entries at once; the
+ *    function mask is cleared, so entries not set up this way stay masked individually.
+ *  - The table lives in a memory BAR, so memory decoding (command bit 1) is needed as
+ *    well as bus mastering; command bit 10 disables the IRQ line.
+ */
+bool PeripheralComponentInterconnectController::EnableExtendedMessageSignaledInterrupt(PeripheralComponentInterconnectDeviceDescriptor* dev, uint16_t entry, uint8_t vector, uint8_t destination)
+{
+    uint8_t capability = FindCapability(dev, CapabilityExtendedMessageSignaledInterrupt);
+    MemoryMappedRegion table = GetExtendedMessageSignaledInterruptTable(dev, capability);
+    if(!table.IsValid() || (uint32_t)entry * 16 >= table.GetSize())
+        return false;
+
+    SetCommandBits(dev, (1 << 1) | (1 << 2) | (1 << 10));
+
+    uint32_t offset = (uint32_t)entry * 16;
+    table.Write<uint32_t>(offset + 0x0, LocalAdvancedProgrammableInterruptController::MessageAddress(destination));
+    table.Write<uint32_t>(offset + 0x4, 0);
+    table.Write<uint32_t>(offset + 0x8, LocalAdvancedProgrammableInterruptController::MessageData(vector));
+    table.Write<uint32_t>(offset + 0xC, 0);
+
+    uint32_t header = Read(dev->bus, dev->device, dev->function, capability);
+    uint16_t control = ((header >> 16) & ~(1 << 14)) | (1 << 15);
+    Write(dev->bus, dev->device, dev->function, capability, ((uint32_t)control << 16) | (header & 0xFFFF));
+    return true;
+}
+
+void PeripheralComponentInterconnectController::MaskExtendedMessageSignaledInterrupt(PeripheralComponentInterconnectDeviceDescriptor* dev, uint16_t entry, bool masked)
+{
+    uint8_t capability = FindCapability(dev, CapabilityExtendedMessageSignaledInterrupt);
+    MemoryMappedRegion table = GetExtendedMessageSignaledInterruptTable(dev, capability);
+    if(!table.IsValid() || (uint32_t)entry * 16 >= table.GetSize())
+        return;
+
+    uint32_t offset = (uint32_t)entry * 16 + 0xC;
+    uint32_t vectorControl = table.Read<uint32_t>(offset);
+    table.Write<uint32_t>(offset, masked ? (vectorControl | 1) : (vectorControl & ~1));
+}
+
+/*
+ * AllocateInterrupt:
+ *  - MSI-X is preferred over MSI, as its entries can be masked individually.
+ *  - The interrupt is targeted at the processor running this code (the only one so far).
+ *  - If neither can be set up, the vector goes back and the IRQ line is used. Devices
+ *    without either capability don't take a vector at all (nor switch the APIC on).
+ */
+uint8_t PeripheralComponentInterconnectController::AllocateInterrupt(PeripheralComponentInterconnectDeviceDescriptor* dev, InterruptManager* interrupts)
+{
+    uint8_t vector = 0;
+    if(GetExtendedMessageSignaledInterruptCount(dev) > 0
+    || FindCapability(dev, CapabilityMessageSignaledInterrupt) != 0)
+        vector = interrupts->AllocateMessageVector();
+
+    if(vector != 0)
+    {
+        uint8_t destination = LocalAdvancedProgrammableInterruptController::GetId();
+        if(EnableExtendedMessageSignaledInterrupt(dev, 0, vector, destination)
+        || EnableMessageSignaledInterrupt(dev, vector, destination))
+        {
+            dev->interruptVector = vector;
+            return vector;
+        }
+        interrupts->FreeMessageVector(vector);
+    }
+
+    dev->interruptVector = dev->interrupt + interrupts->HardwareInterruptOffset();
+    return dev->interruptVector;
+}
@@ -18,6 +18,9 @@ using namespace myos::hardwarecommunication;
  * which represents an I/O port address in the x86 architecture. The derived classes
  * implement specific word-length operations (8-bit, 16-bit, 32-bit).
  *
+ * The Read/Write methods are defined inline in port.h, so only the constructors
+ * and destructors are left here.
+ *
  * Note: The destructor is not declared virtual because memory management in this
  * simple kernel might not support full C++ polymorphism yet.
  */
@@ -62,26 +65,6 @@ Port8Bit::~Port8Bit()
 {
 }
 
-/*
- * Write:
- *  - Writes an 8-bit value to the I/O port.
- *  - Calls the static inline function Write8, passing the stored port number and the data.
- */
-void Port8Bit::Write(uint8_t data)
-{
-    Write8(portnumber, data);
-}
-
-/*
- * Read:
- *  - Reads an 8-bit value from the I/O port.
- *  - Calls the static inline function Read8 with the stored port number.
- */
-uint8_t Port8Bit::Read()
-{
-    return Read8(portnumber);
-}
-
 
 /*
  * ----------------------------------------------------------------------------
@@ -108,16 +91,6 @@ Port8BitSlow::~Port8BitSlow()
 {
 }
 
-/*
- * Write:
- *  - Uses the slow version of the write operation.
- *  - Calls the static inline function Write8Slow with the port number and data.
- */
-void Port8BitSlow::Write(uint8_t data)
-{
-    Write8Slow(portnumber, data);
-}
-
 
 /*
  * ----------------------------------------------------------------------------
@@ -143,24 +116,6 @@ Port16Bit::~Port16Bit()
 {
 }
 
-/*
- * Write:
- *  - Writes a 16-bit value to the specified I/O port using Write16.
- */
-void Port16Bit::Write(uint16_t data)
-{
-    Write16(portnumber, data);
-}
-
-/*
- * Read:
- *  - Reads a 16-bit value from the specified I/O port using Read16.
- */
-uint16_t Port16Bit::Read()
-{
-    return Read16(portnumber);
-}
-
 
 /*
  * ----------------------------------------------------------------------------
@@ -186,20 +141,3 @@ Port32Bit::~Port32Bit()
 {
 }
 
-/*
- * Write:
- *  - Writes a 32-bit value to the I/O port using Write32.
- */
-void Port32Bit::Write(uint32_t data)
-{
-    Write32(portnumber, data);
-}
-
-/*
- * Read:
- *  - Reads a 32-bit value from the I/O port using Read32.
- */
-uint32_t Port32Bit::Read()
-{
-    return Read32(portnumber);
-}
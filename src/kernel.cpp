@@ -7,10 +7,19 @@
 #include <drivers/driver.h>
 #include <drivers/keyboard.h>
 #include <drivers/mouse.h>
+#include <drivers/inputqueue.h>
 #include <drivers/vga.h>
+#include <drivers/bga.h>
 #include <drivers/ata.h>
+#include <hardwarecommunication/cpu.h>
+#include <common/pixelkernels.h>
+#include <common/surface.h>
 #include <gui/desktop.h>
 #include <gui/window.h>
+#include <gui/label.h>
+#include <gui/textbox.h>
+#include <gui/framescheduler.h>
+#include <common/glyphcache.h>
 #include <multitasking.h>
 
 #include <drivers/amd_am79c973.h>
@@ -22,6 +31,7 @@
 #include <net/tcp.h>
 
 // #define GRAPHICSMODE
+// #define GRAPHICSBENCHMARK
 
 using namespace myos;
 using namespace myos::common;
@@ -266,6 +276,118 @@ void taskB()
         sysprintf("B");
 }
 
+#ifdef GRAPHICSBENCHMARK
+/*
+ * printfDec:
+ *  Prints a 32-bit value in decimal.
+ */
+void printfDec(uint32_t value)
+{
+    char buffer[11];
+    int i = 10;
+    buffer[i] = '\0';
+    do
+    {
+        buffer[--i] = '0' + value % 10;
+        value /= 10;
+    } while(value != 0);
+    printf(buffer + i);
+}
+
+/*
+ * PrintPixelRate:
+ *  Prints "name: N MPix/s" for 'pixels' pixels drawn in 'cycles' TSC ticks.
+ *  Pixels per microsecond equal megapixels per second; this keeps the math in
+ *  32 bits (the kernel has no 64-bit division).
+ */
+void PrintPixelRate(char* name, uint32_t pixels, uint32_t cycles, uint32_t mhz)
+{
+    uint32_t microseconds = cycles / mhz;
+    printf(name);
+    printf(": ");
+    printfDec(microseconds == 0 ? 0 : pixels / microseconds);
+    printf(" MPix/s\n");
+}
+
+/*
+ * BenchmarkPixelKernels:
+ *  Measures the throughput of the drawing primitives with every available set
+ *  of PixelKernels on 640x480 surfaces, then restores the selected set.
+ *  The color key source has 16 pixel wide stripes of the key, so opaque, fully
+ *  keyed and mixed blocks all occur.
+ */
+void BenchmarkPixelKernels(bool sse2)
+{
+    const int32_t width = 640;
+    const int32_t height = 480;
+    const int32_t iterations = 16;
+    const uint32_t pixels = width * height * iterations;
+
+    uint32_t mhz = CentralProcessingUnit::TimeStampCounterMHz();
+    if(mhz == 0)
+    {
+        printf("benchmark: no time stamp counter\n");
+        return;
+    }
+
+    static uint32_t palette[256];
+    for(int i = 0; i < 256; i++)
+        palette[i] = i * 0x010101;
+
+    Surface screen(width, height, XRGB8888);
+    Surface screen8(width, height, Indexed8, palette);
+    Surface image(width, height, XRGB8888);
+    Surface image8(width, height, Indexed8, palette);
+    if(!screen.IsValid() || !screen8.IsValid() || !image.IsValid() || !image8.IsValid())
+    {
+        printf("benchmark: out of memory\n");
+        return;
+    }
+    for(int32_t y = 0; y < height; y++)
+        for(int32_t x = 0; x < width; x++)
+        {
+            image.PutPixel(x, y, ((x / 16) & 1) ? (uint32_t)0xFF00FF : (uint32_t)(x * y));
+            image8.PutPixel(x, y, (uint32_t)((x + y) & 0xFF));
+        }
+
+    PixelKernels* selected = PixelKernels::active;
+    PixelKernels* candidates[2] = { &PixelKernels::scalar, &PixelKernels::sse2 };
+    for(int c = 0; c < (sse2 ? 2 : 1); c++)
+    {
+        PixelKernels::active = candidates[c];
+        printf("-- ");
+        printf((char*)candidates[c]->name);
+        printf(" --\n");
+
+        uint64_t start = CentralProcessingUnit::ReadTimeStampCounter();
+        for(int i = 0; i < iterations; i++)
+            screen8.FillRectangle(0, 0, width, height, (uint32_t)i);
+        PrintPixelRate("fill 8bpp", pixels, CentralProcessingUnit::ReadTimeStampCounter() - start, mhz);
+
+        start = CentralProcessingUnit::ReadTimeStampCounter();
+        for(int i = 0; i < iterations; i++)
+            screen.FillRectangle(0, 0, width, height, (uint32_t)(i * 0x010203));
+        PrintPixelRate("fill 32bpp", pixels, CentralProcessingUnit::ReadTimeStampCounter() - start, mhz);
+
+        start = CentralProcessingUnit::ReadTimeStampCounter();
+        for(int i = 0; i < iterations; i++)
+            screen.Blit(&image, 0, 0, width, height, 0, 0);
+        PrintPixelRate("blit 32bpp", pixels, CentralProcessingUnit::ReadTimeStampCounter() - start, mhz);
+
+        start = CentralProcessingUnit::ReadTimeStampCounter();
+        for(int i = 0; i < iterations; i++)
+            screen.BlitColorKey(&image, 0, 0, width, height, 0, 0, 0xFF00FF);
+        PrintPixelRate("color key blit 32bpp", pixels, CentralProcessingUnit::ReadTimeStampCounter() - start, mhz);
+
+        start = CentralProcessingUnit::ReadTimeStampCounter();
+        for(int i = 0; i < iterations; i++)
+            screen.Blit(&image8, 0, 0, width, height, 0, 0);
+        PrintPixelRate("palette 8bpp to 32bpp", pixels, CentralProcessingUnit::ReadTimeStampCounter() - start, mhz);
+    }
+    PixelKernels::active = selected;
+}
+#endif
+
 /*
  * callConstructors:
  *  Called during early boot to invoke global C++ constructors in the kernel.
@@ -310,6 +432,16 @@ extern "C" void kernelMain(const void* multiboot_structure, uint32_t /*multiboot
     printf("\nallocated: 0x");
     printfHex32((size_t)allocated);
     printf("\n");
+
+    // Let the drawing code use SSE2 if the processor supports it
+    bool sse2 = CentralProcessingUnit::EnableSSE();
+    PixelKernels::Select(sse2);
+    printf("pixel kernels: ");
+    printf((char*)PixelKernels::active->name);
+    printf("\n");
+    #ifdef GRAPHICSBENCHMARK
+        BenchmarkPixelKernels(sse2);
+    #endif
     
     /*
      * The TaskManager can schedule multiple tasks (taskA, taskB, etc.).
@@ -331,17 +463,24 @@ extern "C" void kernelMain(const void* multiboot_structure, uint32_t /*multiboot
     printf("Initializing Hardware, Stage 1\n");
     
     #ifdef GRAPHICSMODE
-        // Create a GUI desktop if we are in graphic mode
+        // Create a GUI desktop if we are in graphic mode, and the glyph cache its text is drawn with
         Desktop desktop(320,200, 0x00,0x00,0xA8);
+        GlyphCache glyphCache(&Font::builtin);
     #endif
     
     // DriverManager allows us to register and activate multiple drivers
     DriverManager drvManager;
     
+    #ifdef GRAPHICSMODE
+        // In graphics mode, the drivers only queue their events; the GUI loop passes them on
+        // to the desktop, outside of the interrupt handlers
+        InputQueue input(&desktop, &desktop);
+    #endif
+
     // Keyboard setup
     #ifdef GRAPHICSMODE
-        // If in graphics mode, pass keyboard events to the desktop
-        KeyboardDriver keyboard(&interrupts, &desktop);
+        // If in graphics mode, pass keyboard events to the desktop (through the queue)
+        KeyboardDriver keyboard(&interrupts, &input);
     #else
         // Otherwise, print characters to the console
         PrintfKeyboardEventHandler kbhandler;
@@ -351,7 +490,7 @@ extern "C" void kernelMain(const void* multiboot_structure, uint32_t /*multiboot
     
     // Mouse setup
     #ifdef GRAPHICSMODE
-        MouseDriver mouse(&interrupts, &desktop);
+        MouseDriver mouse(&interrupts, &input);
     #else
         MouseToConsole mousehandler;
         MouseDriver mouse(&interrupts, &mousehandler);
@@ -365,6 +504,10 @@ extern "C" void kernelMain(const void* multiboot_structure, uint32_t /*multiboot
     #ifdef GRAPHICSMODE
         // Provide a VGA driver if we are using graphics mode
         VideoGraphicsArray vga;
+        VideoGraphicsArray* display = &vga;
+
+        // If the PCI scan found a Bochs/QEMU/VirtualBox adapter, prefer its linear framebuffer
+        BochsGraphicsAdapter* bga = BochsGraphicsAdapter::activeAdapter;
     #endif
     
     printf("Initializing Hardware, Stage 2\n");
@@ -373,12 +516,31 @@ extern "C" void kernelMain(const void* multiboot_structure, uint32_t /*multiboot
     printf("Initializing Hardware, Stage 3\n");
 
     #ifdef GRAPHICSMODE
-        // If in graphics mode, set 320x200x8, and add two small windows
-        vga.SetMode(320,200,8);
+        // If in graphics mode, set 1024x768x32 on the BGA (falling back to VGA 320x200x8),
+        // and add two small windows
+        if(bga != 0 && bga->SetMode(1024,768,32))
+        {
+            display = bga;
+            desktop.Resize(1024,768);
+        }
+        else
+            vga.SetMode(320,200,8);
         Window win1(&desktop, 10,10,20,20, 0xA8,0x00,0x00);
         desktop.AddChild(&win1);
         Window win2(&desktop, 40,15,30,30, 0x00,0xA8,0x00);
         desktop.AddChild(&win2);
+
+        // A console window: click it to type into the text box
+        Window console(&desktop, 60,60,200,120, 0x54,0x54,0x54);
+        Label consoleTitle(&console, 2,2,196,16, "Console", 0xFF,0xFF,0xFF, 0x54,0x54,0x54);
+        console.AddChild(&consoleTitle);
+        TextBox consoleText(&console, 2,20,196,98, 0xA8,0xA8,0xA8, 0x00,0x00,0x00);
+        console.AddChild(&consoleText);
+        consoleText.Write("MyOS\n");
+        desktop.AddChild(&console);
+
+        // Pace rendering (and input handling) to the display's refresh
+        FrameScheduler frames(&desktop, display, &input);
     #endif
 
     /*
@@ -390,68 +552,86 @@ extern "C" void kernelMain(const void* multiboot_structure, uint32_t /*multiboot
      *  ata0m.Read28(...), ata0m.Write28(...), etc.
      */
 
-    // Grab the AMD am79c973 (Ethernet) driver from the driver manager
-    amd_am79c973* eth0 = (amd_am79c973*)(drvManager.drivers[2]);
-
-    // Assign IP address 10.0.2.15 (in big-endian)
-    uint8_t ip1 = 10, ip2 = 0, ip3 = 2, ip4 = 15;
-    uint32_t ip_be = ((uint32_t)ip4 << 24)
-                  | ((uint32_t)ip3 << 16)
-                  | ((uint32_t)ip2 << 8)
-                  |  (uint32_t)ip1;
-    eth0->SetIPAddress(ip_be);
+    // Look up the AMD am79c973 (Ethernet) card among the PCI devices and take the driver bound to it
+    PeripheralComponentInterconnectDeviceDescriptor* nic = PCIController.FindDevice(0x1022, 0x2000);
+    amd_am79c973* eth0 = (nic != 0) ? (amd_am79c973*)nic->driver : 0;
+    if(eth0 != 0)
+    {
+        // Assign IP address 10.0.2.15 (in big-endian)
+        uint8_t ip1 = 10, ip2 = 0, ip3 = 2, ip4 = 15;
+        uint32_t ip_be = ((uint32_t)ip4 << 24)
+                      | ((uint32_t)ip3 << 16)
+                      | ((uint32_t)ip2 << 8)
+                      |  (uint32_t)ip1;
+        eth0->SetIPAddress(ip_be);
+
+        // Receive frames in the main loop rather than in the NIC's interrupt handler,
+        // which only queues them; the protocol handlers then run with interrupts on
+        eth0->SetDeferredReceive(true);
+
+        // The protocol stack outlives this block (the main loop below never returns),
+        // so its layers come from the heap rather than from the stack.
+
+        // Create an EtherFrameProvider to send/receive raw Ethernet frames
+        EtherFrameProvider* etherframe = new EtherFrameProvider(eth0);
+
+        // ARP resolves IP <-> MAC addresses on the local network
+        AddressResolutionProtocol* arp = new AddressResolutionProtocol(etherframe);
+        
+        // Default gateway: 10.0.2.2
+        uint8_t gip1 = 10, gip2 = 0, gip3 = 2, gip4 = 2;
+        uint32_t gip_be = ((uint32_t)gip4 << 24)
+                        | ((uint32_t)gip3 << 16)
+                        | ((uint32_t)gip2 << 8)
+                        |  (uint32_t)gip1;
+        
+        // Subnet mask: 255.255.255.0
+        uint8_t subnet1 = 255, subnet2 = 255, subnet3 = 255, subnet4 = 0;
+        uint32_t subnet_be = ((uint32_t)subnet4 << 24)
+                           | ((uint32_t)subnet3 << 16)
+                           | ((uint32_t)subnet2 << 8)
+                           |  (uint32_t)subnet1;
+                       
+        // Provide IPv4 on top of EtherFrame + ARP. Pass gateway & subnet.
+        InternetProtocolProvider* ipv4 = new InternetProtocolProvider(etherframe, arp, gip_be, subnet_be);
+        
+        // ICMP (for pings)
+        new InternetControlMessageProtocol(ipv4);
 
-    // Create an EtherFrameProvider to send/receive raw Ethernet frames
-    EtherFrameProvider etherframe(eth0);
+        // UDP support
+        new UserDatagramProtocolProvider(ipv4);
 
-    // ARP resolves IP <-> MAC addresses on the local network
-    AddressResolutionProtocol arp(&etherframe);
-    
-    // Default gateway: 10.0.2.2
-    uint8_t gip1 = 10, gip2 = 0, gip3 = 2, gip4 = 2;
-    uint32_t gip_be = ((uint32_t)gip4 << 24)
-                    | ((uint32_t)gip3 << 16)
-                    | ((uint32_t)gip2 << 8)
-                    |  (uint32_t)gip1;
-    
-    // Subnet mask: 255.255.255.0
-    uint8_t subnet1 = 255, subnet2 = 255, subnet3 = 255, subnet4 = 0;
-    uint32_t subnet_be = ((uint32_t)subnet4 << 24)
-                       | ((uint32_t)subnet3 << 16)
-                       | ((uint32_t)subnet2 << 8)
-                       |  (uint32_t)subnet1;
-                   
-    // Provide IPv4 on top of EtherFrame + ARP. Pass gateway & subnet.
-    InternetProtocolProvider ipv4(&etherframe, &arp, gip_be, subnet_be);
-    
-    // ICMP (for pings)
-    InternetControlMessageProtocol icmp(&ipv4);
+        // TCP support
+        TransmissionControlProtocolProvider* tcp = new TransmissionControlProtocolProvider(ipv4);
 
-    // UDP support
-    UserDatagramProtocolProvider udp(&ipv4);
+        // Ask for the gateway's MAC; the reply fills the ARP cache once the main loop handles it
+        arp->RequestMACAddress(gip_be);
+        
+        // Listen on TCP port 1234. The listening socket stays open; each connection gets
+        // a socket of its own (with this handler) that is freed when the connection closes
+        TransmissionControlProtocolSocket* tcpsocket = tcp->Listen(1234);
+        tcp->Bind(tcpsocket, new PrintfTCPHandler());
+    }
+    else
+        printf("No network card found\n");
 
-    // TCP support
-    TransmissionControlProtocolProvider tcp(&ipv4);
-    
     // Enable interrupts
     interrupts.Activate();
 
     printf("\n\n\n\n");
-    
-    // Attempt to discover and cache the gateway's MAC via ARP
-    arp.BroadcastMACAddress(gip_be);
-    
-    // Listen on TCP port 1234
-    PrintfTCPHandler tcphandler;
-    TransmissionControlProtocolSocket* tcpsocket = tcp.Listen(1234);
-    tcp.Bind(tcpsocket, &tcphandler);
 
     // Main loop
     while(1)
     {
+        // Hand the frames the NIC has queued since the last pass to the protocol stack
+        if(eth0 != 0)
+            eth0->ProcessReceived();
+
         #ifdef GRAPHICSMODE
-            // Continuously redraw the desktop in graphics mode
-            desktop.Draw(&vga);
+            // Once per refresh: handle queued input, show the last frame and the cursor
+            // during the vertical retrace, then render the next frame if something changed;
+            // with the BGA the frame is drawn into the hidden page and flipped at the next retrace
+            frames.RunFrame();
         #endif
     }
 }
@@ -0,0 +1,179 @@
+.set MAGIC, 0x1badb002                 # The Multiboot "magic number" required by Multiboot-compliant bootloaders
+.set FLAGS, (1<<0 | 1<<1)              # Multiboot flags. Here we set:
+                                       #   bit 0: align the modules on page boundaries
+                                       #   bit 1: indicate we want information about memory layout
+.set CHECKSUM, -(MAGIC + FLAGS)        # The checksum ensures (MAGIC + FLAGS + CHECKSUM) == 0 (32-bit wraparound).
+
+.set KERNEL_CODE_SELECTOR, 0x10        # The selectors of gdt64 below, which are the same as those of
+.set KERNEL_DATA_SELECTOR, 0x18        # GlobalDescriptorTable (it replaces gdt64 in kernelMain).
+
+##
+# .multiboot section:
+#   The same header as in loader.s. The boot loader starts both builds in 32-bit
+#   protected mode; this loader takes the processor on into long mode.
+##
+.section .multiboot
+    .long MAGIC                        # 0x1badb002
+    .long FLAGS                        # The flags set above
+    .long CHECKSUM                     # Computed so that MAGIC + FLAGS + CHECKSUM == 0
+
+
+.section .text
+.extern kernelMain
+.extern callConstructors
+.global loader
+
+
+##
+# loader:
+#   The entry point, still in 32-bit protected mode without paging.
+#   1) Check that the processor supports long mode.
+#   2) Identity map the first 4 GB with 2 MB pages (PML4 -> PDPT -> 4 page directories),
+#      so that every physical address, including the devices below 4 GB, stays where the
+#      kernel expects it.
+#   3) Enable PAE, set EFER.LME and enable paging, which activates long mode.
+#   4) Load a GDT with a 64-bit code segment and jump into it.
+##
+.code32
+loader:
+    mov $kernel_stack, %esp           # Initialize stack pointer to top of kernel stack
+    mov %ebx, %edi                    # Keep 'multiboot_structure' (first argument of kernelMain)
+    mov %eax, %esi                    # Keep 'multiboot_magic' (second argument)
+
+    # Long mode is bit 29 of EDX in CPUID leaf 0x80000001, if that leaf exists.
+    mov $0x80000000, %eax
+    cpuid
+    cmp $0x80000001, %eax
+    jb no_long_mode
+    mov $0x80000001, %eax
+    cpuid
+    test $(1<<29), %edx
+    jz no_long_mode
+
+    # PML4[0] -> PDPT. Present and writable (bits 0 and 1).
+    mov $pdpt + 0x3, %eax
+    mov %eax, pml4
+
+    # PDPT[0..3] -> the four page directories, 1 GB each.
+    mov $page_directories + 0x3, %eax
+    xor %ecx, %ecx
+1:  mov %eax, pdpt(,%ecx,8)
+    add $0x1000, %eax
+    inc %ecx
+    cmp $4, %ecx
+    jne 1b
+
+    # Page directory entries: 2 MB pages (bit 7) at 2 MB * index, present and writable.
+    # The upper halves of the entries are already 0 (.bss).
+    xor %ecx, %ecx
+2:  mov %ecx, %eax
+    shl $21, %eax
+    or $0x83, %eax
+    mov %eax, page_directories(,%ecx,8)
+    inc %ecx
+    cmp $4*512, %ecx
+    jne 2b
+
+    mov $pml4, %eax
+    mov %eax, %cr3
+
+    mov %cr4, %eax
+    or $(1<<5), %eax                  # CR4.PAE
+    mov %eax, %cr4
+
+    mov $0xC0000080, %ecx             # IA32_EFER
+    rdmsr
+    or $(1<<8), %eax                  # EFER.LME
+    wrmsr
+
+    mov %cr0, %eax
+    or $(1<<31), %eax                 # CR0.PG (protection is already on)
+    mov %eax, %cr0
+
+    lgdt gdt64_pointer
+    ljmp $KERNEL_CODE_SELECTOR, $long_mode
+
+
+##
+# no_long_mode:
+#   Prints a message to the text screen and stops: the 64-bit kernel can't run here.
+##
+no_long_mode:
+    mov $no_long_mode_message, %esi
+    mov $0xB8000, %edi
+3:  lodsb
+    test %al, %al
+    jz _stop32
+    mov $0x07, %ah                    # Light grey on black
+    stosw
+    jmp 3b
+_stop32:
+    cli
+    hlt
+    jmp _stop32
+
+
+##
+# long_mode:
+#   1) Load the data segment into the other segment registers.
+#   2) Call callConstructors (ensuring C++ global constructors are run).
+#   3) Call kernelMain(multiboot_structure, multiboot_magic); the arguments go in RDI and RSI.
+#   4) Halt in an infinite loop.
+##
+.code64
+long_mode:
+    mov $KERNEL_DATA_SELECTOR, %ax
+    mov %ax, %ds
+    mov %ax, %es
+    mov %ax, %fs
+    mov %ax, %gs
+    mov %ax, %ss
+
+    mov %edi, %r12d                   # Callee-saved copies (the upper halves become 0)
+    mov %esi, %r13d
+    call callConstructors
+
+    mov %r12, %rdi                    # 'multiboot_structure'
+    mov %r13, %rsi                    # 'multiboot_magic'
+    call kernelMain
+
+_stop:
+    cli                               # Clear interrupts
+    hlt                               # Halt the CPU
+    jmp _stop                         # Jump to itself (loop forever)
+
+
+.section .rodata
+no_long_mode_message:
+    .asciz "This kernel needs a 64-bit processor."
+
+##
+# gdt64:
+#   Null descriptor, an unused one, a 64-bit code segment (L flag) and a data segment.
+##
+.align 8
+gdt64:
+    .quad 0
+    .quad 0
+    .quad 0x00AF9A000000FFFF          # Code: present, ring 0, executable, readable, L
+    .quad 0x00CF92000000FFFF          # Data: present, ring 0, writable
+gdt64_pointer:
+    .word gdt64_pointer - gdt64 - 1
+    .long gdt64
+
+
+##
+# .bss section:
+#   The page tables (4 KB aligned) and, as in loader.s, 2 MiB for the kernel stack.
+##
+.section .bss
+.align 4096
+pml4:
+    .space 4096
+pdpt:
+    .space 4096
+page_directories:
+    .space 4*4096
+.align 16
+.space 2*1024*1024                    # Reserve 2 MiB of uninitialized space
+kernel_stack:
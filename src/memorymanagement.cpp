@@ -1,4 +1,5 @@
 #include <memorymanagement.h>
+#include <hardwarecommunication/cpu.h>
 
 /*
  * We place our code in the "myos" namespace, which provides an operating system context.
@@ -6,6 +7,7 @@
  */
 using namespace myos;
 using namespace myos::common;
+using namespace myos::hardwarecommunication;
 
 
 /*
@@ -83,10 +85,14 @@ MemoryManager::~MemoryManager()
  *      one of exactly 'size' bytes (allocated = true)
  *      and a second chunk for the remainder.
  *  - Returns a pointer to the usable memory (just after the MemoryChunk header).
+ *  - The chunk list is also changed from interrupt context (tables that are copied
+ *    on update, callbacks after a read-copy-update grace period), so malloc and
+ *    free change it with interrupts off.
  */
 void* MemoryManager::malloc(size_t size)
 {
     MemoryChunk* result = 0;
+    uintptr_t flags = CentralProcessingUnit::DisableInterrupts();
     
     // Find a free chunk with enough space
     for(MemoryChunk* chunk = first; chunk != 0 && result == 0; chunk = chunk->next)
@@ -95,7 +101,10 @@ void* MemoryManager::malloc(size_t size)
         
     // No suitable chunk found
     if(result == 0)
+    {
+        CentralProcessingUnit::RestoreInterrupts(flags);
         return 0;
+    }
     
     // If chunk is big enough to split into allocated + free remainder
     if(result->size >= size + sizeof(MemoryChunk) + 1)
@@ -116,6 +125,7 @@ void* MemoryManager::malloc(size_t size)
     
     // Mark the chosen chunk as allocated
     result->allocated = true;
+    CentralProcessingUnit::RestoreInterrupts(flags);
     // Return the address after the chunk header
     return (void*)(((size_t)result) + sizeof(MemoryChunk));
 }
@@ -129,6 +139,7 @@ void MemoryManager::free(void* ptr)
 {
     // The chunk header is located immediately before the pointer
     MemoryChunk* chunk = (MemoryChunk*)((size_t)ptr - sizeof(MemoryChunk));
+    uintptr_t flags = CentralProcessingUnit::DisableInterrupts();
     
     chunk->allocated = false;
     
@@ -151,6 +162,7 @@ void MemoryManager::free(void* ptr)
         if(chunk->next != 0)
             chunk->next->prev = chunk;
     }
+    CentralProcessingUnit::RestoreInterrupts(flags);
 }
 
 
@@ -161,11 +173,11 @@ void MemoryManager::free(void* ptr)
  */
 
 /*
- * operator new(unsigned size):
+ * operator new(size_t size):
  *   - Uses the active memory manager (if any) to allocate 'size' bytes.
  *   - Returns 0 if there's no active manager or if allocation fails.
  */
-void* operator new(unsigned size)
+void* operator new(size_t size)
 {
     if(myos::MemoryManager::activeMemoryManager == 0)
         return 0;
@@ -173,10 +185,10 @@ void* operator new(unsigned size)
 }
 
 /*
- * operator new[](unsigned size):
+ * operator new[](size_t size):
  *   - Same as operator new, but for array allocations (technically the same logic).
  */
-void* operator new[](unsigned size)
+void* operator new[](size_t size)
 {
     if(myos::MemoryManager::activeMemoryManager == 0)
         return 0;
@@ -188,12 +200,12 @@ void* operator new[](unsigned size)
  *   - These versions of new do not allocate memory but construct an object in 
  *     an already provided memory location 'ptr'.
  */
-void* operator new(unsigned size, void* ptr)
+void* operator new(size_t size, void* ptr)
 {
     return ptr;
 }
 
-void* operator new[](unsigned size, void* ptr)
+void* operator new[](size_t size, void* ptr)
 {
     return ptr;
 }
@@ -36,7 +36,22 @@ Task::Task(GlobalDescriptorTable* gdt, void entrypoint())
 {
     // Position the cpustate structure at the top of the 4 KB stack
     cpustate = (CPUState*)(stack + 4096 - sizeof(CPUState));
-    
+
+#ifdef __x86_64__
+    // All general purpose registers (rax to r15) and the error code start out as 0.
+    uint64_t* registers = (uint64_t*)cpustate;
+    for(int i = 0; i < 16; i++)
+        registers[i] = 0;
+
+    cpustate->rip = (uintptr_t)entrypoint;
+    cpustate->cs = gdt->CodeSegmentSelector();
+    cpustate->rflags = 0x202;
+
+    // IRETQ always loads SS:RSP. The task starts on its own stack (the frame above is
+    // consumed by then), aligned as if 'entrypoint' had been called.
+    cpustate->rsp = (((uintptr_t)(stack + 4096)) & ~(uintptr_t)0xF) - 8;
+    cpustate->ss = gdt->DataSegmentSelector();
+#else
     cpustate->eax = 0;
     cpustate->ebx = 0;
     cpustate->ecx = 0;
@@ -61,7 +76,7 @@ Task::Task(GlobalDescriptorTable* gdt, void entrypoint())
     // already being set to point at cpustate)
 
     // Set the instruction pointer to the entry function
-    cpustate->eip = (uint32_t)entrypoint;
+    cpustate->eip = (uintptr_t)entrypoint;
 
     // Use the code segment selector from the GDT
     cpustate->cs = gdt->CodeSegmentSelector();
@@ -70,6 +85,7 @@ Task::Task(GlobalDescriptorTable* gdt, void entrypoint())
     
     // 0x202 sets the IF bit (bit 9 = 1) for interrupts enabled, among other default flags
     cpustate->eflags = 0x202;
+#endif
 }
 
 /*
@@ -93,12 +109,11 @@ Task::~Task()
 
 /*
  * Constructor:
- *   - Initializes no tasks, and sets currentTask to -1 (no current task).
+ *   - Starts with an empty task list and no current task.
  */
 TaskManager::TaskManager()
 {
-    numTasks = 0;
-    currentTask = -1;
+    currentTask = 0;
 }
 
 /*
@@ -112,16 +127,18 @@ TaskManager::~TaskManager()
 
 /*
  * AddTask:
- *  - Attempts to add a Task to the manager’s 'tasks' array.
- *  - If the array is full (>= 256), returns false; otherwise, stores the task
- *    and returns true.
+ *  - Links the Task to the end of the run list through its own node, so there is
+ *    no limit on the number of tasks and nothing is allocated.
+ *  - Returns false if the task is already on the list.
+ *  - From now on, grace periods wait for the task's read-side sections.
  */
 bool TaskManager::AddTask(Task* task)
 {
-    if(numTasks >= 256)
+    if(task->schedulerNode.IsLinked())
         return false;
-    
-    tasks[numTasks++] = task;
+
+    ReadCopyUpdate::AddReader(&task->reader);
+    tasks.PushBack(task);
     return true;
 }
 
@@ -133,25 +150,34 @@ bool TaskManager::AddTask(Task* task)
  *
  * Steps:
  *   1) If there are no tasks, just return the current CPUState.
- *   2) Save the outgoing task’s CPUState (if currentTask >= 0).
- *   3) Increment currentTask to choose the next index (round-robin). 
- *      Wrap around with modulus if needed.
+ *   2) Save the outgoing task’s CPUState (if there is a current task).
+ *   3) Follow the list to the next task (round-robin), wrapping around to
+ *      the front at the end.
  *   4) Return the new currentTask’s cpustate, which the interrupt routine will load.
+ *
+ * Each tick is also where read-copy-update notices quiescent states: the new
+ * task's reader becomes the current one, and ReadCopyUpdate::OnSchedule advances
+ * grace periods.
  */
 CPUState* TaskManager::Schedule(CPUState* cpustate)
 {
     // If no tasks exist, keep running the same context
-    if(numTasks <= 0)
+    if(tasks.IsEmpty())
+    {
+        ReadCopyUpdate::OnSchedule();
         return cpustate;
+    }
     
     // Save the CPUState of the current task
-    if(currentTask >= 0)
-        tasks[currentTask]->cpustate = cpustate;
+    if(currentTask != 0)
+        currentTask->cpustate = cpustate;
     
     // Move to next task in round-robin
-    if(++currentTask >= numTasks)
-        currentTask %= numTasks;
+    Task* next = currentTask == 0 ? 0 : tasks.Next(currentTask);
+    currentTask = next != 0 ? next : tasks.Front();
+    ReadCopyUpdate::SwitchReader(&currentTask->reader);
+    ReadCopyUpdate::OnSchedule();
 
     // Return the chosen task's saved CPUState, so the CPU can switch context
-    return tasks[currentTask]->cpustate;
+    return currentTask->cpustate;
 }
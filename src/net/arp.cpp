@@ -18,13 +18,13 @@ using namespace myos::drivers;
 /*
  * Constructor:
  *   - backend: Pointer to an EtherFrameProvider that provides raw Ethernet communication.
- *   The constructor initializes the ARP handler by setting the number of cached 
- *   entries to 0 and passing the EtherType (0x806) to the EtherFrameHandler base class.
+ *   The constructor initializes the ARP handler by reserving room for MaxCacheEntries
+ *   cache entries and passing the EtherType (0x806) to the EtherFrameHandler base class.
  */
 AddressResolutionProtocol::AddressResolutionProtocol(EtherFrameProvider* backend)
 : EtherFrameHandler(backend, 0x806)  // 0x806 is the ARP EtherType in big-endian format.
 {
-    numCacheEntries = 0;
+    cache.Reserve(MaxCacheEntries);
 }
 
 /*
@@ -98,13 +98,10 @@ bool AddressResolutionProtocol::OnEtherFrameReceived(uint8_t* etherframePayload,
                     /*
                      * For an ARP response:
                      *  - Cache the mapping (IP -> MAC) in our ARP cache if there is room.
+                     *    A known IP always gets its MAC updated.
                      */
-                    if(numCacheEntries < 128)
-                    {
-                        IPcache[numCacheEntries] = arp->srcIP;
-                        MACcache[numCacheEntries] = arp->srcMAC;
-                        numCacheEntries++;
-                    }
+                    if(cache.Size() < MaxCacheEntries || cache.Contains(arp->srcIP))
+                        cache.Insert(arp->srcIP, arp->srcMAC);
                     break;
             }
         }
@@ -138,7 +135,7 @@ void AddressResolutionProtocol::BroadcastMACAddress(uint32_t IP_BE)
     // Set source addresses to our device's values.
     arp.srcMAC = backend->GetMACAddress();
     arp.srcIP = backend->GetIPAddress();
-    // Set destination addresses: use the result from Resolve() to get the correct MAC for the given IP.
+    // Set destination addresses: the MAC from Resolve(), or broadcast while it is unknown.
     arp.dstMAC = Resolve(IP_BE);
     arp.dstIP = IP_BE;
     
@@ -191,9 +188,9 @@ void AddressResolutionProtocol::RequestMACAddress(uint32_t IP_BE)
  */
 uint64_t AddressResolutionProtocol::GetMACFromCache(uint32_t IP_BE)
 {
-    for(int i = 0; i < numCacheEntries; i++)
-        if(IPcache[i] == IP_BE)
-            return MACcache[i];
+    uint64_t MAC;
+    if(cache.Lookup(IP_BE, MAC))
+        return MAC;
     return 0xFFFFFFFFFFFF; // Return the broadcast address if not found.
 }
 
@@ -203,26 +200,22 @@ uint64_t AddressResolutionProtocol::GetMACFromCache(uint32_t IP_BE)
  * ----------------------------------------------------------------------------
  *
  * Attempts to resolve a given IP address to a MAC address by consulting the ARP cache.
- * If the MAC address is not in the cache, it sends an ARP request and then waits 
- * (busy-wait loop) until the MAC address is found.
+ * If the MAC address is not in the cache, it sends an ARP request and returns right away.
+ * Replies are received outside the NIC's interrupt handler (see
+ * amd_am79c973::SetDeferredReceive), so waiting here for one would never end when this
+ * is called from the code that receives them.
  *
  * Parameters:
  *   - IP_BE: The IP address in big-endian format to resolve.
  *
  * Returns:
- *   - The resolved MAC address.
- *
- * Note: The busy-wait loop can potentially block forever if no response is received.
+ *   - The cached MAC address, or the broadcast address (0xFFFFFFFFFFFF) while the
+ *     reply is outstanding; a frame sent to it still reaches the host on the local network.
  */
 uint64_t AddressResolutionProtocol::Resolve(uint32_t IP_BE)
 {
     uint64_t result = GetMACFromCache(IP_BE);
     if(result == 0xFFFFFFFFFFFF)
         RequestMACAddress(IP_BE);
-
-    // Busy-wait until the ARP cache is updated with the MAC address.
-    while(result == 0xFFFFFFFFFFFF) // potential infinite loop if no reply is received
-        result = GetMACFromCache(IP_BE);
-    
     return result;
 }
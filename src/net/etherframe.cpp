@@ -35,17 +35,21 @@ EtherFrameHandler::EtherFrameHandler(EtherFrameProvider* backend, uint16_t ether
     this->backend = backend;
     
     // Register this handler for the specific EtherType in the backend.
-    backend->handlers[etherType_BE] = this;
+    ReadCopyUpdate::Publish(backend->handlers[etherType_BE], this);
 }
 
 /*
  * Destructor:
- *  - Unregisters this handler from its backend if it is currently registered.
+ *  - Unregisters this handler from its backend if it is currently registered, and waits
+ *    for a grace period so that no frame is still being handed to it.
  */
 EtherFrameHandler::~EtherFrameHandler()
 {
     if(backend->handlers[etherType_BE] == this)
-        backend->handlers[etherType_BE] = 0;
+    {
+        ReadCopyUpdate::Publish(backend->handlers[etherType_BE], (EtherFrameHandler*)0);
+        ReadCopyUpdate::Synchronize();
+    }
 }
             
 /*
@@ -153,13 +157,19 @@ bool EtherFrameProvider::OnRawDataReceived(common::uint8_t* buffer, common::uint
     
     EtherFrameHeader* frame = (EtherFrameHeader*)buffer;
     bool sendBack = false;
+    receivedFrames.Increment();
     
     // Check if the frame is broadcast or destined for this NIC.
     if(frame->dstMAC_BE == 0xFFFFFFFFFFFF || frame->dstMAC_BE == backend->GetMACAddress())
     {
-        if(handlers[frame->etherType_BE] != 0)
-            sendBack = handlers[frame->etherType_BE]->OnEtherFrameReceived(
+        ReadCopyUpdate::ReadLock();
+        EtherFrameHandler* handler = ReadCopyUpdate::Dereference(handlers[frame->etherType_BE]);
+        if(handler != 0)
+            sendBack = handler->OnEtherFrameReceived(
                 buffer + sizeof(EtherFrameHeader), size - sizeof(EtherFrameHeader));
+        else
+            unhandledFrames.Increment();
+        ReadCopyUpdate::ReadUnlock();
     }
     
     // If the handler signals to send a response, swap MAC addresses.
@@ -207,6 +217,7 @@ void EtherFrameProvider::Send(common::uint64_t dstMAC_BE, common::uint16_t ether
     
     // Use the NIC's Send method to transmit the complete frame.
     backend->Send(buffer2, size + sizeof(EtherFrameHeader));
+    sentFrames.Increment();
     
     // Free the allocated memory used for the frame.
     MemoryManager::activeMemoryManager->free(buffer2);
@@ -229,3 +240,22 @@ uint64_t EtherFrameProvider::GetMACAddress()
 {
     return backend->GetMACAddress();
 }
+
+/*
+ * GetReceivedFrameCount / GetUnhandledFrameCount / GetSentFrameCount:
+ *  - Sum the per-processor counters; the totals wrap at 32 bits.
+ */
+uint32_t EtherFrameProvider::GetReceivedFrameCount()
+{
+    return receivedFrames.Sum();
+}
+
+uint32_t EtherFrameProvider::GetUnhandledFrameCount()
+{
+    return unhandledFrames.Sum();
+}
+
+uint32_t EtherFrameProvider::GetSentFrameCount()
+{
+    return sentFrames.Sum();
+}
@@ -29,17 +29,21 @@ InternetProtocolHandler::InternetProtocolHandler(InternetProtocolProvider* backe
 {
     this->backend = backend;
     this->ip_protocol = protocol;
-    backend->handlers[protocol] = this;
+    ReadCopyUpdate::Publish(backend->handlers[protocol], this);
 }
 
 /*
  * Destructor:
- *  - Unregisters this handler from the backend if it is still registered.
+ *  - Unregisters this handler from the backend if it is still registered, and waits
+ *    for a grace period so that no packet is still being handed to it.
  */
 InternetProtocolHandler::~InternetProtocolHandler()
 {
     if(backend->handlers[ip_protocol] == this)
-        backend->handlers[ip_protocol] = 0;
+    {
+        ReadCopyUpdate::Publish(backend->handlers[ip_protocol], (InternetProtocolHandler*)0);
+        ReadCopyUpdate::Synchronize();
+    }
 }
             
 /*
@@ -161,11 +165,15 @@ bool InternetProtocolProvider::OnEtherFrameReceived(uint8_t* etherframePayload,
             length = size;
         
         // Invoke the appropriate InternetProtocolHandler based on ipmessage->protocol.
-        if(handlers[ipmessage->protocol] != 0)
-            sendBack = handlers[ipmessage->protocol]->OnInternetProtocolReceived(
+        // The handler can't be unregistered and destroyed until the section ends.
+        ReadCopyUpdate::ReadLock();
+        InternetProtocolHandler* handler = ReadCopyUpdate::Dereference(handlers[ipmessage->protocol]);
+        if(handler != 0)
+            sendBack = handler->OnInternetProtocolReceived(
                 ipmessage->srcIP, ipmessage->dstIP, 
                 etherframePayload + 4 * ipmessage->headerLength, 
                 length - 4 * ipmessage->headerLength);
+        ReadCopyUpdate::ReadUnlock();
     }
     
     // If a response is required (sendBack is true), prepare the IP header for a reply:
@@ -0,0 +1,87 @@
+#include <net/portallocator.h>
+#include <hardwarecommunication/cpu.h>
+
+using namespace myos;
+using namespace myos::common;
+using namespace myos::net;
+using namespace myos::hardwarecommunication;
+
+/*
+ * ----------------------------------------------------------------------------
+ * PortAllocator Class
+ * ----------------------------------------------------------------------------
+ *
+ * Shared by the TCP and UDP providers: a bitmap of the local ports in use and
+ * a rotating start for the ephemeral port search, so a port that was just given
+ * back isn't handed out again right away.
+ */
+
+/*
+ * Constructor:
+ *  - No port is in use; the ephemeral search starts at FirstEphemeralPort.
+ */
+PortAllocator::PortAllocator()
+{
+    freePort = FirstEphemeralPort;
+}
+
+/*
+ * Allocate:
+ *  - Finds the first port at or after 'freePort' that no socket uses, wrapping
+ *    around to FirstEphemeralPort at the end, marks it as used and advances
+ *    'freePort' past it.
+ *  - Returns the port in network byte order, or 0 if all ports from
+ *    FirstEphemeralPort up are in use.
+ */
+uint16_t PortAllocator::Allocate()
+{
+    uintptr_t flags = CentralProcessingUnit::DisableInterrupts();
+    int32_t port = usedPorts.FindFirstClear(freePort);
+    if(port < FirstEphemeralPort)
+        port = usedPorts.FindFirstClear(FirstEphemeralPort);
+    if(port < FirstEphemeralPort)
+        port = 0;
+    else
+    {
+        usedPorts.Set(port);
+        freePort = port + 1;
+    }
+    CentralProcessingUnit::RestoreInterrupts(flags);
+    return SwapBytes(port);
+}
+
+/*
+ * Claim / Release:
+ *  - Set or clear the port's bit (the bitmap is indexed in host byte order).
+ */
+void PortAllocator::Claim(uint16_t port_BE)
+{
+    uintptr_t flags = CentralProcessingUnit::DisableInterrupts();
+    usedPorts.Set(SwapBytes(port_BE));
+    CentralProcessingUnit::RestoreInterrupts(flags);
+}
+
+void PortAllocator::Release(uint16_t port_BE)
+{
+    uintptr_t flags = CentralProcessingUnit::DisableInterrupts();
+    usedPorts.Clear(SwapBytes(port_BE));
+    CentralProcessingUnit::RestoreInterrupts(flags);
+}
+
+/*
+ * SocketKey:
+ *  - Remote IP in the upper half, then remote port, then local port.
+ */
+uint64_t PortAllocator::SocketKey(uint32_t remoteIP, uint16_t remotePort, uint16_t localPort)
+{
+    return ((uint64_t)remoteIP << 32) | ((uint32_t)remotePort << 16) | localPort;
+}
+
+/*
+ * SwapBytes:
+ *  - Exchanges the two bytes of a port number.
+ */
+uint16_t PortAllocator::SwapBytes(uint16_t port)
+{
+    return ((port & 0xFF00) >> 8) | ((port & 0x00FF) << 8);
+}
@@ -1,8 +1,10 @@
 #include <net/tcp.h>
+#include <hardwarecommunication/cpu.h>
 
 using namespace myos;
 using namespace myos::common;
 using namespace myos::net;
+using namespace myos::hardwarecommunication;
 
 /*
  * ----------------------------------------------------------------------------
@@ -66,12 +68,17 @@ bool TransmissionControlProtocolHandler::HandleTransmissionControlProtocolMessag
  * Initializes the socket:
  *   - Stores the backend pointer.
  *   - Sets the handler to 0 (no data handler attached yet).
+ *   - Clears the endpoints (a socket without a remote endpoint is keyed by its local port alone).
  *   - Sets the initial state to CLOSED.
  */
 TransmissionControlProtocolSocket::TransmissionControlProtocolSocket(TransmissionControlProtocolProvider* backend)
 {
     this->backend = backend;
     handler = 0;
+    remotePort = 0;
+    remoteIP = 0;
+    localPort = 0;
+    localIP = 0;
     state = CLOSED;
 }
 
@@ -135,8 +142,9 @@ void TransmissionControlProtocolSocket::Disconnect()
  * meaning that it receives IPv4 packets with protocol number 6 (TCP) and processes
  * them, dispatching them to the appropriate TCP socket.
  *
- * It maintains an array of pointers to TransmissionControlProtocolSocket objects,
- * keeps track of the number of active sockets, and assigns free local ports for new connections.
+ * It maintains a hash map of TransmissionControlProtocolSocket objects keyed by their
+ * endpoints, so an incoming segment finds its socket without scanning all of them,
+ * and a bitmap of the local ports in use, from which new connections get a free port.
  */
 
 /*
@@ -145,17 +153,13 @@ void TransmissionControlProtocolSocket::Disconnect()
  *
  * Initializes:
  *   - Registers itself to handle TCP packets (protocol 0x06) via the InternetProtocolHandler base.
- *   - Initializes the sockets array to 0.
- *   - Sets the initial number of sockets to 0.
- *   - Sets freePort to 1024 (ephemeral port numbers start at 1024).
+ *   - Measures the TSC rate for the handshake timeouts (this takes 10 ms).
+ *   The sockets map and the local ports start out empty.
  */
 TransmissionControlProtocolProvider::TransmissionControlProtocolProvider(InternetProtocolProvider* backend)
 : InternetProtocolHandler(backend, 0x06) // 0x06 is the protocol number for TCP.
 {
-    for(int i = 0; i < 65535; i++)
-        sockets[i] = 0;
-    numSockets = 0;
-    freePort = 1024;
+    timeStampCounterHz = (uint64_t)CentralProcessingUnit::TimeStampCounterMHz() * 1000000;
 }
 
 /*
@@ -166,6 +170,86 @@ TransmissionControlProtocolProvider::~TransmissionControlProtocolProvider()
 {
 }
 
+/*
+ * RemoveSocket:
+ *  - Takes the socket out of the 'sockets' map and releases its local port,
+ *    unless it was accepted by a listener that still uses the port.
+ *  - A receive path may have looked the socket up just before, so it is freed
+ *    only after a grace period.
+ */
+void TransmissionControlProtocolProvider::RemoveSocket(TransmissionControlProtocolSocket* socket)
+{
+    uintptr_t flags = ReadCopyUpdate::LockUpdates();
+    sockets.Remove(PortAllocator::SocketKey(socket->remoteIP, socket->remotePort, socket->localPort));
+    if(!sockets.Contains(PortAllocator::SocketKey(0, 0, socket->localPort)))
+        ports.Release(socket->localPort);
+    ReadCopyUpdate::UnlockUpdates(flags);
+    ReadCopyUpdate::FreeAfterGracePeriod(&socket->reclaim, socket);
+}
+
+/*
+ * Accept:
+ *  - Allocates a socket for the connection from 'remoteIP_BE':'remotePort_BE' to the
+ *    listener's port, with the listener's handler, in the SYN_RECEIVED state.
+ *  - Files it under the connection's key; the listener keeps its own key, so the
+ *    port goes on accepting connections, and the new socket is removed (and freed)
+ *    on its own when its connection closes.
+ *  - Queues it in 'halfOpen', so it is dropped if the peer never finishes the
+ *    handshake. A connection that can't be queued is refused.
+ */
+TransmissionControlProtocolSocket* TransmissionControlProtocolProvider::Accept(TransmissionControlProtocolSocket* listener,
+                                                                             uint32_t remoteIP_BE, uint16_t remotePort_BE)
+{
+    TransmissionControlProtocolSocket* socket = (TransmissionControlProtocolSocket*)MemoryManager::activeMemoryManager->malloc(sizeof(TransmissionControlProtocolSocket));
+    if(socket == 0)
+        return 0;
+
+    new (socket) TransmissionControlProtocolSocket(this);
+    socket->handler = listener->handler;
+    socket->localIP = listener->localIP;
+    socket->localPort = listener->localPort;
+    socket->remoteIP = remoteIP_BE;
+    socket->remotePort = remotePort_BE;
+    socket->state = SYN_RECEIVED;
+
+    TransmissionControlProtocolHalfOpenConnection connection;
+    connection.key = PortAllocator::SocketKey(remoteIP_BE, remotePort_BE, socket->localPort);
+    connection.socket = socket;
+    connection.deadline = CentralProcessingUnit::ReadTimeStampCounter() + timeStampCounterHz * HalfOpenTimeoutSeconds;
+    if((timeStampCounterHz != 0 && !halfOpen.Push(connection)) || !sockets.Insert(connection.key, socket))
+    {
+        // A queued entry for a socket that isn't in 'sockets' is skipped when it expires.
+        MemoryManager::activeMemoryManager->free(socket);
+        return 0;
+    }
+    return socket;
+}
+
+/*
+ * ExpireHalfOpenConnections:
+ *  - Takes the connections whose deadline has passed off 'halfOpen'. Those whose
+ *    socket is still filed under their key and still waits for the final ACK of
+ *    the handshake are reset and removed; the others have been established or
+ *    closed since.
+ */
+void TransmissionControlProtocolProvider::ExpireHalfOpenConnections()
+{
+    uint64_t now = CentralProcessingUnit::ReadTimeStampCounter();
+    while(!halfOpen.IsEmpty() && halfOpen.Top().deadline <= now)
+    {
+        TransmissionControlProtocolHalfOpenConnection connection;
+        halfOpen.Pop(connection);
+
+        TransmissionControlProtocolSocket* socket = 0;
+        if(sockets.Lookup(connection.key, socket) && socket == connection.socket && socket->state == SYN_RECEIVED)
+        {
+            Send(socket, 0, 0, RST);
+            socket->state = CLOSED;
+            RemoveSocket(socket);
+        }
+    }
+}
+
 
 /*
  * bigEndian32:
@@ -188,14 +272,15 @@ uint32_t bigEndian32(uint32_t x)
  *  - The function first validates that the payload is large enough to hold a TCP header.
  *  - It then casts the payload to a TransmissionControlProtocolHeader.
  *
- *  It searches for a corresponding TCP socket:
- *    - If a socket is in the LISTEN state with a matching local port and IP and the received packet has SYN set,
- *      it is considered a new connection request.
- *    - Otherwise, if a socket matches both local and remote addresses/ports, it is selected.
+ *  It looks up the corresponding TCP socket in the sockets map:
+ *    - A socket that matches both local and remote addresses/ports is selected.
+ *    - Otherwise, if the received packet has SYN set, a socket in the LISTEN state with a
+ *      matching local port and IP is considered for a new connection request.
+ *      It accepts the connection into a new socket (Accept) and goes on listening.
  *
  *  Based on the TCP flags in the header, the function updates the socket's state:
- *    - SYN: For new connection requests (LISTEN state), the socket state changes to SYN_RECEIVED,
- *           local/remote ports and IPs are set, and an acknowledgment (SYN+ACK) is sent.
+ *    - SYN: For new connection requests (LISTEN state), a socket for the connection is
+ *           created in the SYN_RECEIVED state and an acknowledgment (SYN+ACK) is sent from it.
  *    - SYN | ACK: For a socket in SYN_SENT state (client mode), the connection is established,
  *                 an ACK is sent, and the state becomes ESTABLISHED.
  *    - FIN and FIN|ACK: Manage connection termination sequences.
@@ -211,7 +296,12 @@ uint32_t bigEndian32(uint32_t x)
  *  for this purpose.
  *
  *  Finally, if a socket becomes CLOSED, it is removed from the sockets array
- *  and its memory is freed.
+ *  and its memory is freed after a grace period.
+ *
+ *  Before that, connections that have been half-open for too long are dropped.
+ *
+ *  This runs inside the IPv4 layer's read-side section, so the socket looked up
+ *  here stays valid until the function returns even if it is removed meanwhile.
  *
  * Returns:
  *   - false, as the return value is used to indicate if a packet should be echoed back.
@@ -224,24 +314,21 @@ bool TransmissionControlProtocolProvider::OnInternetProtocolReceived(uint32_t sr
         return false;
     TransmissionControlProtocolHeader* msg = (TransmissionControlProtocolHeader*)internetprotocolPayload;
 
+    ExpireHalfOpenConnections();
+
     uint16_t localPort = msg->dstPort;
     uint16_t remotePort = msg->srcPort;
     
     TransmissionControlProtocolSocket* socket = 0;
-    // Search through active sockets for a matching connection or a listening socket.
-    for(uint16_t i = 0; i < numSockets && socket == 0; i++)
+    // Look up the connection first, then (for a connection request) a listening socket.
+    TransmissionControlProtocolSocket* entry = 0;
+    if(!sockets.Lookup(PortAllocator::SocketKey(srcIP_BE, remotePort, localPort), entry) && ((msg->flags) & (SYN | ACK)) == SYN)
     {
-        if( sockets[i]->localPort == msg->dstPort
-         && sockets[i]->localIP == dstIP_BE
-         && sockets[i]->state == LISTEN
-         && (((msg->flags) & (SYN | ACK)) == SYN))
-            socket = sockets[i];
-        else if( sockets[i]->localPort == msg->dstPort
-              && sockets[i]->localIP == dstIP_BE
-              && sockets[i]->remotePort == msg->srcPort
-              && sockets[i]->remoteIP == srcIP_BE)
-            socket = sockets[i];
+        if(sockets.Lookup(PortAllocator::SocketKey(0, 0, localPort), entry) && entry->state != LISTEN)
+            entry = 0;
     }
+    if(entry != 0 && entry->localIP == dstIP_BE)
+        socket = entry;
 
     bool reset = false;
     
@@ -258,9 +345,13 @@ bool TransmissionControlProtocolProvider::OnInternetProtocolReceived(uint32_t sr
                 // Incoming connection request
                 if(socket->state == LISTEN)
                 {
-                    socket->state = SYN_RECEIVED;
-                    socket->remotePort = msg->srcPort;
-                    socket->remoteIP = srcIP_BE;
+                    // The connection gets its own socket; the listener waits for the next one.
+                    socket = Accept(socket, srcIP_BE, remotePort);
+                    if(socket == 0)
+                    {
+                        reset = true;
+                        break;
+                    }
                     // Set acknowledgement to sequence number + 1 (converted to big-endian)
                     socket->acknowledgementNumber = bigEndian32(msg->sequenceNumber) + 1;
                     // Initialize sequence number to a chosen value (0xbeefcafe)
@@ -390,16 +481,10 @@ bool TransmissionControlProtocolProvider::OnInternetProtocolReceived(uint32_t sr
         }
     }
     
-    // If a socket has reached the CLOSED state, remove it from the sockets array
+    // If a socket has reached the CLOSED state, remove it from the sockets map
     // and free its allocated memory.
     if(socket != 0 && socket->state == CLOSED)
-        for(uint16_t i = 0; i < numSockets && socket == 0; i++)
-            if(sockets[i] == socket)
-            {
-                sockets[i] = sockets[--numSockets];
-                MemoryManager::activeMemoryManager->free(socket);
-                break;
-            }
+        RemoveSocket(socket);
     
     return false;
 }
@@ -494,16 +579,17 @@ void TransmissionControlProtocolProvider::Send(TransmissionControlProtocolSocket
  *   1. Allocate memory for a new TCP socket.
  *   2. Construct the socket using placement new.
  *   3. Set the remote IP and port.
- *   4. Choose an available local port from the freePort counter.
+ *   4. Choose a free local port (PortAllocator::Allocate, in network order).
  *   5. Set the local IP to the NIC's IP address.
- *   6. Byte-swap the port numbers (to network order).
- *   7. Add the new socket to the sockets array.
+ *   6. Byte-swap the remote port (to network order).
+ *   7. Add the new socket to the sockets map.
  *   8. Set the state to SYN_SENT.
  *   9. Initialize a starting sequence number.
  *   10. Send an initial SYN segment to begin the TCP handshake.
  *
  * Returns:
- *   - A pointer to the new TransmissionControlProtocolSocket, or 0 if allocation failed.
+ *   - A pointer to the new TransmissionControlProtocolSocket, or 0 if allocation failed
+ *     or no local port is free.
  */
 TransmissionControlProtocolSocket* TransmissionControlProtocolProvider::Connect(uint32_t ip, uint16_t port)
 {
@@ -513,16 +599,27 @@ TransmissionControlProtocolSocket* TransmissionControlProtocolProvider::Connect(
     {
         new (socket) TransmissionControlProtocolSocket(this);
         
+        uint16_t localPort = ports.Allocate();
+        if(localPort == 0)
+        {
+            MemoryManager::activeMemoryManager->free(socket);
+            return 0;
+        }
+
         socket->remotePort = port;
         socket->remoteIP = ip;
-        socket->localPort = freePort++;
+        socket->localPort = localPort;
         socket->localIP = backend->GetIPAddress();
         
-        // Convert port numbers to network byte order (swap bytes)
-        socket->remotePort = ((socket->remotePort & 0xFF00) >> 8) | ((socket->remotePort & 0x00FF) << 8);
-        socket->localPort = ((socket->localPort & 0xFF00) >> 8) | ((socket->localPort & 0x00FF) << 8);
+        // Convert the remote port to network byte order (swap bytes)
+        socket->remotePort = PortAllocator::SwapBytes(socket->remotePort);
         
-        sockets[numSockets++] = socket;
+        if(!sockets.Insert(PortAllocator::SocketKey(socket->remoteIP, socket->remotePort, socket->localPort), socket))
+        {
+            ports.Release(localPort);
+            MemoryManager::activeMemoryManager->free(socket);
+            return 0;
+        }
         socket->state = SYN_SENT;
         
         socket->sequenceNumber = 0xbeefcafe;
@@ -568,13 +665,16 @@ void TransmissionControlProtocolProvider::Disconnect(TransmissionControlProtocol
  *   2. Construct the socket via placement new.
  *   3. Set the socket state to LISTEN.
  *   4. Set the local IP and local port (converted to network order).
- *   5. Add the socket to the sockets array.
+ *   5. Add the socket to the sockets map and mark its port as used.
  *
  * Returns:
- *   - Pointer to the new listening socket.
+ *   - Pointer to the new listening socket, or 0 if allocation failed or
+ *     another socket already listens on the port.
  */
 TransmissionControlProtocolSocket* TransmissionControlProtocolProvider::Listen(uint16_t port)
 {
+    // Convert the port to network byte order.
+    uint16_t localPort = PortAllocator::SwapBytes(port);
     TransmissionControlProtocolSocket* socket = (TransmissionControlProtocolSocket*)MemoryManager::activeMemoryManager->malloc(sizeof(TransmissionControlProtocolSocket));
     
     if(socket != 0)
@@ -583,10 +683,18 @@ TransmissionControlProtocolSocket* TransmissionControlProtocolProvider::Listen(u
         
         socket->state = LISTEN;
         socket->localIP = backend->GetIPAddress();
-        // Convert the port to network byte order.
-        socket->localPort = ((port & 0xFF00) >> 8) | ((port & 0x00FF) << 8);
+        socket->localPort = localPort;
         
-        sockets[numSockets++] = socket;
+        uintptr_t flags = ReadCopyUpdate::LockUpdates();
+        bool added = !sockets.Contains(PortAllocator::SocketKey(0, 0, localPort)) && sockets.Insert(PortAllocator::SocketKey(0, 0, localPort), socket);
+        if(added)
+            ports.Claim(localPort);
+        ReadCopyUpdate::UnlockUpdates(flags);
+        if(!added)
+        {
+            MemoryManager::activeMemoryManager->free(socket);
+            return 0;
+        }
     }
     
     return socket;
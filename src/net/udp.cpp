@@ -61,6 +61,10 @@ UserDatagramProtocolSocket::UserDatagramProtocolSocket(UserDatagramProtocolProvi
     this->backend = backend;
     handler = 0;       // No handler is attached initially.
     listening = false; // By default, the socket is not in a "listening" state.
+    remotePort = 0;    // No endpoints yet: the provider keys a socket by them.
+    remoteIP = 0;
+    localPort = 0;
+    localIP = 0;
 }
 
 UserDatagramProtocolSocket::~UserDatagramProtocolSocket()
@@ -118,10 +122,10 @@ void UserDatagramProtocolSocket::Disconnect()
  * This class implements the UDP protocol over IP. It receives IPv4 packets with
  * protocol number 17 (UDP) through its base class InternetProtocolHandler.
  *
- * The provider maintains an array of pointers to UserDatagramProtocolSocket
- * objects, which represent individual UDP endpoints. It is responsible for
- * demultiplexing incoming UDP datagrams to the appropriate socket based on the
- * destination port and IP address.
+ * The provider maintains a hash map of UserDatagramProtocolSocket objects,
+ * which represent individual UDP endpoints, keyed by their remote endpoint and
+ * local port. It is responsible for demultiplexing incoming UDP datagrams to the
+ * appropriate socket based on the destination port and IP address.
  *
  * It also allows for creating new UDP sockets via Connect() or Listen() methods,
  * and binding higher-level handlers to these sockets.
@@ -130,11 +134,7 @@ void UserDatagramProtocolSocket::Disconnect()
 UserDatagramProtocolProvider::UserDatagramProtocolProvider(InternetProtocolProvider* backend)
 : InternetProtocolHandler(backend, 0x11) // 0x11 is the protocol number for UDP.
 {
-    // Initialize the sockets array to zero.
-    for(int i = 0; i < 65535; i++)
-        sockets[i] = 0;
-    numSockets = 0;
-    freePort = 1024;  // Start allocating ephemeral ports from 1024.
+    // The sockets map and the local ports start out empty.
 }
 
 UserDatagramProtocolProvider::~UserDatagramProtocolProvider()
@@ -154,12 +154,16 @@ UserDatagramProtocolProvider::~UserDatagramProtocolProvider()
  *  It performs the following steps:
  *    1. Verifies that the size is sufficient to hold a UDP header.
  *    2. Casts the payload to a UserDatagramProtocolHeader to extract UDP header fields.
- *    3. Searches through the active UDP sockets for one that matches either:
- *         a) A socket in a listening state with a matching local port, or
- *         b) A fully connected socket matching both local and remote addresses/ports.
- *    4. If a listening socket is found, it is taken out of the listening state and initialized with the remote IP and port.
+ *    3. Looks up the socket in the sockets map, trying in turn:
+ *         a) A fully connected socket matching both local and remote addresses/ports, or
+ *         b) A socket in a listening state with a matching local port.
+ *    4. If a listening socket is found, it is taken out of the listening state, initialized with
+ *       the remote IP and port, and re-keyed by them.
  *    5. If a matching socket is found, the UDP payload (data after the header) is passed to the socket’s handler.
  *
+ *  This runs inside the IPv4 layer's read-side section, so a socket looked up here
+ *  isn't freed before the function returns, even if it is disconnected meanwhile.
+ *
  *  Returns:
  *    - false, meaning that no echo-back mechanism is implemented by default.
  */
@@ -176,27 +180,27 @@ bool UserDatagramProtocolProvider::OnInternetProtocolReceived(uint32_t srcIP_BE,
     uint16_t remotePort = msg->srcPort;
     
     UserDatagramProtocolSocket* socket = 0;
-    // Search through all allocated UDP sockets to find a match.
-    for(uint16_t i = 0; i < numSockets && socket == 0; i++)
+
+    // Case 1: an already connected socket matching both local and remote endpoints.
+    UserDatagramProtocolSocket* entry = 0;
+    if(sockets.Lookup(PortAllocator::SocketKey(srcIP_BE, remotePort, localPort), entry) && entry->localIP == dstIP_BE)
+        socket = entry;
+
+    // Case 2: a socket in a listening state with a matching local port and IP.
+    if(socket == 0)
     {
-        // Case 1: a socket in a listening state with a matching local port and IP.
-        if(sockets[i]->localPort == msg->dstPort
-           && sockets[i]->localIP == dstIP_BE
-           && sockets[i]->listening)
-        {
-            socket = sockets[i];
-            // The socket is no longer just listening; we record the remote endpoint details.
-            socket->listening = false;
-            socket->remotePort = msg->srcPort;
-            socket->remoteIP = srcIP_BE;
-        }
-        // Case 2: an already connected socket matching both local and remote endpoints.
-        else if(sockets[i]->localPort == msg->dstPort
-                && sockets[i]->localIP == dstIP_BE
-                && sockets[i]->remotePort == msg->srcPort
-                && sockets[i]->remoteIP == srcIP_BE)
+        if(sockets.Lookup(PortAllocator::SocketKey(0, 0, localPort), entry) && entry->localIP == dstIP_BE && entry->listening)
         {
-            socket = sockets[i];
+            socket = entry;
+            // The socket is no longer just listening; we record the remote endpoint details
+            // and file it under them. If that fails, it stays a listening socket.
+            if(sockets.Insert(PortAllocator::SocketKey(srcIP_BE, remotePort, localPort), socket))
+            {
+                sockets.Remove(PortAllocator::SocketKey(0, 0, localPort));
+                socket->listening = false;
+                socket->remotePort = msg->srcPort;
+                socket->remoteIP = srcIP_BE;
+            }
         }
     }
     
@@ -217,15 +221,17 @@ bool UserDatagramProtocolProvider::OnInternetProtocolReceived(uint32_t srcIP_BE,
  *  - Allocates and constructs a new UserDatagramProtocolSocket.
  *  - Sets up the socket with the remote IP and remote port, assigns a free local port,
  *    and sets the local IP from the underlying IP provider.
- *  - Converts both the remote and local port numbers to network byte order.
- *  - Adds the newly created socket to the internal sockets array and returns it.
+ *  - Converts the remote port to network byte order (PortAllocator hands out local
+ *    ports in network byte order already).
+ *  - Adds the newly created socket to the internal sockets map and returns it.
  *
  * Parameters:
  *   - ip: Remote IP address (big-endian) to which to connect.
  *   - port: Remote UDP port.
  *
  * Returns:
- *   - Pointer to the new UserDatagramProtocolSocket, or 0 if allocation failed.
+ *   - Pointer to the new UserDatagramProtocolSocket, or 0 if allocation failed
+ *     or no local port is free.
  */
 UserDatagramProtocolSocket* UserDatagramProtocolProvider::Connect(uint32_t ip, uint16_t port)
 {
@@ -236,16 +242,28 @@ UserDatagramProtocolSocket* UserDatagramProtocolProvider::Connect(uint32_t ip, u
         // Construct the UDP socket in the allocated memory using placement new.
         new (socket) UserDatagramProtocolSocket(this);
         
+        uint16_t localPort = ports.Allocate();
+        if(localPort == 0)
+        {
+            MemoryManager::activeMemoryManager->free(socket);
+            return 0;
+        }
+
         socket->remotePort = port;
         socket->remoteIP = ip;
-        socket->localPort = freePort++;
+        socket->localPort = localPort;
         socket->localIP = backend->GetIPAddress();
         
-        // Swap bytes for port numbers to convert them to network byte order.
-        socket->remotePort = ((socket->remotePort & 0xFF00) >> 8) | ((socket->remotePort & 0x00FF) << 8);
-        socket->localPort = ((socket->localPort & 0xFF00) >> 8) | ((socket->localPort & 0x00FF) << 8);
+        // Swap bytes of the remote port to convert it to network byte order
+        // (the local port already is).
+        socket->remotePort = PortAllocator::SwapBytes(socket->remotePort);
         
-        sockets[numSockets++] = socket;
+        if(!sockets.Insert(PortAllocator::SocketKey(socket->remoteIP, socket->remotePort, socket->localPort), socket))
+        {
+            ports.Release(localPort);
+            MemoryManager::activeMemoryManager->free(socket);
+            return 0;
+        }
     }
     
     return socket;
@@ -258,16 +276,19 @@ UserDatagramProtocolSocket* UserDatagramProtocolProvider::Connect(uint32_t ip, u
  *  - Allocates and constructs a new UserDatagramProtocolSocket.
  *  - Sets the socket's local IP and local port (converted to network byte order),
  *    and marks it as listening.
- *  - Adds the new socket to the sockets array.
+ *  - Adds the new socket to the sockets map and marks its port as used.
  *
  * Parameters:
  *   - port: The UDP port on which to listen for incoming datagrams.
  *
  * Returns:
- *   - Pointer to the new UserDatagramProtocolSocket.
+ *   - Pointer to the new UserDatagramProtocolSocket, or 0 if allocation failed
+ *     or another socket already listens on the port.
  */
 UserDatagramProtocolSocket* UserDatagramProtocolProvider::Listen(uint16_t port)
 {
+    // Convert the port number to network byte order.
+    uint16_t localPort = PortAllocator::SwapBytes(port);
     UserDatagramProtocolSocket* socket = (UserDatagramProtocolSocket*)MemoryManager::activeMemoryManager->malloc(sizeof(UserDatagramProtocolSocket));
     
     if(socket != 0)
@@ -276,10 +297,18 @@ UserDatagramProtocolSocket* UserDatagramProtocolProvider::Listen(uint16_t port)
         
         socket->listening = true;
         socket->localIP = backend->GetIPAddress();
-        // Convert the port number to network byte order.
-        socket->localPort = ((port & 0xFF00) >> 8) | ((port & 0x00FF) << 8);
+        socket->localPort = localPort;
         
-        sockets[numSockets++] = socket;
+        uintptr_t flags = ReadCopyUpdate::LockUpdates();
+        bool added = !sockets.Contains(PortAllocator::SocketKey(0, 0, localPort)) && sockets.Insert(PortAllocator::SocketKey(0, 0, localPort), socket);
+        if(added)
+            ports.Claim(localPort);
+        ReadCopyUpdate::UnlockUpdates(flags);
+        if(!added)
+        {
+            MemoryManager::activeMemoryManager->free(socket);
+            return 0;
+        }
     }
     
     return socket;
@@ -288,22 +317,22 @@ UserDatagramProtocolSocket* UserDatagramProtocolProvider::Listen(uint16_t port)
 /*
  * Disconnect:
  *  - Removes a UDP socket from active use.
- *  - Searches for the provided socket in the sockets array and, if found, removes it,
- *    and frees its allocated memory.
+ *  - Removes the provided socket from the sockets map (by its key) and releases its
+ *    local port. The receive path may still be handing it a datagram, so its memory
+ *    is freed after a grace period.
  *
  * Parameters:
  *   - socket: Pointer to the UserDatagramProtocolSocket to disconnect.
  */
 void UserDatagramProtocolProvider::Disconnect(UserDatagramProtocolSocket* socket)
 {
-    for(uint16_t i = 0; i < numSockets && socket == 0; i++)
-        if(sockets[i] == socket)
-        {
-            // Replace the socket with the last socket in the array.
-            sockets[i] = sockets[--numSockets];
-            MemoryManager::activeMemoryManager->free(socket);
-            break;
-        }
+    uintptr_t flags = ReadCopyUpdate::LockUpdates();
+    bool removed = sockets.Remove(PortAllocator::SocketKey(socket->remoteIP, socket->remotePort, socket->localPort));
+    if(removed)
+        ports.Release(socket->localPort);
+    ReadCopyUpdate::UnlockUpdates(flags);
+    if(removed)
+        ReadCopyUpdate::FreeAfterGracePeriod(&socket->reclaim, socket);
 }
 
 /*
@@ -0,0 +1,151 @@
+#include <perprocessor.h>
+#include <hardwarecommunication/cpu.h>
+
+/*
+ * The per-processor areas belong to the 'myos' namespace like the GDT that
+ * points the GS segment at them; integer types come from 'myos::common'.
+ */
+using namespace myos;
+using namespace myos::common;
+using namespace myos::hardwarecommunication;
+
+
+/*
+ * ----------------------------------------------------------------------------
+ * PerProcessor Class
+ * ----------------------------------------------------------------------------
+ *
+ * The areas are static, so they exist (zeroed) before any constructor runs and
+ * their addresses are known when the GDT is built. 'reserved' is zero before the
+ * static constructors that call Reserve run, whatever their order.
+ */
+PerProcessorArea PerProcessor::areas[PerProcessor::MaxProcessors];
+size_t PerProcessor::reserved = 0;
+uint32_t PerProcessor::processorsOnline = 0;
+PerProcessor::FreeRange PerProcessor::freeRanges[PerProcessor::MaxFreeRanges];
+uint32_t PerProcessor::freeRangeCount = 0;
+
+/*
+ * Reserve:
+ *  - Reuses a released range of exactly 'size' bytes that has the right
+ *    alignment, if there is one (it was zeroed when it was released).
+ *  - Otherwise hands out the next 'size' bytes of 'data', aligned within the
+ *    area (areas themselves are cache line aligned).
+ *  - Returns the offset from the start of an area, or 0, which is never a
+ *    valid offset (the header is there), if the areas are full.
+ *  - Runs with interrupts off, since objects may be created by any task.
+ */
+size_t PerProcessor::Reserve(size_t size, size_t alignment)
+{
+    uintptr_t flags = CentralProcessingUnit::DisableInterrupts();
+
+    for(uint32_t i = 0; i < freeRangeCount; i++)
+    {
+        if(freeRanges[i].size == size && (freeRanges[i].offset & (alignment - 1)) == 0)
+        {
+            size_t offset = freeRanges[i].offset;
+            freeRanges[i] = freeRanges[--freeRangeCount];
+            CentralProcessingUnit::RestoreInterrupts(flags);
+            return offset;
+        }
+    }
+
+    size_t start = (uint8_t*)areas[0].data - (uint8_t*)&areas[0];
+    size_t offset = (start + reserved + alignment - 1) & ~(alignment - 1);
+    if(offset + size > sizeof(PerProcessorArea))
+        offset = 0;
+    else
+        reserved = offset + size - start;
+
+    CentralProcessingUnit::RestoreInterrupts(flags);
+    return offset;
+}
+
+/*
+ * Release:
+ *  - Zeroes the range in every area, so whoever gets it next starts at 0.
+ *  - The range at the end of what was handed out goes back to the bump
+ *    pointer; any other one is kept for Reserve to reuse. If 'freeRanges'
+ *    is full, the range stays unused.
+ */
+void PerProcessor::Release(size_t offset, size_t size)
+{
+    if(offset == 0)
+        return;
+
+    uintptr_t flags = CentralProcessingUnit::DisableInterrupts();
+
+    for(uint32_t i = 0; i < MaxProcessors; i++)
+    {
+        uint8_t* bytes = (uint8_t*)&areas[i] + offset;
+        for(size_t j = 0; j < size; j++)
+            bytes[j] = 0;
+    }
+
+    size_t start = (uint8_t*)areas[0].data - (uint8_t*)&areas[0];
+    if(offset + size == start + reserved)
+        reserved = offset - start;
+    else if(freeRangeCount < MaxFreeRanges)
+    {
+        freeRanges[freeRangeCount].offset = offset;
+        freeRanges[freeRangeCount].size = size;
+        freeRangeCount++;
+    }
+
+    CentralProcessingUnit::RestoreInterrupts(flags);
+}
+
+/*
+ * Initialize:
+ *  - Fills in the area's header, which This() and CurrentIndex() read through
+ *    GS, and counts the processor as online, so Sum() includes its counters.
+ */
+void PerProcessor::Initialize(uint32_t index)
+{
+    areas[index].self = &areas[index];
+    areas[index].index = index;
+    if(index >= processorsOnline)
+        processorsOnline = index + 1;
+}
+
+
+/*
+ * ----------------------------------------------------------------------------
+ * PerProcessorCounter Class
+ * ----------------------------------------------------------------------------
+ */
+
+/*
+ * Constructor:
+ *  - Reserves a word in every area; the word starts out at 0.
+ */
+PerProcessorCounter::PerProcessorCounter()
+{
+    offset = PerProcessor::Reserve(sizeof(uintptr_t), sizeof(uintptr_t));
+}
+
+/*
+ * Destructor:
+ *  - Gives the word back in every area.
+ */
+PerProcessorCounter::~PerProcessorCounter()
+{
+    PerProcessor::Release(offset, sizeof(uintptr_t));
+}
+
+/*
+ * Sum:
+ *  - Adds up the words of the processors that are online. Each word is read
+ *    whole, so a value is never torn, but the total may miss increments that
+ *    happen while it is being added up.
+ */
+uint64_t PerProcessorCounter::Sum()
+{
+    if(offset == 0)
+        return 0;
+
+    uint64_t sum = 0;
+    for(uint32_t i = 0; i < PerProcessor::ProcessorsOnline(); i++)
+        sum += *(volatile uintptr_t*)((uint8_t*)PerProcessor::Area(i) + offset);
+    return sum;
+}
@@ -0,0 +1,170 @@
+#include <readcopyupdate.h>
+
+/*
+ * The read-copy-update machinery lives in the 'myos' namespace next to the
+ * scheduler it hooks into; integer types and lists come from 'myos::common'.
+ */
+using namespace myos;
+using namespace myos::common;
+
+
+/*
+ * ----------------------------------------------------------------------------
+ * ReadCopyUpdate Class
+ * ----------------------------------------------------------------------------
+ *
+ * All state is static: there is one set of readers and one grace period
+ * machine for the whole kernel. 'currentReader' starts out at the boot
+ * context's reader, so read-side sections work before the scheduler runs.
+ */
+ReadCopyUpdateReader ReadCopyUpdate::bootReader;
+bool ReadCopyUpdate::bootReaderRetired = false;
+ReadCopyUpdateReader* ReadCopyUpdate::currentReader = &ReadCopyUpdate::bootReader;
+IntrusiveList<ReadCopyUpdateReader, &ReadCopyUpdateReader::node> ReadCopyUpdate::readers;
+IntrusiveList<ReadCopyUpdateCallback, &ReadCopyUpdateCallback::node> ReadCopyUpdate::pending;
+IntrusiveList<ReadCopyUpdateCallback, &ReadCopyUpdateCallback::node> ReadCopyUpdate::waiting;
+bool ReadCopyUpdate::gracePeriodActive = false;
+uint32_t ReadCopyUpdate::holdouts = 0;
+
+/*
+ * CallAfterGracePeriod:
+ *  - Queues the callback for the next grace period. The queue is shared with the
+ *    timer interrupt, so interrupts are off while it is changed.
+ */
+void ReadCopyUpdate::CallAfterGracePeriod(ReadCopyUpdateCallback* callback, void (*function)(void*), void* object)
+{
+    callback->function = function;
+    callback->object = object;
+
+    uintptr_t flags = LockUpdates();
+    pending.PushBack(callback);
+    UnlockUpdates(flags);
+}
+
+/*
+ * Synchronize:
+ *  - Queues a callback that sets a flag and halts until a timer tick has run it.
+ *    The flag lives on this stack, which stays valid until the callback has run.
+ */
+void ReadCopyUpdate::SetFlag(void* flag)
+{
+    *(volatile bool*)flag = true;
+}
+
+void ReadCopyUpdate::Synchronize()
+{
+    volatile bool done = false;
+    ReadCopyUpdateCallback callback;
+    CallAfterGracePeriod(&callback, &SetFlag, (void*)&done);
+    while(!done)
+        asm volatile("hlt");
+}
+
+/*
+ * AddReader:
+ *  - Starts tracking a task's reader (called by TaskManager::AddTask).
+ */
+void ReadCopyUpdate::AddReader(ReadCopyUpdateReader* reader)
+{
+    uintptr_t flags = LockUpdates();
+    readers.PushBack(reader);
+    UnlockUpdates(flags);
+}
+
+/*
+ * SwitchReader:
+ *  - Makes 'reader' the running context's reader.
+ *  - The boot context is left for good at the first task switch (the scheduler never
+ *    returns to it), so sections it was in can't hold up grace periods any more.
+ */
+void ReadCopyUpdate::SwitchReader(ReadCopyUpdateReader* reader)
+{
+    if(currentReader == &bootReader && reader != &bootReader && !bootReaderRetired)
+    {
+        bootReaderRetired = true;
+        if(bootReader.holdout)
+        {
+            bootReader.holdout = false;
+            holdouts--;
+        }
+    }
+    currentReader = reader;
+}
+
+/*
+ * StartGracePeriod:
+ *  - Takes over the pending callbacks and notes every reader that is inside a
+ *    read-side section right now. Interrupts are off, so no reader is half way
+ *    into or out of a section on this CPU; interrupt handlers have all finished.
+ */
+void ReadCopyUpdate::StartGracePeriod()
+{
+    while(!pending.IsEmpty())
+        waiting.PushBack(pending.PopFront());
+
+    holdouts = 0;
+    if(!bootReaderRetired)
+        NoteReader(&bootReader);
+    for(ReadCopyUpdateReader* reader = readers.Front(); reader != 0; reader = readers.Next(reader))
+        NoteReader(reader);
+
+    gracePeriodActive = true;
+}
+
+/*
+ * NoteReader:
+ *  - Makes the reader a holdout of the new grace period if it is inside a section.
+ */
+void ReadCopyUpdate::NoteReader(ReadCopyUpdateReader* reader)
+{
+    reader->holdout = reader->nesting != 0;
+    reader->snapshot = reader->sectionsEnded;
+    if(reader->holdout)
+        holdouts++;
+}
+
+/*
+ * CheckHoldout:
+ *  - A holdout is done when it is outside any section or has left the outermost
+ *    section it was in (it may have entered a new one since, which is fine).
+ */
+void ReadCopyUpdate::CheckHoldout(ReadCopyUpdateReader* reader)
+{
+    if(reader->holdout && (reader->nesting == 0 || reader->sectionsEnded != reader->snapshot))
+    {
+        reader->holdout = false;
+        holdouts--;
+    }
+}
+
+/*
+ * OnSchedule:
+ *  - Called on every timer tick with interrupts off.
+ *  - Checks the holdouts of the current grace period; when none is left, runs its
+ *    callbacks. Then starts the next grace period if callbacks are pending. One with
+ *    no holdouts ends right away: every earlier section has ended, and later ones
+ *    see the published versions.
+ */
+void ReadCopyUpdate::OnSchedule()
+{
+    if(gracePeriodActive)
+    {
+        if(!bootReaderRetired)
+            CheckHoldout(&bootReader);
+        for(ReadCopyUpdateReader* reader = readers.Front(); reader != 0 && holdouts != 0; reader = readers.Next(reader))
+            CheckHoldout(reader);
+    }
+
+    if(!gracePeriodActive && !pending.IsEmpty())
+        StartGracePeriod();
+
+    if(gracePeriodActive && holdouts == 0)
+    {
+        gracePeriodActive = false;
+        while(!waiting.IsEmpty())
+        {
+            ReadCopyUpdateCallback* callback = waiting.PopFront();
+            callback->function(callback->object);
+        }
+    }
+}
@@ -57,19 +57,29 @@ extern void printf(char*);
  * For example:
  *   - case 4: treat it as a "print string" system call. The address of the string is in ebx.
  *
- * Returns the (potentially modified) stack pointer.
+ * Leaves 'esp' unchanged: the 64-bit SYSCALL entry relies on system calls never
+ * switching tasks (see HandleSystemCall in interruptstubs64.s). The interrupt is
+ * always claimed.
  */
-uint32_t SyscallHandler::HandleInterrupt(uint32_t esp)
+bool SyscallHandler::HandleInterrupt(uintptr_t& esp)
 {
     // Interpret 'esp' as a pointer to the CPUState structure
     CPUState* cpu = (CPUState*)esp;
     
-    // The system call number is placed in EAX by convention
-    switch(cpu->eax)
+    // The system call number is placed in EAX (RAX) by convention, the argument in EBX (RBX)
+#ifdef __x86_64__
+    uintptr_t number = cpu->rax;
+    uintptr_t argument = cpu->rbx;
+#else
+    uintptr_t number = cpu->eax;
+    uintptr_t argument = cpu->ebx;
+#endif
+
+    switch(number)
     {
         case 4:
             // Syscall #4: print the string pointed to by EBX
-            printf((char*)cpu->ebx);
+            printf((char*)argument);
             break;
             
         default:
@@ -77,6 +87,6 @@ uint32_t SyscallHandler::HandleInterrupt(uint32_t esp)
             break;
     }
 
-    // Return the stack pointer (unchanged in this basic example)
-    return esp;
+    // The stack pointer stays unchanged in this basic example
+    return true;
 }